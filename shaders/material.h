@@ -3,20 +3,74 @@
 // Materials
 const uint TEX_ALBEDO = 0;
 const uint TEX_NORMAL = 1;
-const uint TEX_METALNESS = 2;
-const uint TEX_ROUGHNESS = 3;
-const uint TEX_AO = 4;
-const uint TEX_COUNT = 5;
-layout(set = 1, binding = 0) uniform sampler2D texPBR[TEX_COUNT];
-layout(set = 1, binding = 1) uniform PBRFactors {
+// Occlusion, roughness and metalness in R, G and B
+const uint TEX_ORM = 2;
+const uint TEX_COUNT = 3;
+// Mirrors MaterialManager::MAX_MATERIAL_TEXTURES
+const uint MAX_MATERIAL_TEXTURES = 4096;
+
+// Textures of all materials, partially bound
+layout(set = 1, binding = 0) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout(set = 1, binding = 1) uniform sampler materialSampler;
+
+// Mirrors Material::PBRFactors
+struct PBRFactors
+{
     vec4 vBaseColorFactors;
-    float fRoughness;
     float fMetalness;
-    uint UVIndices0;
-    uint UVIndices1;
-    uint UVIndices2;
-    uint UVIndices3;
-    uint UVIndices4;
-    float padding0;
-} factors;
+    float fRoughness;
+    uint UVIndices[TEX_COUNT];
+    float fReconstructNormalZ;
+    uint FeedbackIds[TEX_COUNT];
+    uint BaseMips[TEX_COUNT];
+    uint TextureIds[TEX_COUNT];
+    uint uPadding;
+};
+layout(std430, set = 1, binding = 2) readonly buffer MaterialFactors {
+    PBRFactors aFactors[];
+} materialFactors;
+
+// Finest level of the full mip chain sampled per streamed texture
+layout(set = 1, binding = 3) buffer MipFeedback {
+    uint uRequestedMips[];
+} mipFeedback;
+
+layout(push_constant) uniform MaterialPushConstants {
+    uint uMaterialIndex;
+} material;
+
+PBRFactors GetMaterialFactors()
+{
+    return materialFactors.aFactors[material.uMaterialIndex];
+}
+
+// The material index is uniform across the draw, so are the texture slots
+vec4 SampleMaterialTexture(PBRFactors factors, uint uTexture, vec2 inTexCoords[2])
+{
+    return texture(sampler2D(materialTextures[factors.TextureIds[uTexture]], materialSampler),
+                   inTexCoords[factors.UVIndices[uTexture]]);
+}
+
+void WriteMipFeedback(PBRFactors factors, uint uTexture, vec2 inTexCoords[2], bool bWrite)
+{
+    // Derivatives need the whole quad, query before the per pixel branch.
+    // The unclamped LOD is relative to the resident base level.
+    vec2 vTexCoords = inTexCoords[factors.UVIndices[uTexture]];
+    float fLod = textureQueryLod(sampler2D(materialTextures[factors.TextureIds[uTexture]], materialSampler), vTexCoords).y +
+                 float(factors.BaseMips[uTexture]);
+    uint uFeedbackId = factors.FeedbackIds[uTexture];
+    if (bWrite && uFeedbackId != 0)
+    {
+        atomicMin(mipFeedback.uRequestedMips[uFeedbackId], uint(max(fLod, 0.0)));
+    }
+}
+
+void WriteMaterialMipFeedback(PBRFactors factors, vec2 inTexCoords[2])
+{
+    // One pixel per 8x8 tile is enough to find the sampled levels
+    bool bWrite = all(equal(uvec2(gl_FragCoord.xy) & 7u, uvec2(0u)));
+    WriteMipFeedback(factors, TEX_ALBEDO, inTexCoords, bWrite);
+    WriteMipFeedback(factors, TEX_NORMAL, inTexCoords, bWrite);
+    WriteMipFeedback(factors, TEX_ORM, inTexCoords, bWrite);
+}
 #endif
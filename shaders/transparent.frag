@@ -44,18 +44,21 @@ void main()
     inTexCoords[0] = inTexCoords0;
     inTexCoords[1] = inTexCoords1;
 
-    uint UVIndices[5];
-    UVIndices[0] = factors.UVIndices0;
-    UVIndices[1] = factors.UVIndices1;
-    UVIndices[2] = factors.UVIndices2;
-    UVIndices[3] = factors.UVIndices3;
-    UVIndices[4] = factors.UVIndices4;
-    vec3 vTextureNormal = texture(texPBR[TEX_NORMAL], inTexCoords[UVIndices[TEX_NORMAL]]).xyz;
+    const PBRFactors factors = GetMaterialFactors();
+    WriteMaterialMipFeedback(factors, inTexCoords);
+    vec3 vTextureNormal = SampleMaterialTexture(factors, TEX_NORMAL, inTexCoords).xyz;
+    if (factors.fReconstructNormalZ > 0.0)
+    {
+        // Two channel normal maps, rebuild Z from the unit length
+        vec2 vNormalXY = vTextureNormal.xy * 2.0 - 1.0;
+        vTextureNormal.z = sqrt(max(1.0 - dot(vNormalXY, vNormalXY), 0.0)) * 0.5 + 0.5;
+    }
     vec3 vWorldNormal = normalize(inWorldNormal.xyz + vTextureNormal);
 
-    const vec4 baseColor = texture(texPBR[TEX_ALBEDO], inTexCoords[UVIndices[TEX_ALBEDO]]) * factors.vBaseColorFactors;
-    const float fMetallic = texture(texPBR[TEX_METALNESS], inTexCoords[UVIndices[TEX_METALNESS]]).r * factors.fMetalness;
-    const float fRoughness = texture(texPBR[TEX_ROUGHNESS], inTexCoords[UVIndices[TEX_ROUGHNESS]]).g * factors.fRoughness;
+    const vec4 baseColor = SampleMaterialTexture(factors, TEX_ALBEDO, inTexCoords) * factors.vBaseColorFactors;
+    const vec3 vORM = SampleMaterialTexture(factors, TEX_ORM, inTexCoords).rgb;
+    const float fMetallic = vORM.b * factors.fMetalness;
+    const float fRoughness = vORM.g * factors.fRoughness;
 
     vec3 vLo = vec3(0.0);
     const vec3 vViewPos = (ubo.view * inWorldPos).xyz;
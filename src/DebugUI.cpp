@@ -1,6 +1,8 @@
 #include "DebugUI.h"
+#include "DescriptorManager.h"
 #include "RenderResourceManager.h"
 #include "SceneManager.h"
+#include "Texture.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/matrix_decompose.hpp>
@@ -17,6 +19,24 @@ void ResourceManagerDebugPage::Render() const
         {
             ImGui::Text("%s", resMap.first.c_str());
         }
+
+        // Texture memory per quality tier, savings relative to full resolution
+        const char* aTierNames[TEXTURE_QUALITY_TIER_COUNT] = {"High", "Medium", "Low"};
+        const auto aTierSizes = GetTextureManager()->GetQualityTierSizes();
+        const double MB = 1024.0 * 1024.0;
+        for (size_t i = 0; i < TEXTURE_QUALITY_TIER_COUNT; i++)
+        {
+            ImGui::Text("%s%s textures: %.1f MB, %.1f MB saved", aTierNames[i],
+                        GetTextureManager()->GetQualityTier() == i ? " (current)" : "", aTierSizes[i] / MB,
+                        (aTierSizes[TEXTURE_QUALITY_HIGH] - aTierSizes[i]) / MB);
+        }
+
+        const DescriptorAllocator::Stats& descStats = GetDescriptorManager()->GetDescriptorStats();
+        const DescriptorAllocator::Stats transientDescStats = GetDescriptorManager()->GetTransientDescriptorStats();
+        ImGui::Text("Descriptor sets: %u (peak %u) in %u pools", descStats.m_uNumSets, descStats.m_uPeakSets,
+                    descStats.m_uNumPools);
+        ImGui::Text("Transient descriptor sets: %u (peak %u) in %u pools", transientDescStats.m_uNumSets,
+                    transientDescStats.m_uPeakSets, transientDescStats.m_uNumPools);
     }
     ImGui::End();
 }
@@ -29,6 +49,25 @@ void SceneDebugPage::Render() const
         for (const auto& scenePair : sceneMap)
         {
             const auto& pRoot = scenePair.second.GetRoot();
+            const StaticBatchStats& batchStats = scenePair.second.GetStaticBatchStats();
+            if (batchStats.m_uNumBatches > 0)
+            {
+                ImGui::Text("%s: %u draws -> %u draws (%u primitives in %u static batches)",
+                            scenePair.first.c_str(), batchStats.m_uDrawsBefore,
+                            batchStats.m_uDrawsAfter, batchStats.m_uNumMergedPrimitives,
+                            batchStats.m_uNumBatches);
+            }
+            const auto& vHLODClusters = scenePair.second.GetHLODClusters();
+            if (!vHLODClusters.empty())
+            {
+                size_t nActiveProxies = 0;
+                for (const HLODCluster& cluster : vHLODClusters)
+                {
+                    nActiveProxies += cluster.m_bIsProxyActive ? 1 : 0;
+                }
+                ImGui::Text("%s: %zu/%zu HLOD proxies active", scenePair.first.c_str(),
+                            nActiveProxies, vHLODClusters.size());
+            }
             std::function<void(const SceneNode*)>
                 DisplayNodesRecursive = [&](const SceneNode* pSceneNode) {
                     if (ImGui::TreeNode(pSceneNode->GetName().c_str()))
@@ -0,0 +1,114 @@
+#include "Defragmentation.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "UploadManager.h"
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+static DefragmentationManager s_defragmentationManager;
+
+DefragmentationManager* GetDefragmentationManager()
+{
+    return &s_defragmentationManager;
+}
+
+// Frames between fragmentation checks
+static const uint64_t STEP_INTERVAL = 60;
+// Frames to wait after a step found nothing to move
+static const uint64_t IDLE_INTERVAL = 600;
+
+void DefragmentationManager::Initialize(VkDeviceSize uBytesPerStep, float fMaxUnusedRatio)
+{
+    m_uBytesPerStep = uBytesPerStep;
+    m_fMaxUnusedRatio = fMaxUnusedRatio;
+    m_uFrame = 0;
+    m_uNextStepFrame = STEP_INTERVAL;
+}
+
+void DefragmentationManager::Unintialize()
+{
+    m_vpOwners.clear();
+}
+
+void DefragmentationManager::Register(IDefragmentable* pOwner)
+{
+    assert(std::find(m_vpOwners.begin(), m_vpOwners.end(), pOwner) == m_vpOwners.end());
+    m_vpOwners.push_back(pOwner);
+}
+
+void DefragmentationManager::Unregister(IDefragmentable* pOwner)
+{
+    m_vpOwners.erase(std::remove(m_vpOwners.begin(), m_vpOwners.end(), pOwner), m_vpOwners.end());
+}
+
+bool DefragmentationManager::Update()
+{
+    m_uFrame++;
+    // Queued uploads would have to land first, wait for a quieter frame
+    if (m_uFrame < m_uNextStepFrame || m_vpOwners.empty() || !GetUploadManager()->IsIdle())
+    {
+        return false;
+    }
+    // Moves overwrite memory submitted frames may still read, and host
+    // visible data moves on the CPU as the step begins. Rather than waiting
+    // for the device, steps run in frames whose predecessors' fences already
+    // signaled, so neither the copies nor the re-recording stall.
+    if (GetRenderDevice()->GetCompletedFrameCount() < GetRenderDevice()->GetSubmittedFrameCount())
+    {
+        return false;
+    }
+    m_uNextStepFrame = m_uFrame + STEP_INTERVAL;
+
+    // Images are not movable, only the buffer pool counts
+    VkDeviceSize uUsed = 0, uUnused = 0;
+    GetMemoryAllocator()->GetMovableBufferPoolUsage(uUsed, uUnused);
+    if (uUnused <= static_cast<VkDeviceSize>((uUsed + uUnused) * m_fMaxUnusedRatio))
+    {
+        return false;
+    }
+
+    std::vector<VmaAllocation> vAllocations;
+    std::vector<IDefragmentable*> vpOwners;
+    for (IDefragmentable* pOwner : m_vpOwners)
+    {
+        pOwner->GetMovableAllocations(vAllocations);
+        vpOwners.resize(vAllocations.size(), pOwner);
+    }
+    if (vAllocations.empty())
+    {
+        return false;
+    }
+
+    // Submitted frames are done, waiting is bounded by the step's copies
+    std::vector<VkBool32> vMoved;
+    VmaDefragmentationContext context = VK_NULL_HANDLE;
+    GetRenderDevice()->ExecuteImmediateCommand([&](VkCommandBuffer cmdBuf) {
+        context = GetMemoryAllocator()->BeginDefragmentation(vAllocations, vMoved, m_uBytesPerStep, cmdBuf);
+        // Later frames read the moved data
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    });
+    GetMemoryAllocator()->EndDefragmentation(context);
+
+    bool bMoved = false;
+    for (size_t i = 0; i < vAllocations.size(); i++)
+    {
+        if (vMoved[i])
+        {
+            vpOwners[i]->OnAllocationMoved(vAllocations[i]);
+            bMoved = true;
+        }
+    }
+    if (!bMoved)
+    {
+        // The free space is between allocations that can't move
+        m_uNextStepFrame = m_uFrame + IDLE_INTERVAL;
+    }
+    return bMoved;
+}
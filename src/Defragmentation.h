@@ -0,0 +1,47 @@
+#pragma once
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Owner of buffers whose memory may be moved to compact the device memory
+// blocks. Once moved the owner binds a new buffer to the allocation and
+// patches what referenced the old one.
+class IDefragmentable
+{
+public:
+    virtual ~IDefragmentable() {}
+    // Append the allocations that may move
+    virtual void GetMovableAllocations(std::vector<VmaAllocation>& vAllocations) = 0;
+    // The data is at its new place and the device is idle
+    virtual void OnAllocationMoved(VmaAllocation allocation) = 0;
+};
+
+// Compacts memory blocks fragmented by scenes loaded and unloaded over long
+// sessions. When the movable buffer pool holds too much free space, a step
+// moves up to a byte budget of registered buffers in a frame where the
+// device finished all submitted work. Images are optimal tiled, VMA can't
+// move them.
+class DefragmentationManager
+{
+public:
+    void Initialize(VkDeviceSize uBytesPerStep = 64 * 1024 * 1024, float fMaxUnusedRatio = 0.25f);
+    void Unintialize();
+
+    void Register(IDefragmentable* pOwner);
+    void Unregister(IDefragmentable* pOwner);
+
+    // Once per frame before it is recorded, returns true if buffers moved so
+    // command buffers referencing them need re-recording
+    bool Update();
+
+private:
+    std::vector<IDefragmentable*> m_vpOwners;
+    VkDeviceSize m_uBytesPerStep = 0;
+    float m_fMaxUnusedRatio = 0.25f;
+    uint64_t m_uFrame = 0;
+    uint64_t m_uNextStepFrame = 0;
+};
+
+DefragmentationManager* GetDefragmentationManager();
@@ -0,0 +1,117 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+#include "Debug.h"
+#include "VkRenderDevice.h"
+
+void DescriptorAllocator::Initialize(const std::vector<VkDescriptorPoolSize>& vPoolSizes, uint32_t uMaxSetsPerPool,
+                                     bool bFreeable, const char* pName)
+{
+    assert(m_vPools.empty());
+    m_vPoolSizes = vPoolSizes;
+    m_uMaxSetsPerPool = uMaxSetsPerPool;
+    m_bFreeable = bFreeable;
+    m_pName = pName;
+    m_vPools.push_back(CreatePool());
+    m_uCurrentPool = 0;
+    m_stats = Stats();
+    m_stats.m_uNumPools = 1;
+}
+
+void DescriptorAllocator::Unintialize()
+{
+    for (VkDescriptorPool pool : m_vPools)
+    {
+        vkDestroyDescriptorPool(GetRenderDevice()->GetDevice(), pool, nullptr);
+    }
+    m_vPools.clear();
+    m_mSetPools.clear();
+    m_stats = Stats();
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+    assert(!m_vPools.empty() && "Descriptor allocator is not initialized");
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    for (;; m_uCurrentPool++)
+    {
+        const bool bNewPool = m_uCurrentPool == m_vPools.size();
+        if (bNewPool)
+        {
+            m_vPools.push_back(CreatePool());
+            m_stats.m_uNumPools++;
+        }
+        allocInfo.descriptorPool = m_vPools[m_uCurrentPool];
+        VkResult res = vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo, &descriptorSet);
+        if (res == VK_SUCCESS)
+        {
+            break;
+        }
+        // Only a full pool is worth moving on from, a set not fitting an
+        // empty pool never will
+        if (bNewPool || (res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL))
+        {
+            throw std::runtime_error(std::string("Failed to allocate descriptor set from ") + m_pName);
+        }
+    }
+    if (m_bFreeable)
+    {
+        m_mSetPools[descriptorSet] = m_uCurrentPool;
+    }
+    m_stats.m_uNumSets++;
+    m_stats.m_uPeakSets = std::max(m_stats.m_uPeakSets, m_stats.m_uNumSets);
+    return descriptorSet;
+}
+
+void DescriptorAllocator::Free(VkDescriptorSet descriptorSet)
+{
+    assert(m_bFreeable && "Sets of the allocator are freed by Reset");
+    auto it = m_mSetPools.find(descriptorSet);
+    assert(it != m_mSetPools.end());
+    VkResult result = vkFreeDescriptorSets(GetRenderDevice()->GetDevice(), m_vPools[it->second], 1, &descriptorSet);
+    assert(result == VK_SUCCESS);
+    (void)result;
+    // The pool has room again
+    m_uCurrentPool = std::min(m_uCurrentPool, it->second);
+    m_mSetPools.erase(it);
+    m_stats.m_uNumSets--;
+}
+
+void DescriptorAllocator::Reset()
+{
+    for (VkDescriptorPool pool : m_vPools)
+    {
+        VkResult result = vkResetDescriptorPool(GetRenderDevice()->GetDevice(), pool, 0);
+        assert(result == VK_SUCCESS);
+        (void)result;
+    }
+    m_uCurrentPool = 0;
+    m_mSetPools.clear();
+    m_stats.m_uNumSets = 0;
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePool() const
+{
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = m_bFreeable ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(m_vPoolSizes.size());
+    poolInfo.pPoolSizes = m_vPoolSizes.data();
+    poolInfo.maxSets = m_uMaxSetsPerPool;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (vkCreateDescriptorPool(GetRenderDevice()->GetDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error(std::string("Failed to create ") + m_pName);
+    }
+    setDebugUtilsObjectName(reinterpret_cast<uint64_t>(pool), VK_OBJECT_TYPE_DESCRIPTOR_POOL, m_pName);
+    return pool;
+}
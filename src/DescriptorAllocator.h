@@ -0,0 +1,49 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Allocates descriptor sets from a chain of pools, another pool is created
+// once the existing ones are out of memory, so there is no hard cap on the
+// number of sets. Sets of freeable allocators can be freed one by one,
+// the others are only given back in bulk by Reset.
+class DescriptorAllocator
+{
+public:
+    struct Stats
+    {
+        uint32_t m_uNumPools = 0;
+        // Sets allocated since the last reset, minus freed ones
+        uint32_t m_uNumSets = 0;
+        uint32_t m_uPeakSets = 0;
+    };
+
+    void Initialize(const std::vector<VkDescriptorPoolSize>& vPoolSizes, uint32_t uMaxSetsPerPool, bool bFreeable,
+                    const char* pName);
+    void Unintialize();
+
+    // Throws if the set fits no pool, not even a new one
+    VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+    void Free(VkDescriptorSet descriptorSet);
+    // All sets must be out of use
+    void Reset();
+
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    VkDescriptorPool CreatePool() const;
+
+    std::vector<VkDescriptorPoolSize> m_vPoolSizes;
+    uint32_t m_uMaxSetsPerPool = 0;
+    bool m_bFreeable = false;
+    const char* m_pName = "";
+
+    std::vector<VkDescriptorPool> m_vPools;
+    // First pool that may have room
+    size_t m_uCurrentPool = 0;
+    // Owning pool of each set of freeable allocators
+    std::unordered_map<VkDescriptorSet, size_t> m_mSetPools;
+    Stats m_stats;
+};
@@ -1,31 +1,89 @@
 #include "DescriptorManager.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "Debug.h"
+#include "DescriptorSetCache.h"
 #include "SamplerManager.h"
+#include "TextureResidency.h"
 #include "VkRenderDevice.h"
 
 // Poor man's singletone
 static DescriptorManager descriptorManager;
 
-void DescriptorManager::createDescriptorPool()
+void DescriptorManager::createDescriptorPool(uint32_t uNumFrames)
 {
-    VkDescriptorPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(POOL_SIZES.size());
-    poolInfo.pPoolSizes = POOL_SIZES.data();
-    poolInfo.maxSets =
-        DESCRIPTOR_COUNT_EACH_TYPE * static_cast<uint32_t>(POOL_SIZES.size());
-    assert(vkCreateDescriptorPool(GetRenderDevice()->GetDevice(), &poolInfo,
-                                  nullptr, &m_descriptorPool) == VK_SUCCESS);
+    m_descriptorAllocator.Initialize(POOL_SIZES, DESCRIPTOR_COUNT_EACH_TYPE, true, "Descriptor pool");
+    GetDescriptorSetCache()->Initialize(&m_descriptorAllocator);
+
+    // Transient sets are short lived, smaller pools are enough
+    std::vector<VkDescriptorPoolSize> vFramePoolSizes = POOL_SIZES;
+    for (VkDescriptorPoolSize& poolSize : vFramePoolSizes)
+    {
+        poolSize.descriptorCount = FRAME_DESCRIPTOR_COUNT_EACH_TYPE;
+    }
+    m_vFrameAllocators.resize(uNumFrames);
+    for (DescriptorAllocator& allocator : m_vFrameAllocators)
+    {
+        allocator.Initialize(vFramePoolSizes, FRAME_DESCRIPTOR_COUNT_EACH_TYPE, false, "Frame descriptor pool");
+    }
+    m_uFrameIdx = 0;
+
+    // Bindless material set
+    const std::array<VkDescriptorPoolSize, 3> aMaterialPoolSizes = {{
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MaterialManager::MAX_MATERIAL_TEXTURES},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+    }};
+    VkDescriptorPoolCreateInfo materialPoolInfo = {};
+    materialPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    materialPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    materialPoolInfo.poolSizeCount = static_cast<uint32_t>(aMaterialPoolSizes.size());
+    materialPoolInfo.pPoolSizes = aMaterialPoolSizes.data();
+    materialPoolInfo.maxSets = 1;
+    VkResult result = vkCreateDescriptorPool(GetRenderDevice()->GetDevice(), &materialPoolInfo, nullptr,
+                                             &m_materialDescriptorPool);
+    assert(result == VK_SUCCESS);
+    (void)result;
 }
 
 void DescriptorManager::destroyDescriptorPool()
 {
-    vkDestroyDescriptorPool(GetRenderDevice()->GetDevice(), m_descriptorPool,
+    GetDescriptorSetCache()->Unintialize();
+    m_descriptorAllocator.Unintialize();
+    for (DescriptorAllocator& allocator : m_vFrameAllocators)
+    {
+        allocator.Unintialize();
+    }
+    m_vFrameAllocators.clear();
+    vkDestroyDescriptorPool(GetRenderDevice()->GetDevice(), m_materialDescriptorPool,
                             nullptr);
+    m_materialDescriptorPool = VK_NULL_HANDLE;
+}
+
+void DescriptorManager::BeginFrame(uint32_t uFrameIdx)
+{
+    m_uFrameIdx = uFrameIdx;
+    m_vFrameAllocators[m_uFrameIdx].Reset();
+}
+
+VkDescriptorSet DescriptorManager::AllocateTransientDescriptorSet(DescriptorLayoutType layoutType)
+{
+    return m_vFrameAllocators[m_uFrameIdx].Allocate(m_aDescriptorSetLayouts[layoutType]);
+}
+
+DescriptorAllocator::Stats DescriptorManager::GetTransientDescriptorStats() const
+{
+    // Summed over the frames in flight
+    DescriptorAllocator::Stats stats;
+    for (const DescriptorAllocator& allocator : m_vFrameAllocators)
+    {
+        stats.m_uNumPools += allocator.GetStats().m_uNumPools;
+        stats.m_uNumSets += allocator.GetStats().m_uNumSets;
+        stats.m_uPeakSets += allocator.GetStats().m_uPeakSets;
+    }
+    return stats;
 }
 
 void DescriptorManager::createDescriptorSetLayouts()
@@ -85,7 +143,7 @@ void DescriptorManager::createDescriptorSetLayouts()
             VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 
         std::array<VkDescriptorSetLayoutBinding, 1> bindings = {
-            GetUniformBufferBinding(0)};
+            GetDynamicUniformBufferBinding(0)};
 
         descriptorSetLayoutInfo.bindingCount = (uint32_t)bindings.size();
         descriptorSetLayoutInfo.pBindings = bindings.data();
@@ -108,7 +166,7 @@ void DescriptorManager::createDescriptorSetLayouts()
             VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 
         std::array<VkDescriptorSetLayoutBinding, 1> bindings = {
-            GetUniformBufferBinding(0)};    // VERTEX and FRAGMENT !?
+            GetDynamicUniformBufferBinding(0)};    // VERTEX and FRAGMENT !?
 
         descriptorSetLayoutInfo.bindingCount = (uint32_t)bindings.size();
         descriptorSetLayoutInfo.pBindings = bindings.data();
@@ -126,15 +184,47 @@ void DescriptorManager::createDescriptorSetLayouts()
 
     // Material layout
     {
+        // Texture slots get written while recorded command buffers are
+        // pending, unused slots are left unwritten
+        VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(GetRenderDevice()->GetPhysicalDevice(), &features2);
+        assert(indexingFeatures.descriptorBindingPartiallyBound == VK_TRUE &&
+               indexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+               indexingFeatures.descriptorBindingUpdateUnusedWhilePending == VK_TRUE &&
+               "Bindless materials need descriptor indexing");
+
+        // Material textures carry full mip chains
+        VkSampler materialSampler = GetSamplerManager()->getSampler(SAMPLER_16_MIPS);
+        VkDescriptorSetLayoutBinding samplerBinding =
+            GetBinding(1, VK_DESCRIPTOR_TYPE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+        samplerBinding.pImmutableSamplers = &materialSampler;
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings = {
+            GetBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MaterialManager::MAX_MATERIAL_TEXTURES,
+                       VK_SHADER_STAGE_FRAGMENT_BIT),
+            samplerBinding,
+            // PBR factors indexed by material
+            GetBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT),
+            // Mip feedback written while sampling
+            GetBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT)
+        };
+        std::array<VkDescriptorBindingFlags, 4> aBindingFlags = {
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+            0, 0, 0};
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = (uint32_t)aBindingFlags.size();
+        bindingFlagsInfo.pBindingFlags = aBindingFlags.data();
+
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {};
         descriptorSetLayoutInfo.sType =
             VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {
-            GetSamplerArrayBinding(0, Material::TEX_COUNT),
-            GetUniformBufferBinding(1, VK_SHADER_STAGE_FRAGMENT_BIT)
-        }; // PBR material
-
+        descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
         descriptorSetLayoutInfo.bindingCount = (uint32_t)bindings.size();
         descriptorSetLayoutInfo.pBindings = bindings.data();
 
@@ -219,10 +309,63 @@ void DescriptorManager::createDescriptorSetLayouts()
                                            &layout) == VK_SUCCESS);
         m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_RAY_TRACING] = layout;
     }
+
+    // Sets written as a whole go through update templates reading packed
+    // descriptor infos
+    createUpdateTemplate(DESCRIPTOR_LAYOUT_SINGLE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, 1,
+                         sizeof(VkDescriptorImageInfo));
+    createUpdateTemplate(DESCRIPTOR_LAYOUT_PER_VIEW_DATA, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, 1,
+                         sizeof(VkDescriptorBufferInfo));
+    createUpdateTemplate(DESCRIPTOR_LAYOUT_PER_OBJ_DATA, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, 1,
+                         sizeof(VkDescriptorBufferInfo));
+    // Factors and feedback buffers only, texture slots are written one by one
+    createUpdateTemplate(DESCRIPTOR_LAYOUT_MATERIALS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, 2,
+                         sizeof(VkDescriptorBufferInfo));
+    createUpdateTemplate(DESCRIPTOR_LAYOUT_GBUFFER, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0,
+                         RenderPassGBuffer::LightingAttachments::GBUFFER_ATTACHMENTS_COUNT,
+                         sizeof(VkDescriptorImageInfo));
+    createUpdateTemplate(DESCRIPTOR_LAYOUT_IBL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, 3,
+                         sizeof(VkDescriptorImageInfo));
+}
+
+void DescriptorManager::createUpdateTemplate(DescriptorLayoutType layoutType, VkDescriptorType descriptorType,
+                                             uint32_t uFirstBinding, uint32_t uNumBindings, size_t uStride)
+{
+    std::vector<VkDescriptorUpdateTemplateEntry> vEntries(uNumBindings);
+    for (uint32_t i = 0; i < uNumBindings; i++)
+    {
+        VkDescriptorUpdateTemplateEntry& entry = vEntries[i];
+        entry.dstBinding = uFirstBinding + i;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = 1;
+        entry.descriptorType = descriptorType;
+        entry.offset = i * uStride;
+        entry.stride = uStride;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = uNumBindings;
+    templateInfo.pDescriptorUpdateEntries = vEntries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout = m_aDescriptorSetLayouts[layoutType];
+
+    VkResult result = vkCreateDescriptorUpdateTemplate(GetRenderDevice()->GetDevice(), &templateInfo, nullptr,
+                                                       &m_aUpdateTemplates[layoutType]);
+    assert(result == VK_SUCCESS);
+    (void)result;
 }
 
 void DescriptorManager::destroyDescriptorSetLayouts()
 {
+    for (VkDescriptorUpdateTemplate& updateTemplate : m_aUpdateTemplates)
+    {
+        if (updateTemplate != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorUpdateTemplate(GetRenderDevice()->GetDevice(), updateTemplate, nullptr);
+            updateTemplate = VK_NULL_HANDLE;
+        }
+    }
     for (auto& descriptorSetLayout : m_aDescriptorSetLayouts)
     {
         vkDestroyDescriptorSetLayout(GetRenderDevice()->GetDevice(),
@@ -236,7 +379,7 @@ VkDescriptorSet DescriptorManager::AllocateMaterialDescriptorSet()
     // Create descriptor sets
     VkDescriptorSetAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorPool = m_materialDescriptorPool;
     allocInfo.descriptorSetCount = 1;
     allocInfo.pSetLayouts =
         &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_MATERIALS];
@@ -249,80 +392,73 @@ VkDescriptorSet DescriptorManager::AllocateMaterialDescriptorSet()
     return descriptorSet;
 }
 
-VkDescriptorSet DescriptorManager::AllocateMaterialDescriptorSet(const Material::MaterialParameters& materialParameters)
+void DescriptorManager::UpdateMaterialTextureDescriptors(VkDescriptorSet descriptorSet,
+                                                         std::vector<uint32_t>& vIndices,
+                                                         const std::vector<VkImageView>& vViews)
 {
-    VkDescriptorSet descSet = AllocateMaterialDescriptorSet();
-    UpdateMaterialDescriptorSet(descSet, materialParameters);
-    return descSet;
-}
-
-void DescriptorManager::UpdateMaterialDescriptorSet(VkDescriptorSet descriptorSet, const Material::MaterialParameters &materialParameters)
-{
-    assert(materialParameters.m_apTextures.size() == Material::TEX_COUNT);
-
-    // prepare image array info for descriptor
-    std::array<VkDescriptorImageInfo, Material::TEX_COUNT> imageInfos = {};
-    for (size_t i = 0; i < Material::TEX_COUNT; i++)
+    // Slots are scattered over the array, a template entry has a fixed
+    // array element, so runs of adjacent slots become one write each
+    std::sort(vIndices.begin(), vIndices.end());
+    vIndices.erase(std::unique(vIndices.begin(), vIndices.end()), vIndices.end());
+
+    std::vector<VkDescriptorImageInfo> vImageInfos;
+    std::vector<VkWriteDescriptorSet> vWriteDescriptorSets;
+    vImageInfos.reserve(vIndices.size());
+    for (uint32_t uIndex : vIndices)
     {
-        imageInfos[i] = {
-            GetSamplerManager()->getSampler(SAMPLER_1_MIPS),
-            materialParameters.m_apTextures[i]->getView(),
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        };
-    }
-
-    // Two writes, one for PBR texture array, another for PBR factors
-    std::array<VkWriteDescriptorSet, 2> aWriteDescriptorSets = {};
-    {
-        // Material sampler views
-        VkWriteDescriptorSet &writeDescriptorSet = aWriteDescriptorSets[0];
-        writeDescriptorSet = {};
+        vImageInfos.push_back({VK_NULL_HANDLE, vViews[uIndex], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+        if (!vWriteDescriptorSets.empty())
+        {
+            VkWriteDescriptorSet& lastWrite = vWriteDescriptorSets.back();
+            if (lastWrite.dstArrayElement + lastWrite.descriptorCount == uIndex)
+            {
+                lastWrite.descriptorCount++;
+                continue;
+            }
+        }
+        VkWriteDescriptorSet writeDescriptorSet = {};
         writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         writeDescriptorSet.dstSet = descriptorSet;
         writeDescriptorSet.dstBinding = 0;
-        writeDescriptorSet.dstArrayElement = 0;
-        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeDescriptorSet.descriptorCount = static_cast<uint32_t>(imageInfos.size());
-        writeDescriptorSet.pImageInfo = imageInfos.data();
+        writeDescriptorSet.dstArrayElement = uIndex;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        writeDescriptorSet.descriptorCount = 1;
+        vWriteDescriptorSets.push_back(writeDescriptorSet);
     }
-
-    // Material parameters
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = materialParameters.m_pFactors->buffer();
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(Material::PBRFactors);
+    // Image infos are complete, point the writes at their runs
+    uint32_t uFirstInfo = 0;
+    for (VkWriteDescriptorSet& writeDescriptorSet : vWriteDescriptorSets)
     {
+        writeDescriptorSet.pImageInfo = &vImageInfos[uFirstInfo];
+        uFirstInfo += writeDescriptorSet.descriptorCount;
+    }
 
-        VkWriteDescriptorSet &writeDescriptorSet = aWriteDescriptorSets[1];
-        writeDescriptorSet = {};
-        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescriptorSet.dstSet = descriptorSet;
-        writeDescriptorSet.dstBinding = 1;
-        writeDescriptorSet.dstArrayElement = 0;
-        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        writeDescriptorSet.descriptorCount = 1;
-        writeDescriptorSet.pBufferInfo = &bufferInfo;
+    if (!vWriteDescriptorSets.empty())
+    {
+        vkUpdateDescriptorSets(GetRenderDevice()->GetDevice(), static_cast<uint32_t>(vWriteDescriptorSets.size()),
+                               vWriteDescriptorSets.data(), 0, nullptr);
     }
+}
 
-    vkUpdateDescriptorSets(GetRenderDevice()->GetDevice(), static_cast<uint32_t>(aWriteDescriptorSets.size()), aWriteDescriptorSets.data(),
-                           0, nullptr);
+void DescriptorManager::UpdateMaterialBufferDescriptors(VkDescriptorSet descriptorSet, VkBuffer factorsBuffer,
+                                                        VkDeviceSize uFactorsSize)
+{
+    // PBR factors at binding 2, mip feedback at binding 3
+    std::array<VkDescriptorBufferInfo, 2> aBufferInfos = {
+        VkDescriptorBufferInfo{factorsBuffer, 0, uFactorsSize},
+        VkDescriptorBufferInfo{GetTextureResidencyManager()->GetFeedbackBuffer(), 0,
+                               GetTextureResidencyManager()->GetFeedbackBufferSize()}};
+
+    vkUpdateDescriptorSetWithTemplate(GetRenderDevice()->GetDevice(), descriptorSet,
+                                      GetDescriptorManager()->m_aUpdateTemplates[DESCRIPTOR_LAYOUT_MATERIALS],
+                                      aBufferInfos.data());
 }
 
 VkDescriptorSet DescriptorManager::AllocateLightingDescriptorSet(
     const UniformBuffer<PerViewData>& perViewData, VkImageView position,
     VkImageView albedo, VkImageView normal, VkImageView uv)
 {
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-    // Create descriptor sets
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts =
-        &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_LIGHTING];
-
-    assert(vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo,
-                                    &descriptorSet) == VK_SUCCESS);
+    VkDescriptorSet descriptorSet = m_descriptorAllocator.Allocate(m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_LIGHTING]);
 
     // Prepare buffer descriptor
     {
@@ -378,18 +514,82 @@ VkDescriptorSet DescriptorManager::AllocateLightingDescriptorSet(
     return descriptorSet;
 }
 
-VkDescriptorSet DescriptorManager::AllocateGBufferDescriptorSet()
+VkDescriptorSet DescriptorManager::GetGBufferDescriptorSet(const RenderPassGBuffer::GBufferViews& gbufferViews)
 {
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-    // Create descriptor sets
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_GBUFFER];
+    static_assert(RenderPassGBuffer::LightingAttachments::GBUFFER_ATTACHMENTS_COUNT <= DescriptorSetCache::MAX_RESOURCES,
+                  "GBuffer views don't fit in a cache key");
+    DescriptorSetCache::Key key;
+    key.m_uLayoutType = DESCRIPTOR_LAYOUT_GBUFFER;
+    for (size_t i = 0; i < gbufferViews.size(); i++)
+    {
+        key.m_aResources[i] = reinterpret_cast<uint64_t>(gbufferViews[i]);
+    }
+    VkDescriptorSet descriptorSet = GetDescriptorSetCache()->Find(key);
+    if (descriptorSet == VK_NULL_HANDLE)
+    {
+        descriptorSet = AllocateGBufferDescriptorSet(gbufferViews);
+        GetDescriptorSetCache()->Add(key, descriptorSet);
+    }
+    return descriptorSet;
+}
 
-    assert(vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo,
-                                    &descriptorSet) == VK_SUCCESS);
+VkDescriptorSet DescriptorManager::GetSingleSamplerDescriptorSet(VkImageView textureView)
+{
+    DescriptorSetCache::Key key;
+    key.m_uLayoutType = DESCRIPTOR_LAYOUT_SINGLE_SAMPLER;
+    key.m_aResources[0] = reinterpret_cast<uint64_t>(textureView);
+    VkDescriptorSet descriptorSet = GetDescriptorSetCache()->Find(key);
+    if (descriptorSet == VK_NULL_HANDLE)
+    {
+        descriptorSet = AllocateSingleSamplerDescriptorSet(textureView);
+        GetDescriptorSetCache()->Add(key, descriptorSet);
+    }
+    return descriptorSet;
+}
+
+VkDescriptorSet DescriptorManager::GetPerviewDataDescriptorSet(const UniformBuffer<PerViewData>& perViewData)
+{
+    // Same layout and write as a dynamic set bound at offset 0
+    return GetDynamicUniformBufferDescriptorSet(perViewData.buffer(), sizeof(PerViewData),
+                                                DESCRIPTOR_LAYOUT_PER_VIEW_DATA);
+}
+
+VkDescriptorSet DescriptorManager::GetDynamicUniformBufferDescriptorSet(VkBuffer buffer, VkDeviceSize uRange,
+                                                                        DescriptorLayoutType layoutType)
+{
+    DescriptorSetCache::Key key;
+    key.m_uLayoutType = layoutType;
+    key.m_aResources[0] = reinterpret_cast<uint64_t>(buffer);
+    key.m_aResources[1] = uRange;
+    VkDescriptorSet descriptorSet = GetDescriptorSetCache()->Find(key);
+    if (descriptorSet == VK_NULL_HANDLE)
+    {
+        descriptorSet = AllocateDynamicUniformBufferDescriptorSet(buffer, uRange, layoutType);
+        GetDescriptorSetCache()->Add(key, descriptorSet);
+    }
+    return descriptorSet;
+}
+
+VkDescriptorSet DescriptorManager::GetIBLDescriptorSet(VkImageView irradianceMap, VkImageView prefilteredEnvMap,
+                                                       VkImageView specularBrdfLutMap)
+{
+    DescriptorSetCache::Key key;
+    key.m_uLayoutType = DESCRIPTOR_LAYOUT_IBL;
+    key.m_aResources[0] = reinterpret_cast<uint64_t>(irradianceMap);
+    key.m_aResources[1] = reinterpret_cast<uint64_t>(prefilteredEnvMap);
+    key.m_aResources[2] = reinterpret_cast<uint64_t>(specularBrdfLutMap);
+    VkDescriptorSet descriptorSet = GetDescriptorSetCache()->Find(key);
+    if (descriptorSet == VK_NULL_HANDLE)
+    {
+        descriptorSet = AllocateIBLDescriptorSet(irradianceMap, prefilteredEnvMap, specularBrdfLutMap);
+        GetDescriptorSetCache()->Add(key, descriptorSet);
+    }
+    return descriptorSet;
+}
+
+VkDescriptorSet DescriptorManager::AllocateGBufferDescriptorSet()
+{
+    VkDescriptorSet descriptorSet = m_descriptorAllocator.Allocate(m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_GBUFFER]);
 
     setDebugUtilsObjectName(reinterpret_cast<uint64_t>(descriptorSet),
                             VK_OBJECT_TYPE_DESCRIPTOR_SET, "GBuffer");
@@ -410,89 +610,53 @@ void DescriptorManager::updateGBufferDescriptorSet(
     const RenderPassGBuffer::GBufferViews& gbufferViews)
 
 {
-    // prepare image descriptor
     std::array<VkDescriptorImageInfo, RenderPassGBuffer::LightingAttachments::GBUFFER_ATTACHMENTS_COUNT> imageInfos;
-    std::array<VkWriteDescriptorSet, RenderPassGBuffer::LightingAttachments::GBUFFER_ATTACHMENTS_COUNT> writeDescriptorSets;
-
     for (uint32_t i = 0; i < RenderPassGBuffer::LightingAttachments::GBUFFER_ATTACHMENTS_COUNT; i++)
     {
-        VkDescriptorImageInfo& imageInfo = imageInfos[i];
-        imageInfo = {GetSamplerManager()->getSampler(SAMPLER_1_MIPS),
-                     gbufferViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-
-        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[i];
-        writeDescriptorSet = {};
-        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescriptorSet.dstSet = descriptorSet;
-        writeDescriptorSet.dstBinding = i;
-        writeDescriptorSet.dstArrayElement = 0;
-        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-        writeDescriptorSet.descriptorCount = 1;
-        writeDescriptorSet.pImageInfo = &imageInfo;
+        imageInfos[i] = {GetSamplerManager()->getSampler(SAMPLER_1_MIPS),
+                         gbufferViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
     }
-    vkUpdateDescriptorSets(GetRenderDevice()->GetDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+    vkUpdateDescriptorSetWithTemplate(GetRenderDevice()->GetDevice(), descriptorSet,
+                                      GetDescriptorManager()->m_aUpdateTemplates[DESCRIPTOR_LAYOUT_GBUFFER],
+                                      imageInfos.data());
 }
 
 VkDescriptorSet DescriptorManager::AllocateSingleSamplerDescriptorSet(
     VkImageView textureView)
 {
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-    // Create descriptor sets
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts =
-        &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_SINGLE_SAMPLER];
-
-    assert(vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo,
-                                    &descriptorSet) == VK_SUCCESS);
+    VkDescriptorSet descriptorSet = m_descriptorAllocator.Allocate(m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_SINGLE_SAMPLER]);
 
     setDebugUtilsObjectName(reinterpret_cast<uint64_t>(descriptorSet),
                             VK_OBJECT_TYPE_DESCRIPTOR_SET, "Single Sampler");
 
-    // Prepare buffer descriptor
-    {
-        // prepare image descriptor
-        VkDescriptorImageInfo imageInfo = {};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textureView;
-        imageInfo.sampler = GetSamplerManager()->getSampler(SAMPLER_1_MIPS);
-
-        VkWriteDescriptorSet descriptorWrite = {};
-
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = descriptorSet;
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(GetRenderDevice()->GetDevice(), 1,
-                               &descriptorWrite, 0, nullptr);
-    }
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = textureView;
+    imageInfo.sampler = GetSamplerManager()->getSampler(SAMPLER_1_MIPS);
+
+    vkUpdateDescriptorSetWithTemplate(GetRenderDevice()->GetDevice(), descriptorSet,
+                                      m_aUpdateTemplates[DESCRIPTOR_LAYOUT_SINGLE_SAMPLER], &imageInfo);
     return descriptorSet;
 }
 
-VkDescriptorSet DescriptorManager::AllocatePerviewDataDescriptorSet(
-    const UniformBuffer<PerViewData>& perViewData)
+VkDescriptorSet DescriptorManager::AllocateDynamicUniformBufferDescriptorSet(VkBuffer buffer, VkDeviceSize uRange,
+                                                                          DescriptorLayoutType layoutType)
 {
-    return AllocateUniformBufferDescriptorSet(perViewData, 0);
+    VkDescriptorSet descriptorSet = m_descriptorAllocator.Allocate(m_aDescriptorSetLayouts[layoutType]);
+
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = uRange;
+
+    vkUpdateDescriptorSetWithTemplate(GetRenderDevice()->GetDevice(), descriptorSet,
+                                      m_aUpdateTemplates[layoutType], &bufferInfo);
+    return descriptorSet;
 }
 
 VkDescriptorSet DescriptorManager::AllocateIBLDescriptorSet()
 {
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-    // Create descriptor sets
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts =
-        &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_IBL];
-    assert(vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo,
-                                    &descriptorSet) == VK_SUCCESS);
+    VkDescriptorSet descriptorSet = m_descriptorAllocator.Allocate(m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_IBL]);
 
     setDebugUtilsObjectName(reinterpret_cast<uint64_t>(descriptorSet),
                             VK_OBJECT_TYPE_DESCRIPTOR_SET, "IBL");
@@ -515,40 +679,19 @@ void DescriptorManager::UpdateIBLDescriptorSet(
     VkImageView prefilteredEnvMap,
     VkImageView specularBrdfLutMap)
 {
-    // prepare image descriptor
-    std::array<VkImageView, 3> aIBLViews = {irradianceMap, prefilteredEnvMap, specularBrdfLutMap};
-    std::array<VkDescriptorImageInfo, 3> imageInfos;
-    std::array<VkWriteDescriptorSet, 3> writeDescriptorSets;
-
-    for (uint32_t i = 0; i < aIBLViews.size(); i++)
-    {
-        VkDescriptorImageInfo& imageInfo = imageInfos[i];
-        imageInfo = {GetSamplerManager()->getSampler(SAMPLER_1_MIPS), aIBLViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-
-        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[i];
-        writeDescriptorSet = {};
-        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescriptorSet.dstSet = descriptorSet;
-        writeDescriptorSet.dstBinding = i;
-        writeDescriptorSet.dstArrayElement = 0;
-        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeDescriptorSet.descriptorCount = 1;
-        writeDescriptorSet.pImageInfo = &imageInfo;
-    }
-    vkUpdateDescriptorSets(GetRenderDevice()->GetDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+    VkSampler sampler = GetSamplerManager()->getSampler(SAMPLER_1_MIPS);
+    std::array<VkDescriptorImageInfo, 3> imageInfos = {
+        VkDescriptorImageInfo{sampler, irradianceMap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        VkDescriptorImageInfo{sampler, prefilteredEnvMap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        VkDescriptorImageInfo{sampler, specularBrdfLutMap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}};
+
+    vkUpdateDescriptorSetWithTemplate(GetRenderDevice()->GetDevice(), descriptorSet,
+                                      m_aUpdateTemplates[DESCRIPTOR_LAYOUT_IBL], imageInfos.data());
 }
 
 VkDescriptorSet DescriptorManager::AllocateRayTracingDescriptorSet(const VkAccelerationStructureKHR &acc, const VkImageView &outputImage)
 {
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-    // Create descriptor sets
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_RAY_TRACING];
-    assert(vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo,
-                                    &descriptorSet) == VK_SUCCESS);
+    VkDescriptorSet descriptorSet = m_descriptorAllocator.Allocate(m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_RAY_TRACING]);
 
     setDebugUtilsObjectName(reinterpret_cast<uint64_t>(descriptorSet),
                             VK_OBJECT_TYPE_DESCRIPTOR_SET, "Ray Tracing input output");
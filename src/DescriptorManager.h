@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "DescriptorAllocator.h"
 #include "Material.h"
 #include "RenderPassGBuffer.h"
 #include "UniformBuffer.h"
@@ -15,9 +16,9 @@ enum DescriptorLayoutType
     DESCRIPTOR_LAYOUT_SINGLE_SAMPLER, // A single sampler descriptor set layout
                                       // at binding 0
     DESCRIPTOR_LAYOUT_PER_VIEW_DATA,  // A layout contains mvp matrices at
-                                      // binding 0
-    DESCRIPTOR_LAYOUT_PER_OBJ_DATA,   // Per object data layout
-    DESCRIPTOR_LAYOUT_MATERIALS,      // A sampler array contains material textures
+                                      // binding 0, dynamic offset
+    DESCRIPTOR_LAYOUT_PER_OBJ_DATA,   // Per object data layout, dynamic offset
+    DESCRIPTOR_LAYOUT_MATERIALS,      // Bindless material textures and factors
     DESCRIPTOR_LAYOUT_GBUFFER,        // Layouts contains output of GBuffer
     DESCRIPTOR_LAYOUT_IBL,            // IBL descriptor sets
     DESCRIPTOR_LAYOUT_RAY_TRACING,     // Raytracing Descriptor sets
@@ -27,7 +28,8 @@ enum DescriptorLayoutType
 class DescriptorManager
 {
 public:
-    void createDescriptorPool();
+    // Transient sets come from a pool chain per frame in flight
+    void createDescriptorPool(uint32_t uNumFrames);
     void destroyDescriptorPool();
     void createDescriptorSetLayouts();
     void destroyDescriptorSetLayouts();
@@ -36,6 +38,16 @@ public:
         const UniformBuffer<PerViewData> &perViewData, VkImageView position,
         VkImageView albedo, VkImageView normal, VkImageView uv); // Deprecating
 
+    // Sets returned by the Get functions are cached by their resources and
+    // shared, the caller must not free or update them
+    VkDescriptorSet GetGBufferDescriptorSet(const RenderPassGBuffer::GBufferViews &gbufferViews);
+    VkDescriptorSet GetSingleSamplerDescriptorSet(VkImageView textureView);
+    VkDescriptorSet GetPerviewDataDescriptorSet(const UniformBuffer<PerViewData> &perViewData);
+    VkDescriptorSet GetDynamicUniformBufferDescriptorSet(VkBuffer buffer, VkDeviceSize uRange,
+                                                         DescriptorLayoutType layoutType);
+    VkDescriptorSet GetIBLDescriptorSet(VkImageView irradianceMap, VkImageView prefilteredEnvMap,
+                                        VkImageView specularBrdfLutMap);
+
     VkDescriptorSet AllocateGBufferDescriptorSet(
         const RenderPassGBuffer::GBufferViews &gbufferViews);
     VkDescriptorSet AllocateGBufferDescriptorSet();
@@ -45,13 +57,20 @@ public:
 
     VkDescriptorSet AllocateSingleSamplerDescriptorSet(VkImageView textureView);
 
-    VkDescriptorSet AllocatePerviewDataDescriptorSet(
-        const UniformBuffer<PerViewData> &perViewData);
+    // Per view or per object set over a range of the buffer picked by the
+    // dynamic offset at bind time
+    VkDescriptorSet AllocateDynamicUniformBufferDescriptorSet(VkBuffer buffer, VkDeviceSize uRange,
+                                                              DescriptorLayoutType layoutType);
 
-    // Material Descriptor Set
+    // Material Descriptor Set, a single update after bind set shared by all
+    // materials
     VkDescriptorSet AllocateMaterialDescriptorSet();
-    VkDescriptorSet AllocateMaterialDescriptorSet(const Material::MaterialParameters &materialParameters);
-    static void UpdateMaterialDescriptorSet(VkDescriptorSet descriptorSet, const Material::MaterialParameters &materialParameters);
+    // Writes the texture slots in vIndices with their views in vViews,
+    // indexed by slot. vIndices is sorted and deduplicated.
+    static void UpdateMaterialTextureDescriptors(VkDescriptorSet descriptorSet, std::vector<uint32_t>& vIndices,
+                                                 const std::vector<VkImageView>& vViews);
+    static void UpdateMaterialBufferDescriptors(VkDescriptorSet descriptorSet, VkBuffer factorsBuffer,
+                                                VkDeviceSize uFactorsSize);
 
     // IBL descriptor set
     VkDescriptorSet AllocateIBLDescriptorSet();
@@ -73,52 +92,26 @@ public:
     static void UpdateRayTracingDescriptorSet(VkDescriptorSet descriptorSet, const VkAccelerationStructureKHR &acc, const VkImageView &outputImage);
 
 
+    // The frame's fence is signaled, its transient sets are recycled
+    void BeginFrame(uint32_t uFrameIdx);
+    // Set only valid for the command buffers of the current frame, written
+    // by the caller
+    VkDescriptorSet AllocateTransientDescriptorSet(DescriptorLayoutType layoutType);
+
+    const DescriptorAllocator::Stats& GetDescriptorStats() const { return m_descriptorAllocator.GetStats(); }
+    DescriptorAllocator::Stats GetTransientDescriptorStats() const;
+
     VkDescriptorSetLayout getDescriptorLayout(DescriptorLayoutType type) const
     {
         return m_aDescriptorSetLayouts[type];
     }
 
-    // Function template to allocate single type uniform buffer descriptor set
-    template <class T>
-    VkDescriptorSet AllocateUniformBufferDescriptorSet(const UniformBuffer<T> &uniformBuffer, uint32_t nBinding)
-    {
-        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-        // Create descriptor sets
-        VkDescriptorSetAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = m_descriptorPool;
-        allocInfo.descriptorSetCount = 1;
-        allocInfo.pSetLayouts =
-            &m_aDescriptorSetLayouts[DESCRIPTOR_LAYOUT_PER_VIEW_DATA];
-
-        assert(vkAllocateDescriptorSets(GetRenderDevice()->GetDevice(), &allocInfo,
-                                        &descriptorSet) == VK_SUCCESS);
-
-        // Bind uniform buffer to descriptor
-        {
-            VkDescriptorBufferInfo bufferInfo = {};
-            bufferInfo.buffer = uniformBuffer.buffer();
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(T);
-            std::array<VkWriteDescriptorSet, 1> descriptorWrites = {};
-
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = descriptorSet;
-            descriptorWrites[0].dstBinding = nBinding;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-            vkUpdateDescriptorSets(GetRenderDevice()->GetDevice(),
-                                   static_cast<uint32_t>(descriptorWrites.size()),
-                                   descriptorWrites.data(), 0, nullptr);
-        }
-
-        return descriptorSet;
-    }
-
 private:
+    // Template writing one descriptor to each of uNumBindings bindings from
+    // an array of infos uStride apart
+    void createUpdateTemplate(DescriptorLayoutType layoutType, VkDescriptorType descriptorType,
+                              uint32_t uFirstBinding, uint32_t uNumBindings, size_t uStride);
+
     static VkDescriptorSetLayoutBinding GetUniformBufferBinding(uint32_t binding, VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
     {
         VkDescriptorSetLayoutBinding uboLayoutBinding = {};
@@ -129,6 +122,12 @@ private:
         uboLayoutBinding.stageFlags = stages;
         return uboLayoutBinding;
     }
+    static VkDescriptorSetLayoutBinding GetDynamicUniformBufferBinding(uint32_t binding)
+    {
+        VkDescriptorSetLayoutBinding uboLayoutBinding = GetUniformBufferBinding(binding);
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        return uboLayoutBinding;
+    }
     static VkDescriptorSetLayoutBinding GetBinding(uint32_t nBinding, VkDescriptorType descType, uint32_t nDescCount = 1, VkShaderStageFlags shaderStageFlags = VK_SHADER_STAGE_ALL)
     {
         VkDescriptorSetLayoutBinding binding = {};
@@ -139,8 +138,11 @@ private:
         return binding;
     }
 
+    // Immutable samplers are baked into the layout, the sampler of image
+    // infos written to the binding is ignored
     static VkDescriptorSetLayoutBinding GetSamplerArrayBinding(
-        uint32_t binding, uint32_t numSamplers)
+        uint32_t binding, uint32_t numSamplers,
+        const VkSampler* pImmutableSamplers = nullptr)
     {
         VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
         samplerLayoutBinding.binding = binding;
@@ -148,6 +150,7 @@ private:
         samplerLayoutBinding.descriptorType =
             VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        samplerLayoutBinding.pImmutableSamplers = pImmutableSamplers;
 
         return samplerLayoutBinding;
     }
@@ -170,9 +173,18 @@ private:
 
     std::array<VkDescriptorSetLayout, DESCRIPTOR_LAYOUT_COUNT>
         m_aDescriptorSetLayouts = {VK_NULL_HANDLE};
-    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
-
+    // Null for layouts written by hand
+    std::array<VkDescriptorUpdateTemplate, DESCRIPTOR_LAYOUT_COUNT>
+        m_aUpdateTemplates = {VK_NULL_HANDLE};
+    DescriptorAllocator m_descriptorAllocator;
+    std::vector<DescriptorAllocator> m_vFrameAllocators;
+    uint32_t m_uFrameIdx = 0;
+    // Update after bind sets need a pool of their own
+    VkDescriptorPool m_materialDescriptorPool = VK_NULL_HANDLE;
+
+    // Per pool, pools are chained once full
     const uint32_t DESCRIPTOR_COUNT_EACH_TYPE = 1000;
+    const uint32_t FRAME_DESCRIPTOR_COUNT_EACH_TYPE = 128;
     const std::vector<VkDescriptorPoolSize> POOL_SIZES = {
         {VK_DESCRIPTOR_TYPE_SAMPLER, DESCRIPTOR_COUNT_EACH_TYPE},
         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_COUNT_EACH_TYPE},
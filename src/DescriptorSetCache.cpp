@@ -0,0 +1,58 @@
+#include "DescriptorSetCache.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "DescriptorAllocator.h"
+
+static DescriptorSetCache s_descriptorSetCache;
+
+DescriptorSetCache* GetDescriptorSetCache()
+{
+    return &s_descriptorSetCache;
+}
+
+void DescriptorSetCache::Initialize(DescriptorAllocator* pAllocator)
+{
+    assert(m_mDescriptorSets.empty());
+    m_pAllocator = pAllocator;
+}
+
+void DescriptorSetCache::Unintialize()
+{
+    m_mDescriptorSets.clear();
+    m_pAllocator = nullptr;
+}
+
+VkDescriptorSet DescriptorSetCache::Find(const Key& key) const
+{
+    auto it = m_mDescriptorSets.find(key);
+    return it != m_mDescriptorSets.end() ? it->second : VK_NULL_HANDLE;
+}
+
+void DescriptorSetCache::Add(const Key& key, VkDescriptorSet descriptorSet)
+{
+    assert(m_pAllocator != nullptr && "Descriptor set cache is not initialized");
+    m_mDescriptorSets[key] = descriptorSet;
+}
+
+void DescriptorSetCache::Release(uint64_t uResource)
+{
+    if (m_pAllocator == nullptr || uResource == 0)
+    {
+        return;
+    }
+    for (auto it = m_mDescriptorSets.begin(); it != m_mDescriptorSets.end();)
+    {
+        const auto& aResources = it->first.m_aResources;
+        if (std::find(aResources.begin(), aResources.end(), uResource) != aResources.end())
+        {
+            m_pAllocator->Free(it->second);
+            it = m_mDescriptorSets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
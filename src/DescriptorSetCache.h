@@ -0,0 +1,47 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+
+class DescriptorAllocator;
+
+// Descriptor sets shared by everything binding the same resources. A set is
+// allocated and written on the first request for its layout and resources,
+// later requests get the same set. Destroying a resource releases the sets
+// referencing it.
+class DescriptorSetCache
+{
+public:
+    static constexpr size_t MAX_RESOURCES = 4;
+    struct Key
+    {
+        uint32_t m_uLayoutType = 0;
+        // Handles of the bound resources, or anything else the content
+        // depends on like buffer ranges
+        std::array<uint64_t, MAX_RESOURCES> m_aResources = {};
+
+        bool operator<(const Key& other) const
+        {
+            return m_uLayoutType != other.m_uLayoutType ? m_uLayoutType < other.m_uLayoutType
+                                                        : m_aResources < other.m_aResources;
+        }
+    };
+
+    // Released sets are freed to the allocator
+    void Initialize(DescriptorAllocator* pAllocator);
+    // Drop the sets without freeing them, they go with the allocator's pools
+    void Unintialize();
+
+    VkDescriptorSet Find(const Key& key) const;
+    void Add(const Key& key, VkDescriptorSet descriptorSet);
+    // Free the sets referencing the resource, they must no longer be in use
+    void Release(uint64_t uResource);
+
+private:
+    std::map<Key, VkDescriptorSet> m_mDescriptorSets;
+    DescriptorAllocator* m_pAllocator = nullptr;
+};
+
+DescriptorSetCache* GetDescriptorSetCache();
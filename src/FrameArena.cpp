@@ -0,0 +1,77 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+static FrameArena s_frameArena;
+
+FrameArena* GetFrameArena()
+{
+    return &s_frameArena;
+}
+
+void FrameArena::Initialize(size_t uSize)
+{
+    assert(m_vBlocks.empty());
+    // Room for a few overflow blocks before the block list itself grows
+    m_vBlocks.reserve(8);
+    AddBlock(uSize);
+}
+
+void FrameArena::Unintialize()
+{
+    m_vBlocks.clear();
+    m_uHead = 0;
+}
+
+void FrameArena::Reset()
+{
+    assert(!m_vBlocks.empty() && "Frame arena is not initialized");
+    if (m_vBlocks.size() > 1)
+    {
+        size_t uSize = 0;
+        for (const Block& block : m_vBlocks)
+        {
+            uSize += block.m_uSize;
+        }
+        m_vBlocks.clear();
+        AddBlock(uSize);
+    }
+    m_uHead = 0;
+}
+
+void* FrameArena::Allocate(size_t uSize, size_t uAlignment)
+{
+    assert(!m_vBlocks.empty() && "Frame arena is not initialized");
+    size_t uStart = (m_uHead + uAlignment - 1) & ~(uAlignment - 1);
+    if (uStart + uSize > m_vBlocks.back().m_uSize)
+    {
+        // Blocks come from new[], aligned for any fundamental type
+        AddBlock(std::max(uSize, m_vBlocks.back().m_uSize * 2));
+        uStart = 0;
+    }
+    m_uHead = uStart + uSize;
+    return m_vBlocks.back().m_pData.get() + uStart;
+}
+
+void FrameArena::Free(void* pData, size_t uSize)
+{
+    if (m_vBlocks.empty())
+    {
+        return;
+    }
+    uint8_t* pHead = m_vBlocks.back().m_pData.get() + m_uHead;
+    if (static_cast<uint8_t*>(pData) + uSize == pHead)
+    {
+        m_uHead -= uSize;
+    }
+}
+
+void FrameArena::AddBlock(size_t uSize)
+{
+    Block block;
+    block.m_pData = std::make_unique<uint8_t[]>(uSize);
+    block.m_uSize = uSize;
+    m_vBlocks.push_back(std::move(block));
+    m_uHead = 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Linear CPU scratch memory for data living within a frame, like the draw
+// lists, command buffer lists and recording temporaries. Allocations are
+// bumped off a block and dropped all at once by Reset at frame start. A
+// frame outgrowing the block chains overflow blocks, the next Reset merges
+// them into a single block, so steady state frames never touch the heap.
+class FrameArena
+{
+public:
+    void Initialize(size_t uSize = 1024 * 1024);
+    void Unintialize();
+
+    // Nothing allocated since the last reset may be alive
+    void Reset();
+    void* Allocate(size_t uSize, size_t uAlignment);
+    // Only the latest allocation is given back, temporaries freed in
+    // reverse order don't use up the block
+    void Free(void* pData, size_t uSize);
+
+private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> m_pData;
+        size_t m_uSize = 0;
+    };
+    void AddBlock(size_t uSize);
+
+    // The last block is the one being bumped
+    std::vector<Block> m_vBlocks;
+    size_t m_uHead = 0;
+};
+
+FrameArena* GetFrameArena();
+
+// STL allocator over the frame arena, containers using it must not outlive
+// the frame
+template <class T>
+class FrameAllocator
+{
+public:
+    using value_type = T;
+
+    FrameAllocator() = default;
+    template <class U>
+    FrameAllocator(const FrameAllocator<U>&)
+    {
+    }
+
+    T* allocate(size_t uCount)
+    {
+        return static_cast<T*>(GetFrameArena()->Allocate(sizeof(T) * uCount, alignof(T)));
+    }
+    void deallocate(T* pData, size_t uCount) { GetFrameArena()->Free(pData, sizeof(T) * uCount); }
+};
+
+template <class T, class U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&)
+{
+    return true;
+}
+template <class T, class U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&)
+{
+    return false;
+}
+
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
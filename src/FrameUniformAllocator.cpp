@@ -0,0 +1,78 @@
+#include "FrameUniformAllocator.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "DescriptorManager.h"
+#include "DescriptorSetCache.h"
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+static FrameUniformAllocator s_frameUniformAllocator;
+
+FrameUniformAllocator* GetFrameUniformAllocator()
+{
+    return &s_frameUniformAllocator;
+}
+
+void FrameUniformAllocator::Initialize(uint32_t uNumFrames, VkDeviceSize uFrameSize)
+{
+    assert(m_buffer == VK_NULL_HANDLE);
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(GetRenderDevice()->GetPhysicalDevice(), &properties);
+    m_uAlignment = properties.limits.minUniformBufferOffsetAlignment;
+    m_uNumFrames = uNumFrames;
+    m_uFrameSize = (uFrameSize + m_uAlignment - 1) & ~(m_uAlignment - 1);
+
+    GetMemoryAllocator()->AllocateBuffer(m_uNumFrames * m_uFrameSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                         VMA_MEMORY_USAGE_CPU_TO_GPU, m_buffer, m_allocation,
+                                         "Frame uniforms");
+    m_pMappedData = static_cast<uint8_t*>(GetMemoryAllocator()->GetMappedData(m_allocation));
+
+    m_perViewDescriptorSet = GetDescriptorManager()->GetDynamicUniformBufferDescriptorSet(
+        m_buffer, sizeof(PerViewData), DESCRIPTOR_LAYOUT_PER_VIEW_DATA);
+    m_perObjDescriptorSet = GetDescriptorManager()->GetDynamicUniformBufferDescriptorSet(
+        m_buffer, sizeof(PerGeometryData), DESCRIPTOR_LAYOUT_PER_OBJ_DATA);
+
+    m_vLayout.clear();
+    Allocate(PerViewData());
+}
+
+void FrameUniformAllocator::Unintialize()
+{
+    // Cached sets go with the buffer
+    m_perViewDescriptorSet = VK_NULL_HANDLE;
+    m_perObjDescriptorSet = VK_NULL_HANDLE;
+    m_vLayout.clear();
+    GetDescriptorSetCache()->Release(reinterpret_cast<uint64_t>(m_buffer));
+    GetMemoryAllocator()->FreeBuffer(m_buffer, m_allocation);
+    m_buffer = VK_NULL_HANDLE;
+    m_pMappedData = nullptr;
+}
+
+void FrameUniformAllocator::Reset()
+{
+    m_vLayout.resize(sizeof(PerViewData));
+}
+
+uint32_t FrameUniformAllocator::Allocate(const void* pData, VkDeviceSize uSize)
+{
+    const VkDeviceSize uOffset = (m_vLayout.size() + m_uAlignment - 1) & ~(m_uAlignment - 1);
+    assert(uOffset + uSize <= m_uFrameSize && "Out of frame uniform memory");
+    m_vLayout.resize(uOffset + uSize);
+    memcpy(m_vLayout.data() + uOffset, pData, uSize);
+    return static_cast<uint32_t>(uOffset);
+}
+
+void FrameUniformAllocator::SetPerViewData(const PerViewData& perViewData)
+{
+    memcpy(m_vLayout.data(), &perViewData, sizeof(PerViewData));
+}
+
+void FrameUniformAllocator::BeginFrame(uint32_t uFrameIdx)
+{
+    assert(uFrameIdx < m_uNumFrames);
+    const VkDeviceSize uFrameOffset = uFrameIdx * m_uFrameSize;
+    memcpy(m_pMappedData + uFrameOffset, m_vLayout.data(), m_vLayout.size());
+    GetMemoryAllocator()->FlushAllocation(m_allocation, uFrameOffset, m_vLayout.size());
+}
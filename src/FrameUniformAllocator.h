@@ -0,0 +1,65 @@
+#pragma once
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "UniformBuffer.h"
+
+// Linear allocator for per view and per draw constants. One persistently
+// mapped buffer is split into a region per frame in flight, every region
+// holds the same layout at the same relative offsets. Allocations are made
+// when command buffers are recorded and bound with UNIFORM_BUFFER_DYNAMIC
+// offsets, one command buffer per frame. Each frame copies the CPU side
+// data into its own region, so frames in flight never share memory.
+class FrameUniformAllocator
+{
+public:
+    void Initialize(uint32_t uNumFrames, VkDeviceSize uFrameSize = 4 * 1024 * 1024);
+    void Unintialize();
+
+    // Drop the allocations of the previous recording, the per view data
+    // stays at offset 0
+    void Reset();
+    // Copy the data into the frame layout, returns its offset relative to
+    // the frame region
+    uint32_t Allocate(const void* pData, VkDeviceSize uSize);
+    template <class T>
+    uint32_t Allocate(const T& data)
+    {
+        return Allocate(&data, sizeof(T));
+    }
+    void SetPerViewData(const PerViewData& perViewData);
+
+    // Write the frame layout to the frame's region, the frame previously
+    // using it must be complete
+    void BeginFrame(uint32_t uFrameIdx);
+
+    uint32_t GetNumFrames() const { return m_uNumFrames; }
+    // Dynamic offset of an allocation in the frame's region
+    uint32_t GetDynamicOffset(uint32_t uFrameIdx, uint32_t uOffset) const
+    {
+        return static_cast<uint32_t>(uFrameIdx * m_uFrameSize) + uOffset;
+    }
+    uint32_t GetPerViewOffset(uint32_t uFrameIdx) const { return GetDynamicOffset(uFrameIdx, 0); }
+    // Sets with a single dynamic uniform buffer at binding 0
+    VkDescriptorSet GetPerViewDescriptorSet() const { return m_perViewDescriptorSet; }
+    VkDescriptorSet GetPerObjDescriptorSet() const { return m_perObjDescriptorSet; }
+
+private:
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    VmaAllocation m_allocation = VK_NULL_HANDLE;
+    uint8_t* m_pMappedData = nullptr;
+
+    uint32_t m_uNumFrames = 0;
+    VkDeviceSize m_uFrameSize = 0;
+    VkDeviceSize m_uAlignment = 0;
+    // CPU side of the frame layout, m_vLayout.size() is the bump head
+    std::vector<uint8_t> m_vLayout;
+
+    VkDescriptorSet m_perViewDescriptorSet = VK_NULL_HANDLE;
+    VkDescriptorSet m_perObjDescriptorSet = VK_NULL_HANDLE;
+};
+
+FrameUniformAllocator* GetFrameUniformAllocator();
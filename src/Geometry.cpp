@@ -1,6 +1,7 @@
 #include "Geometry.h"
 #include <cassert>
-#include <tiny_obj_loader.h>
+#include <iostream>
+#include "ObjParser.h"
 #include <tiny_gltf.h>
 
 static GeometryManager s_geometryManager;
@@ -37,75 +38,86 @@ Geometry* GeometryManager::GetCube()
     return vpGeometries[m_nCubeIdx].get();
 }
 
-std::unique_ptr<Geometry> loadObj(const std::string& path, glm::mat4 mTransformation)
+void GeometryManager::Remove(const std::unordered_set<const Geometry*>& vpGeometriesToRemove)
 {
-    struct TinyObjInfo
+    const Geometry* pQuad = m_nQuadIdx == -1 ? nullptr : vpGeometries[m_nQuadIdx].get();
+    const Geometry* pCube = m_nCubeIdx == -1 ? nullptr : vpGeometries[m_nCubeIdx].get();
+    assert(vpGeometriesToRemove.count(pQuad) == 0 && vpGeometriesToRemove.count(pCube) == 0);
+
+    std::vector<std::unique_ptr<Geometry>> vpRemaining;
+    vpRemaining.reserve(vpGeometries.size());
+    for (auto& pGeometry : vpGeometries)
     {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-    };
-    TinyObjInfo objInfo;
+        if (vpGeometriesToRemove.count(pGeometry.get()) == 0)
+        {
+            if (pGeometry.get() == pQuad)
+            {
+                m_nQuadIdx = (int)vpRemaining.size();
+            }
+            if (pGeometry.get() == pCube)
+            {
+                m_nCubeIdx = (int)vpRemaining.size();
+            }
+            vpRemaining.push_back(std::move(pGeometry));
+        }
+    }
+    vpGeometries = std::move(vpRemaining);
+}
+
+std::unique_ptr<Geometry> loadObj(const std::string& path, glm::mat4 mTransformation)
+{
+    ObjMesh mesh;
     std::string err;
-    bool ret = tinyobj::LoadObj(&(objInfo.attrib), &(objInfo.shapes),
-                                &(objInfo.materials), &err, path.c_str());
-    if (!ret)
+    if (!ParseObj(path, mesh, err))
     {
         std::cerr << err << std::endl;
     }
-    else
-    {
-        std::cout << "Num verts :" << objInfo.attrib.vertices.size() / 3
-                  << std::endl;
-        std::cout << "Num Normals :" << objInfo.attrib.normals.size() / 3
-                  << std::endl;
-        std::cout << "Num TexCoords :" << objInfo.attrib.texcoords.size() / 2
-                  << std::endl;
-
-        // Print out mesh summery
-        for (size_t i = 0; i < objInfo.shapes.size(); i++)
-        {
-            std::cout << "Shape " << i << ": " << std::endl;
-            tinyobj::shape_t &shape = objInfo.shapes[i];
-            std::cout << "\t" << shape.mesh.indices.size() << " indices\n";
-
-        }
-    }
 
     std::vector<std::unique_ptr<Primitive>> primitives;
     const glm::mat4 mNormalTransformation = glm::transpose(glm::inverse(mTransformation));
-    for (size_t i = 0; i < objInfo.shapes.size(); i++)
+    for (const ObjShape &shape : mesh.m_vShapes)
     {
-        const auto &vIndices = objInfo.shapes[i].mesh.indices;
+        const auto &vIndices = shape.m_vIndices;
         size_t numVert = vIndices.size();
 
         std::vector<Vertex> vertices;
         vertices.reserve(numVert);
-        for (const auto &meshIdx : vIndices)
+        for (const ObjIndex &meshIdx : vIndices)
         {
-            glm::vec4 pos(objInfo.attrib.vertices[3 * meshIdx.vertex_index],
-                          objInfo.attrib.vertices[3 * meshIdx.vertex_index + 1],
-                          objInfo.attrib.vertices[3 * meshIdx.vertex_index + 2],
-                          1.0);
+            glm::vec4 pos(0.0, 0.0, 0.0, 1.0);
+            if (meshIdx.m_nPosition >= 0 && 3 * (size_t)meshIdx.m_nPosition + 2 < mesh.m_vPositions.size())
+            {
+                pos = glm::vec4(mesh.m_vPositions[3 * meshIdx.m_nPosition],
+                                mesh.m_vPositions[3 * meshIdx.m_nPosition + 1],
+                                mesh.m_vPositions[3 * meshIdx.m_nPosition + 2],
+                                1.0);
+            }
             pos = pos * mTransformation;
 
-            glm::vec4 normal(
-                objInfo.attrib.normals[3 * meshIdx.normal_index],
-                objInfo.attrib.normals[3 * meshIdx.normal_index + 1],
-                objInfo.attrib.normals[3 * meshIdx.normal_index + 2], 0.0);
-
+            glm::vec4 normal(0.0);
+            if (meshIdx.m_nNormal >= 0 && 3 * (size_t)meshIdx.m_nNormal + 2 < mesh.m_vNormals.size())
+            {
+                normal = glm::vec4(mesh.m_vNormals[3 * meshIdx.m_nNormal],
+                                   mesh.m_vNormals[3 * meshIdx.m_nNormal + 1],
+                                   mesh.m_vNormals[3 * meshIdx.m_nNormal + 2], 0.0);
+            }
             normal = normal * mNormalTransformation;
 
+            glm::vec2 texcoord(0.0);
+            if (meshIdx.m_nTexcoord >= 0 && 2 * (size_t)meshIdx.m_nTexcoord + 1 < mesh.m_vTexcoords.size())
+            {
+                texcoord = glm::vec2(mesh.m_vTexcoords[2 * meshIdx.m_nTexcoord],
+                                     mesh.m_vTexcoords[2 * meshIdx.m_nTexcoord + 1]);
+            }
+
             vertices.emplace_back(Vertex(
                 {{pos.x, pos.y, pos.z},
                  {normal.x, normal.y, normal.z},
-                 {objInfo.attrib.texcoords[2 * meshIdx.texcoord_index],
-                  objInfo.attrib.texcoords[2 * meshIdx.texcoord_index + 1],
-                  0,0}}));
+                 {texcoord.x, texcoord.y, 0, 0}}));
         }
         std::vector<Index> indices;
-        indices.reserve(objInfo.shapes[i].mesh.indices.size());
-        for (size_t index = 0; index < objInfo.shapes[i].mesh.indices.size(); index++)
+        indices.reserve(numVert);
+        for (size_t index = 0; index < numVert; index++)
         {
             indices.push_back((Index)index);
         }
@@ -1,35 +1,63 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <cassert>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
+#include "GeometryHeap.h"
+#include "Hash.h"
+#include "MemoryBudget.h"
 #include "MeshVertex.h"
 #include "UniformBuffer.h"
-#include "VertexBuffer.h"
 class Material;
-class Primitive
+class Primitive : public IEvictable
 {
 public:
+    // Only primitives consumed by load time passes keep a CPU copy
     Primitive(const std::vector<Vertex>& vertices,
-              const std::vector<Index>& indices)
+              const std::vector<Index>& indices, bool bKeepCpuData = false)
     {
-        m_vertexBuffer.setData(reinterpret_cast<const void*>(vertices.data()),
-                               sizeof(Vertex) * vertices.size());
+        m_uContentHash = ComputeContentHash(vertices, indices);
+        m_allocation = GetGeometryHeap()->Allocate(vertices, indices);
         m_nVertexCount = (uint32_t)vertices.size();
-        m_indexBuffer.setData(reinterpret_cast<const void*>(indices.data()),
-                              sizeof(Index) * indices.size());
         m_nIndexCount = (uint32_t)indices.size();
+        if (bKeepCpuData)
+        {
+            RetainCpuData(vertices, indices);
+        }
     }
+    ~Primitive()
+    {
+        GetMemoryBudgetManager()->Unregister(this);
+        if (m_bIsResident)
+        {
+            GetGeometryHeap()->Free(m_allocation);
+        }
+    }
+    static uint64_t ComputeContentHash(const std::vector<Vertex>& vertices,
+                                       const std::vector<Index>& indices)
+    {
+        uint64_t uHash = HashBytes(vertices.data(), sizeof(Vertex) * vertices.size());
+        return HashBytes(indices.data(), sizeof(Index) * indices.size(), uHash);
+    }
+    uint64_t GetContentHash() const { return m_uContentHash; }
+
+    // Buffers are shared with other primitives of the geometry heap, draws
+    // use GetFirstIndex() and GetVertexOffset()
     VkBuffer getVertexDeviceBuffer() const
     {
-        return m_vertexBuffer.buffer();
+        return GetGeometryHeap()->GetVertexBuffer(m_allocation.m_uPage);
     }
 
     VkBuffer getIndexDeviceBuffer() const
     {
-        return m_indexBuffer.buffer();
+        return GetGeometryHeap()->GetIndexBuffer(m_allocation.m_uPage);
     }
 
+    uint32_t GetFirstIndex() const { return m_allocation.m_uFirstIndex; }
+    int32_t GetVertexOffset() const { return static_cast<int32_t>(m_allocation.m_uFirstVertex); }
+
     uint32_t getIndexCount() const
     {
         return m_nIndexCount;
@@ -40,15 +68,69 @@ public:
         return m_nVertexCount;
     }
 
+    // CPU side copies of the uploaded data, used by load time passes
+    // (e.g. static batching) that need to rebuild geometry. Released once
+    // the passes ran.
+    bool HasCpuData() const { return m_bHasCpuData; }
+    void RetainCpuData(const std::vector<Vertex>& vertices, const std::vector<Index>& indices)
+    {
+        assert(vertices.size() == m_nVertexCount && indices.size() == m_nIndexCount);
+        m_vVertices = vertices;
+        m_vIndices = indices;
+        m_bHasCpuData = true;
+    }
+    void ReleaseCpuData()
+    {
+        std::vector<Vertex>().swap(m_vVertices);
+        std::vector<Index>().swap(m_vIndices);
+        m_bHasCpuData = false;
+    }
+    const std::vector<Vertex>& GetVertices() const
+    {
+        assert(m_bHasCpuData);
+        return m_vVertices;
+    }
+    const std::vector<Index>& GetIndices() const
+    {
+        assert(m_bHasCpuData);
+        return m_vIndices;
+    }
+
+    // Evicting frees the primitive's heap range, which only gives memory
+    // back when it was the last range of its page. Other primitives report
+    // 0 and stay resident, as do primitives without CPU copies. Evicted
+    // primitives are uploaded again before they get drawn.
+    VkDeviceSize GetResidentSize() const override
+    {
+        return m_bIsResident && m_bHasCpuData ? GetGeometryHeap()->GetReleasableSize(m_allocation) : 0;
+    }
+    bool IsResident() const override { return m_bIsResident; }
+    void Evict() override
+    {
+        assert(m_bHasCpuData);
+        GetGeometryHeap()->Free(m_allocation);
+        m_bIsResident = false;
+    }
+    void MakeResident() override
+    {
+        m_allocation = GetGeometryHeap()->Allocate(m_vVertices, m_vIndices);
+        m_bIsResident = true;
+    }
+
     void SetMaterial(Material* pMaterial) { m_pMaterial = pMaterial; }
     const Material* GetMaterial() const { return m_pMaterial; }
+    Material* GetMaterial() { return m_pMaterial; }
 
 private:
-    VertexBuffer m_vertexBuffer;
-    IndexBuffer m_indexBuffer;
+    std::vector<Vertex> m_vVertices;
+    std::vector<Index> m_vIndices;
+    GeometryAllocation m_allocation;
     uint32_t m_nIndexCount = 0;
     uint32_t m_nVertexCount = 0;
+    uint64_t m_uContentHash = 0;
     Material* m_pMaterial = nullptr;
+    bool m_bIsResident = true;
+    bool m_bHasCpuData = false;
 };
 
 // Simplify the types
@@ -77,25 +159,13 @@ public:
     {
         return m_vPrimitives;
     }
-    void SetWorldMatrix(const glm::mat4 &mObjectToWorld)
-    {
-        assert(m_mWorldMatrix != nullptr);
-        m_mWorldMatrix->setData(mObjectToWorld);
-    }
-
-    const UniformBuffer<glm::mat4>* GetWorldMatrixBuffer() const
-    {
-        return m_mWorldMatrix;
-    }
-
-    void SetWorldMatrixUniformBuffer(UniformBuffer<glm::mat4>* pWorldMatBuffer)
-    {
-        m_mWorldMatrix = pWorldMatBuffer;
-    }
+    // Hash of the primitives' content and material bindings, set by importers
+    void SetContentHash(uint64_t uHash) { m_uContentHash = uHash; }
+    uint64_t GetContentHash() const { return m_uContentHash; }
 
 private:
     std::vector<std::unique_ptr<Primitive>> m_vPrimitives;
-    UniformBuffer<glm::mat4>* m_mWorldMatrix = nullptr;
+    uint64_t m_uContentHash = 0;
 };
 
 class GeometryManager
@@ -105,6 +175,8 @@ public:
     void Destroy() { vpGeometries.clear(); }
     Geometry* GetQuad();
     Geometry* GetCube();
+    // Release geometries no longer referenced by any scene
+    void Remove(const std::unordered_set<const Geometry*>& vpGeometriesToRemove);
 private:
     int m_nQuadIdx = -1;  // Quad geometry idx
     int m_nCubeIdx = -1;  // Cube geometry idx
@@ -0,0 +1,243 @@
+#include "GeometryHeap.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "UploadManager.h"
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+static GeometryHeap s_geometryHeap;
+
+static const VkBufferUsageFlags VERTEX_USAGE =
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+static const VkBufferUsageFlags INDEX_USAGE =
+    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+GeometryHeap* GetGeometryHeap()
+{
+    return &s_geometryHeap;
+}
+
+void RangeAllocator::Initialize(uint32_t uSize)
+{
+    m_uSize = uSize;
+    m_mFreeRanges.clear();
+    m_mFreeRanges[0] = uSize;
+}
+
+bool RangeAllocator::Allocate(uint32_t uCount, uint32_t& uOffset)
+{
+    if (uCount == 0)
+    {
+        uOffset = 0;
+        return true;
+    }
+    for (auto it = m_mFreeRanges.begin(); it != m_mFreeRanges.end(); ++it)
+    {
+        if (it->second >= uCount)
+        {
+            uOffset = it->first;
+            const uint32_t uRemaining = it->second - uCount;
+            m_mFreeRanges.erase(it);
+            if (uRemaining > 0)
+            {
+                m_mFreeRanges[uOffset + uCount] = uRemaining;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void RangeAllocator::Free(uint32_t uOffset, uint32_t uCount)
+{
+    if (uCount == 0)
+    {
+        return;
+    }
+    auto next = m_mFreeRanges.lower_bound(uOffset);
+    assert((next == m_mFreeRanges.end() || uOffset + uCount <= next->first) && "Range is already free");
+    if (next != m_mFreeRanges.end() && uOffset + uCount == next->first)
+    {
+        uCount += next->second;
+        next = m_mFreeRanges.erase(next);
+    }
+    if (next != m_mFreeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == uOffset)
+        {
+            prev->second += uCount;
+            return;
+        }
+    }
+    m_mFreeRanges[uOffset] = uCount;
+}
+
+bool RangeAllocator::IsEmpty() const
+{
+    return m_mFreeRanges.size() == 1 && m_mFreeRanges.begin()->second == m_uSize;
+}
+
+uint32_t RangeAllocator::GetFreeCount() const
+{
+    uint32_t uCount = 0;
+    for (const auto& it : m_mFreeRanges)
+    {
+        uCount += it.second;
+    }
+    return uCount;
+}
+
+void GeometryHeap::Unintialize()
+{
+    for (uint32_t uPage = 0; uPage < m_vpPages.size(); uPage++)
+    {
+        if (m_vpPages[uPage] != nullptr)
+        {
+            DestroyPage(uPage);
+        }
+    }
+    m_vpPages.clear();
+}
+
+GeometryAllocation GeometryHeap::Allocate(const std::vector<Vertex>& vVertices, const std::vector<Index>& vIndices)
+{
+    GeometryAllocation allocation;
+    allocation.m_uVertexCount = static_cast<uint32_t>(vVertices.size());
+    allocation.m_uIndexCount = static_cast<uint32_t>(vIndices.size());
+    for (uint32_t uPage = 0; uPage < m_vpPages.size() && !allocation.IsValid(); uPage++)
+    {
+        Page* pPage = m_vpPages[uPage].get();
+        if (pPage == nullptr || !pPage->m_vertexRanges.Allocate(allocation.m_uVertexCount, allocation.m_uFirstVertex))
+        {
+            continue;
+        }
+        if (!pPage->m_indexRanges.Allocate(allocation.m_uIndexCount, allocation.m_uFirstIndex))
+        {
+            pPage->m_vertexRanges.Free(allocation.m_uFirstVertex, allocation.m_uVertexCount);
+            continue;
+        }
+        allocation.m_uPage = uPage;
+    }
+    if (!allocation.IsValid())
+    {
+        allocation.m_uPage = CreatePage(std::max(allocation.m_uVertexCount, PAGE_VERTEX_COUNT),
+                                        std::max(allocation.m_uIndexCount, PAGE_INDEX_COUNT));
+        Page* pPage = m_vpPages[allocation.m_uPage].get();
+        bool bAllocated = pPage->m_vertexRanges.Allocate(allocation.m_uVertexCount, allocation.m_uFirstVertex);
+        bAllocated &= pPage->m_indexRanges.Allocate(allocation.m_uIndexCount, allocation.m_uFirstIndex);
+        assert(bAllocated && "New page must fit the primitive");
+        (void)bAllocated;
+    }
+
+    const Page* pPage = m_vpPages[allocation.m_uPage].get();
+    GetUploadManager()->UploadBuffer(pPage->m_vertexBuffer, VERTEX_USAGE, sizeof(Vertex) * allocation.m_uFirstVertex,
+                                     vVertices.data(), sizeof(Vertex) * vVertices.size());
+    GetUploadManager()->UploadBuffer(pPage->m_indexBuffer, INDEX_USAGE, sizeof(Index) * allocation.m_uFirstIndex,
+                                     vIndices.data(), sizeof(Index) * vIndices.size());
+    return allocation;
+}
+
+void GeometryHeap::Free(GeometryAllocation& allocation)
+{
+    assert(allocation.IsValid());
+    Page* pPage = m_vpPages[allocation.m_uPage].get();
+    pPage->m_vertexRanges.Free(allocation.m_uFirstVertex, allocation.m_uVertexCount);
+    pPage->m_indexRanges.Free(allocation.m_uFirstIndex, allocation.m_uIndexCount);
+    // Keep the first page around, the others go once empty
+    if (allocation.m_uPage != 0 && pPage->m_vertexRanges.IsEmpty() && pPage->m_indexRanges.IsEmpty())
+    {
+        DestroyPage(allocation.m_uPage);
+    }
+    allocation = GeometryAllocation();
+}
+
+VkDeviceSize GeometryHeap::GetReleasableSize(const GeometryAllocation& allocation) const
+{
+    assert(allocation.IsValid());
+    const Page* pPage = m_vpPages[allocation.m_uPage].get();
+    // Same rule as Free()
+    if (allocation.m_uPage == 0 ||
+        pPage->m_vertexRanges.GetFreeCount() + allocation.m_uVertexCount != pPage->m_vertexRanges.GetSize() ||
+        pPage->m_indexRanges.GetFreeCount() + allocation.m_uIndexCount != pPage->m_indexRanges.GetSize())
+    {
+        return 0;
+    }
+    return sizeof(Vertex) * pPage->m_vertexRanges.GetSize() + sizeof(Index) * pPage->m_indexRanges.GetSize();
+}
+
+void GeometryHeap::GetMovableAllocations(std::vector<VmaAllocation>& vAllocations)
+{
+    // Bottom level acceleration structures were built from the page addresses
+    if (GetRenderDevice()->IsRayTracingSupported())
+    {
+        return;
+    }
+    for (const std::unique_ptr<Page>& pPage : m_vpPages)
+    {
+        if (pPage != nullptr)
+        {
+            vAllocations.push_back(pPage->m_vertexAllocation);
+            vAllocations.push_back(pPage->m_indexAllocation);
+        }
+    }
+}
+
+void GeometryHeap::OnAllocationMoved(VmaAllocation allocation)
+{
+    // Primitives fetch the buffers of their page when recording
+    for (const std::unique_ptr<Page>& pPage : m_vpPages)
+    {
+        if (pPage == nullptr)
+        {
+            continue;
+        }
+        if (pPage->m_vertexAllocation == allocation)
+        {
+            GetMemoryAllocator()->RebindBuffer(pPage->m_vertexBuffer, pPage->m_vertexAllocation,
+                                               sizeof(Vertex) * pPage->m_vertexRanges.GetSize(), VERTEX_USAGE);
+            return;
+        }
+        if (pPage->m_indexAllocation == allocation)
+        {
+            GetMemoryAllocator()->RebindBuffer(pPage->m_indexBuffer, pPage->m_indexAllocation,
+                                               sizeof(Index) * pPage->m_indexRanges.GetSize(), INDEX_USAGE);
+            return;
+        }
+    }
+}
+
+uint32_t GeometryHeap::CreatePage(uint32_t uVertexCount, uint32_t uIndexCount)
+{
+    auto pPage = std::make_unique<Page>();
+    GetMemoryAllocator()->AllocateMovableBuffer(sizeof(Vertex) * uVertexCount, VERTEX_USAGE, pPage->m_vertexBuffer,
+                                                pPage->m_vertexAllocation, "Geometry heap vertices");
+    GetMemoryAllocator()->AllocateMovableBuffer(sizeof(Index) * uIndexCount, INDEX_USAGE, pPage->m_indexBuffer,
+                                                pPage->m_indexAllocation, "Geometry heap indices");
+    pPage->m_vertexRanges.Initialize(uVertexCount);
+    pPage->m_indexRanges.Initialize(uIndexCount);
+
+    auto it = std::find(m_vpPages.begin(), m_vpPages.end(), nullptr);
+    if (it != m_vpPages.end())
+    {
+        *it = std::move(pPage);
+        return static_cast<uint32_t>(it - m_vpPages.begin());
+    }
+    m_vpPages.push_back(std::move(pPage));
+    return static_cast<uint32_t>(m_vpPages.size() - 1);
+}
+
+void GeometryHeap::DestroyPage(uint32_t uPage)
+{
+    // Copies to the page may still be queued
+    if (!GetUploadManager()->IsIdle())
+    {
+        GetUploadManager()->Flush();
+    }
+    Page* pPage = m_vpPages[uPage].get();
+    GetMemoryAllocator()->FreeBuffer(pPage->m_vertexBuffer, pPage->m_vertexAllocation);
+    GetMemoryAllocator()->FreeBuffer(pPage->m_indexBuffer, pPage->m_indexAllocation);
+    m_vpPages[uPage] = nullptr;
+}
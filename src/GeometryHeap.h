@@ -0,0 +1,90 @@
+#pragma once
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Defragmentation.h"
+#include "MeshVertex.h"
+
+// First fit over a range of elements, freed ranges merge with their
+// neighbours
+class RangeAllocator
+{
+public:
+    void Initialize(uint32_t uSize);
+    bool Allocate(uint32_t uCount, uint32_t& uOffset);
+    void Free(uint32_t uOffset, uint32_t uCount);
+    bool IsEmpty() const;
+    uint32_t GetSize() const { return m_uSize; }
+    uint32_t GetFreeCount() const;
+
+private:
+    // Offset to count of the free ranges
+    std::map<uint32_t, uint32_t> m_mFreeRanges;
+    uint32_t m_uSize = 0;
+};
+
+// Range of a primitive in the geometry heap, drawn with firstIndex and
+// vertexOffset
+struct GeometryAllocation
+{
+    static constexpr uint32_t INVALID_PAGE = UINT32_MAX;
+    uint32_t m_uPage = INVALID_PAGE;
+    uint32_t m_uFirstVertex = 0;
+    uint32_t m_uVertexCount = 0;
+    uint32_t m_uFirstIndex = 0;
+    uint32_t m_uIndexCount = 0;
+
+    bool IsValid() const { return m_uPage != INVALID_PAGE; }
+};
+
+// Vertices and indices of all primitives are suballocated from a few large
+// device local buffers, so draws of a pass share their vertex and index
+// buffer bindings. Primitives larger than a page get a page of their own.
+// Pages may be moved by defragmentation unless acceleration structures
+// reference them by device address.
+class GeometryHeap : public IDefragmentable
+{
+public:
+    static constexpr uint32_t PAGE_VERTEX_COUNT = 1024 * 1024;
+    static constexpr uint32_t PAGE_INDEX_COUNT = 3 * 1024 * 1024;
+
+    void Unintialize();
+
+    // Reserve a range and queue the upload of the data
+    GeometryAllocation Allocate(const std::vector<Vertex>& vVertices, const std::vector<Index>& vIndices);
+    // The caller makes sure the range is no longer in use
+    void Free(GeometryAllocation& allocation);
+    // Device memory freeing the range gives back, the size of its page if
+    // it is the page's last range and the page is not kept, 0 otherwise
+    VkDeviceSize GetReleasableSize(const GeometryAllocation& allocation) const;
+
+    VkBuffer GetVertexBuffer(uint32_t uPage) const { return m_vpPages[uPage]->m_vertexBuffer; }
+    VkBuffer GetIndexBuffer(uint32_t uPage) const { return m_vpPages[uPage]->m_indexBuffer; }
+
+    void GetMovableAllocations(std::vector<VmaAllocation>& vAllocations) override;
+    void OnAllocationMoved(VmaAllocation allocation) override;
+
+private:
+    struct Page
+    {
+        VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+        VmaAllocation m_vertexAllocation = VK_NULL_HANDLE;
+        VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+        VmaAllocation m_indexAllocation = VK_NULL_HANDLE;
+        RangeAllocator m_vertexRanges;
+        RangeAllocator m_indexRanges;
+    };
+
+    uint32_t CreatePage(uint32_t uVertexCount, uint32_t uIndexCount);
+    void DestroyPage(uint32_t uPage);
+
+    // Pages of freed slots are null
+    std::vector<std::unique_ptr<Page>> m_vpPages;
+};
+
+GeometryHeap* GetGeometryHeap();
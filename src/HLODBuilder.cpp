@@ -0,0 +1,367 @@
+#include "HLODBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+#include "../thirdparty/stb/stb_image.h"
+#include "Geometry.h"
+#include "Material.h"
+
+namespace
+{
+struct HLODCandidate
+{
+    GeometrySceneNode* m_pNode = nullptr;
+    glm::mat4 m_mWorldMatrix = glm::mat4(1.0);
+};
+
+using CellKey = std::tuple<int, int, int>;
+// Atlas tile first so vertices of different materials never get merged
+using VertexClusterKey = std::tuple<uint32_t, int, int, int>;
+
+struct VertexCluster
+{
+    glm::vec3 m_vPosition = glm::vec3(0.0f);
+    glm::vec3 m_vNormal = glm::vec3(0.0f);
+    glm::vec2 m_vUV = glm::vec2(0.0f);
+    uint32_t m_uCount = 0;
+    Index m_nIndex = 0;
+};
+
+// Resample the albedo image of a material into a square RGBA8 tile with the
+// base color factor applied. The image is read from its RGBA source, cooked
+// textures are block compressed.
+std::vector<uint8_t> BakeAlbedoTile(const Material* pMaterial, uint32_t uTileSize)
+{
+    const Material::PBRFactors& factors = pMaterial->GetMaterialParameterFactors();
+    std::vector<uint8_t> vTile(uTileSize * uTileSize * 4, 255);
+
+    int nWidth = 0, nHeight = 0, nChannels = 0;
+    stbi_uc* pPixels = nullptr;
+    const std::string& sImagePath = pMaterial->GetAlbedoImagePath();
+    if (!sImagePath.empty())
+    {
+        pPixels = stbi_load(sImagePath.c_str(), &nWidth, &nHeight, &nChannels, STBI_rgb_alpha);
+        if (pPixels == nullptr)
+        {
+            std::cerr << sImagePath << ": cannot be baked into the HLOD atlas, " << stbi_failure_reason()
+                      << std::endl;
+        }
+    }
+    else if (pMaterial->GetTexture(Material::TEX_ALBEDO) != nullptr)
+    {
+        std::cerr << "Albedo of a material has no RGBA image to bake into the HLOD atlas" << std::endl;
+    }
+
+    for (uint32_t y = 0; y < uTileSize; y++)
+    {
+        for (uint32_t x = 0; x < uTileSize; x++)
+        {
+            glm::vec4 vColor(1.0f);
+            if (pPixels != nullptr)
+            {
+                // Box filter over the source footprint of this texel
+                uint32_t uX0 = x * nWidth / uTileSize;
+                uint32_t uX1 = std::max((x + 1) * nWidth / uTileSize, uX0 + 1);
+                uint32_t uY0 = y * nHeight / uTileSize;
+                uint32_t uY1 = std::max((y + 1) * nHeight / uTileSize, uY0 + 1);
+                glm::vec4 vSum(0.0f);
+                for (uint32_t sy = uY0; sy < uY1; sy++)
+                {
+                    for (uint32_t sx = uX0; sx < uX1; sx++)
+                    {
+                        const stbi_uc* pTexel = pPixels + (sy * nWidth + sx) * 4;
+                        vSum += glm::vec4(pTexel[0], pTexel[1], pTexel[2], pTexel[3]) / 255.0f;
+                    }
+                }
+                vColor = vSum / (float)((uX1 - uX0) * (uY1 - uY0));
+            }
+            vColor *= glm::vec4(factors.m_aBaseColorFactor[0], factors.m_aBaseColorFactor[1],
+                                factors.m_aBaseColorFactor[2], factors.m_aBaseColorFactor[3]);
+            vColor = glm::clamp(vColor, 0.0f, 1.0f) * 255.0f;
+            uint8_t* pDst = vTile.data() + (y * uTileSize + x) * 4;
+            pDst[0] = (uint8_t)(vColor.r + 0.5f);
+            pDst[1] = (uint8_t)(vColor.g + 0.5f);
+            pDst[2] = (uint8_t)(vColor.b + 0.5f);
+            pDst[3] = (uint8_t)(vColor.a + 0.5f);
+        }
+    }
+    if (pPixels != nullptr)
+    {
+        stbi_image_free(pPixels);
+    }
+    return vTile;
+}
+}  // namespace
+
+uint32_t HLODBuilder::Build(Scene& scene) const
+{
+    assert(m_fClusterSize > 0.0f);
+    scene.SetHLODSwapDistance(m_fSwapDistance);
+
+    // Collect static opaque nodes, world matrices are relative to the root
+    // since proxies are attached directly under it
+    std::vector<HLODCandidate> vCandidates;
+    std::function<void(SceneNode*, const glm::mat4&)> CollectRecursive =
+        [&](SceneNode* pNode, const glm::mat4& mParent) {
+            glm::mat4 mWorldMatrix = mParent * pNode->GetMatrix();
+            if (GeometrySceneNode* pGeometryNode = dynamic_cast<GeometrySceneNode*>(pNode))
+            {
+                bool bIsCandidate = pGeometryNode->IsStatic() && !pGeometryNode->IsTransparent() &&
+                                    !pGeometryNode->IsBatched();
+                for (const auto& pPrimitive : pGeometryNode->GetGeometry()->getPrimitives())
+                {
+                    bIsCandidate &= pPrimitive->GetMaterial() != nullptr && pPrimitive->HasCpuData();
+                }
+                if (bIsCandidate)
+                {
+                    vCandidates.push_back({pGeometryNode, mWorldMatrix});
+                }
+            }
+            for (const auto& pChild : pNode->GetChildren())
+            {
+                CollectRecursive(pChild.get(), mWorldMatrix);
+            }
+        };
+    for (const auto& pChild : scene.GetRoot()->GetChildren())
+    {
+        CollectRecursive(pChild.get(), glm::mat4(1.0));
+    }
+
+    // Group whole nodes by the cell of their world space bounding box center
+    std::map<CellKey, std::vector<size_t>> mCells;
+    for (size_t i = 0; i < vCandidates.size(); i++)
+    {
+        glm::vec3 vMin(std::numeric_limits<float>::max());
+        glm::vec3 vMax(std::numeric_limits<float>::lowest());
+        for (const auto& pPrimitive : vCandidates[i].m_pNode->GetGeometry()->getPrimitives())
+        {
+            for (const Vertex& vertex : pPrimitive->GetVertices())
+            {
+                glm::vec3 vPos = glm::vec3(vCandidates[i].m_mWorldMatrix * glm::vec4(vertex.pos, 1.0f));
+                vMin = glm::min(vMin, vPos);
+                vMax = glm::max(vMax, vPos);
+            }
+        }
+        if (vMin.x > vMax.x)
+        {
+            continue;
+        }
+        glm::ivec3 vCell = glm::ivec3(glm::floor((vMin + vMax) * 0.5f / m_fClusterSize));
+        mCells[{vCell.x, vCell.y, vCell.z}].push_back(i);
+    }
+
+    uint32_t uNumClusters = 0;
+    for (const auto& cell : mCells)
+    {
+        const std::vector<size_t>& vMembers = cell.second;
+        // A single node gains nothing from a proxy
+        if (vMembers.size() < 2)
+        {
+            continue;
+        }
+
+        // Assign an atlas tile to each material used in the cluster
+        std::vector<const Material*> vpMaterials;
+        std::unordered_map<const Material*, uint32_t> mTileIndices;
+        for (size_t nCandidateIdx : vMembers)
+        {
+            for (const auto& pPrimitive : vCandidates[nCandidateIdx].m_pNode->GetGeometry()->getPrimitives())
+            {
+                const Material* pMaterial = pPrimitive->GetMaterial();
+                if (mTileIndices.find(pMaterial) == mTileIndices.end())
+                {
+                    mTileIndices[pMaterial] = (uint32_t)vpMaterials.size();
+                    vpMaterials.push_back(pMaterial);
+                }
+            }
+        }
+        const uint32_t uTilesPerRow = (uint32_t)std::ceil(std::sqrt((float)vpMaterials.size()));
+        const uint32_t uAtlasSize = uTilesPerRow * m_uAtlasTileSize;
+
+        // Bake the atlas and average the scalar factors
+        std::vector<uint8_t> vAtlas(uAtlasSize * uAtlasSize * 4, 0);
+        float fMetallic = 0.0f;
+        float fRoughness = 0.0f;
+        for (uint32_t uTile = 0; uTile < vpMaterials.size(); uTile++)
+        {
+            std::vector<uint8_t> vTile = BakeAlbedoTile(vpMaterials[uTile], m_uAtlasTileSize);
+            const uint32_t uTileX = (uTile % uTilesPerRow) * m_uAtlasTileSize;
+            const uint32_t uTileY = (uTile / uTilesPerRow) * m_uAtlasTileSize;
+            for (uint32_t y = 0; y < m_uAtlasTileSize; y++)
+            {
+                memcpy(vAtlas.data() + ((uTileY + y) * uAtlasSize + uTileX) * 4,
+                       vTile.data() + y * m_uAtlasTileSize * 4, m_uAtlasTileSize * 4);
+            }
+            fMetallic += vpMaterials[uTile]->GetMaterialParameterFactors().m_fMetalicFactor;
+            fRoughness += vpMaterials[uTile]->GetMaterialParameterFactors().m_fRoughnessFactor;
+        }
+        fMetallic /= (float)vpMaterials.size();
+        fRoughness /= (float)vpMaterials.size();
+
+        // Merge the members in world space and simplify by clustering
+        // vertices on a grid. UVs are clamped into their atlas tile, repeating
+        // textures lose their tiling which is acceptable at proxy distance.
+        const float fGridSize = m_fClusterSize / (float)m_uSimplificationResolution;
+        const float fTexelSize = 1.0f / (float)uAtlasSize;
+        std::map<VertexClusterKey, VertexCluster> mVertexClusters;
+        std::vector<VertexClusterKey> vTriangleKeys;
+        glm::vec3 vCenter(0.0f);
+        uint32_t uNumSourceVertices = 0;
+        for (size_t nCandidateIdx : vMembers)
+        {
+            const HLODCandidate& candidate = vCandidates[nCandidateIdx];
+            const glm::mat3 mNormalMatrix = glm::transpose(glm::inverse(glm::mat3(candidate.m_mWorldMatrix)));
+            for (const auto& pPrimitive : candidate.m_pNode->GetGeometry()->getPrimitives())
+            {
+                const Material* pMaterial = pPrimitive->GetMaterial();
+                const uint32_t uTile = mTileIndices.at(pMaterial);
+                const glm::vec2 vTileOrigin((float)((uTile % uTilesPerRow) * m_uAtlasTileSize),
+                                            (float)((uTile / uTilesPerRow) * m_uAtlasTileSize));
+                const bool bUseUV1 = pMaterial->GetMaterialParameterFactors().m_aUVIndices[Material::TEX_ALBEDO] == 1;
+
+                const std::vector<Vertex>& vVertices = pPrimitive->GetVertices();
+                std::vector<VertexClusterKey> vVertexKeys(vVertices.size());
+                for (size_t i = 0; i < vVertices.size(); i++)
+                {
+                    const Vertex& vertex = vVertices[i];
+                    glm::vec3 vPos = glm::vec3(candidate.m_mWorldMatrix * glm::vec4(vertex.pos, 1.0f));
+                    glm::vec3 vNormal = glm::normalize(mNormalMatrix * vertex.normal);
+                    glm::vec2 vUV = bUseUV1 ? glm::vec2(vertex.textureCoord.z, vertex.textureCoord.w)
+                                            : glm::vec2(vertex.textureCoord.x, vertex.textureCoord.y);
+                    // Keep half a texel away from the tile border to avoid
+                    // bleeding from the neighbours
+                    vUV = (vTileOrigin + 0.5f + glm::clamp(vUV, 0.0f, 1.0f) * (float)(m_uAtlasTileSize - 1)) * fTexelSize;
+
+                    glm::ivec3 vGridCell = glm::ivec3(glm::floor(vPos / fGridSize));
+                    VertexClusterKey key = {uTile, vGridCell.x, vGridCell.y, vGridCell.z};
+                    VertexCluster& vertexCluster = mVertexClusters[key];
+                    vertexCluster.m_vPosition += vPos;
+                    vertexCluster.m_vNormal += vNormal;
+                    vertexCluster.m_vUV += vUV;
+                    vertexCluster.m_uCount++;
+                    vVertexKeys[i] = key;
+                    vCenter += vPos;
+                    uNumSourceVertices++;
+                }
+                for (Index index : pPrimitive->GetIndices())
+                {
+                    vTriangleKeys.push_back(vVertexKeys[index]);
+                }
+            }
+        }
+        if (uNumSourceVertices == 0)
+        {
+            continue;
+        }
+
+        std::vector<Vertex> vProxyVertices;
+        vProxyVertices.reserve(mVertexClusters.size());
+        for (auto& vertexCluster : mVertexClusters)
+        {
+            VertexCluster& vc = vertexCluster.second;
+            vc.m_nIndex = (Index)vProxyVertices.size();
+            Vertex vertex;
+            vertex.pos = vc.m_vPosition / (float)vc.m_uCount;
+            vertex.normal = glm::length(vc.m_vNormal) > 0.0f ? glm::normalize(vc.m_vNormal) : glm::vec3(0.0f, 0.0f, 1.0f);
+            glm::vec2 vUV = vc.m_vUV / (float)vc.m_uCount;
+            vertex.textureCoord = glm::vec4(vUV, vUV);
+            vProxyVertices.push_back(vertex);
+        }
+        std::vector<Index> vProxyIndices;
+        for (size_t i = 0; i + 2 < vTriangleKeys.size(); i += 3)
+        {
+            Index a = mVertexClusters.at(vTriangleKeys[i]).m_nIndex;
+            Index b = mVertexClusters.at(vTriangleKeys[i + 1]).m_nIndex;
+            Index c = mVertexClusters.at(vTriangleKeys[i + 2]).m_nIndex;
+            // Triangles collapsed by the clustering
+            if (a == b || b == c || a == c)
+            {
+                continue;
+            }
+            vProxyIndices.push_back(a);
+            vProxyIndices.push_back(b);
+            vProxyIndices.push_back(c);
+        }
+        if (vProxyIndices.empty())
+        {
+            continue;
+        }
+
+        std::stringstream ssName;
+        ssName << "HLOD_" << scene.GetName() << "_" << uNumClusters;
+        const std::string sName = ssName.str();
+
+        // Proxy material with the atlas as albedo and default maps elsewhere
+        // Re-imports rebuild proxies of the same name, the previous ones are
+        // still referenced by the old scene so the entries are updated in
+        // place
+        std::unique_ptr<Texture>& pAtlasEntry = GetTextureManager()->m_vpTextures[sName];
+        if (pAtlasEntry == nullptr)
+        {
+            pAtlasEntry = std::make_unique<Texture>();
+            pAtlasEntry->LoadPixels(vAtlas.data(), (int)uAtlasSize, (int)uAtlasSize, true);
+            pAtlasEntry->SetDebugName(sName);
+        }
+        else
+        {
+            pAtlasEntry->ReloadPixels(vAtlas.data(), (int)uAtlasSize, (int)uAtlasSize);
+        }
+        Texture* pAtlas = pAtlasEntry.get();
+
+        std::unique_ptr<Material>& pMaterialEntry = GetMaterialManager()->m_mMaterials[sName];
+        if (pMaterialEntry == nullptr)
+        {
+            pMaterialEntry = std::make_unique<Material>();
+        }
+        Material* pProxyMaterial = pMaterialEntry.get();
+        pProxyMaterial->SetTexture(Material::TEX_ALBEDO, pAtlas);
+        pProxyMaterial->loadTexture(Material::TEX_NORMAL, "assets/Materials/black5x5.png", "defaultNormal");
+        pProxyMaterial->loadTexture(Material::TEX_ORM, "assets/Materials/white5x5.png", "defaultORM");
+        Material::PBRFactors pbrFactors;
+        std::fill(std::begin(pbrFactors.m_aBaseColorFactor), std::end(pbrFactors.m_aBaseColorFactor), 1.0f);
+        pbrFactors.m_fMetalicFactor = fMetallic;
+        pbrFactors.m_fRoughnessFactor = fRoughness;
+        pProxyMaterial->SetMaterialParameterFactors(pbrFactors);
+        if (pProxyMaterial->GetMaterialIndex() == Material::INVALID_MATERIAL_INDEX)
+        {
+            pProxyMaterial->AllocateMaterialIndex();
+        }
+        else
+        {
+            pProxyMaterial->UpdateMaterialData();
+        }
+
+        auto pPrimitive = std::make_unique<Primitive>(vProxyVertices, vProxyIndices);
+        pPrimitive->SetMaterial(pProxyMaterial);
+        Geometry* pGeometry = new Geometry(std::move(pPrimitive));
+        GetGeometryManager()->vpGeometries.emplace_back(pGeometry);
+
+        GeometrySceneNode* pProxyNode = new GeometrySceneNode;
+        pProxyNode->SetName(sName);
+        pProxyNode->SetGeometry(pGeometry);
+        pProxyNode->SetHidden(true);
+        scene.GetRoot()->AppendChild(pProxyNode);
+
+        HLODCluster cluster;
+        cluster.m_pProxy = pProxyNode;
+        cluster.m_vCenter = vCenter / (float)uNumSourceVertices;
+        for (size_t nCandidateIdx : vMembers)
+        {
+            cluster.m_vpMembers.push_back(vCandidates[nCandidateIdx].m_pNode);
+        }
+        scene.AddHLODCluster(cluster);
+        uNumClusters++;
+    }
+    scene.MarkDrawListsDirty();
+    return uNumClusters;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+
+#include "Scene.h"
+
+// Build hierarchical LOD proxies at load: spatially close opaque geometry
+// nodes are merged, simplified by vertex clustering and textured with a baked
+// albedo atlas. The proxies live next to the original nodes in the scene and
+// Scene::UpdateHLOD swaps between the two based on the eye distance.
+class HLODBuilder
+{
+public:
+    HLODBuilder(float fClusterSize, float fSwapDistance)
+        : m_fClusterSize(fClusterSize), m_fSwapDistance(fSwapDistance)
+    {
+    }
+    void SetSimplificationResolution(uint32_t uResolution) { m_uSimplificationResolution = uResolution; }
+    void SetAtlasTileSize(uint32_t uTileSize) { m_uAtlasTileSize = uTileSize; }
+    // Returns the number of clusters built
+    uint32_t Build(Scene& scene) const;
+
+private:
+    float m_fClusterSize = 0.0f;
+    float m_fSwapDistance = 0.0f;
+    // Number of vertex clustering cells along each axis of a cluster
+    uint32_t m_uSimplificationResolution = 16;
+    // Size in pixels each material gets in the proxy atlas
+    uint32_t m_uAtlasTileSize = 64;
+};
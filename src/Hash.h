@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a, used to key imported content so unchanged resources can be
+// reused across re-imports
+static const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV1A_PRIME = 1099511628211ull;
+
+inline uint64_t HashBytes(const void* pData, size_t nSize, uint64_t uHash = FNV1A_OFFSET_BASIS)
+{
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    for (size_t i = 0; i < nSize; i++)
+    {
+        uHash ^= pBytes[i];
+        uHash *= FNV1A_PRIME;
+    }
+    return uHash;
+}
+
+template <class T>
+inline uint64_t HashValue(const T& value, uint64_t uHash = FNV1A_OFFSET_BASIS)
+{
+    return HashBytes(&value, sizeof(T), uHash);
+}
@@ -0,0 +1,242 @@
+#include "KTX2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+// Layout of the file header up to the level index
+struct KTX2Header
+{
+    uint8_t m_aIdentifier[12];
+    uint32_t m_uVkFormat;
+    uint32_t m_uTypeSize;
+    uint32_t m_uPixelWidth;
+    uint32_t m_uPixelHeight;
+    uint32_t m_uPixelDepth;
+    uint32_t m_uLayerCount;
+    uint32_t m_uFaceCount;
+    uint32_t m_uLevelCount;
+    uint32_t m_uSupercompressionScheme;
+    uint32_t m_uDfdByteOffset;
+    uint32_t m_uDfdByteLength;
+    uint32_t m_uKvdByteOffset;
+    uint32_t m_uKvdByteLength;
+    uint64_t m_uSgdByteOffset;
+    uint64_t m_uSgdByteLength;
+};
+static_assert(sizeof(KTX2Header) == 80, "KTX2 header must be tightly packed");
+
+struct KTX2LevelIndex
+{
+    uint64_t m_uByteOffset;
+    uint64_t m_uByteLength;
+    uint64_t m_uUncompressedByteLength;
+};
+
+struct FormatInfo
+{
+    VkFormat m_format;
+    uint32_t m_uBlockDimension;
+    uint32_t m_uBlockSize;
+    // Data format descriptor color model
+    uint32_t m_uColorModel;
+};
+
+static const FormatInfo* GetFormatInfo(VkFormat format)
+{
+    static const FormatInfo FORMATS[] = {
+        {VK_FORMAT_R8G8B8A8_UNORM, 1, 4, 1},
+        {VK_FORMAT_BC4_UNORM_BLOCK, 4, 8, 131},
+        {VK_FORMAT_BC5_UNORM_BLOCK, 4, 16, 132},
+        {VK_FORMAT_BC7_UNORM_BLOCK, 4, 16, 134},
+    };
+    for (const FormatInfo& info : FORMATS)
+    {
+        if (info.m_format == format)
+        {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+bool IsKTX2File(const uint8_t* pData, size_t nSize)
+{
+    return nSize >= sizeof(KTX2_IDENTIFIER) && memcmp(pData, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool ReadKTX2(const uint8_t* pData, size_t nSize, KTX2Image& image, std::string& sError)
+{
+    KTX2Header header;
+    if (nSize < sizeof(header) || !IsKTX2File(pData, nSize))
+    {
+        sError = "Not a KTX2 file";
+        return false;
+    }
+    memcpy(&header, pData, sizeof(header));
+    if (header.m_uSupercompressionScheme != 0 || header.m_uVkFormat == VK_FORMAT_UNDEFINED)
+    {
+        sError = "Supercompressed or Basis Universal KTX2 data needs a transcoder";
+        return false;
+    }
+    const FormatInfo* pFormatInfo = GetFormatInfo(static_cast<VkFormat>(header.m_uVkFormat));
+    if (pFormatInfo == nullptr)
+    {
+        sError = "Unsupported KTX2 format " + std::to_string(header.m_uVkFormat);
+        return false;
+    }
+    if (header.m_uPixelDepth > 1 || header.m_uLayerCount > 1 || header.m_uFaceCount != 1 || header.m_uPixelHeight == 0)
+    {
+        sError = "Only single 2D KTX2 images are supported";
+        return false;
+    }
+
+    const uint32_t uLevelCount = std::max(header.m_uLevelCount, 1u);
+    if (sizeof(header) + uLevelCount * sizeof(KTX2LevelIndex) > nSize)
+    {
+        sError = "Truncated KTX2 level index";
+        return false;
+    }
+    image.m_format = pFormatInfo->m_format;
+    image.m_uWidth = header.m_uPixelWidth;
+    image.m_uHeight = header.m_uPixelHeight;
+    image.m_vLevels.resize(uLevelCount);
+    image.m_vData.clear();
+    for (uint32_t i = 0; i < uLevelCount; i++)
+    {
+        KTX2LevelIndex levelIndex;
+        memcpy(&levelIndex, pData + sizeof(header) + i * sizeof(KTX2LevelIndex), sizeof(levelIndex));
+
+        MipLevel& level = image.m_vLevels[i];
+        level.m_uWidth = std::max(header.m_uPixelWidth >> i, 1u);
+        level.m_uHeight = std::max(header.m_uPixelHeight >> i, 1u);
+        level.m_nOffset = image.m_vData.size();
+        const uint32_t uBlockDimension = pFormatInfo->m_uBlockDimension;
+        level.m_nSize = (size_t)((level.m_uWidth + uBlockDimension - 1) / uBlockDimension) *
+                        ((level.m_uHeight + uBlockDimension - 1) / uBlockDimension) * pFormatInfo->m_uBlockSize;
+        if (levelIndex.m_uByteLength < level.m_nSize || levelIndex.m_uByteOffset + level.m_nSize > nSize)
+        {
+            sError = "Truncated KTX2 level " + std::to_string(i);
+            return false;
+        }
+        image.m_vData.insert(image.m_vData.end(), pData + levelIndex.m_uByteOffset,
+                             pData + levelIndex.m_uByteOffset + level.m_nSize);
+    }
+    return true;
+}
+
+VkFormat ReadKTX2Format(const std::string& sPath)
+{
+    KTX2Header header;
+    std::ifstream file(sPath, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !IsKTX2File(reinterpret_cast<const uint8_t*>(&header), sizeof(header)))
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+    return static_cast<VkFormat>(header.m_uVkFormat);
+}
+
+// Basic data format descriptor, required by the container
+static std::vector<uint32_t> BuildDataFormatDescriptor(const FormatInfo& formatInfo)
+{
+    struct Sample
+    {
+        uint32_t m_uBitOffset;
+        uint32_t m_uBitLength;
+        uint32_t m_uChannel;
+        uint32_t m_uUpper;
+    };
+    std::vector<Sample> vSamples;
+    switch (formatInfo.m_format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            vSamples = {{0, 8, 0, 255}, {8, 8, 1, 255}, {16, 8, 2, 255}, {24, 8, 15, 255}};
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            vSamples = {{0, 64, 0, 0xFFFFFFFF}};
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            vSamples = {{0, 64, 0, 0xFFFFFFFF}, {64, 64, 1, 0xFFFFFFFF}};
+            break;
+        default:
+            vSamples = {{0, 128, 0, 0xFFFFFFFF}};
+            break;
+    }
+    const uint32_t uBlockSize = 24 + 16 * (uint32_t)vSamples.size();
+    const uint32_t uDimension = formatInfo.m_uBlockDimension - 1;
+    std::vector<uint32_t> vWords = {
+        4 + uBlockSize,                                   // total size
+        0,                                                // vendor id, descriptor type
+        2 | (uBlockSize << 16),                           // version, block size
+        formatInfo.m_uColorModel | (1 << 8) | (1 << 16),  // BT709 primaries, linear transfer
+        uDimension | (uDimension << 8),                   // texel block dimensions
+        formatInfo.m_uBlockSize,                          // bytes per plane
+        0,
+    };
+    for (const Sample& sample : vSamples)
+    {
+        vWords.push_back(sample.m_uBitOffset | ((sample.m_uBitLength - 1) << 16) | (sample.m_uChannel << 24));
+        vWords.push_back(0);
+        vWords.push_back(0);
+        vWords.push_back(sample.m_uUpper);
+    }
+    return vWords;
+}
+
+bool WriteKTX2(const std::string& sPath, const KTX2Image& image)
+{
+    const FormatInfo* pFormatInfo = GetFormatInfo(image.m_format);
+    if (pFormatInfo == nullptr)
+    {
+        return false;
+    }
+    const std::vector<uint32_t> vDfd = BuildDataFormatDescriptor(*pFormatInfo);
+
+    KTX2Header header = {};
+    memcpy(header.m_aIdentifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.m_uVkFormat = image.m_format;
+    header.m_uTypeSize = 1;
+    header.m_uPixelWidth = image.m_uWidth;
+    header.m_uPixelHeight = image.m_uHeight;
+    header.m_uPixelDepth = 0;
+    header.m_uLayerCount = 0;
+    header.m_uFaceCount = 1;
+    header.m_uLevelCount = (uint32_t)image.m_vLevels.size();
+    header.m_uSupercompressionScheme = 0;
+    header.m_uDfdByteOffset = (uint32_t)(sizeof(header) + image.m_vLevels.size() * sizeof(KTX2LevelIndex));
+    header.m_uDfdByteLength = (uint32_t)(vDfd.size() * sizeof(uint32_t));
+
+    // Levels are stored smallest first, each aligned to the block size
+    const size_t nAlignment = std::max<size_t>(pFormatInfo->m_uBlockSize, 4);
+    std::vector<KTX2LevelIndex> vLevelIndices(image.m_vLevels.size());
+    size_t nOffset = header.m_uDfdByteOffset + header.m_uDfdByteLength;
+    for (size_t i = image.m_vLevels.size(); i-- > 0;)
+    {
+        nOffset = (nOffset + nAlignment - 1) / nAlignment * nAlignment;
+        vLevelIndices[i].m_uByteOffset = nOffset;
+        vLevelIndices[i].m_uByteLength = image.m_vLevels[i].m_nSize;
+        vLevelIndices[i].m_uUncompressedByteLength = image.m_vLevels[i].m_nSize;
+        nOffset += image.m_vLevels[i].m_nSize;
+    }
+
+    std::vector<uint8_t> vFile(nOffset, 0);
+    memcpy(vFile.data(), &header, sizeof(header));
+    memcpy(vFile.data() + sizeof(header), vLevelIndices.data(), vLevelIndices.size() * sizeof(KTX2LevelIndex));
+    memcpy(vFile.data() + header.m_uDfdByteOffset, vDfd.data(), header.m_uDfdByteLength);
+    for (size_t i = 0; i < image.m_vLevels.size(); i++)
+    {
+        memcpy(vFile.data() + vLevelIndices[i].m_uByteOffset, image.m_vData.data() + image.m_vLevels[i].m_nOffset,
+               image.m_vLevels[i].m_nSize);
+    }
+
+    std::ofstream file(sPath, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(vFile.data()), vFile.size());
+    return file.good();
+}
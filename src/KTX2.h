@@ -0,0 +1,30 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MipChain.h"
+
+// Single 2D image stored in a KTX2 container, levels are packed from the
+// base level down
+struct KTX2Image
+{
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    uint32_t m_uWidth = 0;
+    uint32_t m_uHeight = 0;
+    std::vector<uint8_t> m_vData;
+    std::vector<MipLevel> m_vLevels;
+};
+
+bool IsKTX2File(const uint8_t* pData, size_t nSize);
+
+// Only uncompressed or BC formats without supercompression are supported.
+// Basis Universal payloads need a transcoder and are rejected.
+bool ReadKTX2(const uint8_t* pData, size_t nSize, KTX2Image& image, std::string& sError);
+
+// Reads only the header, VK_FORMAT_UNDEFINED if the file is not KTX2
+VkFormat ReadKTX2Format(const std::string& sPath);
+
+bool WriteKTX2(const std::string& sPath, const KTX2Image& image);
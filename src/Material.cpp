@@ -1,10 +1,75 @@
 #include "Material.h"
 
 #include "DescriptorManager.h"
+#include "Hash.h"
 #include "RenderResourceManager.h"
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+#include <algorithm>
+#include <cstring>
 static MaterialManager s_materialManager;
 
 // Material Manager
+void MaterialManager::Initialize()
+{
+    assert(m_factorsBuffer == VK_NULL_HANDLE);
+    const VkDeviceSize uFactorsSize = MAX_MATERIALS * sizeof(Material::PBRFactors);
+    GetMemoryAllocator()->AllocateBuffer(uFactorsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                         VMA_MEMORY_USAGE_CPU_TO_GPU, m_factorsBuffer, m_factorsAllocation,
+                                         "Material factors");
+    m_pFactors = static_cast<Material::PBRFactors*>(GetMemoryAllocator()->GetMappedData(m_factorsAllocation));
+
+    m_descriptorSet = GetDescriptorManager()->AllocateMaterialDescriptorSet();
+    DescriptorManager::UpdateMaterialBufferDescriptors(m_descriptorSet, m_factorsBuffer, uFactorsSize);
+
+    // Slot 0 is reserved for textures without a slot
+    m_vpTextures.resize(1, nullptr);
+    m_vBoundViews.resize(1, VK_NULL_HANDLE);
+}
+
+void MaterialManager::Unintialize()
+{
+    for (Texture* pTexture : m_vpTextures)
+    {
+        if (pTexture != nullptr)
+        {
+            pTexture->SetBindlessIndex(0);
+        }
+    }
+    m_vpTextures.clear();
+    m_vBoundViews.clear();
+    m_vFreeTextureIndices.clear();
+    m_vDirtyTextureIndices.clear();
+    m_qRetiredTextureIndices.clear();
+    m_vFreeMaterialIndices.clear();
+    m_uNumMaterialIndices = 0;
+
+    // The set goes with its pool
+    m_descriptorSet = VK_NULL_HANDLE;
+    GetMemoryAllocator()->FreeBuffer(m_factorsBuffer, m_factorsAllocation);
+    m_factorsBuffer = VK_NULL_HANDLE;
+    m_pFactors = nullptr;
+}
+
+void MaterialManager::GetMovableAllocations(std::vector<VmaAllocation>& vAllocations)
+{
+    if (m_factorsAllocation != VK_NULL_HANDLE)
+    {
+        vAllocations.push_back(m_factorsAllocation);
+    }
+}
+
+void MaterialManager::OnAllocationMoved(VmaAllocation allocation)
+{
+    assert(allocation == m_factorsAllocation);
+    const VkDeviceSize uFactorsSize = MAX_MATERIALS * sizeof(Material::PBRFactors);
+    GetMemoryAllocator()->RebindBuffer(m_factorsBuffer, m_factorsAllocation, uFactorsSize,
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    m_pFactors = static_cast<Material::PBRFactors*>(GetMemoryAllocator()->GetMappedData(m_factorsAllocation));
+    DescriptorManager::UpdateMaterialBufferDescriptors(m_descriptorSet, m_factorsBuffer, uFactorsSize);
+}
+
 void MaterialManager::CreateDefaultMaterial()
 {
     if (m_mMaterials.find(sDefaultName) == m_mMaterials.end())
@@ -14,16 +79,14 @@ void MaterialManager::CreateDefaultMaterial()
 
         // Load PBR textures
         pMaterial->loadTexture( Material::TEX_ALBEDO, "assets/Materials/white5x5.png", "defaultAlbedo"); 
-        pMaterial->loadTexture( Material::TEX_METALNESS, "assets/Materials/white5x5.png", "defaultMetalness"); 
         pMaterial->loadTexture( Material::TEX_NORMAL, "assets/Materials/white5x5.png", "defaultNormal"); 
-        pMaterial->loadTexture( Material::TEX_ROUGHNESS, "assets/Materials/white5x5.png", "defaultRoughness");
-        pMaterial->loadTexture( Material::TEX_AO, "assets/Materials/white5x5.png", "defaultOcclusion");
+        pMaterial->loadTexture( Material::TEX_ORM, "assets/Materials/white5x5.png", "defaultORM");
 
         // Load PBR Factors
         Material::PBRFactors pbrFactors;
-        pMaterial->SetMaterialParameterFactors(pbrFactors, sDefaultName);
+        pMaterial->SetMaterialParameterFactors(pbrFactors);
 
-        pMaterial->AllocateDescriptorSet();
+        pMaterial->AllocateMaterialIndex();
     }
 }
 MaterialManager *GetMaterialManager()
@@ -31,22 +94,241 @@ MaterialManager *GetMaterialManager()
     return &s_materialManager;
 }
 
-void Material::SetMaterialParameterFactors(const PBRFactors &factors, const std::string &sMaterialName)
+uint32_t MaterialManager::UpdateStreamedTextures()
+{
+    RecycleRetiredTextureSlots();
+    uint32_t uNumUpdated = 0;
+    // Moved textures land in free or appended slots, their views are bound
+    const size_t uNumSlots = m_vpTextures.size();
+    for (size_t i = 1; i < uNumSlots; i++)
+    {
+        if (m_vpTextures[i] != nullptr && m_vBoundViews[i] != m_vpTextures[i]->GetResidentView())
+        {
+            MoveTextureSlot(static_cast<uint32_t>(i));
+            uNumUpdated++;
+        }
+    }
+    // Pending frames read the material factors as they execute, the new
+    // slots are written before the materials point at them
+    FlushTextureDescriptors();
+    if (uNumUpdated > 0)
+    {
+        for (auto& it : m_mMaterials)
+        {
+            uNumUpdated += it.second->UpdateStreamedTextures() ? 1 : 0;
+        }
+        FlushTextureDescriptors();
+    }
+    return uNumUpdated;
+}
+
+uint32_t MaterialManager::AllocateTextureSlot()
+{
+    if (!m_vFreeTextureIndices.empty())
+    {
+        const uint32_t uIndex = m_vFreeTextureIndices.back();
+        m_vFreeTextureIndices.pop_back();
+        return uIndex;
+    }
+    assert(m_vpTextures.size() < MAX_MATERIAL_TEXTURES && "Out of material texture slots");
+    m_vpTextures.push_back(nullptr);
+    m_vBoundViews.push_back(VK_NULL_HANDLE);
+    return static_cast<uint32_t>(m_vpTextures.size() - 1);
+}
+
+uint32_t MaterialManager::MoveTextureSlot(uint32_t uIndex)
 {
-    auto* pUniformBuffer = GetRenderResourceManager()->getUniformBuffer<PBRFactors>(sMaterialName);
-    pUniformBuffer->setData(factors);
-    m_materialParameters.m_pFactors = pUniformBuffer;
+    Texture* pTexture = m_vpTextures[uIndex];
+    m_vpTextures[uIndex] = nullptr;
+    m_vBoundViews[uIndex] = VK_NULL_HANDLE;
+    // Frames submitted so far may still sample the old slot
+    m_qRetiredTextureIndices.emplace_back(uIndex, GetRenderDevice()->GetSubmittedFrameCount());
+
+    const uint32_t uNewIndex = AllocateTextureSlot();
+    m_vpTextures[uNewIndex] = pTexture;
+    m_vBoundViews[uNewIndex] = pTexture->GetResidentView();
+    m_vDirtyTextureIndices.push_back(uNewIndex);
+    pTexture->SetBindlessIndex(uNewIndex);
+    return uNewIndex;
 }
 
-void Material::AllocateDescriptorSet()
+void MaterialManager::RecycleRetiredTextureSlots()
 {
-    if (m_descriptorSet == VK_NULL_HANDLE)
+    const uint64_t uCompletedFrames = GetRenderDevice()->GetCompletedFrameCount();
+    while (!m_qRetiredTextureIndices.empty() && m_qRetiredTextureIndices.front().second <= uCompletedFrames)
     {
-        m_descriptorSet = GetDescriptorManager()->AllocateMaterialDescriptorSet(m_materialParameters);
+        m_vFreeTextureIndices.push_back(m_qRetiredTextureIndices.front().first);
+        m_qRetiredTextureIndices.pop_front();
     }
 }
 
-VkDescriptorSet Material::GetDescriptorSet() const
+VkDescriptorSet MaterialManager::GetDescriptorSet()
 {
+    FlushTextureDescriptors();
     return m_descriptorSet;
 }
+
+void MaterialManager::FlushTextureDescriptors()
+{
+    // Slots released after being queued have no view to write
+    m_vDirtyTextureIndices.erase(std::remove_if(m_vDirtyTextureIndices.begin(), m_vDirtyTextureIndices.end(),
+                                                [this](uint32_t uIndex) { return m_vpTextures[uIndex] == nullptr; }),
+                                 m_vDirtyTextureIndices.end());
+    if (!m_vDirtyTextureIndices.empty())
+    {
+        DescriptorManager::UpdateMaterialTextureDescriptors(m_descriptorSet, m_vDirtyTextureIndices, m_vBoundViews);
+        m_vDirtyTextureIndices.clear();
+    }
+}
+
+uint32_t MaterialManager::AllocateMaterialIndex()
+{
+    assert(m_pFactors != nullptr && "Material manager is not initialized");
+    if (!m_vFreeMaterialIndices.empty())
+    {
+        const uint32_t uIndex = m_vFreeMaterialIndices.back();
+        m_vFreeMaterialIndices.pop_back();
+        return uIndex;
+    }
+    assert(m_uNumMaterialIndices < MAX_MATERIALS && "Out of material slots");
+    return m_uNumMaterialIndices++;
+}
+
+void MaterialManager::FreeMaterialIndex(uint32_t uIndex)
+{
+    if (m_pFactors != nullptr)
+    {
+        m_vFreeMaterialIndices.push_back(uIndex);
+    }
+}
+
+void MaterialManager::WriteMaterialFactors(uint32_t uIndex, const Material::PBRFactors& factors)
+{
+    assert(uIndex < m_uNumMaterialIndices);
+    m_pFactors[uIndex] = factors;
+    GetMemoryAllocator()->FlushAllocation(m_factorsAllocation, uIndex * sizeof(Material::PBRFactors),
+                                          sizeof(Material::PBRFactors));
+}
+
+uint32_t MaterialManager::GetTextureIndex(Texture* pTexture)
+{
+    if (pTexture->GetBindlessIndex() != 0)
+    {
+        // Reloaded or streamed textures come with new views
+        const uint32_t uIndex = pTexture->GetBindlessIndex();
+        if (m_vBoundViews[uIndex] != pTexture->GetResidentView())
+        {
+            return MoveTextureSlot(uIndex);
+        }
+        return uIndex;
+    }
+    // New slots are not used by pending command buffers, they can be
+    // written any time
+    const uint32_t uIndex = AllocateTextureSlot();
+    m_vpTextures[uIndex] = pTexture;
+    m_vBoundViews[uIndex] = pTexture->GetResidentView();
+    m_vDirtyTextureIndices.push_back(uIndex);
+    pTexture->SetBindlessIndex(uIndex);
+    return uIndex;
+}
+
+void MaterialManager::ReleaseTextureIndex(Texture* pTexture)
+{
+    const uint32_t uIndex = pTexture->GetBindlessIndex();
+    assert(uIndex != 0 && uIndex < m_vpTextures.size() && m_vpTextures[uIndex] == pTexture);
+    // Partially bound, the stale descriptor is never accessed again
+    m_vpTextures[uIndex] = nullptr;
+    m_vBoundViews[uIndex] = VK_NULL_HANDLE;
+    m_vFreeTextureIndices.push_back(uIndex);
+    pTexture->SetBindlessIndex(0);
+}
+
+// Material
+Material::~Material()
+{
+    if (m_uMaterialIndex != INVALID_MATERIAL_INDEX)
+    {
+        GetMaterialManager()->FreeMaterialIndex(m_uMaterialIndex);
+    }
+}
+
+void Material::SetMaterialParameterFactors(const PBRFactors &inFactors)
+{
+    PBRFactors factors = inFactors;
+    const Texture *pNormalTexture = m_materialParameters.m_apTextures[TEX_NORMAL];
+    factors.m_fReconstructNormalZ =
+        pNormalTexture != nullptr && pNormalTexture->GetFormat() == VK_FORMAT_BC5_UNORM_BLOCK ? 1.0f : 0.0f;
+    // Texture slots and residency are tracked by the material
+    memcpy(factors.m_aFeedbackIds, m_factors.m_aFeedbackIds, sizeof(factors.m_aFeedbackIds));
+    memcpy(factors.m_aBaseMips, m_factors.m_aBaseMips, sizeof(factors.m_aBaseMips));
+    memcpy(factors.m_aTextureIndices, m_factors.m_aTextureIndices, sizeof(factors.m_aTextureIndices));
+    m_factors = factors;
+    if (m_uMaterialIndex != INVALID_MATERIAL_INDEX)
+    {
+        GetMaterialManager()->WriteMaterialFactors(m_uMaterialIndex, m_factors);
+    }
+}
+
+void Material::AllocateMaterialIndex()
+{
+    if (m_uMaterialIndex == INVALID_MATERIAL_INDEX)
+    {
+        m_uMaterialIndex = GetMaterialManager()->AllocateMaterialIndex();
+        UpdateMaterialData();
+    }
+}
+
+void Material::UpdateMaterialData()
+{
+    assert(m_uMaterialIndex != INVALID_MATERIAL_INDEX);
+    UpdateBoundTextures();
+    GetMaterialManager()->WriteMaterialFactors(m_uMaterialIndex, m_factors);
+}
+
+bool Material::UpdateStreamedTextures()
+{
+    if (m_uMaterialIndex != INVALID_MATERIAL_INDEX && UpdateBoundTextures())
+    {
+        GetMaterialManager()->WriteMaterialFactors(m_uMaterialIndex, m_factors);
+        return true;
+    }
+    return false;
+}
+
+bool Material::UpdateBoundTextures()
+{
+    PBRFactors factors = m_factors;
+    for (size_t i = 0; i < TEX_COUNT; i++)
+    {
+        Texture *pTexture = m_materialParameters.m_apTextures[i];
+        factors.m_aTextureIndices[i] = GetMaterialManager()->GetTextureIndex(pTexture);
+        // No feedback while the placeholder is bound
+        factors.m_aFeedbackIds[i] = pTexture->IsResident() ? pTexture->GetFeedbackId() : 0;
+        factors.m_aBaseMips[i] = pTexture->GetBaseMip();
+    }
+    const bool bChanged = memcmp(&factors, &m_factors, sizeof(PBRFactors)) != 0;
+    m_factors = factors;
+    return bChanged;
+}
+
+bool Material::UpdateContentHash()
+{
+    // Texture slots and resident levels change at runtime, they are not
+    // content
+    PBRFactors factors = m_factors;
+    memset(factors.m_aFeedbackIds, 0, sizeof(factors.m_aFeedbackIds));
+    memset(factors.m_aBaseMips, 0, sizeof(factors.m_aBaseMips));
+    memset(factors.m_aTextureIndices, 0, sizeof(factors.m_aTextureIndices));
+    uint64_t uHash = HashValue(factors);
+    uHash = HashValue(m_bIsTransparent, uHash);
+    for (const Texture *pTexture : m_materialParameters.m_apTextures)
+    {
+        // Reloaded textures get new views, include them so the material
+        // data gets rewritten
+        uHash = HashValue(pTexture ? pTexture->GetContentHash() : 0, uHash);
+        uHash = HashValue(pTexture ? pTexture->getView() : VK_NULL_HANDLE, uHash);
+    }
+    bool bChanged = uHash != m_uContentHash;
+    m_uContentHash = uHash;
+    return bChanged;
+}
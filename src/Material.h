@@ -1,12 +1,18 @@
 #pragma once
+#include <vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
 
 #include <array>
 #include <memory>
 #include <string>
+#include <cstdint>
+#include <deque>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <glm/glm.hpp>
 
+#include "Defragmentation.h"
 #include "Texture.h"
 #include "UniformBuffer.h"
 
@@ -18,25 +24,35 @@ public:
     {
         TEX_ALBEDO,
         TEX_NORMAL,
-        TEX_METALNESS,
-        TEX_ROUGHNESS,
-        TEX_AO,
+        // Occlusion, roughness and metalness in R, G and B
+        TEX_ORM,
         TEX_COUNT
     };
 
+    // Entry of the material buffer, laid out for std430
     struct PBRFactors
     {
         float m_aBaseColorFactor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
         float m_fMetalicFactor = 1.0;
         float m_fRoughnessFactor = 1.0;
-        uint32_t m_aUVIndices[TEX_COUNT] = {0, 0, 0, 0, 0};
-        float m_fPadding1 = 0.0;
+        uint32_t m_aUVIndices[TEX_COUNT] = {0, 0, 0};
+        // Set when the normal map only stores XY (BC5)
+        float m_fReconstructNormalZ = 0.0;
+        // Mip feedback slots and resident base levels of the textures
+        uint32_t m_aFeedbackIds[TEX_COUNT] = {0, 0, 0};
+        uint32_t m_aBaseMips[TEX_COUNT] = {0, 0, 0};
+        // Slots in the bindless texture array
+        uint32_t m_aTextureIndices[TEX_COUNT] = {0, 0, 0};
+        uint32_t m_uPadding = 0;
     };
+    static_assert(sizeof(PBRFactors) % 16 == 0, "PBRFactors must match the std430 array stride");
     struct MaterialParameters
     {
-        std::array<Texture *, TEX_COUNT> m_apTextures;
-        UniformBuffer<PBRFactors> *m_pFactors = nullptr;
+        std::array<Texture *, TEX_COUNT> m_apTextures = {};
     };
+    static constexpr uint32_t INVALID_MATERIAL_INDEX = UINT32_MAX;
+
+    ~Material();
 
 public:
     void loadTexture(TextureTypes type, const std::string& path, const std::string& name)
@@ -45,45 +61,150 @@ public:
         if (it == GetTextureManager()->m_vpTextures.end())
         {
             GetTextureManager()->m_vpTextures[name] = std::make_unique<Texture>();
-            GetTextureManager()->m_vpTextures[name]->LoadImage(path);
+            GetTextureManager()->m_vpTextures[name]->LoadImage(path, true);
             GetTextureManager()->m_vpTextures[name]->SetDebugName(name);
             m_materialParameters.m_apTextures[type] = GetTextureManager()->m_vpTextures[name].get();
         }
         else
         {
+            GetTextureManager()->ValidateContent(name, path);
             m_materialParameters.m_apTextures[type] = it->second.get();
         }
     }
+    // Pack the maps into TEX_ORM at load, either path may be empty
+    void loadORMTexture(const std::string& sOcclusionPath, const std::string& sMetallicRoughnessPath,
+                        const std::string& name)
+    {
+        const auto it = GetTextureManager()->m_vpTextures.find(name);
+        if (it == GetTextureManager()->m_vpTextures.end())
+        {
+            GetTextureManager()->m_vpTextures[name] = std::make_unique<Texture>();
+            GetTextureManager()->m_vpTextures[name]->LoadORM(sOcclusionPath, sMetallicRoughnessPath, true);
+            GetTextureManager()->m_vpTextures[name]->SetDebugName(name);
+            m_materialParameters.m_apTextures[TEX_ORM] = GetTextureManager()->m_vpTextures[name].get();
+        }
+        else
+        {
+            GetTextureManager()->ValidateORMContent(name, sOcclusionPath, sMetallicRoughnessPath);
+            m_materialParameters.m_apTextures[TEX_ORM] = it->second.get();
+        }
+    }
+    void SetTexture(TextureTypes type, Texture* pTexture)
+    {
+        m_materialParameters.m_apTextures[type] = pTexture;
+    }
+    const Texture* GetTexture(TextureTypes type) const
+    {
+        return m_materialParameters.m_apTextures[type];
+    }
+    // RGBA image the albedo was loaded or cooked from, baked into HLOD
+    // atlases since block compressed levels can't be decoded on the CPU
+    void SetAlbedoImagePath(const std::string& path) { m_sAlbedoImagePath = path; }
+    const std::string& GetAlbedoImagePath() const { return m_sAlbedoImagePath; }
     VkImageView getImageView(TextureTypes type) const
     {
         return m_materialParameters.m_apTextures[type]->getView();
     }
-    void SetMaterialParameterFactors(const PBRFactors &factors, const std::string &sMaterialName);
+    void SetMaterialParameterFactors(const PBRFactors &factors);
+    const PBRFactors& GetMaterialParameterFactors() const { return m_factors; }
+
+    // Entry in the material buffer, passed to shaders as a push constant
+    uint32_t GetMaterialIndex() const { return m_uMaterialIndex; }
+    void AllocateMaterialIndex();
+    // Rewrite the material buffer entry after textures or factors changed
+    void UpdateMaterialData();
+    // Refresh the residency factors of streamed textures, returns true if
+    // they changed
+    bool UpdateStreamedTextures();
 
-    VkDescriptorSet GetDescriptorSet() const;
-    void AllocateDescriptorSet();
+    // Hash of factors and texture contents, returns true if it changed
+    bool UpdateContentHash();
+    uint64_t GetContentHash() const { return m_uContentHash; }
 
     bool IsTransparent() const { return m_bIsTransparent; }
     void SetTransparent() { m_bIsTransparent = true; }
     void SetOpaque() { m_bIsTransparent = false; }
 
 private:
+    // Refresh texture slots and residency factors, returns true if changed
+    bool UpdateBoundTextures();
+
     MaterialParameters m_materialParameters;
     const std::array<std::string, TEX_COUNT> m_aNames = {
-        "TEX_ALBEDO", "TEX_NORMAL", "TEX_METALNESS", "TEX_ROUGHNESS", "TEX_AO"};
-    VkDescriptorSet m_descriptorSet;
+        "TEX_ALBEDO", "TEX_NORMAL", "TEX_ORM"};
+    PBRFactors m_factors;
+    std::string m_sAlbedoImagePath;
+    uint32_t m_uMaterialIndex = INVALID_MATERIAL_INDEX;
     bool m_bIsTransparent = false;
+    uint64_t m_uContentHash = 0;
 };
 
-class MaterialManager
+// Textures and factors of all materials are bound once through a single
+// descriptor set: a partially bound array of sampled images and a storage
+// buffer of PBRFactors. Draws select their material with a push constant.
+class MaterialManager : public IDefragmentable
 {
 public:
+    // Mirrored in shaders/material.h
+    static constexpr uint32_t MAX_MATERIALS = 4096;
+    static constexpr uint32_t MAX_MATERIAL_TEXTURES = 4096;
+
+    void Initialize();
+    void Unintialize();
+
     void destroyMaterials() { m_mMaterials.clear(); }
     std::unordered_map<std::string, std::unique_ptr<Material>> m_mMaterials;
     void CreateDefaultMaterial();
     const Material* GetDefaultMaterial() {return m_mMaterials[sDefaultName].get();}
+    // Rebind streamed textures that became resident or changed their
+    // resident levels, once per frame. Returns the number of textures and
+    // materials updated.
+    uint32_t UpdateStreamedTextures();
+
+    // Flushes texture slot writes queued since the last bind
+    VkDescriptorSet GetDescriptorSet();
+    // Texture slot writes are queued and written in one batch
+    void FlushTextureDescriptors();
+
+    uint32_t AllocateMaterialIndex();
+    void FreeMaterialIndex(uint32_t uIndex);
+    void WriteMaterialFactors(uint32_t uIndex, const Material::PBRFactors& factors);
+
+    // Slot of the texture in the bindless array, assigned on first use
+    uint32_t GetTextureIndex(Texture* pTexture);
+    void ReleaseTextureIndex(Texture* pTexture);
+
+    void GetMovableAllocations(std::vector<VmaAllocation>& vAllocations) override;
+    // Rebinds the factors buffer, command buffers binding the set need
+    // re-recording
+    void OnAllocationMoved(VmaAllocation allocation) override;
+
 private:
+    // Pending frames may sample a slot, so a new view goes to a new slot and
+    // the old one is recycled once those frames are done
+    uint32_t MoveTextureSlot(uint32_t uIndex);
+    uint32_t AllocateTextureSlot();
+    void RecycleRetiredTextureSlots();
+
     const std::string sDefaultName = "default";
+
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkBuffer m_factorsBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_factorsAllocation = VK_NULL_HANDLE;
+    Material::PBRFactors* m_pFactors = nullptr;
+    uint32_t m_uNumMaterialIndices = 0;
+    std::vector<uint32_t> m_vFreeMaterialIndices;
+
+    // Indexed by texture slot, slot 0 marks textures without one
+    std::vector<Texture*> m_vpTextures;
+    // Views written to the texture slots
+    std::vector<VkImageView> m_vBoundViews;
+    std::vector<uint32_t> m_vFreeTextureIndices;
+    // Slots and the frame count after which they are no longer sampled
+    std::deque<std::pair<uint32_t, uint64_t>> m_qRetiredTextureIndices;
+    // Slots whose bound view changed since the last flush
+    std::vector<uint32_t> m_vDirtyTextureIndices;
 };
 
 MaterialManager* GetMaterialManager();
@@ -0,0 +1,113 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "TextureResidency.h"
+#include "VkMemoryAllocator.h"
+
+static MemoryBudgetManager s_memoryBudgetManager;
+
+MemoryBudgetManager* GetMemoryBudgetManager()
+{
+    return &s_memoryBudgetManager;
+}
+
+// Frames to wait after an eviction before evaluating the budget again
+static const uint64_t EVICTION_COOLDOWN = 30;
+
+void MemoryBudgetManager::Initialize(float fHighWatermark, float fLowWatermark)
+{
+    assert(fLowWatermark <= fHighWatermark && fHighWatermark <= 1.0f);
+    m_fHighWatermark = fHighWatermark;
+    m_fLowWatermark = fLowWatermark;
+    m_uFrame = 0;
+    m_uNextEvictionFrame = 0;
+}
+
+void MemoryBudgetManager::Unintialize()
+{
+    m_mResources.clear();
+}
+
+void MemoryBudgetManager::SetResourcesInUse(const FrameVector<IEvictable*>& vpResources)
+{
+    for (auto& it : m_mResources)
+    {
+        if (it.second.m_bInUse)
+        {
+            it.second.m_bInUse = false;
+            it.second.m_uLastUsedFrame = m_uFrame;
+        }
+    }
+    for (IEvictable* pResource : vpResources)
+    {
+        ResourceUsage& usage = m_mResources[pResource];
+        usage.m_bInUse = true;
+        usage.m_uLastUsedFrame = m_uFrame;
+        if (!pResource->IsResident())
+        {
+            pResource->MakeResident();
+        }
+    }
+}
+
+void MemoryBudgetManager::Unregister(IEvictable* pResource)
+{
+    m_mResources.erase(pResource);
+}
+
+void MemoryBudgetManager::Update()
+{
+    m_uFrame++;
+    VkDeviceSize uUsage = 0, uBudget = 0;
+    GetMemoryAllocator()->GetDeviceLocalBudget(uUsage, uBudget);
+    const VkDeviceSize uHighWatermark = static_cast<VkDeviceSize>(uBudget * m_fHighWatermark);
+    const VkDeviceSize uLowWatermark = static_cast<VkDeviceSize>(uBudget * m_fLowWatermark);
+
+    // Texture streaming may use the room left below the high watermark
+    const VkDeviceSize uTextureSize = GetTextureResidencyManager()->GetResidentSize();
+    GetTextureResidencyManager()->SetBudget(uTextureSize + (uHighWatermark > uUsage ? uHighWatermark - uUsage : 0));
+
+    if (uUsage <= uHighWatermark || m_uFrame < m_uNextEvictionFrame)
+    {
+        return;
+    }
+    VkDeviceSize uExcess = uUsage - uLowWatermark;
+    uExcess -= std::min(uExcess, GetTextureResidencyManager()->Trim(uExcess));
+    if (uExcess > 0)
+    {
+        EvictResources(uExcess);
+    }
+    m_uNextEvictionFrame = m_uFrame + EVICTION_COOLDOWN;
+}
+
+VkDeviceSize MemoryBudgetManager::EvictResources(VkDeviceSize uSize)
+{
+    std::vector<std::pair<uint64_t, IEvictable*>> vCandidates;
+    for (const auto& it : m_mResources)
+    {
+        // Resources without a resident size have nothing to give back
+        if (!it.second.m_bInUse && it.first->IsResident() && it.first->GetResidentSize() > 0)
+        {
+            vCandidates.emplace_back(it.second.m_uLastUsedFrame, it.first);
+        }
+    }
+    std::sort(vCandidates.begin(), vCandidates.end(),
+              [](const std::pair<uint64_t, IEvictable*>& a, const std::pair<uint64_t, IEvictable*>& b) {
+                  return a.first < b.first;
+              });
+
+    // Resources out of use are not referenced by any recorded command buffer
+    VkDeviceSize uFreedSize = 0;
+    for (const auto& candidate : vCandidates)
+    {
+        if (uFreedSize >= uSize)
+        {
+            break;
+        }
+        uFreedSize += candidate.second->GetResidentSize();
+        candidate.second->Evict();
+    }
+    return uFreedSize;
+}
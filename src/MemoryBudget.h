@@ -0,0 +1,59 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "FrameArena.h"
+
+// Resource that can give its device memory back under memory pressure and
+// reload it from a CPU copy when used again
+class IEvictable
+{
+public:
+    virtual ~IEvictable() {}
+    // Device memory Evict() would give back, 0 if it would free none
+    virtual VkDeviceSize GetResidentSize() const = 0;
+    virtual bool IsResident() const = 0;
+    virtual void Evict() = 0;
+    virtual void MakeResident() = 0;
+};
+
+// Watches the device local memory budget. Once usage passes the high
+// watermark, least recently used resources are evicted until it is back at
+// the low watermark: unused streamed texture levels first, then buffers of
+// resources out of the draw lists.
+class MemoryBudgetManager
+{
+public:
+    void Initialize(float fHighWatermark = 0.9f, float fLowWatermark = 0.75f);
+    void Unintialize();
+
+    // Resources referenced by the recorded command buffers, evicted ones get
+    // reloaded. Resources of the previous set are marked as last used now.
+    void SetResourcesInUse(const FrameVector<IEvictable*>& vpResources);
+    void Unregister(IEvictable* pResource);
+
+    // Once per frame, outside of command buffer recording
+    void Update();
+
+private:
+    // Evict unused resources, least recently used first, returns the bytes freed
+    VkDeviceSize EvictResources(VkDeviceSize uSize);
+
+    struct ResourceUsage
+    {
+        uint64_t m_uLastUsedFrame = 0;
+        bool m_bInUse = false;
+    };
+    std::unordered_map<IEvictable*, ResourceUsage> m_mResources;
+
+    float m_fHighWatermark = 0.9f;
+    float m_fLowWatermark = 0.75f;
+    uint64_t m_uFrame = 0;
+    // Evicted memory takes a few frames to show up in the budget
+    uint64_t m_uNextEvictionFrame = 0;
+};
+
+MemoryBudgetManager* GetMemoryBudgetManager();
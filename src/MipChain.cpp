@@ -0,0 +1,141 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPCHAIN_SSE2 1
+#endif
+
+#include "ParallelFor.h"
+
+// Levels with fewer texels are downsampled on the calling thread
+static const size_t PARALLEL_DOWNSAMPLE_TEXELS = 256 * 256;
+
+uint32_t GetMipCount(uint32_t uWidth, uint32_t uHeight)
+{
+    uint32_t uMipCount = 1;
+    uint32_t uSize = std::max(uWidth, uHeight);
+    while (uSize > 1)
+    {
+        uSize >>= 1;
+        uMipCount++;
+    }
+    return uMipCount;
+}
+
+std::vector<MipLevel> GetMipLevels(uint32_t uWidth, uint32_t uHeight)
+{
+    std::vector<MipLevel> vLevels(GetMipCount(uWidth, uHeight));
+    size_t nTotalSize = 0;
+    for (uint32_t i = 0; i < vLevels.size(); i++)
+    {
+        MipLevel& level = vLevels[i];
+        level.m_uWidth = std::max(uWidth >> i, 1u);
+        level.m_uHeight = std::max(uHeight >> i, 1u);
+        level.m_nOffset = nTotalSize;
+        level.m_nSize = (size_t)level.m_uWidth * level.m_uHeight * 4;
+        nTotalSize += level.m_nSize;
+    }
+    return vLevels;
+}
+
+#ifdef MIPCHAIN_SSE2
+// Two destination texels from four source texels of each row, 16 bit sums
+// round the same way as the scalar path
+static inline __m128i AverageTexelPairs(__m128i row0, __m128i row1)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+    const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+    // Add the horizontal neighbour, results in the low four lanes
+    const __m128i loSum = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    const __m128i hiSum = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+    const __m128i sum = _mm_unpacklo_epi64(loSum, hiSum);
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+#endif
+
+// Average 2x2 source texels into each destination texel of rows
+// [uBeginRow, uEndRow). Odd source sizes clamp the second tap to the last
+// row/column.
+static void DownsampleBoxRows(const uint8_t* pSrc, uint32_t uSrcWidth, uint32_t uSrcHeight,
+                              uint8_t* pDst, uint32_t uDstWidth, uint32_t uBeginRow, uint32_t uEndRow)
+{
+    const size_t nSrcStride = (size_t)uSrcWidth * 4;
+    for (uint32_t y = uBeginRow; y < uEndRow; y++)
+    {
+        const uint8_t* pRow0 = pSrc + std::min(2 * y, uSrcHeight - 1) * nSrcStride;
+        const uint8_t* pRow1 = pSrc + std::min(2 * y + 1, uSrcHeight - 1) * nSrcStride;
+        uint8_t* pDstRow = pDst + (size_t)y * uDstWidth * 4;
+        uint32_t x = 0;
+#ifdef MIPCHAIN_SSE2
+        // Four destination texels per iteration while both taps are in the row
+        for (; 2 * x + 7 < uSrcWidth && x + 4 <= uDstWidth; x += 4)
+        {
+            const __m128i a = AverageTexelPairs(_mm_loadu_si128((const __m128i*)(pRow0 + x * 8)),
+                                                _mm_loadu_si128((const __m128i*)(pRow1 + x * 8)));
+            const __m128i b = AverageTexelPairs(_mm_loadu_si128((const __m128i*)(pRow0 + x * 8 + 16)),
+                                                _mm_loadu_si128((const __m128i*)(pRow1 + x * 8 + 16)));
+            _mm_storeu_si128((__m128i*)(pDstRow + x * 4), _mm_packus_epi16(a, b));
+        }
+#endif
+        for (; x < uDstWidth; x++)
+        {
+            const size_t nX0 = (size_t)std::min(2 * x, uSrcWidth - 1) * 4;
+            const size_t nX1 = (size_t)std::min(2 * x + 1, uSrcWidth - 1) * 4;
+            for (size_t c = 0; c < 4; c++)
+            {
+                const uint32_t uSum = pRow0[nX0 + c] + pRow0[nX1 + c] + pRow1[nX0 + c] + pRow1[nX1 + c];
+                pDstRow[x * 4 + c] = (uint8_t)((uSum + 2) >> 2);
+            }
+        }
+    }
+}
+
+// Large levels are split by rows across worker threads
+static void DownsampleBox(const uint8_t* pSrc, uint32_t uSrcWidth, uint32_t uSrcHeight,
+                          uint8_t* pDst, uint32_t uDstWidth, uint32_t uDstHeight)
+{
+    if ((size_t)uDstWidth * uDstHeight < PARALLEL_DOWNSAMPLE_TEXELS)
+    {
+        DownsampleBoxRows(pSrc, uSrcWidth, uSrcHeight, pDst, uDstWidth, 0, uDstHeight);
+        return;
+    }
+    ParallelFor(uDstHeight, [&](size_t, size_t nBegin, size_t nEnd) {
+        DownsampleBoxRows(pSrc, uSrcWidth, uSrcHeight, pDst, uDstWidth, (uint32_t)nBegin, (uint32_t)nEnd);
+    });
+}
+
+void Downsample(const uint8_t* pPixels, uint32_t uWidth, uint32_t uHeight, uint32_t uNumLevels,
+                std::vector<uint8_t>& vPixels)
+{
+    std::vector<uint8_t> vSource(pPixels, pPixels + (size_t)uWidth * uHeight * 4);
+    for (uint32_t i = 0; i < uNumLevels; i++)
+    {
+        const uint32_t uDstWidth = std::max(uWidth >> 1, 1u);
+        const uint32_t uDstHeight = std::max(uHeight >> 1, 1u);
+        vPixels.resize((size_t)uDstWidth * uDstHeight * 4);
+        DownsampleBox(vSource.data(), uWidth, uHeight, vPixels.data(), uDstWidth, uDstHeight);
+        uWidth = uDstWidth;
+        uHeight = uDstHeight;
+        vSource.swap(vPixels);
+    }
+    vPixels.swap(vSource);
+}
+
+void BuildMipChain(const uint8_t* pPixels, uint32_t uWidth, uint32_t uHeight,
+                   std::vector<uint8_t>& vChain, std::vector<MipLevel>& vLevels)
+{
+    vLevels = GetMipLevels(uWidth, uHeight);
+    vChain.resize(vLevels.back().m_nOffset + vLevels.back().m_nSize);
+    memcpy(vChain.data(), pPixels, vLevels[0].m_nSize);
+    for (uint32_t i = 1; i < vLevels.size(); i++)
+    {
+        const MipLevel& src = vLevels[i - 1];
+        const MipLevel& dst = vLevels[i];
+        DownsampleBox(vChain.data() + src.m_nOffset, src.m_uWidth, src.m_uHeight,
+                      vChain.data() + dst.m_nOffset, dst.m_uWidth, dst.m_uHeight);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MipLevel
+{
+    uint32_t m_uWidth = 0;
+    uint32_t m_uHeight = 0;
+    // Byte range of the level in the chain
+    size_t m_nOffset = 0;
+    size_t m_nSize = 0;
+};
+
+// Number of levels down to 1x1
+uint32_t GetMipCount(uint32_t uWidth, uint32_t uHeight);
+// Layout of a packed RGBA8 chain down to 1x1
+std::vector<MipLevel> GetMipLevels(uint32_t uWidth, uint32_t uHeight);
+
+// Halve an RGBA8 image uNumLevels times with the chain's box filter. SSE2
+// where available, large levels are split across worker threads.
+void Downsample(const uint8_t* pPixels, uint32_t uWidth, uint32_t uHeight, uint32_t uNumLevels,
+                std::vector<uint8_t>& vPixels);
+
+// Build a complete RGBA8 mip chain with a 2x2 box filter, levels are packed
+// one after another starting with a copy of the source pixels
+void BuildMipChain(const uint8_t* pPixels, uint32_t uWidth, uint32_t uHeight,
+                   std::vector<uint8_t>& vChain, std::vector<MipLevel>& vLevels);
@@ -0,0 +1,456 @@
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "ParallelFor.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (m_pData != nullptr)
+        {
+            UnmapViewOfFile(m_pData);
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+#else
+        if (m_pData != nullptr)
+        {
+            munmap(const_cast<char*>(m_pData), m_nSize);
+        }
+        if (m_nFd != -1)
+        {
+            close(m_nFd);
+        }
+#endif
+    }
+
+    bool Open(const std::string& sPath)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(sPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size))
+        {
+            return false;
+        }
+        m_nSize = (size_t)size.QuadPart;
+        if (m_nSize == 0)
+        {
+            return true;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping == nullptr)
+        {
+            return false;
+        }
+        m_pData = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        return m_pData != nullptr;
+#else
+        m_nFd = open(sPath.c_str(), O_RDONLY);
+        if (m_nFd == -1)
+        {
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(m_nFd, &fileStat) != 0)
+        {
+            return false;
+        }
+        m_nSize = (size_t)fileStat.st_size;
+        if (m_nSize == 0)
+        {
+            return true;
+        }
+        void* pData = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, m_nFd, 0);
+        if (pData == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(pData, m_nSize, MADV_SEQUENTIAL);
+        m_pData = static_cast<const char*>(pData);
+        return true;
+#endif
+    }
+
+    const char* Data() const { return m_pData; }
+    size_t Size() const { return m_nSize; }
+
+private:
+    const char* m_pData = nullptr;
+    size_t m_nSize = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_nFd = -1;
+#endif
+};
+
+// Parse results of one chunk of lines
+struct ObjChunk
+{
+    std::vector<float> m_vPositions;
+    std::vector<float> m_vNormals;
+    std::vector<float> m_vTexcoords;
+    // The first shape holds faces appearing before any o/g statement of the
+    // chunk, they belong to the last shape of the previous chunk
+    std::vector<ObjShape> m_vShapes = {ObjShape()};
+    // Negative OBJ indices are relative to the attributes read so far, which
+    // may live in previous chunks. Their locations are patched once the
+    // attribute counts of all chunks are known.
+    struct RelativeIndex
+    {
+        uint32_t m_uShape;
+        uint32_t m_uIndex;
+        uint32_t m_uAttribute;
+    };
+    std::vector<RelativeIndex> m_vRelativeIndices;
+    std::string m_sError;
+};
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool IsDigit(char c) { return (unsigned)(c - '0') < 10u; }
+
+inline const char* SkipSpaces(const char* p, const char* pEnd)
+{
+    while (p < pEnd && IsSpace(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+inline const char* SkipLine(const char* p, const char* pEnd)
+{
+    const char* pNewLine = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+    return pNewLine ? pNewLine + 1 : pEnd;
+}
+
+// Decimal float parser. Digits are accumulated into a 64-bit mantissa with a
+// single scale at the end, keeping the loop free of floating point work.
+const char* ParseFloat(const char* p, const char* pEnd, float& fValue)
+{
+    static const double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                           1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                           1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    p = SkipSpaces(p, pEnd);
+    bool bNegative = false;
+    if (p < pEnd && (*p == '-' || *p == '+'))
+    {
+        bNegative = *p == '-';
+        p++;
+    }
+    uint64_t uMantissa = 0;
+    int nExponent = 0;
+    int nDigits = 0;
+    while (p < pEnd && IsDigit(*p))
+    {
+        if (nDigits < 19)
+        {
+            uMantissa = uMantissa * 10 + (uint64_t)(*p - '0');
+            nDigits += uMantissa != 0 ? 1 : 0;
+        }
+        else
+        {
+            nExponent++;
+        }
+        p++;
+    }
+    if (p < pEnd && *p == '.')
+    {
+        p++;
+        while (p < pEnd && IsDigit(*p))
+        {
+            if (nDigits < 19)
+            {
+                uMantissa = uMantissa * 10 + (uint64_t)(*p - '0');
+                nDigits += uMantissa != 0 ? 1 : 0;
+                nExponent--;
+            }
+            p++;
+        }
+    }
+    if (p < pEnd && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool bNegativeExponent = false;
+        if (p < pEnd && (*p == '-' || *p == '+'))
+        {
+            bNegativeExponent = *p == '-';
+            p++;
+        }
+        int nExplicitExponent = 0;
+        while (p < pEnd && IsDigit(*p))
+        {
+            nExplicitExponent = std::min(nExplicitExponent * 10 + (*p - '0'), 1000);
+            p++;
+        }
+        nExponent += bNegativeExponent ? -nExplicitExponent : nExplicitExponent;
+    }
+    double dValue = (double)uMantissa;
+    if (nExponent < 0 && nExponent >= -22)
+    {
+        dValue /= POWERS_OF_TEN[-nExponent];
+    }
+    else if (nExponent > 0 && nExponent <= 22)
+    {
+        dValue *= POWERS_OF_TEN[nExponent];
+    }
+    else if (nExponent != 0)
+    {
+        dValue *= std::pow(10.0, (double)nExponent);
+    }
+    fValue = (float)(bNegative ? -dValue : dValue);
+    return p;
+}
+
+inline const char* ParseInt(const char* p, const char* pEnd, int64_t& nValue)
+{
+    bool bNegative = false;
+    if (p < pEnd && (*p == '-' || *p == '+'))
+    {
+        bNegative = *p == '-';
+        p++;
+    }
+    nValue = 0;
+    while (p < pEnd && IsDigit(*p))
+    {
+        nValue = nValue * 10 + (*p - '0');
+        p++;
+    }
+    nValue = bNegative ? -nValue : nValue;
+    return p;
+}
+
+// Convert a 1-based or negative OBJ index to 0-based. Negative ones are
+// resolved against the chunk local count and recorded for patching.
+inline int32_t ResolveIndex(int64_t nIndex, size_t nLocalCount, uint32_t uAttribute, ObjChunk& chunk)
+{
+    if (nIndex > 0)
+    {
+        return (int32_t)(nIndex - 1);
+    }
+    if (nIndex < 0)
+    {
+        chunk.m_vRelativeIndices.push_back({(uint32_t)chunk.m_vShapes.size() - 1,
+                                            (uint32_t)chunk.m_vShapes.back().m_vIndices.size(), uAttribute});
+        return (int32_t)((int64_t)nLocalCount + nIndex);
+    }
+    return -1;
+}
+
+void ParseChunk(const char* p, const char* pEnd, ObjChunk& chunk)
+{
+    std::vector<ObjIndex> vPolygon;
+    while (p < pEnd)
+    {
+        p = SkipSpaces(p, pEnd);
+        if (p >= pEnd)
+        {
+            break;
+        }
+        const char c0 = *p;
+        const char c1 = p + 1 < pEnd ? p[1] : '\n';
+        if (c0 == 'v' && IsSpace(c1))
+        {
+            float x, y, z;
+            p = ParseFloat(p + 1, pEnd, x);
+            p = ParseFloat(p, pEnd, y);
+            p = ParseFloat(p, pEnd, z);
+            chunk.m_vPositions.insert(chunk.m_vPositions.end(), {x, y, z});
+        }
+        else if (c0 == 'v' && c1 == 'n')
+        {
+            float x, y, z;
+            p = ParseFloat(p + 2, pEnd, x);
+            p = ParseFloat(p, pEnd, y);
+            p = ParseFloat(p, pEnd, z);
+            chunk.m_vNormals.insert(chunk.m_vNormals.end(), {x, y, z});
+        }
+        else if (c0 == 'v' && c1 == 't')
+        {
+            float u, v = 0.0f;
+            p = ParseFloat(p + 2, pEnd, u);
+            const char* pNext = SkipSpaces(p, pEnd);
+            if (pNext < pEnd && *pNext != '\n')
+            {
+                p = ParseFloat(pNext, pEnd, v);
+            }
+            chunk.m_vTexcoords.insert(chunk.m_vTexcoords.end(), {u, v});
+        }
+        else if (c0 == 'f' && IsSpace(c1))
+        {
+            vPolygon.clear();
+            p = SkipSpaces(p + 1, pEnd);
+            while (p < pEnd && *p != '\n' && *p != '#')
+            {
+                int64_t nPosition = 0, nTexcoord = 0, nNormal = 0;
+                p = ParseInt(p, pEnd, nPosition);
+                if (p < pEnd && *p == '/')
+                {
+                    p++;
+                    if (p < pEnd && *p != '/')
+                    {
+                        p = ParseInt(p, pEnd, nTexcoord);
+                    }
+                    if (p < pEnd && *p == '/')
+                    {
+                        p = ParseInt(p + 1, pEnd, nNormal);
+                    }
+                }
+                ObjIndex index;
+                index.m_nPosition = (int32_t)nPosition;
+                index.m_nTexcoord = (int32_t)nTexcoord;
+                index.m_nNormal = (int32_t)nNormal;
+                vPolygon.push_back(index);
+                if (nPosition == 0)
+                {
+                    chunk.m_sError = "Malformed face statement";
+                    return;
+                }
+                p = SkipSpaces(p, pEnd);
+            }
+            // Triangulate as a fan
+            for (size_t i = 1; i + 1 < vPolygon.size(); i++)
+            {
+                for (size_t nCorner : {(size_t)0, i, i + 1})
+                {
+                    const ObjIndex& raw = vPolygon[nCorner];
+                    ObjIndex index;
+                    index.m_nPosition = ResolveIndex(raw.m_nPosition, chunk.m_vPositions.size() / 3, 0, chunk);
+                    index.m_nTexcoord = ResolveIndex(raw.m_nTexcoord, chunk.m_vTexcoords.size() / 2, 1, chunk);
+                    index.m_nNormal = ResolveIndex(raw.m_nNormal, chunk.m_vNormals.size() / 3, 2, chunk);
+                    chunk.m_vShapes.back().m_vIndices.push_back(index);
+                }
+            }
+        }
+        else if ((c0 == 'o' || c0 == 'g') && IsSpace(c1))
+        {
+            const char* pNameBegin = SkipSpaces(p + 1, pEnd);
+            const char* pNameEnd = static_cast<const char*>(memchr(pNameBegin, '\n', pEnd - pNameBegin));
+            pNameEnd = pNameEnd ? pNameEnd : pEnd;
+            while (pNameEnd > pNameBegin && IsSpace(pNameEnd[-1]))
+            {
+                pNameEnd--;
+            }
+            ObjShape shape;
+            shape.m_sName.assign(pNameBegin, pNameEnd);
+            chunk.m_vShapes.push_back(std::move(shape));
+        }
+        p = SkipLine(p, pEnd);
+    }
+}
+}  // namespace
+
+bool ParseObj(const std::string& sPath, ObjMesh& mesh, std::string& sError)
+{
+    MappedFile file;
+    if (!file.Open(sPath))
+    {
+        sError = "Failed to open " + sPath;
+        return false;
+    }
+    const char* pData = file.Data();
+    const size_t nSize = file.Size();
+
+    // Small files are not worth the threads
+    const size_t MIN_CHUNK_SIZE = 1 << 20;
+    size_t nChunks = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), nSize / MIN_CHUNK_SIZE));
+
+    // Chunk boundaries start right after a new line
+    std::vector<const char*> vpBoundaries(nChunks + 1);
+    vpBoundaries[0] = pData;
+    vpBoundaries[nChunks] = pData + nSize;
+    for (size_t i = 1; i < nChunks; i++)
+    {
+        const char* p = std::max(pData + nSize * i / nChunks, vpBoundaries[i - 1]);
+        vpBoundaries[i] = SkipLine(p, pData + nSize);
+    }
+
+    std::vector<ObjChunk> vChunks(nChunks);
+    ParallelFor(
+        nChunks,
+        [&](size_t, size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++)
+            {
+                ParseChunk(vpBoundaries[i], vpBoundaries[i + 1], vChunks[i]);
+            }
+        },
+        nChunks);
+
+    // Merge chunks in order
+    mesh = ObjMesh();
+    for (ObjChunk& chunk : vChunks)
+    {
+        if (!chunk.m_sError.empty())
+        {
+            sError = chunk.m_sError;
+            return false;
+        }
+        const int32_t aOffsets[3] = {(int32_t)(mesh.m_vPositions.size() / 3),
+                                     (int32_t)(mesh.m_vTexcoords.size() / 2),
+                                     (int32_t)(mesh.m_vNormals.size() / 3)};
+        for (const ObjChunk::RelativeIndex& relative : chunk.m_vRelativeIndices)
+        {
+            ObjIndex& index = chunk.m_vShapes[relative.m_uShape].m_vIndices[relative.m_uIndex];
+            int32_t* pIndex = relative.m_uAttribute == 0   ? &index.m_nPosition
+                              : relative.m_uAttribute == 1 ? &index.m_nTexcoord
+                                                           : &index.m_nNormal;
+            *pIndex += aOffsets[relative.m_uAttribute];
+        }
+        mesh.m_vPositions.insert(mesh.m_vPositions.end(), chunk.m_vPositions.begin(), chunk.m_vPositions.end());
+        mesh.m_vTexcoords.insert(mesh.m_vTexcoords.end(), chunk.m_vTexcoords.begin(), chunk.m_vTexcoords.end());
+        mesh.m_vNormals.insert(mesh.m_vNormals.end(), chunk.m_vNormals.begin(), chunk.m_vNormals.end());
+
+        for (size_t i = 0; i < chunk.m_vShapes.size(); i++)
+        {
+            ObjShape& shape = chunk.m_vShapes[i];
+            if (i == 0 && !mesh.m_vShapes.empty())
+            {
+                // Continuation of a shape started in a previous chunk
+                auto& vIndices = mesh.m_vShapes.back().m_vIndices;
+                vIndices.insert(vIndices.end(), shape.m_vIndices.begin(), shape.m_vIndices.end());
+            }
+            else
+            {
+                mesh.m_vShapes.push_back(std::move(shape));
+            }
+        }
+    }
+    mesh.m_vShapes.erase(std::remove_if(mesh.m_vShapes.begin(), mesh.m_vShapes.end(),
+                                        [](const ObjShape& shape) { return shape.m_vIndices.empty(); }),
+                         mesh.m_vShapes.end());
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal multithreaded Wavefront OBJ parser. The file is memory mapped,
+// split into chunks on line boundaries and each chunk is parsed on its own
+// thread. Only geometry is read: positions, normals, texture coordinates,
+// faces and object/group names. Materials are ignored.
+struct ObjIndex
+{
+    // 0-based, -1 when the attribute is missing
+    int32_t m_nPosition = -1;
+    int32_t m_nTexcoord = -1;
+    int32_t m_nNormal = -1;
+};
+
+struct ObjShape
+{
+    std::string m_sName;
+    // Triangulated, three indices per face
+    std::vector<ObjIndex> m_vIndices;
+};
+
+struct ObjMesh
+{
+    std::vector<float> m_vPositions;  // xyz
+    std::vector<float> m_vNormals;    // xyz
+    std::vector<float> m_vTexcoords;  // uv
+    std::vector<ObjShape> m_vShapes;
+};
+
+bool ParseObj(const std::string& sPath, ObjMesh& mesh, std::string& sError);
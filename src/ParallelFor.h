@@ -0,0 +1,36 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Split [0, nCount) into contiguous ranges and run them on worker threads,
+// fnRange(nThreadIdx, nBegin, nEnd) is called once per range
+inline void ParallelFor(size_t nCount,
+                        const std::function<void(size_t, size_t, size_t)>& fnRange,
+                        size_t nMaxThreads = 0)
+{
+    size_t nThreads = nMaxThreads != 0 ? nMaxThreads : std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min(nThreads, nCount);
+    if (nThreads <= 1)
+    {
+        if (nCount > 0)
+        {
+            fnRange(0, 0, nCount);
+        }
+        return;
+    }
+    std::vector<std::thread> vThreads;
+    vThreads.reserve(nThreads);
+    for (size_t i = 0; i < nThreads; i++)
+    {
+        size_t nBegin = nCount * i / nThreads;
+        size_t nEnd = nCount * (i + 1) / nThreads;
+        vThreads.emplace_back(fnRange, i, nBegin, nEnd);
+    }
+    for (auto& thread : vThreads)
+    {
+        thread.join();
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <vulkan/vulkan.h>
 
+#include <array>
 #include <cassert>
 #include <fstream>
 #include <string>
@@ -360,10 +361,12 @@ public:
         m_info.renderArea.extent = WH;
         return *this;
     }
+    // The values must outlive the built info
+    template <size_t N>
     RenderPassBeginInfoBuilder& setClearValues(
-        const std::vector<VkClearValue>& values)
+        const std::array<VkClearValue, N>& values)
     {
-        m_info.clearValueCount = values.size();
+        m_info.clearValueCount = static_cast<uint32_t>(values.size());
         m_info.pClearValues = values.data();
         return *this;
     }
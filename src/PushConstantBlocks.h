@@ -17,6 +17,12 @@ struct PrefilteredPushConstantBlock
     float fRoughness;
 };
 
+// Entry of the bindless material buffer
+struct MaterialPushConstantBlock
+{
+    uint32_t uMaterialIndex;
+};
+
 template <class T>
 VkPushConstantRange getPushConstantRange(
     VkShaderStageFlagBits stageFlags = VK_SHADER_STAGE_ALL)
@@ -9,6 +9,7 @@
 #include "Geometry.h"
 #include "MeshVertex.h"
 #include "Scene.h"
+#include "UploadManager.h"
 #include "VkRenderDevice.h"
 #include "RenderResourceManager.h"
 #include "Debug.h"
@@ -71,11 +72,16 @@ RTInputs ConstructRTInputsFromDrawLists(const DrawLists& dls)
                 triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
                 // Vertex data
                 triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-                triangles.vertexData.deviceAddress = GetRenderDevice()->GetBufferDeviceAddress(primitive->getVertexDeviceBuffer());
+                // Primitives are suballocated from the geometry heap
+                triangles.vertexData.deviceAddress =
+                    GetRenderDevice()->GetBufferDeviceAddress(primitive->getVertexDeviceBuffer()) +
+                    sizeof(Vertex) * primitive->GetVertexOffset();
                 // Index data
                 triangles.vertexStride = sizeof(Vertex);
                 triangles.indexType = VK_INDEX_TYPE_UINT32;
-                triangles.indexData.deviceAddress = GetRenderDevice()->GetBufferDeviceAddress(primitive->getIndexDeviceBuffer());
+                triangles.indexData.deviceAddress =
+                    GetRenderDevice()->GetBufferDeviceAddress(primitive->getIndexDeviceBuffer()) +
+                    sizeof(Index) * primitive->GetFirstIndex();
                 // misc
                 triangles.transformData = {};
                 triangles.maxVertex = primitive->getVertexCount();
@@ -189,6 +195,9 @@ void RTBuilder::BuildBLAS(const std::vector<BLASInput> &vBLASInputs, VkBuildAcce
     VkQueryPool queryPool;
     vkCreateQueryPool(GetRenderDevice()->GetDevice(), &qpci, nullptr, &queryPool);
 
+    // Geometry may still be staged, copies go ahead of the builds on the
+    // same queue
+    GetUploadManager()->Submit();
     std::vector<VkCommandBuffer> cmdBuffers;
     for (size_t idx = 0; idx < nNumBlas; idx++)
     {
@@ -241,7 +250,7 @@ void RTBuilder::BuildBLAS(const std::vector<BLASInput> &vBLASInputs, VkBuildAcce
         cmdBuffers.push_back(cmdBuf);
     }
 
-    GetRenderDevice()->SubmitCommandBuffersAndWait(cmdBuffers);
+    GetRenderDevice()->SubmitCommandBuffersAndWait(cmdBuffers.data(), static_cast<uint32_t>(cmdBuffers.size()));
     cmdBuffers.clear();
 
     if (bDoCompaction)
@@ -300,7 +309,7 @@ void RTBuilder::BuildBLAS(const std::vector<BLASInput> &vBLASInputs, VkBuildAcce
             vAcToSwap.push_back(acc);
             vBufToSwap.push_back(pBuf);
         }
-        GetRenderDevice()->SubmitCommandBuffersAndWait(cmdBuffers);
+        GetRenderDevice()->SubmitCommandBuffersAndWait(cmdBuffers.data(), static_cast<uint32_t>(cmdBuffers.size()));
         cmdBuffers.clear();
 
         // Swap old blas structure with compacted blas structure
@@ -393,7 +402,8 @@ void RTBuilder::BuildTLAS(const std::vector<Instance> &instances, VkBuildAcceler
     VkAccelerationStructureBuildRangeInfoKHR buildOffsetInfo{static_cast<uint32_t>(instances.size()), 0, 0, 0};
     const VkAccelerationStructureBuildRangeInfoKHR* pBuildOffsetInfo = &buildOffsetInfo;
 
-    // Build the TLAS
+    // Build the TLAS after the instance buffer copy
+    GetUploadManager()->Submit();
     GetRenderDevice()->ExecuteImmediateCommand([&](VkCommandBuffer cmdBuf) {
         SCOPED_MARKER(cmdBuf, "Buld TLAS");
         vkCmdBuildAccelerationStructuresKHR(cmdBuf, 1, &buildInfo, &pBuildOffsetInfo);
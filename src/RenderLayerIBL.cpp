@@ -2,10 +2,15 @@
 
 #include "DescriptorManager.h"
 #include "PushConstantBlocks.h"
+#include "RenderPassManager.h"
 #include "RenderResourceManager.h"
 #include "VkRenderDevice.h"
 #include "PipelineStateBuilder.h"
 #include "glm/gtc/matrix_transform.hpp"
+
+// The layer owns its per view buffer, the data sits at its start
+static const uint32_t PER_VIEW_DYNAMIC_OFFSET = 0;
+
 void RenderLayerIBL::setupRenderPass()
 {
     m_vRenderPasses.resize(RENDERPASS_COUNT);
@@ -87,17 +92,20 @@ void RenderLayerIBL::setupRenderPass()
 
 void RenderLayerIBL::setupFramebuffer()
 {
+    // The environment cubemap and the prefiltered levels before their copy
+    // are only needed while baking, later passes reuse their memory
+    const RenderTargetLifetime bakeLifetime = {RENDERPASS_IBL, RENDERPASS_IBL};
     std::array<VkImageView, RENDERPASS_COUNT> vImageViews = {
         GetRenderResourceManager()
-            ->getColorTarget("env_cube_map", {ENV_CUBE_DIM, ENV_CUBE_DIM},
-                             TEX_FORMAT, 1, 6)
+            ->getTransientColorTarget("env_cube_map", bakeLifetime, {ENV_CUBE_DIM, ENV_CUBE_DIM},
+                                      TEX_FORMAT, 1, 6)
             ->getView(),
         GetRenderResourceManager()
             ->getColorTarget("irr_cube_map", {IRR_CUBE_DIM, IRR_CUBE_DIM},
                              TEX_FORMAT, 1, 6)
             ->getView(),
         GetRenderResourceManager()
-            ->getColorTarget("prefiltered_cubemap_tmp", {PREFILTERED_CUBE_DIM, PREFILTERED_CUBE_DIM}, TEX_FORMAT, 1, NUM_FACES, VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+            ->getTransientColorTarget("prefiltered_cubemap_tmp", bakeLifetime, {PREFILTERED_CUBE_DIM, PREFILTERED_CUBE_DIM}, TEX_FORMAT, 1, NUM_FACES, VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
             ->getView(),
         GetRenderResourceManager()
             ->getColorTarget("specular_brdf_lut", {SPECULAR_BRDF_LUT_DIM, SPECULAR_BRDF_LUT_DIM}, VK_FORMAT_R32G32_SFLOAT, 1, 1)
@@ -423,17 +431,17 @@ void RenderLayerIBL::setupDescriptorSets()
 {
     // Per veiw data
     m_perViewDataDescriptorSet =
-        GetDescriptorManager()->AllocatePerviewDataDescriptorSet(
+        GetDescriptorManager()->GetPerviewDataDescriptorSet(
             m_uniformBuffer);
 
     // Environment map sampler descriptor set
     VkImageView envMapView =
         GetRenderResourceManager()->getTexture("EnvMap", "assets/hdr/Walk_Of_Fame/Mans_Outside_2k.hdr")->getView();
     m_envMapDescriptorSet =
-        GetDescriptorManager()->AllocateSingleSamplerDescriptorSet(envMapView);
+        GetDescriptorManager()->GetSingleSamplerDescriptorSet(envMapView);
 
     // Environment cube map descriptor set
-    m_irrMapDescriptorSet = GetDescriptorManager()->AllocateSingleSamplerDescriptorSet(
+    m_irrMapDescriptorSet = GetDescriptorManager()->GetSingleSamplerDescriptorSet(
         GetRenderResourceManager() ->getColorTarget("env_cube_map", {IRR_CUBE_DIM, IRR_CUBE_DIM}, TEX_FORMAT, 1, 6) ->getView());
 }
 
@@ -446,6 +454,8 @@ void RenderLayerIBL::recordCommandBuffer()
     VkBuffer vertexBuffer = primitives[0]->getVertexDeviceBuffer();
     VkBuffer indexBuffer = primitives[0]->getIndexDeviceBuffer();
     uint32_t nIndexCount = primitives[0]->getIndexCount();
+    uint32_t uFirstIndex = primitives[0]->GetFirstIndex();
+    int32_t nVertexOffset = primitives[0]->GetVertexOffset();
 
     VkCommandBufferBeginInfo cmdBeginInfo = {};
 
@@ -459,7 +469,7 @@ void RenderLayerIBL::recordCommandBuffer()
     VkDeviceSize offsets[1] = {0};
 
     // prepare render pass
-    std::vector<VkClearValue> clearValues = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    std::array<VkClearValue, 1> clearValues = {{{0.0f, 0.0f, 0.0f, 0.0f}}};
     std::array<VkRenderPassBeginInfo, RENDERPASS_COUNT> aRenderpassBeginInfos = {};
     std::array<VkViewport, RENDERPASS_COUNT> aViewports;
     std::array<VkRect2D, RENDERPASS_COUNT> aScissors;
@@ -506,13 +516,13 @@ void RenderLayerIBL::recordCommandBuffer()
 
             vkCmdBindDescriptorSets(
                 m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_envCubeMapPipelineLayout, 0, 2, sets.data(), 0, NULL);
+                m_envCubeMapPipelineLayout, 0, 2, sets.data(), 1, &PER_VIEW_DYNAMIC_OFFSET);
 
             vkCmdBindVertexBuffers(m_commandBuffer, 0, 1, &vertexBuffer, offsets);
 
             vkCmdBindIndexBuffer(m_commandBuffer, indexBuffer, 0,
                                  VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, 0, 0, 0);
+            vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, uFirstIndex, nVertexOffset, 0);
             vkCmdEndRenderPass(m_commandBuffer);
         }
         // Second subpass
@@ -534,13 +544,13 @@ void RenderLayerIBL::recordCommandBuffer()
 
             vkCmdBindDescriptorSets(
                 m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_irrCubeMapPipelineLayout, 0, 2, sets.data(), 0, NULL);
+                m_irrCubeMapPipelineLayout, 0, 2, sets.data(), 1, &PER_VIEW_DYNAMIC_OFFSET);
 
             vkCmdBindVertexBuffers(m_commandBuffer, 0, 1,
                                    &vertexBuffer, offsets);
             vkCmdBindIndexBuffer(m_commandBuffer, indexBuffer, 0,
                                  VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, 0, 0, 0);
+            vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, uFirstIndex, nVertexOffset, 0);
 
             vkCmdEndRenderPass(m_commandBuffer);
         }
@@ -585,13 +595,13 @@ void RenderLayerIBL::recordCommandBuffer()
 
                 vkCmdBindDescriptorSets(
                     m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    m_prefilteredCubemapPipelineLayout, 0, 2, sets.data(), 0, NULL);
+                    m_prefilteredCubemapPipelineLayout, 0, 2, sets.data(), 1, &PER_VIEW_DYNAMIC_OFFSET);
 
                 vkCmdBindVertexBuffers(m_commandBuffer, 0, 1,
                                        &vertexBuffer, offsets);
                 vkCmdBindIndexBuffer(m_commandBuffer, indexBuffer, 0,
                                      VK_INDEX_TYPE_UINT32);
-                vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, 0, 0, 0);
+                vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, uFirstIndex, nVertexOffset, 0);
 
                 vkCmdEndRenderPass(m_commandBuffer);
 
@@ -650,7 +660,7 @@ void RenderLayerIBL::recordCommandBuffer()
             //    m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
             //    mLightingPipelineLayout, 0, lightingDescSets.size(),
             //    lightingDescSets.data(), 0, nullptr);
-            vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, 0, 0, 0);
+            vkCmdDrawIndexed(m_commandBuffer, nIndexCount, 1, prim->GetFirstIndex(), prim->GetVertexOffset(), 0);
             vkCmdEndRenderPass(m_commandBuffer);
         }
     }
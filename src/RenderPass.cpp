@@ -206,12 +206,17 @@ void RecordCommandBuffers()
 
 void RenderPassFinal::RecordCommandBuffers()
 {
+    // Re-recording, the caller makes sure the previous recording is idle
+    for (VkCommandBuffer& cmdBuf : m_vCommandBuffers)
+    {
+        GetRenderDevice()->FreeStaticPrimaryCommandbuffer(cmdBuf);
+    }
+    m_vCommandBuffers.clear();
     VkImageView imgView = GetRenderResourceManager()
                               ->getColorTarget("LIGHTING_OUTPUT", VkExtent2D({0, 0}))
                               ->getView();
+    m_descriptorSet = GetDescriptorManager()->GetSingleSamplerDescriptorSet(imgView);
     Geometry* pQuad = GetGeometryManager()->GetQuad();
-
-    VkDescriptorSet descSet = GetDescriptorManager()->AllocateSingleSamplerDescriptorSet(imgView);
     VkCommandBufferBeginInfo beginInfo = {};
 
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -253,9 +258,9 @@ void RenderPassFinal::RecordCommandBuffers()
             vkCmdBindPipeline(curCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
                               m_pipeline);
             vkCmdBindDescriptorSets(curCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    m_pipelineLayout, 0, 1, &descSet, 0,
+                                    m_pipelineLayout, 0, 1, &m_descriptorSet, 0,
                                     nullptr);
-            vkCmdDrawIndexed(curCmdBuf, nIndexCount, 1, 0, 0, 0);
+            vkCmdDrawIndexed(curCmdBuf, nIndexCount, 1, prim->GetFirstIndex(), prim->GetVertexOffset(), 0);
         }
 
         // vkCmdDraw(s_commandBuffers[i], 3, 1, 0, 0);
@@ -8,6 +8,7 @@
 #include <vector>
 
 class Geometry;
+class GeometrySceneNode;
 class RenderPass
 {
 public:
@@ -55,4 +56,5 @@ protected:
 
 private:
     void destroyFramebuffers();
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 };
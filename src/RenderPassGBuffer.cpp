@@ -2,9 +2,13 @@
 
 #include "Debug.h"
 #include "DescriptorManager.h"
+#include "FrameUniformAllocator.h"
 #include "PipelineStateBuilder.h"
+#include "PushConstantBlocks.h"
+#include "RenderPassManager.h"
 #include "RenderResourceManager.h"
 #include "VkRenderDevice.h"
+#include "Scene.h"
 #include "Geometry.h"
 
 RenderPassGBuffer::LightingAttachments::LightingAttachments()
@@ -19,16 +23,23 @@ RenderPassGBuffer::LightingAttachments::LightingAttachments()
     desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     desc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    aAttachmentDesc[GBUFFER_POSITION_AO] = desc;
+    // GBuffer content is consumed by the lighting subpass, nothing is
+    // stored so the targets can stay in tile memory
+    VkAttachmentDescription gbufferDesc = desc;
+    gbufferDesc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    gbufferDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    gbufferDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    aAttachmentDesc[GBUFFER_POSITION_AO] = gbufferDesc;
     aAttachmentDesc[GBUFFER_POSITION_AO].format = VK_FORMAT_R16G16B16A16_SFLOAT;
 
-    aAttachmentDesc[GBUFFER_ALBEDO_TRANSMITTANCE] = desc;
+    aAttachmentDesc[GBUFFER_ALBEDO_TRANSMITTANCE] = gbufferDesc;
     aAttachmentDesc[GBUFFER_ALBEDO_TRANSMITTANCE].format = VK_FORMAT_R16G16B16A16_SFLOAT;
 
-    aAttachmentDesc[GBUFFER_METALNESS_TRANSLUCENCY] = desc;
+    aAttachmentDesc[GBUFFER_METALNESS_TRANSLUCENCY] = gbufferDesc;
     aAttachmentDesc[GBUFFER_METALNESS_TRANSLUCENCY].format = VK_FORMAT_R16G16B16A16_SFLOAT;
 
-    aAttachmentDesc[GBUFFER_NORMAL_ROUGHNESS] = desc;
+    aAttachmentDesc[GBUFFER_NORMAL_ROUGHNESS] = gbufferDesc;
     aAttachmentDesc[GBUFFER_NORMAL_ROUGHNESS].format = VK_FORMAT_R16G16B16A16_SFLOAT;
 
     aAttachmentDesc[LIGHTING_OUTPUT] = desc;
@@ -73,7 +84,8 @@ RenderPassGBuffer::RenderPassGBuffer()
     }
 
     // subpass deps
-    VkSubpassDependency subpassDep = {};
+    std::array<VkSubpassDependency, 2> aSubpassDeps = {};
+    VkSubpassDependency& subpassDep = aSubpassDeps[0];
     subpassDep.srcSubpass = 0;
     subpassDep.dstSubpass = 1;
     subpassDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -82,6 +94,21 @@ RenderPassGBuffer::RenderPassGBuffer()
     subpassDep.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     subpassDep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+    // GBuffer targets alias the memory of transient targets of earlier
+    // passes, wait for their writes and reads before clearing
+    VkSubpassDependency& externalDep = aSubpassDeps[1];
+    externalDep.srcSubpass = VK_SUBPASS_EXTERNAL;
+    externalDep.dstSubpass = 0;
+    externalDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                               VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                               VK_PIPELINE_STAGE_TRANSFER_BIT;
+    externalDep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                               VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    externalDep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                VK_ACCESS_TRANSFER_WRITE_BIT;
+    externalDep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount =
@@ -89,8 +116,8 @@ RenderPassGBuffer::RenderPassGBuffer()
     renderPassInfo.pAttachments = mAttachments.aAttachmentDesc.data();
     renderPassInfo.subpassCount = aSubpasses.size();
     renderPassInfo.pSubpasses = aSubpasses.data();
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &subpassDep;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(aSubpassDeps.size());
+    renderPassInfo.pDependencies = aSubpassDeps.data();
 
 
     m_vRenderPasses.resize(1, VK_NULL_HANDLE);
@@ -150,7 +177,69 @@ void RenderPassGBuffer::destroyFramebuffer()
     vkDestroyFramebuffer(GetRenderDevice()->GetDevice(), mFramebuffer, nullptr);
 }
 
-void RenderPassGBuffer::recordCommandBuffer(const std::vector<const Geometry*>& vpGeometries)
+void RenderPassGBuffer::recordCommandBuffer(const FrameVector<const GeometrySceneNode*>& vpGeometryNodes)
+{
+    // Re-recording, the caller makes sure the previous recording is idle
+    for (VkCommandBuffer& cmdBuf : m_vCommandBuffers)
+    {
+        GetRenderDevice()->FreeStaticPrimaryCommandbuffer(cmdBuf);
+    }
+    m_vCommandBuffers.clear();
+
+    // Create gbuffer render target views
+    GBufferViews vGBufferRTViews = {
+        GetRenderResourceManager()
+            ->getColorTarget("GBUFFER_POSITION_AO", mRenderArea)
+            ->getView(),
+
+        GetRenderResourceManager()
+            ->getColorTarget("GBUFFER_ALBEDO_TRANSMITTANCE",
+                             mRenderArea)
+            ->getView(),
+
+        GetRenderResourceManager()
+            ->getColorTarget("GBUFFER_NORMAL_ROUGHNESS", mRenderArea)
+            ->getView(),
+
+        GetRenderResourceManager()
+            ->getColorTarget("GBUFFER_METALNESS_TRANSLUCENCY",
+                             mRenderArea)
+            ->getView()};
+    // Lighting inputs are shared by the command buffers of all frames, the
+    // sets are only written the first time their targets are bound
+    m_aDescriptorSets = {
+        // GBuffer descriptor sets
+        GetDescriptorManager()->GetGBufferDescriptorSet(
+            vGBufferRTViews),
+        // IBL descriptor sets
+        GetDescriptorManager()->GetIBLDescriptorSet(
+            GetRenderResourceManager()
+                ->getColorTarget("irr_cube_map", {0, 0}, VK_FORMAT_B8G8R8A8_UNORM, 1, 6)
+                ->getView(),
+            GetRenderResourceManager()
+                ->getColorTarget("prefiltered_cubemap", {0, 0}, VK_FORMAT_B8G8R8A8_UNORM, 1, 6)
+                ->getView(),
+            GetRenderResourceManager()
+                ->getColorTarget("specular_brdf_lut", {0, 0}, VK_FORMAT_R32G32_SFLOAT, 1, 1)
+                ->getView())};
+
+    // World matrices sit at the same offsets in every frame region
+    FrameVector<uint32_t> vWorldMatrixOffsets;
+    vWorldMatrixOffsets.reserve(vpGeometryNodes.size());
+    for (const GeometrySceneNode* pGeometryNode : vpGeometryNodes)
+    {
+        vWorldMatrixOffsets.push_back(
+            GetFrameUniformAllocator()->Allocate(PerGeometryData{pGeometryNode->GetWorldMatrix()}));
+    }
+    for (uint32_t uFrameIdx = 0; uFrameIdx < GetFrameUniformAllocator()->GetNumFrames(); uFrameIdx++)
+    {
+        recordFrameCommandBuffer(uFrameIdx, vpGeometryNodes, vWorldMatrixOffsets);
+    }
+}
+
+void RenderPassGBuffer::recordFrameCommandBuffer(uint32_t uFrameIdx,
+                                                 const FrameVector<const GeometrySceneNode*>& vpGeometryNodes,
+                                                 const FrameVector<uint32_t>& vWorldMatrixOffsets)
 {
     VkCommandBufferBeginInfo beginInfo = {};
 
@@ -167,107 +256,78 @@ void RenderPassGBuffer::recordCommandBuffer(const std::vector<const Geometry*>&
         SCOPED_MARKER(mCommandBuffer, "Opaque Lighting Pass");
         // Build render pass
         RenderPassBeginInfoBuilder rpbiBuilder;
-        std::vector<VkClearValue> vClearValeus(
-            LightingAttachments::aClearValues.begin(),
-            LightingAttachments::aClearValues.end());
-
         VkRenderPassBeginInfo renderPassBeginInfo =
             rpbiBuilder.setRenderArea(mRenderArea)
             .setRenderPass(m_vRenderPasses.back())
             .setFramebuffer(mFramebuffer)
-            .setClearValues(vClearValeus)
+            .setClearValues(LightingAttachments::aClearValues)
             .build();
 
         vkCmdBeginRenderPass(mCommandBuffer, &renderPassBeginInfo,
             VK_SUBPASS_CONTENTS_INLINE);
 
-        // Allocate perview constant buffer
-        const UniformBuffer<PerViewData>* perView =
-            GetRenderResourceManager()->getUniformBuffer<PerViewData>("perView");
-
-        VkDescriptorSet perViewSets =
-            GetDescriptorManager()->AllocatePerviewDataDescriptorSet(*perView);
+        VkDescriptorSet perViewSets = GetFrameUniformAllocator()->GetPerViewDescriptorSet();
+        const uint32_t uPerViewOffset = GetFrameUniformAllocator()->GetPerViewOffset(uFrameIdx);
 
         {
             SCOPED_MARKER(mCommandBuffer, "GBuffer Pass");
+            // Materials are selected by push constant, the view and the
+            // bindless material set are shared by all draws
+            std::array<VkDescriptorSet, 2> aSharedDescSets = {perViewSets,
+                                                              GetMaterialManager()->GetDescriptorSet()};
+            vkCmdBindPipeline(mCommandBuffer,
+                              VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              mGBufferPipeline);
+            vkCmdBindDescriptorSets(
+                mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                mGBufferPipelineLayout, 0, (uint32_t)aSharedDescSets.size(),
+                aSharedDescSets.data(), 1, &uPerViewOffset);
+            VkDescriptorSet worldMatrixDescSet = GetFrameUniformAllocator()->GetPerObjDescriptorSet();
+            // Primitives share the geometry heap's buffers, they are only
+            // rebound when a primitive lives in another page
+            VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
             // Handle Geometires
-            for (const Geometry* pGeometry : vpGeometries)
+            for (size_t i = 0; i < vpGeometryNodes.size(); i++)
             {
+                const Geometry* pGeometry = vpGeometryNodes[i]->GetGeometry();
                 // each geometry has their own transformation
-                // TODO: Update perViewSets buffer data based on the geometries
-                // transformation
+                const uint32_t uWorldMatrixOffset =
+                    GetFrameUniformAllocator()->GetDynamicOffset(uFrameIdx, vWorldMatrixOffsets[i]);
+                vkCmdBindDescriptorSets(
+                    mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    mGBufferPipelineLayout, 2, 1, &worldMatrixDescSet, 1, &uWorldMatrixOffset);
                 for (const auto& pPrimitive : pGeometry->getPrimitives())
                 {
-                    VkDescriptorSet materialDescSet = GetMaterialManager()->GetDefaultMaterial()->GetDescriptorSet();
+                    MaterialPushConstantBlock materialBlock = {
+                        GetMaterialManager()->GetDefaultMaterial()->GetMaterialIndex()};
                     if (pPrimitive->GetMaterial() != nullptr)
                     {
-                        materialDescSet = pPrimitive->GetMaterial()->GetDescriptorSet();
+                        materialBlock.uMaterialIndex = pPrimitive->GetMaterial()->GetMaterialIndex();
                     }
-                    const UniformBuffer<glm::mat4>* worldMatrixBuffer = pGeometry->GetWorldMatrixBuffer();
-                    assert(worldMatrixBuffer != nullptr && "Buffer must be valid");
-                    VkDescriptorSet worldMatrixDescSet = GetDescriptorManager()->AllocateUniformBufferDescriptorSet(*worldMatrixBuffer, 0);
-
-                    std::vector<VkDescriptorSet> vGBufferDescSets = {perViewSets,
-                                                                     materialDescSet,
-                                                                     worldMatrixDescSet};
-                    VkDeviceSize offset = 0;
                     VkBuffer vertexBuffer = pPrimitive->getVertexDeviceBuffer();
-                    VkBuffer indexBuffer = pPrimitive->getIndexDeviceBuffer();
-                    uint32_t nIndexCount = pPrimitive->getIndexCount();
-                    vkCmdBindVertexBuffers(mCommandBuffer, 0, 1, &vertexBuffer,
-                                           &offset);
-                    vkCmdBindIndexBuffer(mCommandBuffer, indexBuffer, 0,
-                                         VK_INDEX_TYPE_UINT32);
-                    vkCmdBindPipeline(mCommandBuffer,
-                                      VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                      mGBufferPipeline);
-                    vkCmdBindDescriptorSets(
-                        mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        mGBufferPipelineLayout, 0, vGBufferDescSets.size(),
-                        vGBufferDescSets.data(), 0, nullptr);
-                    vkCmdDrawIndexed(mCommandBuffer, nIndexCount, 1, 0, 0, 0);
+                    if (vertexBuffer != boundVertexBuffer)
+                    {
+                        VkDeviceSize offset = 0;
+                        VkBuffer indexBuffer = pPrimitive->getIndexDeviceBuffer();
+                        vkCmdBindVertexBuffers(mCommandBuffer, 0, 1, &vertexBuffer,
+                                               &offset);
+                        vkCmdBindIndexBuffer(mCommandBuffer, indexBuffer, 0,
+                                             VK_INDEX_TYPE_UINT32);
+                        boundVertexBuffer = vertexBuffer;
+                    }
+                    vkCmdPushConstants(mCommandBuffer, mGBufferPipelineLayout,
+                                       VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                       sizeof(MaterialPushConstantBlock), &materialBlock);
+                    vkCmdDrawIndexed(mCommandBuffer, pPrimitive->getIndexCount(), 1, pPrimitive->GetFirstIndex(),
+                                     pPrimitive->GetVertexOffset(), 0);
                 }
             }
         }
         vkCmdNextSubpass(mCommandBuffer, VK_SUBPASS_CONTENTS_INLINE);
         {
             SCOPED_MARKER(mCommandBuffer, "Lighting Pass");
-            // Create gbuffer render target views
-            GBufferViews vGBufferRTViews = {
-                GetRenderResourceManager()
-                    ->getColorTarget("GBUFFER_POSITION_AO", mRenderArea)
-                    ->getView(),
-
-                GetRenderResourceManager()
-                    ->getColorTarget("GBUFFER_ALBEDO_TRANSMITTANCE",
-                                     mRenderArea)
-                    ->getView(),
-
-                GetRenderResourceManager()
-                    ->getColorTarget("GBUFFER_NORMAL_ROUGHNESS", mRenderArea)
-                    ->getView(),
-
-                GetRenderResourceManager()
-                    ->getColorTarget("GBUFFER_METALNESS_TRANSLUCENCY",
-                                     mRenderArea)
-                    ->getView()};
-
-            std::vector<VkDescriptorSet> lightingDescSets = {
-                perViewSets,
-                // GBuffer descriptor sets
-                GetDescriptorManager()->AllocateGBufferDescriptorSet(
-                    vGBufferRTViews),
-                // IBL descriptor sets
-                GetDescriptorManager()->AllocateIBLDescriptorSet(
-                    GetRenderResourceManager()
-                        ->getColorTarget("irr_cube_map", {0, 0}, VK_FORMAT_B8G8R8A8_UNORM, 1, 6)
-                        ->getView(),
-                    GetRenderResourceManager()
-                        ->getColorTarget("prefiltered_cubemap", {0, 0}, VK_FORMAT_B8G8R8A8_UNORM, 1, 6)
-                        ->getView(),
-                    GetRenderResourceManager()
-                        ->getColorTarget("specular_brdf_lut", {0, 0}, VK_FORMAT_R32G32_SFLOAT, 1, 1)
-                        ->getView())};
+            std::array<VkDescriptorSet, 3> lightingDescSets = {perViewSets, m_aDescriptorSets[0],
+                                                               m_aDescriptorSets[1]};
             const auto& prim = GetGeometryManager()->GetQuad()->getPrimitives().at(0);
             VkDeviceSize offset = 0;
             VkBuffer vertexBuffer = prim->getVertexDeviceBuffer();
@@ -283,8 +343,8 @@ void RenderPassGBuffer::recordCommandBuffer(const std::vector<const Geometry*>&
             vkCmdBindDescriptorSets(
                 mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                 mLightingPipelineLayout, 0, lightingDescSets.size(),
-                lightingDescSets.data(), 0, nullptr);
-            vkCmdDrawIndexed(mCommandBuffer, nIndexCount, 1, 0, 0, 0);
+                lightingDescSets.data(), 1, &uPerViewOffset);
+            vkCmdDrawIndexed(mCommandBuffer, nIndexCount, 1, prim->GetFirstIndex(), prim->GetVertexOffset(), 0);
         }
         vkCmdEndRenderPass(mCommandBuffer);
     }
@@ -297,8 +357,18 @@ void RenderPassGBuffer::recordCommandBuffer(const std::vector<const Geometry*>&
 void RenderPassGBuffer::createGBufferViews(VkExtent2D size)
 {
     std::array<VkImageView, LightingAttachments::ATTACHMENTS_COUNT> views;
-    // Color attachments
-    for (int i = 0; i < LightingAttachments::COLOR_ATTACHMENTS_COUNT; i++)
+    // GBuffer attachments are only read by the lighting subpass, they never
+    // leave the render pass
+    const RenderTargetLifetime gbufferLifetime = {RENDERPASS_GBUFFER, RENDERPASS_GBUFFER};
+    for (int i = 0; i < LightingAttachments::GBUFFER_ATTACHMENTS_COUNT; i++)
+    {
+        views[i] = GetRenderResourceManager()
+                       ->getTransientColorTarget(mAttachments.aNames[i], gbufferLifetime, size,
+                                                 mAttachments.aFormats[i], 1, 1, 0, true)
+                       ->getView();
+    }
+    // Lighting output
+    for (int i = LightingAttachments::GBUFFER_ATTACHMENTS_COUNT; i < LightingAttachments::COLOR_ATTACHMENTS_COUNT; i++)
     {
         views[i] = GetRenderResourceManager()
                        ->getColorTarget(mAttachments.aNames[i], size,
@@ -350,7 +420,8 @@ void RenderPassGBuffer::createPipelines()
                 DESCRIPTOR_LAYOUT_PER_OBJ_DATA)
         };
 
-        std::vector<VkPushConstantRange> pushConstants;
+        std::vector<VkPushConstantRange> pushConstants = {
+            getPushConstantRange<MaterialPushConstantBlock>(VK_SHADER_STAGE_FRAGMENT_BIT)};
 
         mGBufferPipelineLayout =
             PipelineManager::CreatePipelineLayout(descLayouts, pushConstants);
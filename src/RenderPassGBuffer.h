@@ -2,6 +2,7 @@
 #include <array>
 #include <memory>
 
+#include "FrameArena.h"
 #include "Geometry.h"
 #include "RenderPass.h"
 
@@ -81,7 +82,7 @@ public:
 
     RenderPassGBuffer();
     ~RenderPassGBuffer();
-    void recordCommandBuffer(const std::vector<const Geometry*>& vpGeometries);
+    void recordCommandBuffer(const FrameVector<const GeometrySceneNode*>& vpGeometryNodes);
     void createFramebuffer();
     void destroyFramebuffer();
     void setGBufferImageViews(VkImageView positionView, VkImageView albedoView,
@@ -92,9 +93,13 @@ public:
     void removeGBufferViews();
     void createPipelines();
 
-    VkCommandBuffer GetCommandBuffer(size_t idx) const override { return m_vCommandBuffers[0]; }
+    VkCommandBuffer GetCommandBuffer(size_t idx) const override { return m_vCommandBuffers[idx]; }
 
 private:
+    // One command buffer per frame in flight, each binds its frame's uniforms
+    void recordFrameCommandBuffer(uint32_t uFrameIdx, const FrameVector<const GeometrySceneNode*>& vpGeometryNodes,
+                                  const FrameVector<uint32_t>& vWorldMatrixOffsets);
+
     LightingAttachments mAttachments;
     VkFramebuffer mFramebuffer = VK_NULL_HANDLE;
     VkExtent2D mRenderArea = {0, 0};
@@ -107,4 +112,6 @@ private:
 
     VkDescriptorSet mPerViewDescSet;
     VkDescriptorSet mMaterialDescSet;
+    // GBuffer and IBL sets allocated by the last recording
+    std::array<VkDescriptorSet, 2> m_aDescriptorSets = {VK_NULL_HANDLE, VK_NULL_HANDLE};
 };
@@ -9,6 +9,9 @@
 #include "RenderPassTransparent.h"
 #include "RenderPassSkybox.h"
 #include "DebugUI.h"
+#include "FrameUniformAllocator.h"
+#include "MemoryBudget.h"
+#include "VkRenderDevice.h"
 
 static RenderPassManager renderPassManager;
 
@@ -73,36 +76,62 @@ void RenderPassManager::Unintialize()
 
 void RenderPassManager::RecordStaticCmdBuffers(const DrawLists& drawLists)
 {
+    RecordDrawListCmdBuffers(drawLists);
+
+    RenderPassSkybox *pSkybox = static_cast<RenderPassSkybox *>(m_vpRenderPasses[RENDERPASS_SKYBOX].get());
+    pSkybox->RecordCommandBuffers();
+    RenderPassFinal *pFinalPass = static_cast<RenderPassFinal *>(m_vpRenderPasses[RENDERPASS_FINAL].get());
+    pFinalPass->RecordCommandBuffers();
+}
+
+void RenderPassManager::RecordGeometryCmdBuffers(const DrawLists& drawLists)
+{
+    // Static command buffers of every swapchain image may still be in flight
+    GetRenderDevice()->WaitForFrames();
+    RecordDrawListCmdBuffers(drawLists);
+}
+
+void RenderPassManager::RecordDrawListCmdBuffers(const DrawLists& drawLists)
+{
+    // Reload evicted geometry before it gets bound, the rest may be evicted
+    // while out of the draw lists
+    FrameVector<IEvictable *> vpResources;
+    for (const FrameVector<const SceneNode *> &drawList : drawLists.m_aDrawLists)
+    {
+        for (const SceneNode *pNode : drawList)
+        {
+            for (const auto &pPrimitive : static_cast<const GeometrySceneNode *>(pNode)->GetGeometry()->getPrimitives())
+            {
+                vpResources.push_back(pPrimitive.get());
+            }
+        }
+    }
+    GetMemoryBudgetManager()->SetResourcesInUse(vpResources);
+    // World matrices get allocated again by the passes
+    GetFrameUniformAllocator()->Reset();
+
     {
         RenderPassGBuffer *pGBufferPass = static_cast<RenderPassGBuffer *>(m_vpRenderPasses[RENDERPASS_GBUFFER].get());
-        const std::vector<const SceneNode *> &opaqueDrawList = drawLists.m_aDrawLists[DrawLists::DL_OPAQUE];
-        std::vector<const Geometry *> vpGeometries;
-        vpGeometries.reserve(opaqueDrawList.size());
+        const FrameVector<const SceneNode *> &opaqueDrawList = drawLists.m_aDrawLists[DrawLists::DL_OPAQUE];
+        FrameVector<const GeometrySceneNode *> vpGeometryNodes;
+        vpGeometryNodes.reserve(opaqueDrawList.size());
         for (const SceneNode *pNode : opaqueDrawList)
         {
-            vpGeometries.push_back(
-                static_cast<const GeometrySceneNode *>(pNode)->GetGeometry());
+            vpGeometryNodes.push_back(static_cast<const GeometrySceneNode *>(pNode));
         }
-        pGBufferPass->recordCommandBuffer(vpGeometries);
+        pGBufferPass->recordCommandBuffer(vpGeometryNodes);
     }
     {
         RenderPassTransparent *pTransparentPass = static_cast<RenderPassTransparent *>(m_vpRenderPasses[RENDERPASS_TRANSPARENT].get());
-        const std::vector<const SceneNode *> &transparentDrawList = drawLists.m_aDrawLists[DrawLists::DL_TRANSPARENT];
-        std::vector<const Geometry *> vpGeometries;
-        vpGeometries.reserve(transparentDrawList.size());
+        const FrameVector<const SceneNode *> &transparentDrawList = drawLists.m_aDrawLists[DrawLists::DL_TRANSPARENT];
+        FrameVector<const GeometrySceneNode *> vpGeometryNodes;
+        vpGeometryNodes.reserve(transparentDrawList.size());
         for (const SceneNode *pNode : transparentDrawList)
         {
-            vpGeometries.push_back(
-                static_cast<const GeometrySceneNode *>(pNode)->GetGeometry());
+            vpGeometryNodes.push_back(static_cast<const GeometrySceneNode *>(pNode));
         }
-        pTransparentPass->RecordCommandBuffers(vpGeometries);
+        pTransparentPass->RecordCommandBuffers(vpGeometryNodes);
     }
-
-    RenderPassSkybox *pSkybox = static_cast<RenderPassSkybox *>(m_vpRenderPasses[RENDERPASS_SKYBOX].get());
-    pSkybox->RecordCommandBuffers();
-    RenderPassFinal *pFinalPass = static_cast<RenderPassFinal *>(m_vpRenderPasses[RENDERPASS_FINAL].get());
-    pFinalPass->RecordCommandBuffers();
-
 }
 
 void RenderPassManager::RecordDynamicCmdBuffers(uint32_t nFrameIdx, VkExtent2D vpExtent)
@@ -113,9 +142,10 @@ void RenderPassManager::RecordDynamicCmdBuffers(uint32_t nFrameIdx, VkExtent2D v
     pUIPass->recordCommandBuffer(vpExtent, nFrameIdx);
 }
 
-std::vector<VkCommandBuffer> RenderPassManager::GetCommandBuffers(uint32_t uImgIdx)
+FrameVector<VkCommandBuffer> RenderPassManager::GetCommandBuffers(uint32_t uImgIdx)
 {
-    std::vector<VkCommandBuffer> vCmdBufs;
+    FrameVector<VkCommandBuffer> vCmdBufs;
+    vCmdBufs.reserve(RENDERPASS_COUNT);
     for (size_t i = 0; i < RENDERPASS_COUNT; i++)
     {
         if (m_bIsIrradianceGenerated && i == RENDERPASS_IBL)
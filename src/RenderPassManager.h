@@ -5,6 +5,8 @@
 #include <memory>
 #include <vector>
 
+#include "FrameArena.h"
+
 class RenderPass;
 struct DrawLists;
 enum RenderPassNames
@@ -27,10 +29,14 @@ public:
     void OnResize(uint32_t uWidth, uint32_t uHeight);
     void Unintialize();
     void RecordStaticCmdBuffers(const DrawLists& drawLists);
+    // Re-record the passes consuming draw lists after the lists changed
+    void RecordGeometryCmdBuffers(const DrawLists& drawLists);
     void RecordDynamicCmdBuffers(uint32_t uFrameIdx, VkExtent2D vpExtent);
-    std::vector<VkCommandBuffer> GetCommandBuffers(uint32_t uImgIdx);
+    // Valid until the frame arena is reset
+    FrameVector<VkCommandBuffer> GetCommandBuffers(uint32_t uImgIdx);
 
 private:
+    void RecordDrawListCmdBuffers(const DrawLists& drawLists);
     std::array<std::unique_ptr<RenderPass>, RENDERPASS_COUNT> m_vpRenderPasses = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
     uint32_t m_uWidth = 0;
     uint32_t m_uHeight = 0;
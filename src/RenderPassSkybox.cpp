@@ -3,6 +3,7 @@
 #include "RenderResourceManager.h"
 #include "PipelineStateBuilder.h"
 #include "DescriptorManager.h"
+#include "FrameUniformAllocator.h"
 #include "Debug.h"
 #include <cassert>
 
@@ -200,6 +201,24 @@ void RenderPassSkybox::DestroyPipeline()
 }
 
 void RenderPassSkybox::RecordCommandBuffers()
+{
+    for (VkCommandBuffer& cmdBuf : m_vCommandBuffers)
+    {
+        GetRenderDevice()->FreeStaticPrimaryCommandbuffer(cmdBuf);
+    }
+    m_vCommandBuffers.clear();
+    m_cubemapDescriptorSet = GetDescriptorManager()->GetSingleSamplerDescriptorSet(
+        GetRenderResourceManager()
+            ->getColorTarget("irr_cube_map", {0, 0},
+                             VK_FORMAT_B8G8R8A8_UNORM, 1, 6)
+            ->getView());
+    for (uint32_t uFrameIdx = 0; uFrameIdx < GetFrameUniformAllocator()->GetNumFrames(); uFrameIdx++)
+    {
+        recordCommandBuffer(uFrameIdx);
+    }
+}
+
+void RenderPassSkybox::recordCommandBuffer(uint32_t uFrameIdx)
 {
     VkCommandBufferBeginInfo beginInfo = {};
 
@@ -212,30 +231,22 @@ void RenderPassSkybox::RecordCommandBuffers()
         SCOPED_MARKER(mCommandBuffer, "Skybox Pass");
         // Build render pass
         RenderPassBeginInfoBuilder rpbiBuilder;
-        std::vector<VkClearValue> vClearValeus = {{{.color = {0.0f, 0.0f, 0.0f, 0.0f}},
-                                                   {.depthStencil = {1.0f, 0}}}};
+        std::array<VkClearValue, 2> aClearValues = {{{.color = {0.0f, 0.0f, 0.0f, 0.0f}},
+                                                     {.depthStencil = {1.0f, 0}}}};
 
         VkRenderPassBeginInfo renderPassBeginInfo =
             rpbiBuilder.setRenderArea(m_renderArea)
                 .setRenderPass(m_vRenderPasses.back())
                 .setFramebuffer(m_frameBuffer)
-                .setClearValues(vClearValeus)
+                .setClearValues(aClearValues)
                 .build();
 
         vkCmdBeginRenderPass(mCommandBuffer, &renderPassBeginInfo,
                              VK_SUBPASS_CONTENTS_INLINE);
 
-        // Allocate perview constant buffer
-        const UniformBuffer<PerViewData>* perView =
-            GetRenderResourceManager()->getUniformBuffer<PerViewData>("perView");
-
-        std::vector<VkDescriptorSet> vDescSets = {
-            GetDescriptorManager()->AllocatePerviewDataDescriptorSet(*perView),
-            GetDescriptorManager()->AllocateSingleSamplerDescriptorSet(
-                GetRenderResourceManager()
-                    ->getColorTarget("irr_cube_map", {0, 0},
-                                     VK_FORMAT_B8G8R8A8_UNORM, 1, 6)
-                    ->getView())};
+        std::array<VkDescriptorSet, 2> aDescSets = {GetFrameUniformAllocator()->GetPerViewDescriptorSet(),
+                                                    m_cubemapDescriptorSet};
+        const uint32_t uPerViewOffset = GetFrameUniformAllocator()->GetPerViewOffset(uFrameIdx);
 
         {
             // Draw skybox cube
@@ -253,9 +264,9 @@ void RenderPassSkybox::RecordCommandBuffers()
                               m_pipeline);
             vkCmdBindDescriptorSets(
                 mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_pipelineLayout, 0, (uint32_t)vDescSets.size(),
-                vDescSets.data(), 0, nullptr);
-            vkCmdDrawIndexed(mCommandBuffer, nIndexCount, 1, 0, 0, 0);
+                m_pipelineLayout, 0, (uint32_t)aDescSets.size(),
+                aDescSets.data(), 1, &uPerViewOffset);
+            vkCmdDrawIndexed(mCommandBuffer, nIndexCount, 1, prim->GetFirstIndex(), prim->GetVertexOffset(), 0);
         }
         vkCmdEndRenderPass(mCommandBuffer);
     }
@@ -267,5 +278,5 @@ void RenderPassSkybox::RecordCommandBuffers()
 
 VkCommandBuffer RenderPassSkybox::GetCommandBuffer(size_t idx) const
 {
-    return m_vCommandBuffers.back();
+    return m_vCommandBuffers[idx];
 }
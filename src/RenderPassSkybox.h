@@ -18,10 +18,11 @@ private:
     void DestroyFramebuffer();
     void DestroyPipeline();
     void SetupDescriptorSets();
-    void recordCommandBuffer();
+    void recordCommandBuffer(uint32_t uFrameIdx);
 private:
     VkPipeline m_pipeline = VK_NULL_HANDLE;
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
     VkExtent2D m_renderArea = {0, 0};
     VkFramebuffer m_frameBuffer = VK_NULL_HANDLE;
+    VkDescriptorSet m_cubemapDescriptorSet = VK_NULL_HANDLE;
 };
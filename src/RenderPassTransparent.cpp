@@ -4,9 +4,12 @@
 
 #include "Debug.h"
 #include "DescriptorManager.h"
+#include "FrameUniformAllocator.h"
 #include "PipelineStateBuilder.h"
+#include "PushConstantBlocks.h"
 #include "RenderResourceManager.h"
 #include "VkRenderDevice.h"
+#include "Scene.h"
 
 RenderPassTransparent::RenderPassTransparent()
 {
@@ -137,7 +140,8 @@ void RenderPassTransparent::CreatePipeline()
         GetDescriptorManager()->getDescriptorLayout(
             DESCRIPTOR_LAYOUT_PER_OBJ_DATA)};
 
-    std::vector<VkPushConstantRange> pushConstants;
+    std::vector<VkPushConstantRange> pushConstants = {
+        getPushConstantRange<MaterialPushConstantBlock>(VK_SHADER_STAGE_FRAGMENT_BIT)};
 
     m_pipelineLayout = PipelineManager::CreatePipelineLayout(descLayouts, pushConstants);
 
@@ -196,7 +200,32 @@ void RenderPassTransparent::DestroyPipeline()
     m_pipeline = VK_NULL_HANDLE;
 }
 
-void RenderPassTransparent::RecordCommandBuffers(const std::vector<const Geometry*>& vpGeometries)
+void RenderPassTransparent::RecordCommandBuffers(const FrameVector<const GeometrySceneNode*>& vpGeometryNodes)
+{
+    // Re-recording, the caller makes sure the previous recording is idle
+    for (VkCommandBuffer& cmdBuf : m_vCommandBuffers)
+    {
+        GetRenderDevice()->FreeStaticPrimaryCommandbuffer(cmdBuf);
+    }
+    m_vCommandBuffers.clear();
+
+    // World matrices sit at the same offsets in every frame region
+    FrameVector<uint32_t> vWorldMatrixOffsets;
+    vWorldMatrixOffsets.reserve(vpGeometryNodes.size());
+    for (const GeometrySceneNode* pGeometryNode : vpGeometryNodes)
+    {
+        vWorldMatrixOffsets.push_back(
+            GetFrameUniformAllocator()->Allocate(PerGeometryData{pGeometryNode->GetWorldMatrix()}));
+    }
+    for (uint32_t uFrameIdx = 0; uFrameIdx < GetFrameUniformAllocator()->GetNumFrames(); uFrameIdx++)
+    {
+        RecordCommandBuffer(uFrameIdx, vpGeometryNodes, vWorldMatrixOffsets);
+    }
+}
+
+void RenderPassTransparent::RecordCommandBuffer(uint32_t uFrameIdx,
+                                                const FrameVector<const GeometrySceneNode*>& vpGeometryNodes,
+                                                const FrameVector<uint32_t>& vWorldMatrixOffsets)
 {
     VkCommandBufferBeginInfo beginInfo = {};
 
@@ -209,63 +238,70 @@ void RenderPassTransparent::RecordCommandBuffers(const std::vector<const Geometr
         SCOPED_MARKER(mCommandBuffer, "Transparent Pass");
         // Build render pass
         RenderPassBeginInfoBuilder rpbiBuilder;
-        std::vector<VkClearValue> vClearValeus = {{{.color = {0.0f, 0.0f, 0.0f, 0.0f}},
-                                                   {.depthStencil = {1.0f, 0}}}};
+        std::array<VkClearValue, 2> aClearValues = {{{.color = {0.0f, 0.0f, 0.0f, 0.0f}},
+                                                     {.depthStencil = {1.0f, 0}}}};
 
         VkRenderPassBeginInfo renderPassBeginInfo =
             rpbiBuilder.setRenderArea(m_renderArea)
                 .setRenderPass(m_vRenderPasses.back())
                 .setFramebuffer(m_frameBuffer)
-                .setClearValues(vClearValeus)
+                .setClearValues(aClearValues)
                 .build();
 
         vkCmdBeginRenderPass(mCommandBuffer, &renderPassBeginInfo,
                              VK_SUBPASS_CONTENTS_INLINE);
 
-        // Allocate perview constant buffer
-        const UniformBuffer<PerViewData>* perView =
-            GetRenderResourceManager()->getUniformBuffer<PerViewData>("perView");
-
-        VkDescriptorSet perViewSets =
-            GetDescriptorManager()->AllocatePerviewDataDescriptorSet(*perView);
-
         {
+            // Materials are selected by push constant, the view and the
+            // bindless material set are shared by all draws
+            std::array<VkDescriptorSet, 2> aSharedDescSets = {GetFrameUniformAllocator()->GetPerViewDescriptorSet(),
+                                                              GetMaterialManager()->GetDescriptorSet()};
+            const uint32_t uPerViewOffset = GetFrameUniformAllocator()->GetPerViewOffset(uFrameIdx);
+            vkCmdBindPipeline(mCommandBuffer,
+                              VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              m_pipeline);
+            vkCmdBindDescriptorSets(
+                mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                m_pipelineLayout, 0, (uint32_t)aSharedDescSets.size(),
+                aSharedDescSets.data(), 1, &uPerViewOffset);
+            VkDescriptorSet worldMatrixDescSet = GetFrameUniformAllocator()->GetPerObjDescriptorSet();
+            // Primitives share the geometry heap's buffers, they are only
+            // rebound when a primitive lives in another page
+            VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
             // Handle Geometires
-            for (const Geometry* pGeometry : vpGeometries)
+            for (size_t i = 0; i < vpGeometryNodes.size(); i++)
             {
+                const Geometry* pGeometry = vpGeometryNodes[i]->GetGeometry();
                 // each geometry has their own transformation
-                // TODO: Update perViewSets buffer data based on the geometries
-                // transformation
+                const uint32_t uWorldMatrixOffset =
+                    GetFrameUniformAllocator()->GetDynamicOffset(uFrameIdx, vWorldMatrixOffsets[i]);
+                vkCmdBindDescriptorSets(
+                    mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_pipelineLayout, 2, 1, &worldMatrixDescSet, 1, &uWorldMatrixOffset);
                 for (const auto& pPrimitive : pGeometry->getPrimitives())
                 {
-                    VkDescriptorSet materialDescSet = GetMaterialManager()->GetDefaultMaterial()->GetDescriptorSet();
+                    MaterialPushConstantBlock materialBlock = {
+                        GetMaterialManager()->GetDefaultMaterial()->GetMaterialIndex()};
                     if (pPrimitive->GetMaterial() != nullptr)
                     {
-                        materialDescSet = pPrimitive->GetMaterial()->GetDescriptorSet();
+                        materialBlock.uMaterialIndex = pPrimitive->GetMaterial()->GetMaterialIndex();
                     }
-                    const UniformBuffer<glm::mat4>* worldMatrixBuffer = pGeometry->GetWorldMatrixBuffer();
-                    assert(worldMatrixBuffer != nullptr && "Buffer must be valid");
-                    VkDescriptorSet worldMatrixDescSet = GetDescriptorManager()->AllocateUniformBufferDescriptorSet(*worldMatrixBuffer, 0);
-
-                    std::vector<VkDescriptorSet> vGBufferDescSets = {perViewSets,
-                                                                     materialDescSet,
-                                                                     worldMatrixDescSet};
-                    VkDeviceSize offset = 0;
                     VkBuffer vertexBuffer = pPrimitive->getVertexDeviceBuffer();
-                    VkBuffer indexBuffer = pPrimitive->getIndexDeviceBuffer();
-                    uint32_t nIndexCount = pPrimitive->getIndexCount();
-                    vkCmdBindVertexBuffers(mCommandBuffer, 0, 1, &vertexBuffer,
-                                           &offset);
-                    vkCmdBindIndexBuffer(mCommandBuffer, indexBuffer, 0,
-                                         VK_INDEX_TYPE_UINT32);
-                    vkCmdBindPipeline(mCommandBuffer,
-                                      VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                      m_pipeline);
-                    vkCmdBindDescriptorSets(
-                        mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        m_pipelineLayout, 0, vGBufferDescSets.size(),
-                        vGBufferDescSets.data(), 0, nullptr);
-                    vkCmdDrawIndexed(mCommandBuffer, nIndexCount, 1, 0, 0, 0);
+                    if (vertexBuffer != boundVertexBuffer)
+                    {
+                        VkDeviceSize offset = 0;
+                        VkBuffer indexBuffer = pPrimitive->getIndexDeviceBuffer();
+                        vkCmdBindVertexBuffers(mCommandBuffer, 0, 1, &vertexBuffer,
+                                               &offset);
+                        vkCmdBindIndexBuffer(mCommandBuffer, indexBuffer, 0,
+                                             VK_INDEX_TYPE_UINT32);
+                        boundVertexBuffer = vertexBuffer;
+                    }
+                    vkCmdPushConstants(mCommandBuffer, m_pipelineLayout,
+                                       VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                       sizeof(MaterialPushConstantBlock), &materialBlock);
+                    vkCmdDrawIndexed(mCommandBuffer, pPrimitive->getIndexCount(), 1, pPrimitive->GetFirstIndex(),
+                                     pPrimitive->GetVertexOffset(), 0);
                 }
             }
         }
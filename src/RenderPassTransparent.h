@@ -1,4 +1,5 @@
 #pragma once
+#include "FrameArena.h"
 #include "RenderPass.h"
 
 class RenderPassTransparent : public RenderPass
@@ -6,14 +7,17 @@ class RenderPassTransparent : public RenderPass
 public:
     RenderPassTransparent();
     virtual ~RenderPassTransparent() override;
-    VkCommandBuffer GetCommandBuffer(size_t) const override { return m_vCommandBuffers[0]; }
-    void RecordCommandBuffers(const std::vector<const Geometry*>& vpGeometries);
+    VkCommandBuffer GetCommandBuffer(size_t idx) const override { return m_vCommandBuffers[idx]; }
+    void RecordCommandBuffers(const FrameVector<const GeometrySceneNode*>& vpGeometryNodes);
     void CreatePipeline();
     void DestroyPipeline();
     void CreateFramebuffer(uint32_t uWidth, uint32_t uHeight);
     void DestroyFramebuffer();
 private:
     void CreateRenderPasses();
+    // One command buffer per frame in flight, each binds its frame's uniforms
+    void RecordCommandBuffer(uint32_t uFrameIdx, const FrameVector<const GeometrySceneNode*>& vpGeometryNodes,
+                             const FrameVector<uint32_t>& vWorldMatrixOffsets);
     VkFramebuffer m_frameBuffer = VK_NULL_HANDLE;
     VkExtent2D m_renderArea = {0, 0};
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
@@ -16,7 +16,7 @@ void ImGuiResource::createResources(VkRenderPass UIRenderPass, uint32_t numSwapc
     pTexture = std::make_unique<Texture>();
     pTexture->LoadPixels(fontData, texWidth, texHeight);
     // Allocate descriptor
-    descriptorSet = GetDescriptorManager()->AllocateSingleSamplerDescriptorSet(
+    descriptorSet = GetDescriptorManager()->GetSingleSamplerDescriptorSet(
         pTexture->getView());
     GetDescriptorManager()->getDescriptorLayout(DESCRIPTOR_LAYOUT_SINGLE_SAMPLER);
 
@@ -24,8 +24,8 @@ void ImGuiResource::createResources(VkRenderPass UIRenderPass, uint32_t numSwapc
     indexBuffers.resize(numSwapchainBuffers);
     for (uint32_t i = 0; i< numSwapchainBuffers; i++)
     {
-        vertexBuffers[i] = VertexBuffer(false, "UI Vertex buffer");
-        indexBuffers[i] = IndexBuffer(false, "UI Index buffer");
+        vertexBuffers[i] = std::make_unique<VertexBuffer>(BufferUploadPolicy::HOST_VISIBLE, "UI Vertex buffer");
+        indexBuffers[i] = std::make_unique<IndexBuffer>(BufferUploadPolicy::HOST_VISIBLE, "UI Index buffer");
     }
 }
 
@@ -149,11 +149,13 @@ void RenderPassUI::updateBuffers(uint32_t nSwapchainBufferIndex)
     }
 
     // Prepare vertex buffer and index buffer
-    m_uiResources.vertexBuffers[nSwapchainBufferIndex].setData(nullptr, vertexBufferSize);
-    m_uiResources.indexBuffers[nSwapchainBufferIndex].setData(nullptr, indexBufferSize);
+    VertexBuffer* pVertexBuffer = m_uiResources.vertexBuffers[nSwapchainBufferIndex].get();
+    IndexBuffer* pIndexBuffer = m_uiResources.indexBuffers[nSwapchainBufferIndex].get();
+    pVertexBuffer->SetData(nullptr, vertexBufferSize);
+    pIndexBuffer->SetData(nullptr, indexBufferSize);
 
-    ImDrawVert* vtxDst = (ImDrawVert*)m_uiResources.vertexBuffers[nSwapchainBufferIndex].map();
-    ImDrawIdx* idxDst = (ImDrawIdx*)m_uiResources.indexBuffers[nSwapchainBufferIndex].map();
+    ImDrawVert* vtxDst = (ImDrawVert*)pVertexBuffer->GetMappedData();
+    ImDrawIdx* idxDst = (ImDrawIdx*)pIndexBuffer->GetMappedData();
 
     for (int n = 0; n < imDrawData->CmdListsCount; n++)
     {
@@ -166,8 +168,8 @@ void RenderPassUI::updateBuffers(uint32_t nSwapchainBufferIndex)
         idxDst += cmd_list->IdxBuffer.Size;
     }
 
-    m_uiResources.vertexBuffers[nSwapchainBufferIndex].unmap();
-    m_uiResources.indexBuffers[nSwapchainBufferIndex].unmap();
+    pVertexBuffer->FlushMappedData(0, vertexBufferSize);
+    pIndexBuffer->FlushMappedData(0, indexBufferSize);
 }
 
 void RenderPassUI::recordCommandBuffer(VkExtent2D screenExtent, uint32_t nSwapchainBufferIndex)
@@ -234,9 +236,9 @@ void RenderPassUI::recordCommandBuffer(VkExtent2D screenExtent, uint32_t nSwapch
                            sizeof(PushConstBlock), &pushConstBlock);
 
         VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(curCmdBuf, 0, 1,
-                               &m_uiResources.vertexBuffers[nSwapchainBufferIndex].buffer(), &offset);
-        vkCmdBindIndexBuffer(curCmdBuf, m_uiResources.indexBuffers[nSwapchainBufferIndex].buffer(), 0,
+        VkBuffer vertexBuffer = m_uiResources.vertexBuffers[nSwapchainBufferIndex]->buffer();
+        vkCmdBindVertexBuffers(curCmdBuf, 0, 1, &vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(curCmdBuf, m_uiResources.indexBuffers[nSwapchainBufferIndex]->buffer(), 0,
                              VK_INDEX_TYPE_UINT32);
         vkCmdBindPipeline(curCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
         vkCmdBindDescriptorSets(curCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
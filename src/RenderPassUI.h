@@ -1,5 +1,7 @@
 #pragma once
+#include <array>
 #include <memory>
+#include <vector>
 
 #include "RenderPass.h"
 #include "Texture.h"
@@ -21,9 +23,10 @@ struct UISettings
 class Texture;
 struct ImGuiResource
 {
-    // Vertex buffer and index buffer can be updated each frame
-    std::vector<VertexBuffer> vertexBuffers;
-    std::vector<IndexBuffer> indexBuffers;
+    // Vertex buffer and index buffer are rewritten each frame, one pair per
+    // swapchain image
+    std::vector<std::unique_ptr<VertexBuffer>> vertexBuffers;
+    std::vector<std::unique_ptr<IndexBuffer>> indexBuffers;
 
     VkSampler sampler;
     VkDeviceMemory fontMemory = VK_NULL_HANDLE;
@@ -1,9 +1,13 @@
 #pragma once
 #include <vk_mem_alloc.h>
 #include <cassert>
+#include <cstring>
+#include <string>
 #include <vulkan/vulkan_core.h>
 
 #include "Debug.h"
+#include "DescriptorSetCache.h"
+#include "UploadManager.h"
 #include "VkMemoryAllocator.h"
 #include "VkRenderDevice.h"
 
@@ -22,6 +26,7 @@ public:
     VkImage getImage() const { return m_image; }
     virtual ~ImageResource()
     {
+        GetDescriptorSetCache()->Release(reinterpret_cast<uint64_t>(m_view));
         vkDestroyImageView(GetRenderDevice()->GetDevice(), m_view, nullptr);
         GetMemoryAllocator()->FreeImage(m_image, m_allocation);
     }
@@ -42,6 +47,16 @@ protected:
             &m_imageInfo, memoryUsage, m_image, m_allocation);
     }
 
+    void DestroyImageInternal()
+    {
+        GetDescriptorSetCache()->Release(reinterpret_cast<uint64_t>(m_view));
+        vkDestroyImageView(GetRenderDevice()->GetDevice(), m_view, nullptr);
+        GetMemoryAllocator()->FreeImage(m_image, m_allocation);
+        m_view = VK_NULL_HANDLE;
+        m_image = VK_NULL_HANDLE;
+        m_allocation = VK_NULL_HANDLE;
+    }
+
     void CreateImageViewInternal()
     {
         assert(m_image != VK_NULL_HANDLE);
@@ -92,18 +107,37 @@ protected:
     };
 };
 
+// How the host gets data into a buffer, each policy only pays for the
+// synchronization it needs
+enum class BufferUploadPolicy
+{
+    // Device local, copied through the upload manager's staging ring whose
+    // barrier waits for the copies at the buffer's consumer stages
+    STAGED,
+    // Written in place, queue submission makes host writes visible so no
+    // barrier is needed. For data rewritten every frame.
+    HOST_VISIBLE,
+    // Written in place in device local memory when the BAR reaches it,
+    // staged otherwise. For data the GPU reads more often than it changes.
+    REBAR,
+};
+
+// Buffer owning its memory. Small per-frame data is better served by the
+// FrameUniformAllocator ring than by a buffer per frame.
 class BufferResource : public IRenderResource
 {
 public:
-    BufferResource(VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage)
-        : BUFFER_USAGE(bufferUsage), MEMORY_USAGE(memoryUsage)
+    BufferResource(VkBufferUsageFlags bufferUsage, BufferUploadPolicy uploadPolicy,
+                   const std::string& sName = "Buffer")
+        : BUFFER_USAGE(uploadPolicy == BufferUploadPolicy::HOST_VISIBLE
+                           ? bufferUsage
+                           : bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+          UPLOAD_POLICY(uploadPolicy),
+          m_sName(sName)
     {
     }
     virtual VkBuffer buffer() const { return m_buffer; }
-    virtual ~BufferResource()
-    {
-        GetMemoryAllocator()->FreeBuffer(m_buffer, m_allocation);
-    }
+    virtual ~BufferResource() { Release(); }
     virtual VkObjectType GetVkObjectType() const override
     {
         return VK_OBJECT_TYPE_BUFFER;
@@ -114,75 +148,109 @@ public:
         setDebugUtilsObjectName(reinterpret_cast<uint64_t>(m_buffer),
                                 GetVkObjectType(), sName.c_str());
     }
+
+    // Grow the buffer to size and upload pData if given. Without data the
+    // content is undefined, host visible buffers get filled through
+    // GetMappedData().
     void SetData(const void* pData, size_t size)
     {
         if (m_buffer != VK_NULL_HANDLE && size > m_nSize)
         {
-            GetMemoryAllocator()->FreeBuffer(m_buffer, m_allocation);
-            m_buffer = VK_NULL_HANDLE;
+            Release();
         }
         if (m_buffer == VK_NULL_HANDLE)
         {
-            GetMemoryAllocator()->AllocateBuffer(size, BUFFER_USAGE,
-                                                 MEMORY_USAGE, m_buffer,
-                                                 m_allocation);
+            Allocate(size);
         }
         m_nSize = size;
-
-        if (BUFFER_USAGE & VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+        if (pData == nullptr)
+        {
+            return;
+        }
+        if (m_bStaged)
         {
-            assert(pData != nullptr && "Need to have data to upload");
-            // Create staging buffer
-            VkBuffer stagingBuffer = VK_NULL_HANDLE;
-            VmaAllocation stagingAllocation = VK_NULL_HANDLE;
-            GetMemoryAllocator()->AllocateBuffer(
-                size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
-                stagingBuffer, stagingAllocation);
-
-            void* pMappedMemory = nullptr;
-            GetMemoryAllocator()->MapBuffer(stagingAllocation, &pMappedMemory);
-            memcpy(pMappedMemory, pData, size);
-            GetMemoryAllocator()->UnmapBuffer(stagingAllocation);
-
-            // Submit the copy immedietly
-            GetRenderDevice()->ExecuteImmediateCommand(
-                [&](VkCommandBuffer commandBuffer) {
-                    VkBufferCopy copyRegion = {};
-                    copyRegion.size = size;
-                    vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_buffer, 1,
-                                    &copyRegion);
-                    // Make sure the copy of the instance buffer are copied before triggering the
-                    // acceleration structure build
-                    VkMemoryBarrier barrier{
-                        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
-                        nullptr, VK_ACCESS_TRANSFER_WRITE_BIT,
-                        VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR};
-                    vkCmdPipelineBarrier(commandBuffer,
-                                         VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-                                         0, 1, &barrier, 0, nullptr, 0, nullptr);
-                });
-
-            GetMemoryAllocator()->FreeBuffer(stagingBuffer, stagingAllocation);
+            // Batched with other uploads, submitted before the next frame
+            GetUploadManager()->UploadBuffer(m_buffer, BUFFER_USAGE, 0, pData, size);
         }
         else
         {
-            if (pData != nullptr)
+            WriteMappedData(pData, 0, size);
+        }
+    }
+
+    // Host visible buffers stay mapped, writes through the pointer need a
+    // FlushMappedData()
+    void* GetMappedData() const
+    {
+        assert(m_pMappedData != nullptr && "Buffer is not host visible");
+        return m_pMappedData;
+    }
+    void FlushMappedData(size_t uOffset, size_t uSize)
+    {
+        GetMemoryAllocator()->FlushAllocation(m_allocation, uOffset, uSize);
+    }
+
+    // Free the memory, SetData allocates it again
+    void Release()
+    {
+        if (m_buffer == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        // Staged copies must land before the buffer is freed
+        if (m_bStaged && !GetUploadManager()->IsIdle())
+        {
+            GetUploadManager()->Flush();
+        }
+        GetDescriptorSetCache()->Release(reinterpret_cast<uint64_t>(m_buffer));
+        GetMemoryAllocator()->FreeBuffer(m_buffer, m_allocation);
+        m_buffer = VK_NULL_HANDLE;
+        m_allocation = VK_NULL_HANDLE;
+        m_pMappedData = nullptr;
+        m_nSize = 0;
+    }
+
+protected:
+    void Allocate(size_t size)
+    {
+        if (UPLOAD_POLICY != BufferUploadPolicy::STAGED)
+        {
+            GetMemoryAllocator()->AllocateBuffer(size, BUFFER_USAGE, VMA_MEMORY_USAGE_CPU_TO_GPU, m_buffer,
+                                                 m_allocation, m_sName);
+            // Without resizable BAR the buffer landed in system memory,
+            // keep it there only when the host rewrites it every frame
+            if (UPLOAD_POLICY == BufferUploadPolicy::HOST_VISIBLE ||
+                GetMemoryAllocator()->IsDeviceLocal(m_allocation))
             {
-                void* pMappedMemory = nullptr;
-                GetMemoryAllocator()->MapBuffer(m_allocation, &pMappedMemory);
-                memcpy(pMappedMemory, pData, size);
-                GetMemoryAllocator()->UnmapBuffer(m_allocation);
+                m_pMappedData = GetMemoryAllocator()->GetMappedData(m_allocation);
+                m_bStaged = false;
+                return;
             }
+            GetMemoryAllocator()->FreeBuffer(m_buffer, m_allocation);
         }
+        GetMemoryAllocator()->AllocateBuffer(size, BUFFER_USAGE, VMA_MEMORY_USAGE_GPU_ONLY, m_buffer,
+                                             m_allocation, m_sName);
+        m_pMappedData = nullptr;
+        m_bStaged = true;
+    }
+
+    // Copy into the mapped memory, only the written range is flushed
+    void WriteMappedData(const void* pData, size_t uOffset, size_t uSize)
+    {
+        memcpy(static_cast<uint8_t*>(GetMappedData()) + uOffset, pData, uSize);
+        FlushMappedData(uOffset, uSize);
     }
 
-protected:
     VkBuffer m_buffer = VK_NULL_HANDLE;
     VmaAllocation m_allocation = VK_NULL_HANDLE;
-    uint32_t m_nSize;
+    // Persistent mapping of host visible buffers
+    void* m_pMappedData = nullptr;
+    size_t m_nSize = 0;
+    // Data goes through the upload manager
+    bool m_bStaged = true;
     const VkBufferUsageFlags BUFFER_USAGE = 0x0;
-    const VmaMemoryUsage MEMORY_USAGE = VMA_MEMORY_USAGE_UNKNOWN;
+    const BufferUploadPolicy UPLOAD_POLICY = BufferUploadPolicy::STAGED;
+    const std::string m_sName;
 };
 
 class AccelerationStructureBuffer : public BufferResource
@@ -192,23 +260,18 @@ public:
         : BufferResource(
               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_EXT |
                   VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
-              VMA_MEMORY_USAGE_GPU_ONLY)
+              BufferUploadPolicy::STAGED, "AccelerationStrucutre")
     {
-        GetMemoryAllocator()->AllocateBuffer(size, BUFFER_USAGE, MEMORY_USAGE,
-                                             m_buffer, m_allocation,
-                                             "AccelerationStrucutre");
+        SetData(nullptr, size);
     }
 
+    // Instances are read by every build, written in place with resizable BAR
     AccelerationStructureBuffer(const void* pData, uint32_t size)
         : BufferResource(
               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_EXT |
-                  VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
-                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-              VMA_MEMORY_USAGE_GPU_ONLY)
+                  VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
+              BufferUploadPolicy::REBAR, "AccelerationStrucutre")
     {
-        GetMemoryAllocator()->AllocateBuffer(size, BUFFER_USAGE, MEMORY_USAGE,
-                                             m_buffer, m_allocation,
-                                             "AccelerationStrucutre");
         SetData(pData, size);
     }
 };
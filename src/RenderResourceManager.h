@@ -19,7 +19,7 @@ public:
 
     void Unintialize() { m_mResources.clear(); }
 
-    RenderTarget* getRenderTarget(const std::string sName, bool bColorTarget,
+    RenderTarget* getRenderTarget(const std::string& sName, bool bColorTarget,
                                   VkExtent2D extent, VkFormat format,
                                   uint32_t numMips = 1, uint32_t numLayers = 1,
                                   VkImageUsageFlags nAdditionalUsageFlags = 0)
@@ -40,7 +40,7 @@ public:
         return static_cast<RenderTarget*>(m_mResources[sName].get());
     }
 
-    Texture* getTexture(const std::string sName, const std::string path)
+    Texture* getTexture(const std::string& sName, const std::string& path)
     {
         if (m_mResources.find(sName) == m_mResources.end())
         {
@@ -51,14 +51,14 @@ public:
         return static_cast<Texture*>(m_mResources[sName].get());
     }
 
-    RenderTarget* getDepthTarget(const std::string sName, VkExtent2D extent,
+    RenderTarget* getDepthTarget(const std::string& sName, VkExtent2D extent,
                                  VkFormat format = VK_FORMAT_D32_SFLOAT)
     {
         return getRenderTarget(sName, false, extent, format);
     }
 
     RenderTarget* getColorTarget(
-        const std::string sName, VkExtent2D extent,
+        const std::string& sName, VkExtent2D extent,
         VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT, uint32_t numMips = 1,
         uint32_t numLayers = 1, VkImageUsageFlags nAdditionalUsageFlags = 0)
     {
@@ -66,12 +66,33 @@ public:
                                nAdditionalUsageFlags);
     }
 
-    RenderTarget* getColorTarget(const std::string sName)
+    RenderTarget* getColorTarget(const std::string& sName)
     {
         return static_cast<RenderTarget*>(m_mResources[sName].get());
     }
 
-    void removeResource(const std::string sName)
+    // Color target only used within lifetime's passes of a frame, see
+    // RenderTarget. Later lookups go through getColorTarget.
+    RenderTarget* getTransientColorTarget(
+        const std::string& sName, const RenderTargetLifetime& lifetime,
+        VkExtent2D extent, VkFormat format, uint32_t numMips = 1,
+        uint32_t numLayers = 1, VkImageUsageFlags nAdditionalUsageFlags = 0,
+        bool bLazy = false)
+    {
+        if (m_mResources.find(sName) == m_mResources.end())
+        {
+            VkImageUsageFlags nUsageFlags = nAdditionalUsageFlags |
+                                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                            VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+            m_mResources[sName] = std::make_unique<RenderTarget>(
+                format, nUsageFlags, extent.width, extent.height, numMips,
+                numLayers, lifetime, bLazy);
+            m_mResources[sName]->SetDebugName(sName);
+        }
+        return static_cast<RenderTarget*>(m_mResources[sName].get());
+    }
+
+    void removeResource(const std::string& sName)
     {
         if (auto it = m_mResources.find(sName); it != m_mResources.end())
         {
@@ -81,7 +102,7 @@ public:
     const ResourceMap& getResourceMap() { return m_mResources; }
 
     template <class T>
-    UniformBuffer<T>* getUniformBuffer(const std::string sName)
+    UniformBuffer<T>* getUniformBuffer(const std::string& sName)
     {
         if (m_mResources.find(sName) == m_mResources.end())
         {
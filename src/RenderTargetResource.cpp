@@ -1,29 +1,132 @@
 #include "RenderTargetResource.h"
 
+#include <algorithm>
 #include <cassert>
+#include <utility>
+#include <vector>
 
 #include "Texture.h"
 #include "VkMemoryAllocator.h"
 #include "VkRenderDevice.h"
 
-RenderTarget::RenderTarget(VkFormat format, VkImageUsageFlags usage,
-                           uint32_t width, uint32_t height, uint32_t numMips, uint32_t numLayers)
+// Memory shared by transient render targets of disjoint lifetimes, images
+// are bound at its start
+struct TransientMemoryBlock
 {
-    VkImageAspectFlags aspectMask = 0;
-    VkImageLayout imageLayout=VK_IMAGE_LAYOUT_UNDEFINED;
+    VmaAllocation m_allocation = VK_NULL_HANDLE;
+    VkDeviceSize m_uSize = 0;
+    uint32_t m_uMemoryType = 0;
+    std::vector<std::pair<const RenderTarget*, RenderTargetLifetime>> m_vTargets;
+};
+static std::vector<TransientMemoryBlock> s_vTransientBlocks;
 
-    if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+static VmaAllocation AcquireTransientMemory(const RenderTarget* pTarget,
+                                            const VkMemoryRequirements& requirements,
+                                            const RenderTargetLifetime& lifetime, bool bLazy)
+{
+    for (TransientMemoryBlock& block : s_vTransientBlocks)
     {
-        aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        const bool bFits = block.m_uSize >= requirements.size &&
+                           (requirements.memoryTypeBits & (1u << block.m_uMemoryType));
+        if (bFits && std::none_of(block.m_vTargets.begin(), block.m_vTargets.end(),
+                                  [&](const auto& target) { return target.second.Overlaps(lifetime); }))
+        {
+            block.m_vTargets.emplace_back(pTarget, lifetime);
+            return block.m_allocation;
+        }
     }
-    if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+
+    TransientMemoryBlock block;
+    if (!bLazy || !GetMemoryAllocator()->AllocateMemory(requirements, VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED,
+                                                        block.m_allocation))
     {
-        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        const bool bAllocated =
+            GetMemoryAllocator()->AllocateMemory(requirements, VMA_MEMORY_USAGE_GPU_ONLY, block.m_allocation);
+        assert(bAllocated && "Failed to allocate render target memory");
+        (void)bAllocated;
     }
+    block.m_uSize = requirements.size;
+    block.m_uMemoryType = GetMemoryAllocator()->GetMemoryType(block.m_allocation);
+    block.m_vTargets.emplace_back(pTarget, lifetime);
+    s_vTransientBlocks.push_back(std::move(block));
+    return s_vTransientBlocks.back().m_allocation;
+}
 
-    assert(aspectMask > 0);
+static void ReleaseTransientMemory(const RenderTarget* pTarget)
+{
+    for (auto it = s_vTransientBlocks.begin(); it != s_vTransientBlocks.end(); ++it)
+    {
+        auto& vTargets = it->m_vTargets;
+        auto target = std::find_if(vTargets.begin(), vTargets.end(),
+                                   [pTarget](const auto& target) { return target.first == pTarget; });
+        if (target == vTargets.end())
+        {
+            continue;
+        }
+        vTargets.erase(target);
+        if (vTargets.empty())
+        {
+            GetMemoryAllocator()->FreeMemory(it->m_allocation);
+            s_vTransientBlocks.erase(it);
+        }
+        return;
+    }
+    assert(false && "Render target has no transient memory");
+}
+
+RenderTarget::RenderTarget(VkFormat format, VkImageUsageFlags usage,
+                           uint32_t width, uint32_t height, uint32_t numMips, uint32_t numLayers)
+{
+    initializeImageInfo(format, usage | VK_IMAGE_USAGE_SAMPLED_BIT, width, height, numMips, numLayers);
+    CreateImageInternal(VMA_MEMORY_USAGE_GPU_ONLY);
+    assert(m_image != VK_NULL_HANDLE && "Failed to allocate image");
+    createView(usage, numMips, numLayers);
+
+    Texture::sTransitionImageLayout(m_image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                    (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+                                        ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                        : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+RenderTarget::RenderTarget(VkFormat format, VkImageUsageFlags usage, uint32_t width,
+                           uint32_t height, uint32_t numMips, uint32_t numLayers,
+                           const RenderTargetLifetime& lifetime, bool bLazy)
+    : m_bTransient(true)
+{
+    // Content doesn't survive the memory being reused, so no initial layout
+    // transition, render passes start from undefined
+    initializeImageInfo(format,
+                        bLazy ? usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : usage | VK_IMAGE_USAGE_SAMPLED_BIT,
+                        width, height, numMips, numLayers);
+    VkDevice device = GetRenderDevice()->GetDevice();
+    VkResult result = vkCreateImage(device, &m_imageInfo, nullptr, &m_image);
+    assert(result == VK_SUCCESS);
+    (void)result;
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(device, m_image, &requirements);
+    m_allocation = AcquireTransientMemory(this, requirements, lifetime, bLazy);
+    GetMemoryAllocator()->BindImageMemory(m_allocation, m_image);
+    createView(usage, numMips, numLayers);
+}
+
+RenderTarget::~RenderTarget()
+{
+    if (m_bTransient)
+    {
+        // The memory block goes with its last target
+        GetDescriptorSetCache()->Release(reinterpret_cast<uint64_t>(m_view));
+        vkDestroyImageView(GetRenderDevice()->GetDevice(), m_view, nullptr);
+        vkDestroyImage(GetRenderDevice()->GetDevice(), m_image, nullptr);
+        ReleaseTransientMemory(this);
+        m_view = VK_NULL_HANDLE;
+        m_image = VK_NULL_HANDLE;
+        m_allocation = VK_NULL_HANDLE;
+    }
+}
+
+void RenderTarget::initializeImageInfo(VkFormat format, VkImageUsageFlags usage, uint32_t width,
+                                       uint32_t height, uint32_t numMips, uint32_t numLayers)
+{
     m_imageInfo.imageType = VK_IMAGE_TYPE_2D;
     m_imageInfo.extent.width = width;
     m_imageInfo.extent.height = height;
@@ -34,15 +137,26 @@ RenderTarget::RenderTarget(VkFormat format, VkImageUsageFlags usage,
     m_imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     m_imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     m_imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    m_imageInfo.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+    m_imageInfo.usage = usage;
     m_imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     if (numLayers > 1)
     {
         m_imageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
     }
+}
 
-    CreateImageInternal(VMA_MEMORY_USAGE_GPU_ONLY);
-    assert(m_image != VK_NULL_HANDLE && "Failed to allocate image");
+void RenderTarget::createView(VkImageUsageFlags usage, uint32_t numMips, uint32_t numLayers)
+{
+    VkImageAspectFlags aspectMask = 0;
+    if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+    {
+        aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+    if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+    {
+        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    }
+    assert(aspectMask > 0);
 
     // Create Image View
     m_imageViewInfo.viewType = numLayers == 1 ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_CUBE;
@@ -58,7 +172,4 @@ RenderTarget::RenderTarget(VkFormat format, VkImageUsageFlags usage,
     m_imageViewInfo.subresourceRange.baseArrayLayer = 0;
     m_imageViewInfo.subresourceRange.layerCount = numLayers;
     CreateImageViewInternal();
-
-    Texture::sTransitionImageLayout(m_image, VK_IMAGE_LAYOUT_UNDEFINED,
-                                    imageLayout);
 }
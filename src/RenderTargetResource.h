@@ -1,9 +1,37 @@
 #pragma once
 #include "RenderResource.h"
 
+// First and last pass of a frame using a transient render target, in
+// RenderPassNames order
+struct RenderTargetLifetime
+{
+    uint32_t m_uFirstPass = 0;
+    uint32_t m_uLastPass = 0;
+
+    bool Overlaps(const RenderTargetLifetime& other) const
+    {
+        return m_uFirstPass <= other.m_uLastPass && other.m_uFirstPass <= m_uLastPass;
+    }
+};
+
 class RenderTarget : public ImageResource
 {
 public:
     RenderTarget(VkFormat format, VkImageUsageFlags usage, uint32_t width,
                  uint32_t height, uint32_t numMips, uint32_t numLayers);
+    // Transient targets share memory with the ones of disjoint lifetimes
+    // and start each render pass with undefined content. Lazy targets never
+    // leave their render pass, they go to lazily allocated memory when the
+    // device has it and can't be sampled.
+    RenderTarget(VkFormat format, VkImageUsageFlags usage, uint32_t width,
+                 uint32_t height, uint32_t numMips, uint32_t numLayers,
+                 const RenderTargetLifetime& lifetime, bool bLazy);
+    ~RenderTarget() override;
+
+private:
+    void initializeImageInfo(VkFormat format, VkImageUsageFlags usage, uint32_t width,
+                             uint32_t height, uint32_t numMips, uint32_t numLayers);
+    void createView(VkImageUsageFlags usage, uint32_t numMips, uint32_t numLayers);
+
+    bool m_bTransient = false;
 };
@@ -1,4 +1,5 @@
 #include "SamplerManager.h"
+#include "Hash.h"
 
 static SamplerManager s_samplerManager;
 
@@ -7,3 +8,64 @@ SamplerManager* GetSamplerManager()
     return &s_samplerManager;
 }
 
+size_t SamplerManager::SamplerKeyHash::operator()(const VkSamplerCreateInfo& info) const
+{
+    // Field by field, the struct has padding
+    uint64_t uHash = HashValue(info.flags);
+    uHash = HashValue(info.magFilter, uHash);
+    uHash = HashValue(info.minFilter, uHash);
+    uHash = HashValue(info.mipmapMode, uHash);
+    uHash = HashValue(info.addressModeU, uHash);
+    uHash = HashValue(info.addressModeV, uHash);
+    uHash = HashValue(info.addressModeW, uHash);
+    uHash = HashValue(info.mipLodBias, uHash);
+    uHash = HashValue(info.anisotropyEnable, uHash);
+    uHash = HashValue(info.maxAnisotropy, uHash);
+    uHash = HashValue(info.compareEnable, uHash);
+    uHash = HashValue(info.compareOp, uHash);
+    uHash = HashValue(info.minLod, uHash);
+    uHash = HashValue(info.maxLod, uHash);
+    uHash = HashValue(info.borderColor, uHash);
+    uHash = HashValue(info.unnormalizedCoordinates, uHash);
+    return static_cast<size_t>(uHash);
+}
+
+bool SamplerManager::SamplerKeyEqual::operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const
+{
+    return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter &&
+           a.mipmapMode == b.mipmapMode && a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV &&
+           a.addressModeW == b.addressModeW && a.mipLodBias == b.mipLodBias &&
+           a.anisotropyEnable == b.anisotropyEnable && a.maxAnisotropy == b.maxAnisotropy &&
+           a.compareEnable == b.compareEnable && a.compareOp == b.compareOp && a.minLod == b.minLod &&
+           a.maxLod == b.maxLod && a.borderColor == b.borderColor &&
+           a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+VkSampler SamplerManager::GetSampler(const VkSamplerCreateInfo& samplerInfo)
+{
+    assert(samplerInfo.pNext == nullptr);
+    VkSamplerCreateInfo key = samplerInfo;
+    // Fall back to plain filtering on devices without anisotropy
+    if (m_fMaxAnisotropy <= 1.0f || key.anisotropyEnable == VK_FALSE)
+    {
+        key.anisotropyEnable = VK_FALSE;
+        key.maxAnisotropy = 1.0f;
+    }
+    else
+    {
+        key.maxAnisotropy = std::min(key.maxAnisotropy, m_fMaxAnisotropy);
+    }
+
+    auto it = m_mSamplers.find(key);
+    if (it != m_mSamplers.end())
+    {
+        return it->second;
+    }
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkResult result = vkCreateSampler(GetRenderDevice()->GetDevice(), &key, nullptr, &sampler);
+    assert(result == VK_SUCCESS);
+    (void)result;
+    setDebugUtilsObjectName(reinterpret_cast<uint64_t>(sampler), VK_OBJECT_TYPE_SAMPLER, "Shared Sampler");
+    m_mSamplers[key] = sampler;
+    return sampler;
+}
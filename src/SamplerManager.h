@@ -2,9 +2,11 @@
 #include "VkRenderDevice.h"
 #include "Debug.h"
 #include <vulkan/vulkan.h>
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <unordered_map>
 enum SamplerTypes
 {
     SAMPLER_1_MIPS,
@@ -15,6 +17,8 @@ enum SamplerTypes
     SAMPLER_32_MIPS,
     SAMPLER_TYPE_COUNT
 };
+// Samplers are deduplicated by their create info, handles are shared and
+// live until destroySamplers()
 class SamplerManager
 {
 public:
@@ -27,7 +31,41 @@ public:
     }
     void createSamplers()
     {
-        // Frame sampler
+        VkPhysicalDeviceFeatures features = {};
+        vkGetPhysicalDeviceFeatures(GetRenderDevice()->GetPhysicalDevice(), &features);
+        VkPhysicalDeviceProperties properties = {};
+        vkGetPhysicalDeviceProperties(GetRenderDevice()->GetPhysicalDevice(), &properties);
+        m_fMaxAnisotropy = features.samplerAnisotropy == VK_TRUE
+                               ? std::min(MAX_ANISOTROPY, properties.limits.maxSamplerAnisotropy)
+                               : 1.0f;
+
+        // full screen texture sampler
+        for (int i = 0; i<SAMPLER_TYPE_COUNT; i++)
+        {
+            m_aSamplers[i] = GetSampler(GetDefaultSamplerInfo((float)std::pow(2, i)));
+        }
+    }
+    void destroySamplers()
+    {
+        for (auto& it : m_mSamplers)
+        {
+            vkDestroySampler(GetRenderDevice()->GetDevice(), it.second, nullptr);
+        }
+        m_mSamplers.clear();
+        for (auto& sampler : m_aSamplers)
+        {
+            sampler = VK_NULL_HANDLE;
+        }
+    }
+    VkSampler getSampler(SamplerTypes type)
+    {
+        assert(m_aSamplers[type] != VK_NULL_HANDLE);
+        return m_aSamplers[type];
+    }
+
+    // Linear, repeating, anisotropic when supported
+    VkSamplerCreateInfo GetDefaultSamplerInfo(float fMaxLod) const
+    {
         VkSamplerCreateInfo samplerInfo = {};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -39,8 +77,8 @@ public:
         samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 
         // Anistropic filter
-        samplerInfo.anisotropyEnable = VK_FALSE;
-        samplerInfo.maxAnisotropy = 1;
+        samplerInfo.anisotropyEnable = m_fMaxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+        samplerInfo.maxAnisotropy = m_fMaxAnisotropy;
 
         samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
         // Choose of [0, width] or [0, 1]
@@ -54,32 +92,29 @@ public:
         samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         samplerInfo.mipLodBias = 0.0f;
         samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 1.0f;
-
-        // full screen texture sampler
-        for (int i = 0; i<SAMPLER_TYPE_COUNT; i++)
-        {
-            samplerInfo.maxLod = std::pow(2, i);
-            assert(vkCreateSampler(GetRenderDevice()->GetDevice(), &samplerInfo,
-                                   nullptr, &m_aSamplers[i]) == VK_SUCCESS);
-            setDebugUtilsObjectName(reinterpret_cast<uint64_t>(m_aSamplers[i]),
-                                    VK_OBJECT_TYPE_SAMPLER, "Frame Sampler");
-        }
+        samplerInfo.maxLod = fMaxLod;
+        return samplerInfo;
     }
-    void destroySamplers()
+
+    // Shared sampler matching the create info, created on first request.
+    // Chained create infos are not supported.
+    VkSampler GetSampler(const VkSamplerCreateInfo& samplerInfo);
+
+private:
+    static constexpr float MAX_ANISOTROPY = 16.0f;
+
+    struct SamplerKeyHash
     {
-        for (auto& sampler : m_aSamplers)
-        {
-            vkDestroySampler(GetRenderDevice()->GetDevice(), sampler, nullptr);
-        }
-    }
-    VkSampler getSampler(SamplerTypes type)
+        size_t operator()(const VkSamplerCreateInfo& info) const;
+    };
+    struct SamplerKeyEqual
     {
-        assert(m_aSamplers[type] != VK_NULL_HANDLE);
-        return m_aSamplers[type];
-    }
-private:
+        bool operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const;
+    };
+
+    std::unordered_map<VkSamplerCreateInfo, VkSampler, SamplerKeyHash, SamplerKeyEqual> m_mSamplers;
     std::array<VkSampler, SAMPLER_TYPE_COUNT> m_aSamplers;
+    float m_fMaxAnisotropy = 1.0f;
 };
 
 SamplerManager* GetSamplerManager();
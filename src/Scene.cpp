@@ -5,12 +5,67 @@
 #include <functional>
 
 #include "Geometry.h"
+#include "RenderResourceManager.h"
 
 void SceneNode::AppendChild(SceneNode *node)
 {
     m_vpChildren.emplace_back(node);
 }
 
+SceneNode *SceneNode::CloneNode() const
+{
+    SceneNode *pNode = new SceneNode;
+    CopyNodeProperties(*pNode);
+    return pNode;
+}
+
+SceneNode *SceneNode::Clone(std::unordered_map<const SceneNode *, SceneNode *> &mClones) const
+{
+    SceneNode *pNode = CloneNode();
+    mClones[this] = pNode;
+    for (const auto &pChild : m_vpChildren)
+    {
+        pNode->AppendChild(pChild->Clone(mClones));
+    }
+    return pNode;
+}
+
+SceneNode *GeometrySceneNode::CloneNode() const
+{
+    GeometrySceneNode *pNode = new GeometrySceneNode;
+    CopyNodeProperties(*pNode);
+    pNode->m_pGeometry = m_pGeometry;
+    return pNode;
+}
+
+void GeometrySceneNode::SetWorldMatrix(const glm::mat4 &mObjectToWorld)
+{
+    // Uploaded to the frame uniforms when the draw lists are recorded
+    m_mWorldMatrix = mObjectToWorld;
+}
+
+Scene Scene::Instantiate(const std::string &sName, const glm::mat4 &mRootTransformation) const
+{
+    Scene instance(sName);
+    std::unordered_map<const SceneNode *, SceneNode *> mClones;
+    instance.m_pRoot.reset(m_pRoot->Clone(mClones));
+    instance.m_pRoot->SetMatrix(mRootTransformation);
+
+    instance.m_staticBatchStats = m_staticBatchStats;
+    instance.m_fHLODSwapDistance = m_fHLODSwapDistance;
+    for (const HLODCluster &cluster : m_vHLODClusters)
+    {
+        HLODCluster clusterInstance = cluster;
+        clusterInstance.m_pProxy = static_cast<GeometrySceneNode *>(mClones.at(cluster.m_pProxy));
+        for (GeometrySceneNode *&pMember : clusterInstance.m_vpMembers)
+        {
+            pMember = static_cast<GeometrySceneNode *>(mClones.at(pMember));
+        }
+        instance.m_vHLODClusters.push_back(clusterInstance);
+    }
+    return instance;
+}
+
 std::string Scene::ConstructDebugString() const
 {
     std::stringstream ss;
@@ -30,39 +85,72 @@ std::string Scene::ConstructDebugString() const
     return ss.str();
 }
 
-const DrawLists &Scene::GatherDrawLists()
+const Scene::CachedDrawLists &Scene::GatherDrawLists()
 {
     if (m_bAreDrawListsDirty)
     {
-        for (auto& dl : m_drawLists.m_aDrawLists)
+        for (auto& dl : m_aDrawLists)
         {
             dl.clear();
         }
-        std::function<void(const std::unique_ptr<SceneNode> &, const glm::mat4 &, DrawLists&)>
+        std::function<void(const std::unique_ptr<SceneNode> &, const glm::mat4 &, CachedDrawLists&)>
             FlattenTreeRecursive = [&](const std::unique_ptr<SceneNode> &pNode,
-                                       const glm::mat4 &mCurrentTrans, DrawLists& drawLists) {
+                                       const glm::mat4 &mCurrentTrans, CachedDrawLists& drawLists) {
                 glm::mat4 mWorldMatrix = mCurrentTrans * pNode->GetMatrix();
                 assert(IsMat4Valid(mWorldMatrix));
-                if (GeometrySceneNode *pGeometryNode = dynamic_cast<GeometrySceneNode *>(pNode.get()))
+                GeometrySceneNode *pGeometryNode = dynamic_cast<GeometrySceneNode *>(pNode.get());
+                // Batched nodes are drawn through their static batch, hidden
+                // ones are swapped out by an HLOD proxy
+                if (pGeometryNode && !pGeometryNode->IsBatched() && !pGeometryNode->IsHidden())
                 {
                     if (pGeometryNode->IsTransparent())
                     {
-                        drawLists.m_aDrawLists[DrawLists::DL_TRANSPARENT].push_back(pNode.get());
+                        drawLists[DrawLists::DL_TRANSPARENT].push_back(pNode.get());
                     }
                     else
                     {
-                        drawLists.m_aDrawLists[DrawLists::DL_OPAQUE].push_back(pNode.get());
+                        drawLists[DrawLists::DL_OPAQUE].push_back(pNode.get());
                     }
-                    Geometry *pGeometry = pGeometryNode->GetGeometry();
-                    pGeometry->SetWorldMatrix(mWorldMatrix);
+                    pGeometryNode->SetWorldMatrix(mWorldMatrix);
                 }
                 for (const auto &pChild : pNode->GetChildren())
                 {
                     FlattenTreeRecursive(pChild, mWorldMatrix, drawLists);
                 }
             };
-        FlattenTreeRecursive(m_pRoot, m_pRoot->GetMatrix(), m_drawLists);
+        FlattenTreeRecursive(m_pRoot, glm::mat4(1.0), m_aDrawLists);
         m_bAreDrawListsDirty = false;
     }
-    return m_drawLists;
+    return m_aDrawLists;
+}
+
+bool Scene::UpdateHLOD(const glm::vec3 &vEye)
+{
+    // Swap back a bit closer than the swap distance so clusters sitting right
+    // at the threshold don't flip every frame
+    const float fSwapBackDistance = m_fHLODSwapDistance * 0.9f;
+    bool bChanged = false;
+    for (HLODCluster &cluster : m_vHLODClusters)
+    {
+        // Cluster centers are relative to the root
+        glm::vec3 vCenter = glm::vec3(m_pRoot->GetMatrix() * glm::vec4(cluster.m_vCenter, 1.0f));
+        float fDistance = glm::length(vCenter - vEye);
+        bool bUseProxy = cluster.m_bIsProxyActive ? fDistance > fSwapBackDistance
+                                                  : fDistance > m_fHLODSwapDistance;
+        if (bUseProxy != cluster.m_bIsProxyActive)
+        {
+            cluster.m_bIsProxyActive = bUseProxy;
+            cluster.m_pProxy->SetHidden(!bUseProxy);
+            for (GeometrySceneNode *pMember : cluster.m_vpMembers)
+            {
+                pMember->SetHidden(bUseProxy);
+            }
+            bChanged = true;
+        }
+    }
+    if (bChanged)
+    {
+        m_bAreDrawListsDirty = true;
+    }
+    return bChanged;
 }
@@ -5,8 +5,17 @@
 #include <string>
 #include <sstream>
 #include <array>
+#include <unordered_map>
+
+#include "FrameArena.h"
 
 static const uint32_t TRANSPARENT_FLAG = 1;
+// Node never moves after load, can be merged by the static batcher
+static const uint32_t STATIC_FLAG = 1 << 1;
+// Node has been merged into a static batch and is no longer drawn itself
+static const uint32_t BATCHED_FLAG = 1 << 2;
+// Node is temporarily not drawn, e.g. swapped out by an HLOD proxy
+static const uint32_t HIDDEN_FLAG = 1 << 3;
 
 class SceneNode
 {
@@ -30,14 +39,27 @@ public:
     {
         return m_vpChildren;
     }
+    // Deep copy of the subtree. Geometries are shared with the source, every
+    // source node is mapped to its clone in mClones.
+    SceneNode* Clone(std::unordered_map<const SceneNode*, SceneNode*>& mClones) const;
 
 protected:
+    // Copy of this node without its children
+    virtual SceneNode* CloneNode() const;
+    void CopyNodeProperties(SceneNode& dst) const
+    {
+        dst.m_sName = m_sName;
+        dst.m_mTransformation = m_mTransformation;
+        dst.m_uFlag = m_uFlag;
+    }
+
     std::string m_sName;
     std::vector<std::unique_ptr<SceneNode>> m_vpChildren;
     glm::mat4 m_mTransformation = glm::mat4(1.0);
     uint32_t m_uFlag = 0;
 };
 
+// Draw lists gathered for a frame, they live in the frame arena
 struct DrawLists
 {
 public:
@@ -47,8 +69,27 @@ public:
         DL_OPAQUE,
         DL_COUNT
     };
-    std::array<std::vector<const SceneNode*>, DL_COUNT> m_aDrawLists;
+    std::array<FrameVector<const SceneNode*>, DL_COUNT> m_aDrawLists;
+};
+struct StaticBatchStats
+{
+    uint32_t m_uDrawsBefore = 0;
+    uint32_t m_uDrawsAfter = 0;
+    uint32_t m_uNumBatches = 0;
+    uint32_t m_uNumMergedPrimitives = 0;
+};
+
+class GeometrySceneNode;
+// A group of spatially close geometry nodes and the simplified proxy that
+// replaces them beyond the scene's HLOD swap distance
+struct HLODCluster
+{
+    GeometrySceneNode* m_pProxy = nullptr;
+    std::vector<GeometrySceneNode*> m_vpMembers;
+    glm::vec3 m_vCenter = glm::vec3(0.0f);
+    bool m_bIsProxyActive = false;
 };
+
 class Scene
 {
 public:
@@ -56,7 +97,9 @@ public:
     explicit Scene(const std::string& sName) : m_sName(sName) {}
     SceneNode* GetRoot() { return m_pRoot.get(); }
     const std::unique_ptr<SceneNode>& GetRoot() const { return m_pRoot; }
-    const DrawLists& GatherDrawLists();
+    using CachedDrawLists = std::array<std::vector<const SceneNode*>, DrawLists::DL_COUNT>;
+    // Lists are kept until the scene changes
+    const CachedDrawLists& GatherDrawLists();
     std::string ConstructDebugString() const;
 
     static bool IsMat4Valid(const glm::mat4 &mat)
@@ -76,12 +119,29 @@ public:
     }
     void SetName(const std::string& sName) { m_sName = sName; }
     const std::string& GetName() const { return m_sName; }
+    // New scene sharing all geometries and materials with this one, placed
+    // under mRootTransformation
+    Scene Instantiate(const std::string& sName, const glm::mat4& mRootTransformation) const;
+    void MarkDrawListsDirty() { m_bAreDrawListsDirty = true; }
+
+    void SetStaticBatchStats(const StaticBatchStats& stats) { m_staticBatchStats = stats; }
+    const StaticBatchStats& GetStaticBatchStats() const { return m_staticBatchStats; }
+
+    void AddHLODCluster(const HLODCluster& cluster) { m_vHLODClusters.push_back(cluster); }
+    const std::vector<HLODCluster>& GetHLODClusters() const { return m_vHLODClusters; }
+    void SetHLODSwapDistance(float fDistance) { m_fHLODSwapDistance = fDistance; }
+    // Swap clusters between proxy and members based on the eye position,
+    // returns true if the draw lists changed
+    bool UpdateHLOD(const glm::vec3& vEye);
 
 protected:
     std::unique_ptr<SceneNode> m_pRoot = std::make_unique<SceneNode>();
-    DrawLists m_drawLists;
+    CachedDrawLists m_aDrawLists;
     std::string m_sName;
     bool m_bAreDrawListsDirty = true;
+    StaticBatchStats m_staticBatchStats;
+    std::vector<HLODCluster> m_vHLODClusters;
+    float m_fHLODSwapDistance = 0.0f;
 };
 
 class Geometry;
@@ -90,6 +150,15 @@ class GeometrySceneNode : public SceneNode
 public:
     void SetTransparent() {m_uFlag |= TRANSPARENT_FLAG;}
     bool IsTransparent() const { return m_uFlag & TRANSPARENT_FLAG; }
+    void SetStatic() { m_uFlag |= STATIC_FLAG; }
+    bool IsStatic() const { return m_uFlag & STATIC_FLAG; }
+    void SetBatched() { m_uFlag |= BATCHED_FLAG; }
+    bool IsBatched() const { return m_uFlag & BATCHED_FLAG; }
+    void SetHidden(bool bHidden)
+    {
+        m_uFlag = bHidden ? (m_uFlag | HIDDEN_FLAG) : (m_uFlag & ~HIDDEN_FLAG);
+    }
+    bool IsHidden() const { return m_uFlag & HIDDEN_FLAG; }
     void SetGeometry(Geometry* pGeometry)
     {
         m_pGeometry = pGeometry;
@@ -103,7 +172,13 @@ public:
         return m_pGeometry;
     }
 
+    // World matrix lives on the node so several nodes can share a geometry
+    void SetWorldMatrix(const glm::mat4& mObjectToWorld);
+    const glm::mat4& GetWorldMatrix() const { return m_mWorldMatrix; }
+
 protected:
-    Geometry* m_pGeometry;
-};
+    SceneNode* CloneNode() const override;
 
+    Geometry* m_pGeometry = nullptr;
+    glm::mat4 m_mWorldMatrix = glm::mat4(1.0);
+};
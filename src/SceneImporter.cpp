@@ -6,12 +6,57 @@
 #include <functional>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
 #include <sstream> // std::stringstream
 
 #include "Geometry.h"
+#include "Hash.h"
+#include "KTX2.h"
 #include "Material.h"
 #include "SceneImporter.h"
 #include "RenderResourceManager.h"
+#include "TexturePacking.h"
+#include "VkRenderDevice.h"
+
+// Textures are loaded from their uri by Texture, skip decoding them here.
+// This also lets images tinygltf can't decode, like KTX2, through.
+static bool SkipImageData(tinygltf::Image *, const int, std::string *, std::string *, int, int,
+                          const unsigned char *, int, void *)
+{
+    return true;
+}
+
+// Image of a texture. KHR_texture_basisu sources need a transcoder, they are
+// only used when the texture has no fallback source.
+static int GetTextureSource(const tinygltf::Texture &texture)
+{
+    const auto it = texture.extensions.find("KHR_texture_basisu");
+    if (texture.source == -1 && it != texture.extensions.end() && it->second.Has("source"))
+    {
+        return it->second.Get("source").Get<int>();
+    }
+    return texture.source;
+}
+
+// Block compressed formats are optional, the source images are decoded to
+// RGBA instead when the device can't sample the cooked format
+static bool IsCookedTextureUsable(const std::filesystem::path &cookedPath)
+{
+    if (!std::filesystem::exists(cookedPath))
+    {
+        return false;
+    }
+    const VkFormat format = ReadKTX2Format(cookedPath.string());
+    return format != VK_FORMAT_UNDEFINED && GetRenderDevice()->IsFormatSampleable(format);
+}
+
+// Prefer a texture cooked next to the source image
+static std::string GetCookedTexturePath(const std::filesystem::path &imagePath)
+{
+    std::filesystem::path cookedPath = imagePath;
+    cookedPath.replace_extension(".ktx2");
+    return IsCookedTextureUsable(cookedPath) ? cookedPath.string() : imagePath.string();
+}
 
 std::vector<Scene> GLTFImporter::ImportScene(const std::string &sSceneFile)
 {
@@ -20,6 +65,7 @@ std::vector<Scene> GLTFImporter::ImportScene(const std::string &sSceneFile)
     if (std::filesystem::exists(sSceneFile))
     {
         tinygltf::TinyGLTF loader;
+        loader.SetImageLoader(SkipImageData, nullptr);
         tinygltf::Model model;
         std::string err, warn;
         bool ret =
@@ -135,7 +181,12 @@ void GLTFImporter::ConstructGeometryNode(GeometrySceneNode &geomNode,
                                          const tinygltf::Mesh &mesh,
                                          const tinygltf::Model &model)
 {
-    std::vector<std::unique_ptr<Primitive>> vPrimitives;
+    // Primitive data is kept on the CPU until the mesh hash tells whether a
+    // resident geometry can be reused
+    std::vector<std::vector<Vertex>> vvVertices;
+    std::vector<std::vector<Index>> vvIndices;
+    std::vector<Material*> vpMaterials;
+    uint64_t uGeometryHash = FNV1A_OFFSET_BASIS;
     bool bIsMeshTransparent =false;
     for (const auto &primitive : mesh.primitives)
     {
@@ -291,17 +342,32 @@ void GLTFImporter::ConstructGeometryNode(GeometrySceneNode &geomNode,
                 assert(false && "Unsupported type");
             }
         }
-        vPrimitives.emplace_back(
-            std::make_unique<Primitive>(vVertices, vIndices));
+        uGeometryHash = HashValue(Primitive::ComputeContentHash(vVertices, vIndices), uGeometryHash);
+        vvVertices.push_back(std::move(vVertices));
+        vvIndices.push_back(std::move(vIndices));
 
         //  =========Material
         const tinygltf::Material &gltfMaterial = model.materials[primitive.material];
-        auto materialIter = GetMaterialManager()->m_mMaterials.find(gltfMaterial.name);
+        // Primitives of the previous import still point at resident
+        // materials, they are reused and never replaced
+        auto materialIter = GetMaterialManager()->m_mMaterials.try_emplace(gltfMaterial.name);
         Material* pMaterial = nullptr;
-        if (materialIter == GetMaterialManager()->m_mMaterials.end())
+        bool bShouldLoadMaterial = false;
+        if (materialIter.second)
+        {
+            materialIter.first->second = std::make_unique<Material>();
+            pMaterial = materialIter.first->second.get();
+            bShouldLoadMaterial = true;
+        }
+        else
+        {
+            pMaterial = materialIter.first->second.get();
+            // Refresh resident materials once per import when re-importing
+            bShouldLoadMaterial = m_bRefreshResidentMaterials &&
+                                  m_sRefreshedMaterials.insert(gltfMaterial.name).second;
+        }
+        if (bShouldLoadMaterial)
         {
-            GetMaterialManager()->m_mMaterials[gltfMaterial.name] = std::make_unique<Material>();
-            pMaterial = GetMaterialManager()->m_mMaterials.at(gltfMaterial.name).get();
             const std::filesystem::path sceneDir = m_sceneFile.parent_path();
 
             // Load material textures
@@ -310,7 +376,8 @@ void GLTFImporter::ConstructGeometryNode(GeometrySceneNode &geomNode,
             std::fill(aUVIndices.begin(), aUVIndices.end(), 0);
 
             // Albedo
-            std::string sAlbedoTexPath = "assets/Materials/white5x5.png";
+            std::string sAlbedoImagePath = "assets/Materials/white5x5.png";
+            std::string sAlbedoTexPath = sAlbedoImagePath;
             std::string sAlbedoTexName = "defaultAlbedo";
             if (gltfMaterial.pbrMetallicRoughness.baseColorTexture.index != -1)
             {
@@ -319,25 +386,9 @@ void GLTFImporter::ConstructGeometryNode(GeometrySceneNode &geomNode,
                     model.textures[gltfMaterial.pbrMetallicRoughness
                                        .baseColorTexture.index];
 
-                sAlbedoTexPath =
-                    (sceneDir / model.images[albedoTexture.source].uri)
-                        .string();
-                sAlbedoTexName = model.images[albedoTexture.source].uri;
-            }
-
-            // Metalness
-            std::string sMetalnessTexPath = "assets/Materials/white5x5.png";
-            std::string sMetalnessTexName = "defaultMetalness";
-            if (gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index != -1)
-            {
-                aUVIndices[Material::TEX_METALNESS] = gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
-                const tinygltf::Texture &metalnessTextrue =
-                    model.textures[gltfMaterial.pbrMetallicRoughness
-                                       .metallicRoughnessTexture.index];
-                sMetalnessTexPath =
-                    (sceneDir / model.images[metalnessTextrue.source].uri).string();
-
-                sMetalnessTexName = model.images[metalnessTextrue.source].uri;
+                sAlbedoImagePath = (sceneDir / model.images[GetTextureSource(albedoTexture)].uri).string();
+                sAlbedoTexPath = GetCookedTexturePath(sAlbedoImagePath);
+                sAlbedoTexName = model.images[GetTextureSource(albedoTexture)].uri;
             }
 
             // Normal
@@ -349,39 +400,47 @@ void GLTFImporter::ConstructGeometryNode(GeometrySceneNode &geomNode,
                 const tinygltf::Texture &normalTexture =
                     model.textures[gltfMaterial.normalTexture.index];
                 sNormalTexPath =
-                    (sceneDir / model.images[normalTexture.source].uri)
-                        .string();
-                sNormalTexName = model.images[normalTexture.source].uri;
+                    GetCookedTexturePath(sceneDir / model.images[GetTextureSource(normalTexture)].uri);
+                sNormalTexName = model.images[GetTextureSource(normalTexture)].uri;
             }
 
-            // Roughness
-            std::string sRoughnessTexPath = "assets/Materials/white5x5.png";
-            std::string sRoughnessTexName = "defaultRoughness";
+            // Occlusion, roughness and metalness share one texture. Maps
+            // already packed in one image are used as is, others are packed
+            // at load unless the cooker packed them.
+            std::string sOcclusionImagePath, sMetallicRoughnessImagePath;
             if (gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index != -1)
             {
-                aUVIndices[Material::TEX_ROUGHNESS] = gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
-                const tinygltf::Texture &metalnessTextrue =
+                aUVIndices[Material::TEX_ORM] = gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
+                const tinygltf::Texture &metallicRoughnessTexture =
                     model.textures[gltfMaterial.pbrMetallicRoughness
                                        .metallicRoughnessTexture.index];
-                sRoughnessTexPath =
-                    (sceneDir / model.images[metalnessTextrue.source].uri)
-                        .string();
-                sRoughnessTexName = model.images[metalnessTextrue.source].uri;
+                sMetallicRoughnessImagePath =
+                    (sceneDir / model.images[GetTextureSource(metallicRoughnessTexture)].uri).string();
             }
-
-            // Occulution
-            std::string sOcclusionTexPath = "assets/Materials/white5x5.png";
-            std::string sOcclusionTexName = "defaultOcclusion";
             if (gltfMaterial.occlusionTexture.index != -1)
             {
-                aUVIndices[Material::TEX_AO] = gltfMaterial.occlusionTexture.texCoord;
-                const tinygltf::Texture &occlusionTexture =
-                    model.textures[gltfMaterial.occlusionTexture.index];
-                sOcclusionTexPath =
-                    (sceneDir / model.images[occlusionTexture.source].uri)
-                        .string();
-                sOcclusionTexName = model.images[occlusionTexture.source].uri;
-                //sOcclusionTexName = model.images[occlusionTexture.source].name;
+                // A single UV set per packed texture, occlusion on another
+                // set than metallic roughness is left out
+                if (!sMetallicRoughnessImagePath.empty() &&
+                    gltfMaterial.occlusionTexture.texCoord !=
+                        gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.texCoord)
+                {
+                    std::cerr << "Warning: " << gltfMaterial.name << ": occlusion uses UV set "
+                              << gltfMaterial.occlusionTexture.texCoord << ", metallic roughness "
+                              << aUVIndices[Material::TEX_ORM] << ", occlusion is ignored" << std::endl;
+                }
+                else
+                {
+                    aUVIndices[Material::TEX_ORM] = gltfMaterial.occlusionTexture.texCoord;
+                    const tinygltf::Texture &occlusionTexture =
+                        model.textures[gltfMaterial.occlusionTexture.index];
+                    sOcclusionImagePath = (sceneDir / model.images[GetTextureSource(occlusionTexture)].uri).string();
+                }
+            }
+            std::string sPackedORMPath;
+            if (!sOcclusionImagePath.empty() || !sMetallicRoughnessImagePath.empty())
+            {
+                sPackedORMPath = GetPackedORMPath(sOcclusionImagePath, sMetallicRoughnessImagePath);
             }
 
             // PBR factors
@@ -390,51 +449,115 @@ void GLTFImporter::ConstructGeometryNode(GeometrySceneNode &geomNode,
                     (float)gltfMaterial.pbrMetallicRoughness.baseColorFactor[2], (float)gltfMaterial.pbrMetallicRoughness.baseColorFactor[3], // Base Color
                 (float)gltfMaterial.pbrMetallicRoughness.metallicFactor,                                                                       // Metallic
                 (float)gltfMaterial.pbrMetallicRoughness.roughnessFactor,                                                                      // Roughness
-                aUVIndices[0], aUVIndices[1],                                                                                                  // UVs
-                aUVIndices[2], aUVIndices[3],
-                aUVIndices[4], 0.0f};
+                aUVIndices[0], aUVIndices[1], aUVIndices[2],                                                                                   // UVs
+                0.0f};
 
             pMaterial->loadTexture(Material::TEX_ALBEDO, sAlbedoTexPath, sAlbedoTexName);
+            pMaterial->SetAlbedoImagePath(sAlbedoImagePath);
             pMaterial->loadTexture(Material::TEX_NORMAL, sNormalTexPath, sNormalTexName);
-            pMaterial->loadTexture(Material::TEX_METALNESS, sMetalnessTexPath, sMetalnessTexName);
-            pMaterial->loadTexture(Material::TEX_ROUGHNESS, sRoughnessTexPath, sRoughnessTexName);
-            pMaterial->loadTexture(Material::TEX_AO, sOcclusionTexPath, sOcclusionTexName);
-            pMaterial->SetMaterialParameterFactors(pbrFactors, gltfMaterial.name);
+            if (sPackedORMPath.empty())
+            {
+                pMaterial->loadTexture(Material::TEX_ORM, "assets/Materials/white5x5.png", "defaultORM");
+            }
+            else if (sOcclusionImagePath == sMetallicRoughnessImagePath)
+            {
+                pMaterial->loadTexture(Material::TEX_ORM, GetCookedTexturePath(sMetallicRoughnessImagePath),
+                                       sMetallicRoughnessImagePath);
+            }
+            else if (IsCookedTextureUsable(sPackedORMPath))
+            {
+                pMaterial->loadTexture(Material::TEX_ORM, sPackedORMPath, sPackedORMPath);
+            }
+            else
+            {
+                pMaterial->loadORMTexture(sOcclusionImagePath, sMetallicRoughnessImagePath, sPackedORMPath);
+            }
+            pMaterial->SetMaterialParameterFactors(pbrFactors);
 
-            pMaterial->AllocateDescriptorSet();
-            assert(pMaterial->GetDescriptorSet() != VK_NULL_HANDLE);
             if (gltfMaterial.alphaMode != "OPAQUE")
             {
                 assert(gltfMaterial.alphaMode == "BLEND" && "Unsupported alpha mode");
                 pMaterial->SetTransparent();
             }
+            else
+            {
+                pMaterial->SetOpaque();
+            }
             if (gltfMaterial.doubleSided)
             {
             }
-        }
-        else
-        {
-            pMaterial = materialIter->second.get();
+
+            bool bHasChanged = pMaterial->UpdateContentHash();
+            if (pMaterial->GetMaterialIndex() == Material::INVALID_MATERIAL_INDEX)
+            {
+                pMaterial->AllocateMaterialIndex();
+            }
+            else if (bHasChanged)
+            {
+                pMaterial->UpdateMaterialData();
+                m_stats.m_uNumUpdatedMaterials++;
+            }
         }
 
-        vPrimitives.back()->SetMaterial(pMaterial);
+        vpMaterials.push_back(pMaterial);
+        uGeometryHash = HashValue(pMaterial, uGeometryHash);
         if (pMaterial->IsTransparent())
         {
             bIsMeshTransparent = true;
         }
     }
-    Geometry *pGeometry = new Geometry(vPrimitives);
-    // Setup world transformation uniform buffer object
-    // Use pointer address as string
-    std::stringstream ss;
-    ss << static_cast<void*>(pGeometry);
-    auto *worldMatBuffer = GetRenderResourceManager()->getUniformBuffer<glm::mat4>(ss.str());
-    pGeometry->SetWorldMatrixUniformBuffer(worldMatBuffer);
-    pGeometry->SetWorldMatrix(glm::mat4(1.0));
-    GetGeometryManager()->vpGeometries.emplace_back(pGeometry);
+    auto KeepsCpuData = [this](const std::vector<Vertex> &vVertices) {
+        return m_uCpuDataVertexLimit > 0 && vVertices.size() <= m_uCpuDataVertexLimit;
+    };
+    Geometry *pGeometry = nullptr;
+    auto geometryIter = m_mGeometryCache.find(uGeometryHash);
+    if (geometryIter != m_mGeometryCache.end())
+    {
+        pGeometry = geometryIter->second;
+        m_stats.m_uNumReusedGeometries++;
+        // Resident geometries dropped their copies after the last import,
+        // the content is the same so the parsed data can stand in
+        const PrimitiveList &vpPrimitives = pGeometry->getPrimitives();
+        for (size_t i = 0; i < vpPrimitives.size(); i++)
+        {
+            if (!vpPrimitives[i]->HasCpuData() && KeepsCpuData(vvVertices[i]))
+            {
+                vpPrimitives[i]->RetainCpuData(vvVertices[i], vvIndices[i]);
+            }
+        }
+    }
+    else
+    {
+        std::vector<std::unique_ptr<Primitive>> vPrimitives;
+        for (size_t i = 0; i < vvVertices.size(); i++)
+        {
+            vPrimitives.emplace_back(
+                std::make_unique<Primitive>(vvVertices[i], vvIndices[i], KeepsCpuData(vvVertices[i])));
+            vPrimitives.back()->SetMaterial(vpMaterials[i]);
+        }
+        pGeometry = new Geometry(vPrimitives);
+        pGeometry->SetContentHash(uGeometryHash);
+        GetGeometryManager()->vpGeometries.emplace_back(pGeometry);
+        m_mGeometryCache[uGeometryHash] = pGeometry;
+        m_stats.m_uNumUploadedGeometries++;
+    }
     geomNode.SetGeometry(pGeometry);
+    // Animations are not imported, every mesh node is static
+    geomNode.SetStatic();
     if (bIsMeshTransparent)
     {
         geomNode.SetTransparent();
     }
 }
+
+void GLTFImporter::SetResidentGeometries(const std::vector<Geometry *> &vpGeometries)
+{
+    for (Geometry *pGeometry : vpGeometries)
+    {
+        // Generated geometries (batches, proxies) carry no hash
+        if (pGeometry->GetContentHash() != 0)
+        {
+            m_mGeometryCache[pGeometry->GetContentHash()] = pGeometry;
+        }
+    }
+}
@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
 #include "Scene.h"
 
 namespace tinygltf
@@ -16,6 +18,14 @@ class GeometryManager;
 class SceneNode;
 class Scene;
 
+struct ImportStats
+{
+    uint32_t m_uNumReusedGeometries = 0;
+    uint32_t m_uNumUploadedGeometries = 0;
+    uint32_t m_uNumUpdatedMaterials = 0;
+    uint32_t m_uNumReloadedTextures = 0;
+};
+
 class ISceneImporter
 {
 public:
@@ -26,6 +36,15 @@ class GLTFImporter : public ISceneImporter
 {
 public:
     virtual std::vector<Scene> ImportScene(const std::string& sSceneFile) override;
+    // Meshes whose content hash matches a resident geometry reuse it instead
+    // of uploading again
+    void SetResidentGeometries(const std::vector<Geometry*>& vpGeometries);
+    // Reload factors and textures of materials that already exist
+    void SetRefreshResidentMaterials(bool bRefresh) { m_bRefreshResidentMaterials = bRefresh; }
+    // Primitives with at most this many vertices keep a CPU copy for load
+    // time passes, 0 keeps none
+    void SetCpuDataVertexLimit(uint32_t uLimit) { m_uCpuDataVertexLimit = uLimit; }
+    const ImportStats& GetStats() const { return m_stats; }
 
 private:
     void CopyGLTFNode(SceneNode& sceneNode, const tinygltf::Node& gltfNode);
@@ -34,5 +53,10 @@ private:
     void ConstructGeometryNode(GeometrySceneNode &geomNode, const tinygltf::Mesh &mesh, const tinygltf::Model &model);
 private:
     std::filesystem::path m_sceneFile;
+    std::unordered_map<uint64_t, Geometry*> m_mGeometryCache;
+    bool m_bRefreshResidentMaterials = false;
+    uint32_t m_uCpuDataVertexLimit = 0;
+    std::unordered_set<std::string> m_sRefreshedMaterials;
+    ImportStats m_stats;
 };
 
@@ -1,5 +1,13 @@
 #include "SceneManager.h"
+#include "HLODBuilder.h"
 #include "SceneImporter.h"
+#include "StaticBatcher.h"
+#include "Geometry.h"
+#include "Material.h"
+#include "VkRenderDevice.h"
+
+#include <cstdint>
+#include <unordered_set>
 static SceneManager s_sceneManager;
 
 SceneManager* GetSceneManager()
@@ -7,27 +15,183 @@ SceneManager* GetSceneManager()
     return &s_sceneManager;
 }
 
+static void CollectGeometryNodes(SceneNode* pNode, std::vector<GeometrySceneNode*>& vpGeometryNodes)
+{
+    if (GeometrySceneNode* pGeometryNode = dynamic_cast<GeometrySceneNode*>(pNode))
+    {
+        vpGeometryNodes.push_back(pGeometryNode);
+    }
+    for (const auto& pChild : pNode->GetChildren())
+    {
+        CollectGeometryNodes(pChild.get(), vpGeometryNodes);
+    }
+}
+
+std::vector<Scene> SceneManager::ImportScenes(const std::string& sPath, GLTFImporter& importer) const
+{
+    // HLOD clusters any static opaque node, batching only small ones
+    if (m_fHLODClusterSize > 0.0f)
+    {
+        importer.SetCpuDataVertexLimit(UINT32_MAX);
+    }
+    else if (m_fStaticBatchCellSize > 0.0f)
+    {
+        importer.SetCpuDataVertexLimit(StaticBatcher::DEFAULT_MAX_VERTEX_COUNT);
+    }
+    std::vector<Scene> scenes = importer.ImportScene(sPath);
+    for (auto& scene : scenes)
+    {
+        if (m_fStaticBatchCellSize > 0.0f)
+        {
+            StaticBatcher batcher(m_fStaticBatchCellSize);
+            scene.SetStaticBatchStats(batcher.Batch(scene));
+        }
+        if (m_fHLODClusterSize > 0.0f)
+        {
+            HLODBuilder builder(m_fHLODClusterSize, m_fHLODSwapDistance);
+            builder.Build(scene);
+        }
+
+        std::vector<GeometrySceneNode*> vpNodes;
+        CollectGeometryNodes(scene.GetRoot(), vpNodes);
+        for (GeometrySceneNode* pNode : vpNodes)
+        {
+            for (const auto& pPrimitive : pNode->GetGeometry()->getPrimitives())
+            {
+                pPrimitive->ReleaseCpuData();
+            }
+        }
+    }
+    return scenes;
+}
+
 void SceneManager::LoadSceneFromFile(const std::string& sPath)
 {
     GLTFImporter importer;
-    std::vector<Scene> scenes = importer.ImportScene(sPath);
+    std::vector<Scene> scenes = ImportScenes(sPath, importer);
     for (auto& scene : scenes)
     {
         assert(m_mScenes.find(scene.GetName()) == m_mScenes.end());
+        m_mSceneSources[scene.GetName()] = sPath;
         m_mScenes[scene.GetName()] = std::move(scene);
     }
 }
 
+ImportStats SceneManager::ReimportSceneFromFile(const std::string& sPath)
+{
+    // Resources get updated in place
+    VkResult result = vkDeviceWaitIdle(GetRenderDevice()->GetDevice());
+    assert(result == VK_SUCCESS);
+    (void)result;
+
+    std::vector<std::string> vOldSceneNames;
+    std::vector<GeometrySceneNode*> vpOldNodes;
+    for (const auto& sourcePair : m_mSceneSources)
+    {
+        if (sourcePair.second == sPath)
+        {
+            vOldSceneNames.push_back(sourcePair.first);
+            CollectGeometryNodes(m_mScenes.at(sourcePair.first).GetRoot(), vpOldNodes);
+        }
+    }
+    std::vector<Geometry*> vpResidentGeometries;
+    for (GeometrySceneNode* pNode : vpOldNodes)
+    {
+        vpResidentGeometries.push_back(pNode->GetGeometry());
+    }
+
+    GLTFImporter importer;
+    importer.SetResidentGeometries(vpResidentGeometries);
+    importer.SetRefreshResidentMaterials(true);
+    GetTextureManager()->BeginContentValidation();
+    std::vector<Scene> scenes = ImportScenes(sPath, importer);
+    ImportStats stats = importer.GetStats();
+    stats.m_uNumReloadedTextures = GetTextureManager()->EndContentValidation();
+
+    // Swap in the new scenes
+    for (const std::string& sName : vOldSceneNames)
+    {
+        m_mScenes.erase(sName);
+        m_mSceneSources.erase(sName);
+    }
+    for (auto& scene : scenes)
+    {
+        assert(m_mScenes.find(scene.GetName()) == m_mScenes.end());
+        m_mSceneSources[scene.GetName()] = sPath;
+        m_mScenes[scene.GetName()] = std::move(scene);
+    }
+
+    // Release old geometries nothing refers to anymore
+    std::unordered_set<const Geometry*> vpUnreferenced(vpResidentGeometries.begin(), vpResidentGeometries.end());
+    for (SceneMap* pSceneMap : {&m_mScenes, &m_mPrefabs})
+    {
+        for (auto& scenePair : *pSceneMap)
+        {
+            std::vector<GeometrySceneNode*> vpNodes;
+            CollectGeometryNodes(scenePair.second.GetRoot(), vpNodes);
+            for (GeometrySceneNode* pNode : vpNodes)
+            {
+                vpUnreferenced.erase(pNode->GetGeometry());
+            }
+        }
+    }
+    GetGeometryManager()->Remove(vpUnreferenced);
+    return stats;
+}
+
+void SceneManager::LoadPrefab(const std::string& sPath)
+{
+    GLTFImporter importer;
+    std::vector<Scene> scenes = ImportScenes(sPath, importer);
+    for (auto& scene : scenes)
+    {
+        assert(m_mPrefabs.find(scene.GetName()) == m_mPrefabs.end());
+        m_mPrefabs[scene.GetName()] = std::move(scene);
+    }
+}
+
+Scene& SceneManager::InstantiatePrefab(const std::string& sPrefabName, const std::string& sInstanceName,
+                                       const glm::mat4& mRootTransformation)
+{
+    assert(m_mScenes.find(sInstanceName) == m_mScenes.end());
+    const Scene& prefab = m_mPrefabs.at(sPrefabName);
+    m_mScenes[sInstanceName] = prefab.Instantiate(sInstanceName, mRootTransformation);
+    return m_mScenes.at(sInstanceName);
+}
+
+bool SceneManager::UpdateHLOD(const glm::vec3& vEye)
+{
+    bool bChanged = false;
+    for (auto& scenePair : m_mScenes)
+    {
+        bChanged |= scenePair.second.UpdateHLOD(vEye);
+    }
+    return bChanged;
+}
+
 DrawLists SceneManager::GatherDrawLists()
 {
+    // Sized up front, storage outgrown in the frame arena is not reused
+    std::array<size_t, DrawLists::DL_COUNT> aSizes = {};
+    for (auto& scenePair : m_mScenes)
+    {
+        const Scene::CachedDrawLists& sceneDLs = scenePair.second.GatherDrawLists();
+        for (size_t i = 0; i < sceneDLs.size(); i++)
+        {
+            aSizes[i] += sceneDLs[i].size();
+        }
+    }
     DrawLists dls;
+    for (size_t i = 0; i < aSizes.size(); i++)
+    {
+        dls.m_aDrawLists[i].reserve(aSizes[i]);
+    }
     for (auto& scenePair : m_mScenes)
     {
-        Scene& scene = scenePair.second;
-        const DrawLists& sceneDLs = scene.GatherDrawLists();
-        for (size_t i = 0; i < sceneDLs.m_aDrawLists.size(); i++)
+        const Scene::CachedDrawLists& sceneDLs = scenePair.second.GatherDrawLists();
+        for (size_t i = 0; i < sceneDLs.size(); i++)
         {
-            auto& sceneDL = sceneDLs.m_aDrawLists[i];
+            auto& sceneDL = sceneDLs[i];
             dls.m_aDrawLists[i].insert(dls.m_aDrawLists[i].end(), sceneDL.begin(), sceneDL.end());
         }
     }
@@ -1,7 +1,9 @@
 #pragma once
 #include "Scene.h"
+#include "SceneImporter.h"
 #include <unordered_map>
 #include <string>
+#include <vector>
 class SceneManager
 {
     using SceneMap = std::unordered_map<std::string, Scene>;
@@ -9,9 +11,41 @@ public:
     const Scene& GetScene(const std::string& sSceneName) const { return m_mScenes.at(sSceneName); }
     const SceneMap& GetAllScenes() const { return m_mScenes; }
     void LoadSceneFromFile(const std::string& sPath);
+    // Re-import scenes previously loaded from sPath. Geometries, materials and
+    // textures whose content hash is unchanged are kept resident, changed
+    // ones are swapped in place. Command buffers consuming the draw lists
+    // need re-recording afterwards.
+    ImportStats ReimportSceneFromFile(const std::string& sPath);
+    // Load the scenes of a file as prefabs, they are not drawn until
+    // instantiated
+    void LoadPrefab(const std::string& sPath);
+    // Add a scene sharing all GPU data with the prefab, only transforms are
+    // allocated per instance
+    Scene& InstantiatePrefab(const std::string& sPrefabName, const std::string& sInstanceName,
+                             const glm::mat4& mRootTransformation);
     DrawLists GatherDrawLists();
+    // Cell size in world units used to merge small static meshes at load,
+    // 0 disables static batching
+    void SetStaticBatchCellSize(float fCellSize) { m_fStaticBatchCellSize = fCellSize; }
+    float GetStaticBatchCellSize() const { return m_fStaticBatchCellSize; }
+    // Cluster size and swap distance of HLOD proxies built at load, a cluster
+    // size of 0 disables HLOD
+    void SetHLODSettings(float fClusterSize, float fSwapDistance)
+    {
+        m_fHLODClusterSize = fClusterSize;
+        m_fHLODSwapDistance = fSwapDistance;
+    }
+    // Returns true if any scene swapped HLOD proxies and needs re-recording
+    bool UpdateHLOD(const glm::vec3& vEye);
 private:
+    std::vector<Scene> ImportScenes(const std::string& sPath, GLTFImporter& importer) const;
     SceneMap m_mScenes;
+    // Source file of each scene in m_mScenes loaded from file
+    std::unordered_map<std::string, std::string> m_mSceneSources;
+    SceneMap m_mPrefabs;
+    float m_fStaticBatchCellSize = 0.0f;
+    float m_fHLODClusterSize = 0.0f;
+    float m_fHLODSwapDistance = 0.0f;
 };
 
 SceneManager* GetSceneManager();
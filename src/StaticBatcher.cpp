@@ -0,0 +1,181 @@
+#include "StaticBatcher.h"
+
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+#include "Geometry.h"
+#include "Material.h"
+
+namespace
+{
+struct BatchCandidate
+{
+    GeometrySceneNode* m_pNode = nullptr;
+    glm::mat4 m_mWorldMatrix = glm::mat4(1.0);
+};
+
+struct BatchEntry
+{
+    size_t m_nCandidateIdx = 0;
+    Primitive* m_pPrimitive = nullptr;
+};
+
+// Material first so all cells of one material end up adjacent
+using BatchKey = std::tuple<Material*, int, int, int>;
+}  // namespace
+
+StaticBatchStats StaticBatcher::Batch(Scene& scene) const
+{
+    StaticBatchStats stats;
+    assert(m_fCellSize > 0.0f);
+
+    // Collect static opaque geometry nodes, world matrices are relative to the
+    // root since batches are attached directly under it
+    std::vector<BatchCandidate> vCandidates;
+    std::function<void(SceneNode*, const glm::mat4&)> CollectRecursive =
+        [&](SceneNode* pNode, const glm::mat4& mParent) {
+            glm::mat4 mWorldMatrix = mParent * pNode->GetMatrix();
+            if (GeometrySceneNode* pGeometryNode = dynamic_cast<GeometrySceneNode*>(pNode))
+            {
+                stats.m_uDrawsBefore += (uint32_t)pGeometryNode->GetGeometry()->getPrimitives().size();
+                bool bIsCandidate = pGeometryNode->IsStatic() && !pGeometryNode->IsTransparent() &&
+                                    !pGeometryNode->IsBatched();
+                for (const auto& pPrimitive : pGeometryNode->GetGeometry()->getPrimitives())
+                {
+                    bIsCandidate &= pPrimitive->getVertexCount() <= m_uMaxVertexCount &&
+                                    pPrimitive->GetMaterial() != nullptr && pPrimitive->HasCpuData();
+                }
+                if (bIsCandidate)
+                {
+                    vCandidates.push_back({pGeometryNode, mWorldMatrix});
+                }
+            }
+            for (const auto& pChild : pNode->GetChildren())
+            {
+                CollectRecursive(pChild.get(), mWorldMatrix);
+            }
+        };
+    for (const auto& pChild : scene.GetRoot()->GetChildren())
+    {
+        CollectRecursive(pChild.get(), glm::mat4(1.0));
+    }
+
+    // Bucket each primitive by material and the cell of its world space center
+    std::map<BatchKey, std::vector<BatchEntry>> mBatches;
+    for (size_t i = 0; i < vCandidates.size(); i++)
+    {
+        const BatchCandidate& candidate = vCandidates[i];
+        for (const auto& pPrimitive : candidate.m_pNode->GetGeometry()->getPrimitives())
+        {
+            glm::vec3 vMin(std::numeric_limits<float>::max());
+            glm::vec3 vMax(std::numeric_limits<float>::lowest());
+            for (const Vertex& vertex : pPrimitive->GetVertices())
+            {
+                glm::vec3 vPos = glm::vec3(candidate.m_mWorldMatrix * glm::vec4(vertex.pos, 1.0f));
+                vMin = glm::min(vMin, vPos);
+                vMax = glm::max(vMax, vPos);
+            }
+            glm::ivec3 vCell = glm::ivec3(glm::floor((vMin + vMax) * 0.5f / m_fCellSize));
+            BatchKey key = {pPrimitive->GetMaterial(), vCell.x, vCell.y, vCell.z};
+            mBatches[key].push_back({i, pPrimitive.get()});
+        }
+    }
+
+    // A node can only stop drawing itself when all of its primitives end up in
+    // a batch with at least one other primitive, otherwise merging would not
+    // save a draw. Drop such nodes until nothing changes.
+    std::vector<bool> vIsRejected(vCandidates.size(), false);
+    bool bChanged = true;
+    while (bChanged)
+    {
+        bChanged = false;
+        for (auto& batch : mBatches)
+        {
+            size_t nLiveEntries = 0;
+            for (const BatchEntry& entry : batch.second)
+            {
+                nLiveEntries += vIsRejected[entry.m_nCandidateIdx] ? 0 : 1;
+            }
+            if (nLiveEntries == 1)
+            {
+                for (const BatchEntry& entry : batch.second)
+                {
+                    if (!vIsRejected[entry.m_nCandidateIdx])
+                    {
+                        vIsRejected[entry.m_nCandidateIdx] = true;
+                        bChanged = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Build a combined world space primitive per batch
+    for (const auto& batch : mBatches)
+    {
+        std::vector<Vertex> vVertices;
+        std::vector<Index> vIndices;
+        uint32_t uNumMerged = 0;
+        for (const BatchEntry& entry : batch.second)
+        {
+            if (vIsRejected[entry.m_nCandidateIdx])
+            {
+                continue;
+            }
+            const glm::mat4& mWorldMatrix = vCandidates[entry.m_nCandidateIdx].m_mWorldMatrix;
+            const glm::mat3 mNormalMatrix = glm::transpose(glm::inverse(glm::mat3(mWorldMatrix)));
+            const Index nBaseVertex = (Index)vVertices.size();
+            for (const Vertex& vertex : entry.m_pPrimitive->GetVertices())
+            {
+                Vertex worldVertex = vertex;
+                worldVertex.pos = glm::vec3(mWorldMatrix * glm::vec4(vertex.pos, 1.0f));
+                worldVertex.normal = glm::normalize(mNormalMatrix * vertex.normal);
+                vVertices.push_back(worldVertex);
+            }
+            for (Index index : entry.m_pPrimitive->GetIndices())
+            {
+                vIndices.push_back(nBaseVertex + index);
+            }
+            uNumMerged++;
+        }
+        if (uNumMerged == 0)
+        {
+            continue;
+        }
+        assert(uNumMerged > 1);
+
+        Material* pMaterial = std::get<0>(batch.first);
+        // HLOD may cluster the batch next, the copy goes with the others
+        auto pPrimitive = std::make_unique<Primitive>(vVertices, vIndices, true);
+        pPrimitive->SetMaterial(pMaterial);
+        Geometry* pGeometry = new Geometry(std::move(pPrimitive));
+        GetGeometryManager()->vpGeometries.emplace_back(pGeometry);
+
+        std::stringstream nodeName;
+        nodeName << "StaticBatch_" << stats.m_uNumBatches << "_(" << std::get<1>(batch.first) << ","
+                 << std::get<2>(batch.first) << "," << std::get<3>(batch.first) << ")";
+        GeometrySceneNode* pBatchNode = new GeometrySceneNode;
+        pBatchNode->SetName(nodeName.str());
+        pBatchNode->SetGeometry(pGeometry);
+        pBatchNode->SetStatic();
+        scene.GetRoot()->AppendChild(pBatchNode);
+
+        stats.m_uNumBatches++;
+        stats.m_uNumMergedPrimitives += uNumMerged;
+    }
+
+    for (size_t i = 0; i < vCandidates.size(); i++)
+    {
+        if (!vIsRejected[i])
+        {
+            vCandidates[i].m_pNode->SetBatched();
+        }
+    }
+    stats.m_uDrawsAfter = stats.m_uDrawsBefore - stats.m_uNumMergedPrimitives + stats.m_uNumBatches;
+    scene.MarkDrawListsDirty();
+    return stats;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+
+#include "Scene.h"
+
+// Merge small static opaque meshes sharing a material into combined,
+// world space vertex/index buffers. Batches never cross a spatial cell so
+// each batch stays compact enough to be culled on its own.
+class StaticBatcher
+{
+public:
+    // Primitives bigger than this already amortize their draw call
+    static constexpr uint32_t DEFAULT_MAX_VERTEX_COUNT = 4096;
+
+    explicit StaticBatcher(float fCellSize) : m_fCellSize(fCellSize) {}
+    void SetMaxVertexCount(uint32_t uMaxVertexCount) { m_uMaxVertexCount = uMaxVertexCount; }
+    StaticBatchStats Batch(Scene& scene) const;
+
+private:
+    float m_fCellSize = 0.0f;
+    uint32_t m_uMaxVertexCount = DEFAULT_MAX_VERTEX_COUNT;
+};
@@ -1,5 +1,19 @@
 #include "Texture.h"
 #include "../thirdparty/stb/stb_image.h"
+#include "Hash.h"
+#include "KTX2.h"
+#include "Material.h"
+#include "MipChain.h"
+#include "TexturePacking.h"
+#include "TextureResidency.h"
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
 
 static TextureManager s_textureManager;
 
@@ -12,56 +26,448 @@ Texture::Texture() : m_textureSampler(VK_NULL_HANDLE) {}
 
 Texture::~Texture()
 {
-    if (GetRenderDevice()->GetDevice() != VK_NULL_HANDLE)
+    if (m_uBindlessIndex != 0)
+    {
+        GetMaterialManager()->ReleaseTextureIndex(this);
+    }
+    if (m_uFeedbackId != 0)
+    {
+        GetTextureResidencyManager()->Unregister(this);
+    }
+    if (!m_bIsResident && m_image != VK_NULL_HANDLE)
     {
-        vkDestroySampler(GetRenderDevice()->GetDevice(), m_textureSampler, nullptr);
+        // Upload may still be in flight
+        GetTextureStreamer()->Flush();
     }
 }
 
-void Texture::LoadPixels(void *pixels, int width, int height)
+void Texture::LoadPixels(void *pixels, int width, int height, bool bStreamed)
 {
-    // Upload pixels to staging buffer
-    const size_t BUFFER_SIZE = width * height * 4;
-    VmaAllocation stagingAllocation;
-    VkBuffer stagingBuffer;
-    GetMemoryAllocator()->AllocateBuffer(
-        BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer, stagingAllocation, "Texture");
+    // Generated pixels have no source to read levels back from
+    m_sSourcePath.clear();
+    m_sOcclusionSourcePath.clear();
+    m_bIsPackedORM = false;
+    m_uContentHash = 0;
+    // Box filtered mip chain down to 1x1
+    std::vector<uint8_t> vMipChain;
+    std::vector<MipLevel> vMipLevels;
+    BuildMipChain(static_cast<const uint8_t *>(pixels), static_cast<uint32_t>(width),
+                  static_cast<uint32_t>(height), vMipChain, vMipLevels);
+    LoadLevels(VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(width), static_cast<uint32_t>(height), vMipChain,
+               vMipLevels, bStreamed);
+}
 
-    void *pMappedMemory = nullptr;
-    GetMemoryAllocator()->MapBuffer(stagingAllocation, &pMappedMemory);
-    memcpy(pMappedMemory, pixels, BUFFER_SIZE);
-    GetMemoryAllocator()->UnmapBuffer(stagingAllocation);
+void Texture::LoadLevels(VkFormat format, uint32_t uWidth, uint32_t uHeight, const std::vector<uint8_t> &vData,
+                         const std::vector<MipLevel> &vLevels, bool bStreamed)
+{
+    assert(!vLevels.empty() && vLevels[0].m_uWidth == uWidth && vLevels[0].m_uHeight == uHeight);
+    if (m_uFeedbackId != 0)
+    {
+        GetTextureResidencyManager()->Unregister(this);
+    }
+    // Large streamed textures start with their mip tail, finer levels follow
+    // on demand
+    uint32_t uBaseMip = 0;
+    if (bStreamed)
+    {
+        uBaseMip = GetTextureResidencyManager()->Register(this, format, vLevels);
+    }
+    LoadResidentLevels(format, vData, vLevels, uBaseMip, bStreamed);
+}
 
-    createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM,
+void Texture::LoadResidentLevels(VkFormat format, const std::vector<uint8_t> &vData,
+                                 const std::vector<MipLevel> &vLevels, uint32_t uBaseMip, bool bStreamed)
+{
+    assert(uBaseMip < vLevels.size());
+    const MipLevel &baseLevel = vLevels[uBaseMip];
+    // Copy source of the mip tail when dropped levels can't be read back
+    createImage(baseLevel.m_uWidth, baseLevel.m_uHeight, format,
                 VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                VMA_MEMORY_USAGE_GPU_ONLY);
-
-    // UNDEFINED -> DST_OPTIMAL
-    sTransitionImageLayout(m_image,
-                           VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    // Copy source to image
-    mCopyBufferToImage(stagingBuffer, m_image, static_cast<uint32_t>(width),
-                       static_cast<uint32_t>(height));
-
-    // DST_OPTIMAL -> SHADER_READ_ONLY
-    sTransitionImageLayout(m_image,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    GetMemoryAllocator()->FreeBuffer(stagingBuffer, stagingAllocation);
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY, static_cast<uint32_t>(vLevels.size()) - uBaseMip);
+    m_uBaseMip = uBaseMip;
     mInitImageView();
     mInitSampler();
+
+    // Level offsets relative to the first uploaded level
+    std::vector<MipLevel> vResidentLevels(vLevels.begin() + uBaseMip, vLevels.end());
+    for (MipLevel &level : vResidentLevels)
+    {
+        level.m_nOffset -= baseLevel.m_nOffset;
+    }
+
+    // Pixels are copied to staging right away, layout transitions and the
+    // copy run on the transfer queue
+    m_bIsResident = false;
+    GetTextureStreamer()->RequestUpload(this, vData.data() + baseLevel.m_nOffset, vData.size() - baseLevel.m_nOffset,
+                                        vResidentLevels);
+    if (!bStreamed)
+    {
+        GetTextureStreamer()->Flush();
+    }
+}
+
+void Texture::CopyResidentLevels(const Texture &source, uint32_t uBaseMip)
+{
+    assert(source.m_bIsResident && uBaseMip >= source.m_uBaseMip &&
+           uBaseMip < source.m_uBaseMip + source.GetMipCount());
+    const uint32_t uFirstLevel = uBaseMip - source.m_uBaseMip;
+    const uint32_t uNumLevels = source.GetMipCount() - uFirstLevel;
+    createImage(std::max(source.m_imageInfo.extent.width >> uFirstLevel, 1u),
+                std::max(source.m_imageInfo.extent.height >> uFirstLevel, 1u), source.GetFormat(),
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY, uNumLevels);
+    m_uBaseMip = uBaseMip;
+    mInitImageView();
+    mInitSampler();
+
+    std::vector<VkImageCopy> vRegions(uNumLevels);
+    for (uint32_t i = 0; i < uNumLevels; i++)
+    {
+        VkImageCopy &region = vRegions[i];
+        region = {};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, uFirstLevel + i, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+        region.extent = {std::max(m_imageInfo.extent.width >> i, 1u), std::max(m_imageInfo.extent.height >> i, 1u), 1};
+    }
+
+    std::array<VkImageMemoryBarrier, 2> aBarriers = {};
+    for (VkImageMemoryBarrier &barrier : aBarriers)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, uNumLevels, 0, 1};
+    }
+    VkImageMemoryBarrier &srcBarrier = aBarriers[0];
+    VkImageMemoryBarrier &dstBarrier = aBarriers[1];
+    srcBarrier.image = source.m_image;
+    srcBarrier.subresourceRange.baseMipLevel = uFirstLevel;
+    dstBarrier.image = m_image;
+    GetRenderDevice()->ExecuteImmediateCommand([&](VkCommandBuffer cmdBuf) {
+        // The source stays bound, frames submitted before keep sampling it
+        srcBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        srcBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        srcBarrier.srcAccessMask = 0;
+        srcBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        dstBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        dstBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        dstBarrier.srcAccessMask = 0;
+        dstBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(aBarriers.size()), aBarriers.data());
+        vkCmdCopyImage(cmdBuf, source.m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(vRegions.size()), vRegions.data());
+
+        srcBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        srcBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        srcBarrier.srcAccessMask = 0;
+        srcBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dstBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        dstBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        dstBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dstBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(aBarriers.size()), aBarriers.data());
+    });
+    m_bIsResident = true;
+}
+
+void Texture::SwapImage(Texture &other)
+{
+    std::swap(m_image, other.m_image);
+    std::swap(m_allocation, other.m_allocation);
+    std::swap(m_view, other.m_view);
+    std::swap(m_imageInfo, other.m_imageInfo);
+    std::swap(m_imageViewInfo, other.m_imageViewInfo);
+    std::swap(m_textureSampler, other.m_textureSampler);
+    std::swap(m_bIsResident, other.m_bIsResident);
+    std::swap(m_uBaseMip, other.m_uBaseMip);
+}
+
+VkImageView Texture::GetResidentView() const
+{
+    return m_bIsResident ? m_view : GetTextureStreamer()->GetPlaceholder()->getView();
+}
+
+uint32_t GetQualitySkippedMips(TextureQualityTiers tier, const std::vector<MipLevel> &vLevels)
+{
+    static const uint32_t MAX_SIZES[TEXTURE_QUALITY_TIER_COUNT] = {UINT32_MAX, 2048, 1024};
+    static const uint32_t DROPPED_MIPS[TEXTURE_QUALITY_TIER_COUNT] = {0, 0, 1};
+    const uint32_t uLastMip = static_cast<uint32_t>(vLevels.size()) - 1;
+    uint32_t uSkippedMips = std::min(DROPPED_MIPS[tier], uLastMip);
+    while (uSkippedMips < uLastMip &&
+           std::max(vLevels[uSkippedMips].m_uWidth, vLevels[uSkippedMips].m_uHeight) > MAX_SIZES[tier])
+    {
+        uSkippedMips++;
+    }
+    return uSkippedMips;
 }
 
-void Texture::LoadImage(const std::string path)
+uint32_t Texture::ApplyQualityTier(const std::vector<MipLevel> &vLevels)
 {
+    const size_t nTotalSize = vLevels.back().m_nOffset + vLevels.back().m_nSize;
+    for (size_t i = 0; i < TEXTURE_QUALITY_TIER_COUNT; i++)
+    {
+        const uint32_t uSkippedMips = GetQualitySkippedMips(static_cast<TextureQualityTiers>(i), vLevels);
+        m_aQualityTierSizes[i] = nTotalSize - vLevels[uSkippedMips].m_nOffset;
+    }
+    return GetQualitySkippedMips(GetTextureManager()->GetQualityTier(), vLevels);
+}
+
+void Texture::BuildCappedMipChain(const uint8_t *pPixels, uint32_t uWidth, uint32_t uHeight, bool bIsReload,
+                                  std::vector<uint8_t> &vData, std::vector<MipLevel> &vLevels)
+{
+    const uint32_t uSkippedMips =
+        bIsReload ? m_uSkippedMips : (m_uSkippedMips = ApplyQualityTier(GetMipLevels(uWidth, uHeight)));
+    if (uSkippedMips == 0)
+    {
+        BuildMipChain(pPixels, uWidth, uHeight, vData, vLevels);
+        return;
+    }
+    // Only the capped image is filtered
+    std::vector<uint8_t> vPixels;
+    Downsample(pPixels, uWidth, uHeight, uSkippedMips, vPixels);
+    BuildMipChain(vPixels.data(), std::max(uWidth >> uSkippedMips, 1u), std::max(uHeight >> uSkippedMips, 1u), vData,
+                  vLevels);
+}
+
+// Empty when the file can't be read, e.g. it was moved or deleted
+static std::vector<stbi_uc> ReadFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const std::streamoff nSize = file.is_open() ? static_cast<std::streamoff>(file.tellg()) : -1;
+    if (nSize < 0)
+    {
+        std::cerr << path << ": cannot be read" << std::endl;
+        return std::vector<stbi_uc>();
+    }
+    std::vector<stbi_uc> vBytes(static_cast<size_t>(nSize));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(vBytes.data()), vBytes.size());
+    return vBytes;
+}
+
+void Texture::LoadImage(const std::string path, bool bStreamed)
+{
+    // Read the file once for both hashing and decoding
+    std::vector<stbi_uc> vFileBytes = ReadFile(path);
+    m_aQualityTierSizes = {};
+    // Streamed levels are read back from the sources on demand
+    m_sSourcePath = path;
+    m_sOcclusionSourcePath.clear();
+    m_bIsPackedORM = false;
+    m_uContentHash = HashBytes(vFileBytes.data(), vFileBytes.size());
+
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    std::vector<uint8_t> vData;
+    std::vector<MipLevel> vLevels;
+    if (!DecodeImage(vFileBytes, false, format, vData, vLevels))
+    {
+        const uint8_t WHITE_PIXEL[4] = {255, 255, 255, 255};
+        format = VK_FORMAT_R8G8B8A8_UNORM;
+        BuildMipChain(WHITE_PIXEL, 1, 1, vData, vLevels);
+    }
+    LoadLevels(format, vLevels[0].m_uWidth, vLevels[0].m_uHeight, vData, vLevels, bStreamed);
+}
 
+bool Texture::DecodeImage(const std::vector<uint8_t> &vFileBytes, bool bIsReload, VkFormat &format,
+                          std::vector<uint8_t> &vData, std::vector<MipLevel> &vLevels)
+{
+    if (!IsKTX2File(vFileBytes.data(), vFileBytes.size()))
+    {
+        int width, height, channels;
+        stbi_uc *pixels =
+            stbi_load_from_memory(vFileBytes.data(), (int)vFileBytes.size(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr)
+        {
+            std::cerr << m_sSourcePath << ": " << stbi_failure_reason() << std::endl;
+            return false;
+        }
+        format = VK_FORMAT_R8G8B8A8_UNORM;
+        BuildCappedMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), bIsReload, vData,
+                            vLevels);
+        stbi_image_free(pixels);
+        return true;
+    }
+
+    KTX2Image image;
+    std::string sError;
+    bool bIsLoaded = ReadKTX2(vFileBytes.data(), vFileBytes.size(), image, sError);
+    if (bIsLoaded && !GetRenderDevice()->IsFormatSampleable(image.m_format))
+    {
+        sError = "Format " + std::to_string(image.m_format) + " can't be sampled on this device";
+        bIsLoaded = false;
+    }
+    if (!bIsLoaded)
+    {
+        std::cerr << m_sSourcePath << ": " << sError << std::endl;
+        return false;
+    }
+    // Cooked levels are dropped as they are
+    const uint32_t uSkippedMips = bIsReload ? m_uSkippedMips : (m_uSkippedMips = ApplyQualityTier(image.m_vLevels));
+    if (uSkippedMips > 0)
+    {
+        const size_t nBaseOffset = image.m_vLevels[uSkippedMips].m_nOffset;
+        image.m_vData.erase(image.m_vData.begin(), image.m_vData.begin() + nBaseOffset);
+        image.m_vLevels.erase(image.m_vLevels.begin(), image.m_vLevels.begin() + uSkippedMips);
+        for (MipLevel &level : image.m_vLevels)
+        {
+            level.m_nOffset -= nBaseOffset;
+        }
+    }
+    format = image.m_format;
+    vData = std::move(image.m_vData);
+    vLevels = std::move(image.m_vLevels);
+    return true;
+}
+
+static std::vector<stbi_uc> ReadPackingFile(const std::string &path)
+{
+    return path.empty() ? std::vector<stbi_uc>() : ReadFile(path);
+}
+
+// Returns the decoded pixels to free, maps stb cannot decode (like KTX2) are
+// packed as white
+static stbi_uc *DecodePackingSource(const std::vector<stbi_uc> &vFileBytes, const std::string &path,
+                                    PackingSource &source)
+{
+    if (vFileBytes.empty())
+    {
+        return nullptr;
+    }
     int width, height, channels;
     stbi_uc *pixels =
-        stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-    assert(pixels);
-    LoadPixels((void *)pixels, width, height);
+        stbi_load_from_memory(vFileBytes.data(), (int)vFileBytes.size(), &width, &height, &channels, STBI_rgb_alpha);
+    if (pixels == nullptr)
+    {
+        std::cerr << path << ": cannot be packed, " << stbi_failure_reason() << std::endl;
+        return nullptr;
+    }
+    source.m_pPixels = pixels;
+    source.m_uWidth = static_cast<uint32_t>(width);
+    source.m_uHeight = static_cast<uint32_t>(height);
+    return pixels;
+}
+
+static uint64_t HashPackingFiles(const std::vector<stbi_uc> &vOcclusionBytes,
+                                 const std::vector<stbi_uc> &vMetallicRoughnessBytes)
+{
+    const uint64_t uHash = HashBytes(vOcclusionBytes.data(), vOcclusionBytes.size());
+    return HashBytes(vMetallicRoughnessBytes.data(), vMetallicRoughnessBytes.size(), uHash);
+}
+
+void Texture::LoadORM(const std::string &sOcclusionPath, const std::string &sMetallicRoughnessPath, bool bStreamed)
+{
+    const std::vector<stbi_uc> vOcclusionBytes = ReadPackingFile(sOcclusionPath);
+    const std::vector<stbi_uc> vMetallicRoughnessBytes = ReadPackingFile(sMetallicRoughnessPath);
+    m_aQualityTierSizes = {};
+    m_sSourcePath = sMetallicRoughnessPath;
+    m_sOcclusionSourcePath = sOcclusionPath;
+    m_bIsPackedORM = true;
+    m_uContentHash = HashPackingFiles(vOcclusionBytes, vMetallicRoughnessBytes);
+
+    std::vector<uint8_t> vData;
+    std::vector<MipLevel> vLevels;
+    DecodeORM(vOcclusionBytes, vMetallicRoughnessBytes, false, vData, vLevels);
+    LoadLevels(VK_FORMAT_R8G8B8A8_UNORM, vLevels[0].m_uWidth, vLevels[0].m_uHeight, vData, vLevels, bStreamed);
+}
+
+void Texture::DecodeORM(const std::vector<uint8_t> &vOcclusionBytes, const std::vector<uint8_t> &vMetallicRoughnessBytes,
+                        bool bIsReload, std::vector<uint8_t> &vData, std::vector<MipLevel> &vLevels)
+{
+    PackingSource occlusion, metallicRoughness;
+    stbi_uc *pOcclusionPixels = DecodePackingSource(vOcclusionBytes, m_sOcclusionSourcePath, occlusion);
+    stbi_uc *pMetallicRoughnessPixels =
+        DecodePackingSource(vMetallicRoughnessBytes, m_sSourcePath, metallicRoughness);
+
+    std::vector<uint8_t> vPixels;
+    uint32_t uWidth = 0, uHeight = 0;
+    PackORM(occlusion, metallicRoughness, vPixels, uWidth, uHeight);
+    stbi_image_free(pOcclusionPixels);
+    stbi_image_free(pMetallicRoughnessPixels);
+    BuildCappedMipChain(vPixels.data(), uWidth, uHeight, bIsReload, vData, vLevels);
+}
+
+bool Texture::ReadSourceLevels(VkFormat &format, std::vector<uint8_t> &vData, std::vector<MipLevel> &vLevels)
+{
+    if (!HasSource())
+    {
+        return false;
+    }
+    // Changed sources wait for the content validation to reload them
+    if (m_bIsPackedORM)
+    {
+        const std::vector<stbi_uc> vOcclusionBytes = ReadPackingFile(m_sOcclusionSourcePath);
+        const std::vector<stbi_uc> vMetallicRoughnessBytes = ReadPackingFile(m_sSourcePath);
+        if ((vOcclusionBytes.empty() && !m_sOcclusionSourcePath.empty()) ||
+            (vMetallicRoughnessBytes.empty() && !m_sSourcePath.empty()))
+        {
+            return false;
+        }
+        if (HashPackingFiles(vOcclusionBytes, vMetallicRoughnessBytes) != m_uContentHash)
+        {
+            return false;
+        }
+        format = VK_FORMAT_R8G8B8A8_UNORM;
+        DecodeORM(vOcclusionBytes, vMetallicRoughnessBytes, true, vData, vLevels);
+        return true;
+    }
+    const std::vector<stbi_uc> vFileBytes = ReadFile(m_sSourcePath);
+    if (vFileBytes.empty() || HashBytes(vFileBytes.data(), vFileBytes.size()) != m_uContentHash)
+    {
+        return false;
+    }
+    return DecodeImage(vFileBytes, true, format, vData, vLevels);
+}
+
+bool Texture::ReloadIfChanged(const std::string &path)
+{
+    std::vector<stbi_uc> vFileBytes = ReadFile(path);
+    // Keep the current image while the source is unreadable
+    if (vFileBytes.empty())
+    {
+        return false;
+    }
+    if (path == m_sSourcePath && HashBytes(vFileBytes.data(), vFileBytes.size()) == m_uContentHash)
+    {
+        return false;
+    }
+    if (!m_bIsResident)
+    {
+        GetTextureStreamer()->Flush();
+    }
+    m_textureSampler = VK_NULL_HANDLE;
+    DestroyImageInternal();
+    LoadImage(path);
+    return true;
+}
+
+void Texture::ReloadPixels(void *pixels, int width, int height)
+{
+    if (!m_bIsResident)
+    {
+        GetTextureStreamer()->Flush();
+    }
+    m_textureSampler = VK_NULL_HANDLE;
+    DestroyImageInternal();
+    LoadPixels(pixels, width, height, true);
+}
+
+bool Texture::ReloadORMIfChanged(const std::string &sOcclusionPath, const std::string &sMetallicRoughnessPath)
+{
+    if (sOcclusionPath == m_sOcclusionSourcePath && sMetallicRoughnessPath == m_sSourcePath &&
+        HashPackingFiles(ReadPackingFile(sOcclusionPath), ReadPackingFile(sMetallicRoughnessPath)) == m_uContentHash)
+    {
+        return false;
+    }
+    if (!m_bIsResident)
+    {
+        GetTextureStreamer()->Flush();
+    }
+    m_textureSampler = VK_NULL_HANDLE;
+    DestroyImageInternal();
+    LoadORM(sOcclusionPath, sMetallicRoughnessPath);
+    return true;
 }
@@ -2,13 +2,29 @@
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
 #include "RenderResource.h"
+#include <array>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <cassert>
 #include "VkRenderDevice.h"
 #include "VkMemoryAllocator.h"
+#include "MipChain.h"
+#include "SamplerManager.h"
+
+// Global caps on the resolution of textures loaded from files, levels above
+// the cap are never uploaded
+enum TextureQualityTiers
+{
+    TEXTURE_QUALITY_HIGH,      // Full resolution
+    TEXTURE_QUALITY_MEDIUM,    // Up to 2048
+    TEXTURE_QUALITY_LOW,       // Top level dropped, up to 1024
+    TEXTURE_QUALITY_TIER_COUNT
+};
+// Levels of a full chain skipped under a tier
+uint32_t GetQualitySkippedMips(TextureQualityTiers tier, const std::vector<MipLevel>& vLevels);
 
 class Texture : public ImageResource
 {
@@ -16,15 +32,73 @@ public:
     Texture();
     ~Texture();
 
-    void LoadPixels(void *pixels, int width, int height);
+    // Streamed textures return right away and sample the streamer's
+    // placeholder until IsResident(), others wait for the upload
+    void LoadPixels(void *pixels, int width, int height, bool bStreamed = false);
 
-    void LoadImage(const std::string path);
+    // Loads KTX2 containers as is, other images through stb as RGBA8. Both
+    // are capped by the texture manager's quality tier.
+    void LoadImage(const std::string path, bool bStreamed = false);
+    // Pack occlusion, roughness and metalness maps into one RGBA8 texture,
+    // see PackORM(). Either path may be empty.
+    void LoadORM(const std::string& sOcclusionPath, const std::string& sMetallicRoughnessPath,
+                 bool bStreamed = false);
+    // Upload pre-built levels of any format supported by the streamer
+    void LoadLevels(VkFormat format, uint32_t uWidth, uint32_t uHeight, const std::vector<uint8_t>& vData,
+                    const std::vector<MipLevel>& vLevels, bool bStreamed = false);
+    // Create the image from levels [uBaseMip, end) of a packed chain only
+    void LoadResidentLevels(VkFormat format, const std::vector<uint8_t>& vData, const std::vector<MipLevel>& vLevels,
+                            uint32_t uBaseMip, bool bStreamed);
+    // Create the image from levels [uBaseMip, end) of another texture's
+    // resident image, copied on the graphics queue. Waits for the copy.
+    void CopyResidentLevels(const Texture& source, uint32_t uBaseMip);
+    // Take over the image of another texture, which gets this one's. The
+    // caller makes sure neither image is in use.
+    void SwapImage(Texture& other);
+
+    bool IsResident() const { return m_bIsResident; }
+    // Called by the streamer once the upload finished
+    void SetResident() { m_bIsResident = true; }
+    // View to bind in descriptor sets, the placeholder's until resident
+    VkImageView GetResidentView() const;
+    // Level of the full mip chain the image starts at, finer levels are not
+    // resident
+    uint32_t GetBaseMip() const { return m_uBaseMip; }
+    // Slot in the mip feedback buffer, 0 if residency is not feedback driven
+    uint32_t GetFeedbackId() const { return m_uFeedbackId; }
+    void SetFeedbackId(uint32_t uFeedbackId) { m_uFeedbackId = uFeedbackId; }
+    // Slot in the bindless material texture array, 0 if not bound
+    uint32_t GetBindlessIndex() const { return m_uBindlessIndex; }
+    void SetBindlessIndex(uint32_t uBindlessIndex) { m_uBindlessIndex = uBindlessIndex; }
+    // Path the pixels were loaded from, empty for generated textures
+    const std::string& GetSourcePath() const { return m_sSourcePath; }
+    // Loaded from files that levels can be read back from
+    bool HasSource() const { return m_bIsPackedORM || !m_sSourcePath.empty(); }
+    // Decode the sources again into the levels the texture was loaded with,
+    // false if they can't be read or changed since
+    bool ReadSourceLevels(VkFormat& format, std::vector<uint8_t>& vData, std::vector<MipLevel>& vLevels);
+    // Hash of the source file, 0 for generated textures
+    uint64_t GetContentHash() const { return m_uContentHash; }
+    // Reload the image in place if the file content changed since it was
+    // loaded and can be read, the caller makes sure the image is not in use
+    bool ReloadIfChanged(const std::string& path);
+    bool ReloadORMIfChanged(const std::string& sOcclusionPath, const std::string& sMetallicRoughnessPath);
+    // Replace the image of a generated texture, same requirements
+    void ReloadPixels(void* pixels, int width, int height);
 
     VkSampler getSamper() const { return m_textureSampler; }
+    uint32_t GetMipCount() const { return m_imageInfo.mipLevels; }
+    // Size of the loaded levels under every quality tier, 0 unless loaded
+    // from files
+    const std::array<VkDeviceSize, TEXTURE_QUALITY_TIER_COUNT>& GetQualityTierSizes() const
+    {
+        return m_aQualityTierSizes;
+    }
+    VkFormat GetFormat() const { return m_imageInfo.format; }
 
     void createImage(uint32_t width, uint32_t height, VkFormat format,
                      VkImageTiling tiling, VkImageUsageFlags usage,
-                     VmaMemoryUsage memoryUsage)
+                     VmaMemoryUsage memoryUsage, uint32_t mipLevels = 1)
     {
         // Create a vkimage
         m_imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -32,7 +106,7 @@ public:
         m_imageInfo.extent.width = width;
         m_imageInfo.extent.height = height;
         m_imageInfo.extent.depth = 1;
-        m_imageInfo.mipLevels = 1;
+        m_imageInfo.mipLevels = mipLevels;
         m_imageInfo.arrayLayers = 1;
         m_imageInfo.format = format;
         m_imageInfo.tiling = tiling;
@@ -131,35 +205,38 @@ public:
     }
 
 private:
-    void mCopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                            uint32_t height)
-    {
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
+    // Record the size under every tier, returns the levels to skip under the
+    // current one
+    uint32_t ApplyQualityTier(const std::vector<MipLevel>& vLevels);
+    // Downsample to the current tier before building the chain, reloads
+    // skip the levels skipped at load
+    void BuildCappedMipChain(const uint8_t* pPixels, uint32_t uWidth, uint32_t uHeight, bool bIsReload,
+                             std::vector<uint8_t>& vData, std::vector<MipLevel>& vLevels);
+    // KTX2 containers as is, other images as RGBA8. False if the file can't
+    // be decoded.
+    bool DecodeImage(const std::vector<uint8_t>& vFileBytes, bool bIsReload, VkFormat& format,
+                     std::vector<uint8_t>& vData, std::vector<MipLevel>& vLevels);
+    void DecodeORM(const std::vector<uint8_t>& vOcclusionBytes, const std::vector<uint8_t>& vMetallicRoughnessBytes,
+                   bool bIsReload, std::vector<uint8_t>& vData, std::vector<MipLevel>& vLevels);
 
-        GetRenderDevice()->ExecuteImmediateCommand(
-            [&](VkCommandBuffer commandBuffer) {
-                vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                                       &region);
-            });
-    }
     void mInitImageView()
     {
         m_imageViewInfo.image = m_image;
         m_imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        m_imageViewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        m_imageViewInfo.format = m_imageInfo.format;
+        // Single channel maps are read from any of rgb
+        if (m_imageInfo.format == VK_FORMAT_BC4_UNORM_BLOCK)
+        {
+            m_imageViewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R,
+                                          VK_COMPONENT_SWIZZLE_ONE};
+        }
+        else
+        {
+            m_imageViewInfo.components = {};
+        }
         m_imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         m_imageViewInfo.subresourceRange.baseMipLevel = 0;
-        m_imageViewInfo.subresourceRange.levelCount = 1;
+        m_imageViewInfo.subresourceRange.levelCount = m_imageInfo.mipLevels;
         m_imageViewInfo.subresourceRange.baseArrayLayer = 0;
         m_imageViewInfo.subresourceRange.layerCount = 1;
         CreateImageViewInternal();
@@ -167,39 +244,24 @@ private:
 
     void mInitSampler()
     {
-        VkSamplerCreateInfo samplerInfo = {};
-        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.magFilter = VK_FILTER_LINEAR;
-        samplerInfo.minFilter = VK_FILTER_LINEAR;
-
-        // Wrapping
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-        // Anistropic filter
-        samplerInfo.anisotropyEnable = VK_FALSE;
-        samplerInfo.maxAnisotropy = 1;
-
-        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-        // Choose of [0, width] or [0, 1]
-        samplerInfo.unnormalizedCoordinates = VK_FALSE;
-
-        // Used for percentage-closer filter for shadow
-        samplerInfo.compareEnable = VK_FALSE;
-        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-
-        // mipmaps
-        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerInfo.mipLodBias = 0.0f;
-        samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 0.0f;
-
-        assert(vkCreateSampler(GetRenderDevice()->GetDevice(), &samplerInfo,
-                               nullptr, &m_textureSampler) == VK_SUCCESS);
+        // Shared with every texture of the same mip count
+        m_textureSampler = GetSamplerManager()->GetSampler(
+            GetSamplerManager()->GetDefaultSamplerInfo(static_cast<float>(m_imageInfo.mipLevels)));
     }
 
     VkSampler m_textureSampler;
+    bool m_bIsResident = false;
+    uint32_t m_uBaseMip = 0;
+    uint32_t m_uFeedbackId = 0;
+    uint32_t m_uBindlessIndex = 0;
+    std::string m_sSourcePath;
+    // Second source of packed textures
+    std::string m_sOcclusionSourcePath;
+    bool m_bIsPackedORM = false;
+    // Levels dropped by the quality tier at load
+    uint32_t m_uSkippedMips = 0;
+    uint64_t m_uContentHash = 0;
+    std::array<VkDeviceSize, TEXTURE_QUALITY_TIER_COUNT> m_aQualityTierSizes = {};
 };
 
 class TextureManager
@@ -207,5 +269,65 @@ class TextureManager
 public:
     std::unordered_map<std::string, std::unique_ptr<Texture>> m_vpTextures;
     void Destroy() { m_vpTextures.clear(); }
+
+    // Applies to textures loaded afterwards
+    void SetQualityTier(TextureQualityTiers tier) { m_qualityTier = tier; }
+    TextureQualityTiers GetQualityTier() const { return m_qualityTier; }
+    // Memory of the loaded textures under every tier, for reporting savings
+    std::array<VkDeviceSize, TEXTURE_QUALITY_TIER_COUNT> GetQualityTierSizes() const
+    {
+        std::array<VkDeviceSize, TEXTURE_QUALITY_TIER_COUNT> aSizes = {};
+        for (const auto& it : m_vpTextures)
+        {
+            for (size_t i = 0; i < TEXTURE_QUALITY_TIER_COUNT; i++)
+            {
+                aSizes[i] += it.second->GetQualityTierSizes()[i];
+            }
+        }
+        return aSizes;
+    }
+
+    // While validating, textures looked up by name are checked once against
+    // their source file and reloaded if it changed
+    void BeginContentValidation()
+    {
+        m_bIsValidatingContent = true;
+        m_sValidatedTextures.clear();
+        m_uNumReloadedTextures = 0;
+    }
+    uint32_t EndContentValidation()
+    {
+        m_bIsValidatingContent = false;
+        m_sValidatedTextures.clear();
+        return m_uNumReloadedTextures;
+    }
+    void ValidateContent(const std::string& name, const std::string& path)
+    {
+        if (ShouldValidate(name))
+        {
+            m_uNumReloadedTextures += m_vpTextures.at(name)->ReloadIfChanged(path) ? 1 : 0;
+        }
+    }
+    void ValidateORMContent(const std::string& name, const std::string& sOcclusionPath,
+                            const std::string& sMetallicRoughnessPath)
+    {
+        if (ShouldValidate(name))
+        {
+            m_uNumReloadedTextures +=
+                m_vpTextures.at(name)->ReloadORMIfChanged(sOcclusionPath, sMetallicRoughnessPath) ? 1 : 0;
+        }
+    }
+
+private:
+    TextureQualityTiers m_qualityTier = TEXTURE_QUALITY_HIGH;
+
+    bool ShouldValidate(const std::string& name)
+    {
+        return m_bIsValidatingContent && m_sValidatedTextures.insert(name).second;
+    }
+
+    bool m_bIsValidatingContent = false;
+    std::unordered_set<std::string> m_sValidatedTextures;
+    uint32_t m_uNumReloadedTextures = 0;
 };
 TextureManager *GetTextureManager();
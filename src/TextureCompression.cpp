@@ -0,0 +1,287 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+uint32_t GetBlockSize(BlockFormat format)
+{
+    return format == BlockFormat::BC4 ? 8 : 16;
+}
+
+// Little endian bit writer for block layouts
+class BlockWriter
+{
+public:
+    explicit BlockWriter(uint8_t* pBlock, size_t nSize) : m_pBlock(pBlock) { memset(pBlock, 0, nSize); }
+    void Write(uint32_t uValue, uint32_t uNumBits)
+    {
+        for (uint32_t i = 0; i < uNumBits; i++, m_uBit++)
+        {
+            m_pBlock[m_uBit >> 3] |= ((uValue >> i) & 1u) << (m_uBit & 7);
+        }
+    }
+
+private:
+    uint8_t* m_pBlock;
+    uint32_t m_uBit = 0;
+};
+
+void EncodeBC4Block(const uint8_t* aTexels, uint32_t uChannel, uint8_t* pBlock)
+{
+    uint8_t uMin = 255, uMax = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uMin = std::min(uMin, aTexels[i * 4 + uChannel]);
+        uMax = std::max(uMax, aTexels[i * 4 + uChannel]);
+    }
+
+    BlockWriter writer(pBlock, 8);
+    writer.Write(uMax, 8);
+    writer.Write(uMin, 8);
+    if (uMax == uMin)
+    {
+        // All indices select the first endpoint
+        return;
+    }
+
+    // red0 > red1 selects the 8 value palette
+    int aPalette[8];
+    aPalette[0] = uMax;
+    aPalette[1] = uMin;
+    for (int i = 1; i < 7; i++)
+    {
+        aPalette[i + 1] = ((7 - i) * uMax + i * uMin + 3) / 7;
+    }
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        const int nValue = aTexels[i * 4 + uChannel];
+        uint32_t uBest = 0;
+        int nBestError = 256;
+        for (uint32_t j = 0; j < 8; j++)
+        {
+            const int nError = std::abs(aPalette[j] - nValue);
+            if (nError < nBestError)
+            {
+                nBestError = nError;
+                uBest = j;
+            }
+        }
+        writer.Write(uBest, 3);
+    }
+}
+
+void EncodeBC5Block(const uint8_t* aTexels, uint8_t* pBlock)
+{
+    EncodeBC4Block(aTexels, 0, pBlock);
+    EncodeBC4Block(aTexels, 1, pBlock + 8);
+}
+
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit each and
+// 4-bit indices. Endpoints are the extremes of the block along its
+// principal axis.
+void EncodeBC7Block(const uint8_t* aTexels, uint8_t* pBlock)
+{
+    static const int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float aMean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            aMean[c] += aTexels[i * 4 + c] / 16.0f;
+        }
+    }
+    float aCovariance[4][4] = {};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t r = 0; r < 4; r++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                aCovariance[r][c] += (aTexels[i * 4 + r] - aMean[r]) * (aTexels[i * 4 + c] - aMean[c]);
+            }
+        }
+    }
+    // Power iteration for the principal axis
+    float aAxis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (uint32_t uIteration = 0; uIteration < 8; uIteration++)
+    {
+        float aNext[4] = {};
+        float fLength = 0.0f;
+        for (uint32_t r = 0; r < 4; r++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                aNext[r] += aCovariance[r][c] * aAxis[c];
+            }
+            fLength = std::max(fLength, std::fabs(aNext[r]));
+        }
+        if (fLength < 1e-6f)
+        {
+            break;
+        }
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            aAxis[c] = aNext[c] / fLength;
+        }
+    }
+    float fMinProjection = 0.0f, fMaxProjection = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float fProjection = 0.0f;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            fProjection += (aTexels[i * 4 + c] - aMean[c]) * aAxis[c];
+        }
+        fMinProjection = std::min(fMinProjection, fProjection);
+        fMaxProjection = std::max(fMaxProjection, fProjection);
+    }
+    float fAxisLengthSquared = 0.0f;
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        fAxisLengthSquared += aAxis[c] * aAxis[c];
+    }
+    fAxisLengthSquared = std::max(fAxisLengthSquared, 1e-6f);
+
+    // Quantize both endpoints to 7 bits + p-bit, keeping the p-bit with the
+    // lower error
+    uint32_t aQuantized[2][4];
+    uint32_t aPBits[2];
+    int aEndpoints[2][4];
+    for (uint32_t e = 0; e < 2; e++)
+    {
+        const float fProjection = (e == 0 ? fMinProjection : fMaxProjection) / fAxisLengthSquared;
+        float aTarget[4];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            aTarget[c] = std::min(std::max(aMean[c] + aAxis[c] * fProjection, 0.0f), 255.0f);
+        }
+        float fBestError = 1e30f;
+        for (uint32_t p = 0; p < 2; p++)
+        {
+            float fError = 0.0f;
+            uint32_t aCandidate[4];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                const int nQ = (int)std::lround((aTarget[c] - (float)p) / 2.0f);
+                aCandidate[c] = (uint32_t)std::min(std::max(nQ, 0), 127);
+                const float fDelta = (float)((aCandidate[c] << 1) | p) - aTarget[c];
+                fError += fDelta * fDelta;
+            }
+            if (fError < fBestError)
+            {
+                fBestError = fError;
+                aPBits[e] = p;
+                memcpy(aQuantized[e], aCandidate, sizeof(aCandidate));
+            }
+        }
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            aEndpoints[e][c] = (int)((aQuantized[e][c] << 1) | aPBits[e]);
+        }
+    }
+
+    uint32_t aIndices[16];
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        int nBestError = 1 << 30;
+        for (uint32_t j = 0; j < 16; j++)
+        {
+            int nError = 0;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                const int nValue = ((64 - WEIGHTS[j]) * aEndpoints[0][c] + WEIGHTS[j] * aEndpoints[1][c] + 32) >> 6;
+                const int nDelta = nValue - aTexels[i * 4 + c];
+                nError += nDelta * nDelta;
+            }
+            if (nError < nBestError)
+            {
+                nBestError = nError;
+                aIndices[i] = j;
+            }
+        }
+    }
+
+    // The anchor index is stored without its high bit, swap the endpoints
+    // if it is set
+    if (aIndices[0] & 8)
+    {
+        std::swap(aQuantized[0], aQuantized[1]);
+        std::swap(aPBits[0], aPBits[1]);
+        for (uint32_t& uIndex : aIndices)
+        {
+            uIndex = 15 - uIndex;
+        }
+    }
+
+    BlockWriter writer(pBlock, 16);
+    writer.Write(1u << 6, 7);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        writer.Write(aQuantized[0][c], 7);
+        writer.Write(aQuantized[1][c], 7);
+    }
+    writer.Write(aPBits[0], 1);
+    writer.Write(aPBits[1], 1);
+    writer.Write(aIndices[0], 3);
+    for (uint32_t i = 1; i < 16; i++)
+    {
+        writer.Write(aIndices[i], 4);
+    }
+}
+
+void CompressMipChain(const std::vector<uint8_t>& vChain, const std::vector<MipLevel>& vLevels, BlockFormat format,
+                      std::vector<uint8_t>& vCompressed, std::vector<MipLevel>& vCompressedLevels)
+{
+    const uint32_t uBlockSize = GetBlockSize(format);
+    vCompressedLevels.resize(vLevels.size());
+    size_t nTotalSize = 0;
+    for (size_t i = 0; i < vLevels.size(); i++)
+    {
+        MipLevel& level = vCompressedLevels[i];
+        level.m_uWidth = vLevels[i].m_uWidth;
+        level.m_uHeight = vLevels[i].m_uHeight;
+        level.m_nOffset = nTotalSize;
+        level.m_nSize = (size_t)((level.m_uWidth + 3) / 4) * ((level.m_uHeight + 3) / 4) * uBlockSize;
+        nTotalSize += level.m_nSize;
+    }
+    vCompressed.resize(nTotalSize);
+
+    for (size_t i = 0; i < vLevels.size(); i++)
+    {
+        const MipLevel& src = vLevels[i];
+        const uint8_t* pSrc = vChain.data() + src.m_nOffset;
+        uint8_t* pDst = vCompressed.data() + vCompressedLevels[i].m_nOffset;
+        for (uint32_t by = 0; by < src.m_uHeight; by += 4)
+        {
+            for (uint32_t bx = 0; bx < src.m_uWidth; bx += 4)
+            {
+                uint8_t aTexels[16 * 4];
+                for (uint32_t y = 0; y < 4; y++)
+                {
+                    const uint32_t uY = std::min(by + y, src.m_uHeight - 1);
+                    for (uint32_t x = 0; x < 4; x++)
+                    {
+                        const uint32_t uX = std::min(bx + x, src.m_uWidth - 1);
+                        memcpy(&aTexels[(y * 4 + x) * 4], pSrc + ((size_t)uY * src.m_uWidth + uX) * 4, 4);
+                    }
+                }
+                switch (format)
+                {
+                    case BlockFormat::BC4:
+                        EncodeBC4Block(aTexels, 0, pDst);
+                        break;
+                    case BlockFormat::BC5:
+                        EncodeBC5Block(aTexels, pDst);
+                        break;
+                    case BlockFormat::BC7:
+                        EncodeBC7Block(aTexels, pDst);
+                        break;
+                }
+                pDst += uBlockSize;
+            }
+        }
+    }
+}
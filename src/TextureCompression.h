@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "MipChain.h"
+
+// CPU block compression used when cooking textures. Blocks are 4x4 texels,
+// sources are RGBA8 and partial blocks at the edges repeat the last texel.
+enum class BlockFormat
+{
+    BC4,  // single channel, from R
+    BC5,  // two channels, from RG
+    BC7,  // RGBA
+};
+
+// Bytes per 4x4 block
+uint32_t GetBlockSize(BlockFormat format);
+
+// aTexels are 16 RGBA8 texels in row order
+void EncodeBC4Block(const uint8_t* aTexels, uint32_t uChannel, uint8_t* pBlock);
+void EncodeBC5Block(const uint8_t* aTexels, uint8_t* pBlock);
+void EncodeBC7Block(const uint8_t* aTexels, uint8_t* pBlock);
+
+// Compress every level of an RGBA8 chain built by BuildMipChain
+void CompressMipChain(const std::vector<uint8_t>& vChain, const std::vector<MipLevel>& vLevels, BlockFormat format,
+                      std::vector<uint8_t>& vCompressed, std::vector<MipLevel>& vCompressedLevels);
@@ -0,0 +1,57 @@
+#include "TexturePacking.h"
+
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+
+static uint8_t SampleNearest(const PackingSource& source, uint32_t x, uint32_t y, uint32_t uWidth, uint32_t uHeight,
+                             uint32_t uChannel)
+{
+    if (source.m_pPixels == nullptr)
+    {
+        return 255;
+    }
+    const uint32_t uSrcX = (uint32_t)((uint64_t)x * source.m_uWidth / uWidth);
+    const uint32_t uSrcY = (uint32_t)((uint64_t)y * source.m_uHeight / uHeight);
+    return source.m_pPixels[((size_t)uSrcY * source.m_uWidth + uSrcX) * 4 + uChannel];
+}
+
+void PackORM(const PackingSource& occlusion, const PackingSource& metallicRoughness, std::vector<uint8_t>& vPixels,
+             uint32_t& uWidth, uint32_t& uHeight)
+{
+    uWidth = std::max(occlusion.m_pPixels ? occlusion.m_uWidth : 1u,
+                      metallicRoughness.m_pPixels ? metallicRoughness.m_uWidth : 1u);
+    uHeight = std::max(occlusion.m_pPixels ? occlusion.m_uHeight : 1u,
+                       metallicRoughness.m_pPixels ? metallicRoughness.m_uHeight : 1u);
+    vPixels.resize((size_t)uWidth * uHeight * 4);
+    for (uint32_t y = 0; y < uHeight; y++)
+    {
+        for (uint32_t x = 0; x < uWidth; x++)
+        {
+            uint8_t* pTexel = &vPixels[((size_t)y * uWidth + x) * 4];
+            pTexel[0] = SampleNearest(occlusion, x, y, uWidth, uHeight, 0);
+            pTexel[1] = SampleNearest(metallicRoughness, x, y, uWidth, uHeight, 1);
+            pTexel[2] = SampleNearest(metallicRoughness, x, y, uWidth, uHeight, 2);
+            pTexel[3] = 255;
+        }
+    }
+}
+
+std::string GetPackedORMPath(const std::string& sOcclusionPath, const std::string& sMetallicRoughnessPath)
+{
+    assert(!sOcclusionPath.empty() || !sMetallicRoughnessPath.empty());
+    const std::filesystem::path metallicRoughnessPath(sMetallicRoughnessPath);
+    const std::filesystem::path occlusionPath(sOcclusionPath);
+    std::string sFileName;
+    if (!sMetallicRoughnessPath.empty())
+    {
+        sFileName = metallicRoughnessPath.stem().string();
+    }
+    if (!sOcclusionPath.empty())
+    {
+        sFileName += (sFileName.empty() ? "" : "_") + occlusionPath.stem().string();
+    }
+    const std::filesystem::path directory =
+        sMetallicRoughnessPath.empty() ? occlusionPath.parent_path() : metallicRoughnessPath.parent_path();
+    return (directory / (sFileName + ".orm.ktx2")).string();
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// RGBA8 map feeding one channel group of a packed texture, missing maps read
+// as white
+struct PackingSource
+{
+    const uint8_t* m_pPixels = nullptr;
+    uint32_t m_uWidth = 0;
+    uint32_t m_uHeight = 0;
+};
+
+// Pack occlusion (R), roughness (G) and metalness (B) into one RGBA8 image.
+// Roughness and metalness keep their glTF metallicRoughness channels,
+// occlusion is taken from the red channel of its map. The result has the
+// larger size of the two, the smaller map is sampled nearest.
+void PackORM(const PackingSource& occlusion, const PackingSource& metallicRoughness, std::vector<uint8_t>& vPixels,
+             uint32_t& uWidth, uint32_t& uHeight);
+
+// Cooked packed map next to the source images, also used as the name of
+// textures packed at load. Either path may be empty.
+std::string GetPackedORMPath(const std::string& sOcclusionPath, const std::string& sMetallicRoughnessPath);
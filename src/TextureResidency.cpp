@@ -0,0 +1,324 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "Texture.h"
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+static TextureResidencyManager s_textureResidencyManager;
+
+TextureResidencyManager* GetTextureResidencyManager()
+{
+    return &s_textureResidencyManager;
+}
+
+// Feedback of textures not sampled since the last read back
+static const uint32_t NO_REQUEST = 0xFFFFFFFFu;
+// Frames between read backs, requests accumulate in between
+static const uint64_t FEEDBACK_INTERVAL = 16;
+// Bounds the uploads queued by a single read back
+static const uint32_t MAX_CHANGES_PER_UPDATE = 8;
+
+void TextureResidencyManager::Initialize(VkDeviceSize uBudget)
+{
+    assert(m_feedbackBuffer == VK_NULL_HANDLE);
+    m_uBudgetLimit = m_uBudget = uBudget;
+    GetMemoryAllocator()->AllocateBuffer(GetFeedbackBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                         VMA_MEMORY_USAGE_GPU_TO_CPU, m_feedbackBuffer, m_feedbackAllocation,
+                                         "Mip feedback");
+    m_pFeedback = static_cast<uint32_t*>(GetMemoryAllocator()->GetMappedData(m_feedbackAllocation));
+    memset(m_pFeedback, 0xFF, GetFeedbackBufferSize());
+    GetMemoryAllocator()->FlushAllocation(m_feedbackAllocation, 0, GetFeedbackBufferSize());
+
+    // Slot 0 is reserved for textures without feedback
+    m_vTextures.resize(1);
+}
+
+void TextureResidencyManager::Unintialize()
+{
+    m_qRetiredImages.clear();
+    m_vTextures.clear();
+    m_vFreeSlots.clear();
+    GetMemoryAllocator()->FreeBuffer(m_feedbackBuffer, m_feedbackAllocation);
+    m_pFeedback = nullptr;
+    m_feedbackBuffer = VK_NULL_HANDLE;
+}
+
+uint32_t TextureResidencyManager::Register(Texture* pTexture, VkFormat format, const std::vector<MipLevel>& vLevels)
+{
+    assert(m_pFeedback != nullptr && "Texture residency manager is not initialized");
+    if (!pTexture->HasSource())
+    {
+        return 0;
+    }
+    uint32_t uTailMip = 0;
+    while (uTailMip + 1 < vLevels.size() &&
+           std::max(vLevels[uTailMip].m_uWidth, vLevels[uTailMip].m_uHeight) > MIP_TAIL_SIZE)
+    {
+        uTailMip++;
+    }
+    if (uTailMip == 0)
+    {
+        return 0;
+    }
+
+    uint32_t uSlot = 0;
+    if (!m_vFreeSlots.empty())
+    {
+        uSlot = m_vFreeSlots.back();
+        m_vFreeSlots.pop_back();
+    }
+    else if (m_vTextures.size() < MAX_FEEDBACK_TEXTURES)
+    {
+        uSlot = static_cast<uint32_t>(m_vTextures.size());
+        m_vTextures.emplace_back();
+    }
+    else
+    {
+        // Out of slots, keep the texture fully resident
+        return 0;
+    }
+
+    StreamedTexture& texture = m_vTextures[uSlot];
+    texture.m_pTexture = pTexture;
+    texture.m_format = format;
+    texture.m_vLevels = vLevels;
+    texture.m_uTailMip = uTailMip;
+    texture.m_uRequestedMip = uTailMip;
+    texture.m_uLastRequestFrame = m_uFrame;
+    pTexture->SetFeedbackId(uSlot);
+    return uTailMip;
+}
+
+void TextureResidencyManager::Unregister(Texture* pTexture)
+{
+    const uint32_t uSlot = pTexture->GetFeedbackId();
+    assert(uSlot != 0 && uSlot < m_vTextures.size() && m_vTextures[uSlot].m_pTexture == pTexture);
+    m_vTextures[uSlot] = StreamedTexture();
+    m_pFeedback[uSlot] = NO_REQUEST;
+    m_vFreeSlots.push_back(uSlot);
+    pTexture->SetFeedbackId(0);
+}
+
+VkDeviceSize TextureResidencyManager::GetResidentSize() const
+{
+    VkDeviceSize uSize = 0;
+    for (const StreamedTexture& texture : m_vTextures)
+    {
+        if (texture.m_pTexture == nullptr)
+        {
+            continue;
+        }
+        uSize += GetLevelsSize(texture, texture.m_pTexture->GetBaseMip());
+        if (texture.m_pPending != nullptr)
+        {
+            uSize += GetLevelsSize(texture, texture.m_pPending->GetBaseMip());
+        }
+    }
+    for (const RetiredImage& image : m_qRetiredImages)
+    {
+        uSize += image.m_uSize;
+    }
+    return uSize;
+}
+
+void TextureResidencyManager::Update()
+{
+    m_uFrame++;
+    if (m_uFrame % FEEDBACK_INTERVAL != 0 || m_vTextures.size() <= 1)
+    {
+        return;
+    }
+
+    // Frames in flight may still write requests around the reset, they are
+    // hints and get repeated by later frames
+    const VkDeviceSize uFeedbackSize = m_vTextures.size() * sizeof(uint32_t);
+    GetMemoryAllocator()->InvalidateAllocation(m_feedbackAllocation, 0, uFeedbackSize);
+    std::vector<StreamedTexture*> vPromotions;
+    for (size_t i = 1; i < m_vTextures.size(); i++)
+    {
+        StreamedTexture& texture = m_vTextures[i];
+        const uint32_t uRequest = m_pFeedback[i];
+        m_pFeedback[i] = NO_REQUEST;
+        if (texture.m_pTexture == nullptr)
+        {
+            continue;
+        }
+        if (uRequest != NO_REQUEST)
+        {
+            texture.m_uRequestedMip = std::min(uRequest, texture.m_uTailMip);
+            texture.m_uLastRequestFrame = m_uFrame;
+        }
+        else
+        {
+            // Unused levels stay until the budget needs them
+            texture.m_uRequestedMip = texture.m_uTailMip;
+        }
+        if (texture.m_pPending == nullptr && texture.m_pTexture->IsResident() &&
+            texture.m_uRequestedMip < texture.m_pTexture->GetBaseMip())
+        {
+            vPromotions.push_back(&texture);
+        }
+    }
+    GetMemoryAllocator()->FlushAllocation(m_feedbackAllocation, 0, uFeedbackSize);
+
+    // Largest resolution gap first
+    std::sort(vPromotions.begin(), vPromotions.end(), [](const StreamedTexture* pA, const StreamedTexture* pB) {
+        return pA->m_pTexture->GetBaseMip() - pA->m_uRequestedMip > pB->m_pTexture->GetBaseMip() - pB->m_uRequestedMip;
+    });
+    uint32_t uNumChanges = 0;
+    for (StreamedTexture* pTexture : vPromotions)
+    {
+        if (uNumChanges == MAX_CHANGES_PER_UPDATE)
+        {
+            break;
+        }
+        // The new image holds all resident levels, the old one stays until
+        // the new one is uploaded
+        if (MakeRoom(GetLevelsSize(*pTexture, pTexture->m_uRequestedMip), pTexture) &&
+            RequestBaseMip(*pTexture, pTexture->m_uRequestedMip))
+        {
+            uNumChanges++;
+        }
+    }
+}
+
+bool TextureResidencyManager::MakeRoom(VkDeviceSize uSize, const StreamedTexture* pRequester)
+{
+    const VkDeviceSize uResidentSize = GetResidentSize();
+    if (uResidentSize + uSize <= m_uBudget)
+    {
+        return true;
+    }
+    const VkDeviceSize uExcess = uResidentSize + uSize - m_uBudget;
+    if (GetUnusedSize(pRequester) < uExcess)
+    {
+        return false;
+    }
+    DropUnusedLevels(uExcess, pRequester);
+    return true;
+}
+
+std::vector<TextureResidencyManager::StreamedTexture*> TextureResidencyManager::GetUnusedTextures(
+    const StreamedTexture* pExclude)
+{
+    // Textures holding finer levels than requested
+    std::vector<StreamedTexture*> vTextures;
+    for (StreamedTexture& texture : m_vTextures)
+    {
+        if (texture.m_pTexture != nullptr && &texture != pExclude && texture.m_pPending == nullptr &&
+            texture.m_pTexture->IsResident() && texture.m_uRequestedMip > texture.m_pTexture->GetBaseMip())
+        {
+            vTextures.push_back(&texture);
+        }
+    }
+    return vTextures;
+}
+
+VkDeviceSize TextureResidencyManager::GetUnusedSize(const StreamedTexture* pExclude)
+{
+    VkDeviceSize uSize = 0;
+    for (const StreamedTexture* pTexture : GetUnusedTextures(pExclude))
+    {
+        uSize += GetLevelsSize(*pTexture, pTexture->m_pTexture->GetBaseMip()) -
+                 GetLevelsSize(*pTexture, pTexture->m_uRequestedMip);
+    }
+    return uSize;
+}
+
+VkDeviceSize TextureResidencyManager::DropUnusedLevels(VkDeviceSize uSize, const StreamedTexture* pExclude)
+{
+    // Least recently requested first
+    std::vector<StreamedTexture*> vTextures = GetUnusedTextures(pExclude);
+    std::sort(vTextures.begin(), vTextures.end(), [](const StreamedTexture* pA, const StreamedTexture* pB) {
+        return pA->m_uLastRequestFrame < pB->m_uLastRequestFrame;
+    });
+    VkDeviceSize uDroppedSize = 0;
+    for (StreamedTexture* pTexture : vTextures)
+    {
+        if (uDroppedSize >= uSize)
+        {
+            break;
+        }
+        // Counted as freed right away, the levels go once the smaller image
+        // is swapped in
+        const VkDeviceSize uUnusedSize = GetLevelsSize(*pTexture, pTexture->m_pTexture->GetBaseMip()) -
+                                         GetLevelsSize(*pTexture, pTexture->m_uRequestedMip);
+        if (RequestBaseMip(*pTexture, pTexture->m_uRequestedMip))
+        {
+            uDroppedSize += uUnusedSize;
+        }
+    }
+    return uDroppedSize;
+}
+
+VkDeviceSize TextureResidencyManager::Trim(VkDeviceSize uSize)
+{
+    const VkDeviceSize uResidentSize = GetResidentSize();
+    // Trimmed textures keep sampling their levels until the smaller images
+    // are swapped in
+    const VkDeviceSize uDroppedSize = DropUnusedLevels(uSize, nullptr);
+    // Keep the streaming from filling the memory up again
+    SetBudget(uResidentSize > uDroppedSize ? uResidentSize - uDroppedSize : 0);
+    return uDroppedSize;
+}
+
+bool TextureResidencyManager::RequestBaseMip(StreamedTexture& texture, uint32_t uBaseMip)
+{
+    assert(texture.m_pPending == nullptr);
+    // Levels are decoded again rather than kept in host memory, the data
+    // is only held until it's copied to staging
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::vector<uint8_t> vData;
+    std::vector<MipLevel> vLevels;
+    if (!texture.m_pTexture->ReadSourceLevels(format, vData, vLevels) || format != texture.m_format ||
+        vLevels.size() != texture.m_vLevels.size() || vData.size() != GetLevelsSize(texture, 0))
+    {
+        const uint32_t uResidentMip = texture.m_pTexture->GetBaseMip();
+        if (uBaseMip <= uResidentMip || uResidentMip >= texture.m_uTailMip)
+        {
+            return false;
+        }
+        // The resident image already holds the coarser levels
+        std::cerr << texture.m_pTexture->GetSourcePath()
+                  << ": levels can't be read back, dropping to the mip tail" << std::endl;
+        texture.m_pPending = std::make_unique<Texture>();
+        texture.m_pPending->CopyResidentLevels(*texture.m_pTexture, texture.m_uTailMip);
+        return true;
+    }
+    texture.m_pPending = std::make_unique<Texture>();
+    texture.m_pPending->LoadResidentLevels(format, vData, vLevels, uBaseMip, true);
+    return true;
+}
+
+bool TextureResidencyManager::ApplyResidencyChanges()
+{
+    const uint64_t uCompletedFrames = GetRenderDevice()->GetCompletedFrameCount();
+    while (!m_qRetiredImages.empty() && m_qRetiredImages.front().m_uLastFrame <= uCompletedFrames)
+    {
+        m_qRetiredImages.pop_front();
+    }
+
+    bool bChanged = false;
+    for (StreamedTexture& texture : m_vTextures)
+    {
+        if (texture.m_pPending != nullptr && texture.m_pPending->IsResident())
+        {
+            // The pending texture takes the old image along, materials move
+            // to a new slot with the new view before the next submission
+            texture.m_pTexture->SwapImage(*texture.m_pPending);
+            RetiredImage image;
+            image.m_uSize = GetLevelsSize(texture, texture.m_pPending->GetBaseMip());
+            image.m_uLastFrame = GetRenderDevice()->GetSubmittedFrameCount();
+            image.m_pTexture = std::move(texture.m_pPending);
+            m_qRetiredImages.push_back(std::move(image));
+            bChanged = true;
+        }
+    }
+    return bChanged;
+}
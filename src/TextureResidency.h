@@ -0,0 +1,107 @@
+#pragma once
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "MipChain.h"
+
+class Texture;
+
+// Keeps the fine mip levels of large streamed textures resident on demand.
+// Material shaders write the finest level they sample per texture to a
+// feedback buffer, textures get rebuilt with the requested levels and drop
+// back to their mip tail when unused and over budget. Images only hold their
+// resident levels, so no sparse binding is needed. Until finer levels arrive
+// sampling is clamped by the image's base level.
+class TextureResidencyManager
+{
+public:
+    // Feedback slots, slot 0 marks textures without feedback
+    static constexpr uint32_t MAX_FEEDBACK_TEXTURES = 4096;
+    // Levels up to this size are always resident
+    static constexpr uint32_t MIP_TAIL_SIZE = 256;
+
+    void Initialize(VkDeviceSize uBudget = 512 * 1024 * 1024);
+    void Unintialize();
+
+    // Track the levels of a streamed texture, returns the first level to
+    // upload. Finer levels are read back from the texture's sources when
+    // requested, textures without sources stay fully resident.
+    uint32_t Register(Texture* pTexture, VkFormat format, const std::vector<MipLevel>& vLevels);
+    void Unregister(Texture* pTexture);
+
+    // Read back the feedback every few frames and queue uploads of the
+    // requested levels within budget
+    void Update();
+
+    // Swap in images whose levels finished uploading, once per frame. Old
+    // images are released after the frames submitted so far are done.
+    // Returns true if any texture changed.
+    bool ApplyResidencyChanges();
+
+    VkBuffer GetFeedbackBuffer() const { return m_feedbackBuffer; }
+    VkDeviceSize GetFeedbackBufferSize() const { return MAX_FEEDBACK_TEXTURES * sizeof(uint32_t); }
+    VkDeviceSize GetResidentSize() const;
+
+    // Streaming budget, capped by the one given at initialization
+    void SetBudget(VkDeviceSize uBudget) { m_uBudget = std::min(uBudget, m_uBudgetLimit); }
+    // Drop levels not requested lately to free about uSize bytes and lower
+    // the budget accordingly, returns the bytes dropped. The old images stay
+    // bound until the smaller ones are resident.
+    VkDeviceSize Trim(VkDeviceSize uSize);
+
+private:
+    struct StreamedTexture
+    {
+        Texture* m_pTexture = nullptr;
+        VkFormat m_format = VK_FORMAT_UNDEFINED;
+        std::vector<MipLevel> m_vLevels;
+        // Coarsest base level, always resident
+        uint32_t m_uTailMip = 0;
+        uint32_t m_uRequestedMip = 0;
+        uint64_t m_uLastRequestFrame = 0;
+        // Image being uploaded with a new base level
+        std::unique_ptr<Texture> m_pPending = nullptr;
+    };
+
+    VkDeviceSize GetLevelsSize(const StreamedTexture& texture, uint32_t uBaseMip) const
+    {
+        const MipLevel& lastLevel = texture.m_vLevels.back();
+        return lastLevel.m_nOffset + lastLevel.m_nSize - texture.m_vLevels[uBaseMip].m_nOffset;
+    }
+    // False if the levels can't be read back. Dropping levels then falls
+    // back to a copy of the resident mip tail.
+    bool RequestBaseMip(StreamedTexture& texture, uint32_t uBaseMip);
+    // Drop least recently requested levels until uSize fits the budget
+    bool MakeRoom(VkDeviceSize uSize, const StreamedTexture* pRequester);
+    std::vector<StreamedTexture*> GetUnusedTextures(const StreamedTexture* pExclude);
+    VkDeviceSize GetUnusedSize(const StreamedTexture* pExclude);
+    VkDeviceSize DropUnusedLevels(VkDeviceSize uSize, const StreamedTexture* pExclude);
+
+    struct RetiredImage
+    {
+        std::unique_ptr<Texture> m_pTexture = nullptr;
+        VkDeviceSize m_uSize = 0;
+        // Frames up to this one may still sample the image
+        uint64_t m_uLastFrame = 0;
+    };
+
+    // Indexed by feedback slot
+    std::vector<StreamedTexture> m_vTextures;
+    std::deque<RetiredImage> m_qRetiredImages;
+    std::vector<uint32_t> m_vFreeSlots;
+
+    VkBuffer m_feedbackBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_feedbackAllocation = VK_NULL_HANDLE;
+    uint32_t* m_pFeedback = nullptr;
+
+    VkDeviceSize m_uBudget = 0;
+    VkDeviceSize m_uBudgetLimit = 0;
+    uint64_t m_uFrame = 0;
+};
+
+TextureResidencyManager* GetTextureResidencyManager();
@@ -0,0 +1,320 @@
+#include "TextureStreamer.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "Texture.h"
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+static TextureStreamer s_textureStreamer;
+
+TextureStreamer* GetTextureStreamer()
+{
+    return &s_textureStreamer;
+}
+
+// Stages where streamed textures get sampled, the IBL inputs are read in
+// compute shaders
+static const VkPipelineStageFlags TEXTURE_CONSUMER_STAGES =
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+void TextureStreamer::Initialize(VkDeviceSize uStagingSize)
+{
+    assert(m_stagingBuffer == VK_NULL_HANDLE);
+    m_uStagingSize = uStagingSize;
+    GetMemoryAllocator()->AllocateBuffer(
+        m_uStagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_MEMORY_USAGE_CPU_ONLY, m_stagingBuffer, m_stagingAllocation, "Texture staging ring");
+    m_pStagingData = static_cast<uint8_t*>(GetMemoryAllocator()->GetMappedData(m_stagingAllocation));
+
+    // Neutral grey shown until the real pixels arrive
+    const uint8_t PLACEHOLDER_PIXEL[4] = {128, 128, 128, 255};
+    m_pPlaceholder = std::make_unique<Texture>();
+    m_pPlaceholder->LoadPixels((void*)PLACEHOLDER_PIXEL, 1, 1);
+    m_pPlaceholder->SetDebugName("Texture placeholder");
+}
+
+void TextureStreamer::Unintialize()
+{
+    Flush();
+    m_pPlaceholder = nullptr;
+    GetMemoryAllocator()->FreeBuffer(m_stagingBuffer, m_stagingAllocation);
+    m_pStagingData = nullptr;
+    m_stagingBuffer = VK_NULL_HANDLE;
+}
+
+void TextureStreamer::RequestUpload(Texture* pTexture, const void* pData, size_t nSize, const std::vector<MipLevel>& vLevels)
+{
+    assert(m_pStagingData != nullptr && "Texture streamer is not initialized");
+    PendingUpload upload;
+    upload.m_pTexture = pTexture;
+    upload.m_vLevels = vLevels;
+    if (nSize > m_uStagingSize)
+    {
+        GetMemoryAllocator()->AllocateBuffer(
+            nSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_ONLY, upload.m_buffer, upload.m_dedicatedAllocation, "Texture staging");
+        memcpy(GetMemoryAllocator()->GetMappedData(upload.m_dedicatedAllocation), pData, nSize);
+        GetMemoryAllocator()->FlushAllocation(upload.m_dedicatedAllocation, 0, nSize);
+    }
+    else
+    {
+        // Recycle the oldest uploads until the ring has room
+        while (!AllocateStaging(nSize, upload.m_uOffset))
+        {
+            Submit();
+            RetireOldest(true);
+        }
+        memcpy(m_pStagingData + upload.m_uOffset, pData, nSize);
+        GetMemoryAllocator()->FlushAllocation(m_stagingAllocation, upload.m_uOffset, nSize);
+        upload.m_buffer = m_stagingBuffer;
+    }
+    m_vPending.push_back(upload);
+}
+
+bool TextureStreamer::Update()
+{
+    Submit();
+    while (RetireOldest(false))
+        ;
+    bool bHasNewResidents = m_bHasNewResidents;
+    m_bHasNewResidents = false;
+    return bHasNewResidents;
+}
+
+void TextureStreamer::Flush()
+{
+    Submit();
+    while (RetireOldest(true))
+        ;
+}
+
+bool TextureStreamer::AllocateStaging(VkDeviceSize uSize, VkDeviceSize& uOffset)
+{
+    // Buffer offsets of image copies must be a multiple of the texel size
+    const VkDeviceSize ALIGNMENT = 16;
+    if (IsRingEmpty())
+    {
+        m_uHead = m_uTail = 0;
+        m_bWrapped = false;
+    }
+    const VkDeviceSize uStart = (m_uHead + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (m_bWrapped)
+    {
+        // Free range is [head, tail)
+        if (uStart + uSize > m_uTail)
+        {
+            return false;
+        }
+        uOffset = uStart;
+    }
+    else if (uStart + uSize <= m_uStagingSize)
+    {
+        // Free range is [head, end) then [0, tail)
+        uOffset = uStart;
+    }
+    else if (uSize <= m_uTail)
+    {
+        uOffset = 0;
+        m_bWrapped = true;
+    }
+    else
+    {
+        return false;
+    }
+    m_uHead = uOffset + uSize;
+    return true;
+}
+
+void TextureStreamer::Submit()
+{
+    if (m_vPending.empty())
+    {
+        return;
+    }
+    VkRenderDevice* pDevice = GetRenderDevice();
+    const uint32_t uTransferFamily = (uint32_t)pDevice->GetTransferQueueFamilyIndex();
+    const uint32_t uGraphicsFamily = (uint32_t)pDevice->GetGraphicsQueueFamilyIndex();
+    const bool bTransferOwnership = uTransferFamily != uGraphicsFamily;
+
+    UploadBatch batch;
+    batch.m_vUploads = std::move(m_vPending);
+    m_vPending.clear();
+    batch.m_uRingEnd = m_uHead;
+
+    std::vector<VkImageMemoryBarrier> vBarriers(batch.m_vUploads.size());
+    for (size_t i = 0; i < vBarriers.size(); i++)
+    {
+        VkImageMemoryBarrier& barrier = vBarriers[i];
+        barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = batch.m_vUploads[i].m_pTexture->getImage();
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = batch.m_vUploads[i].m_pTexture->GetMipCount();
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    // Copies on the transfer queue
+    batch.m_transferCmdBuf = pDevice->AllocateTransferCommandBuffer();
+    vkBeginCommandBuffer(batch.m_transferCmdBuf, &beginInfo);
+    {
+        // UNDEFINED -> DST_OPTIMAL
+        for (VkImageMemoryBarrier& barrier : vBarriers)
+        {
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        vkCmdPipelineBarrier(batch.m_transferCmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(vBarriers.size()), vBarriers.data());
+
+        std::vector<VkBufferImageCopy> vRegions;
+        for (const PendingUpload& upload : batch.m_vUploads)
+        {
+            // One region per mip level
+            vRegions.resize(upload.m_vLevels.size());
+            for (size_t i = 0; i < upload.m_vLevels.size(); i++)
+            {
+                const MipLevel& level = upload.m_vLevels[i];
+                VkBufferImageCopy& region = vRegions[i];
+                region = {};
+                region.bufferOffset = upload.m_uOffset + level.m_nOffset;
+                region.bufferRowLength = 0;
+                region.bufferImageHeight = 0;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = {0, 0, 0};
+                region.imageExtent = {level.m_uWidth, level.m_uHeight, 1};
+            }
+            vkCmdCopyBufferToImage(batch.m_transferCmdBuf, upload.m_buffer, upload.m_pTexture->getImage(),
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(vRegions.size()), vRegions.data());
+        }
+
+        // DST_OPTIMAL -> SHADER_READ_ONLY, released to the graphics family
+        // when the queues differ
+        for (VkImageMemoryBarrier& barrier : vBarriers)
+        {
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcQueueFamilyIndex = bTransferOwnership ? uTransferFamily : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = bTransferOwnership ? uGraphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = bTransferOwnership ? 0 : VK_ACCESS_SHADER_READ_BIT;
+        }
+        vkCmdPipelineBarrier(batch.m_transferCmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             bTransferOwnership ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : TEXTURE_CONSUMER_STAGES,
+                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(vBarriers.size()), vBarriers.data());
+    }
+    vkEndCommandBuffer(batch.m_transferCmdBuf);
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkResult result = vkCreateFence(pDevice->GetDevice(), &fenceInfo, nullptr, &batch.m_fence);
+    assert(result == VK_SUCCESS);
+
+    VkSubmitInfo transferSubmitInfo = {};
+    transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transferSubmitInfo.commandBufferCount = 1;
+    transferSubmitInfo.pCommandBuffers = &batch.m_transferCmdBuf;
+
+    if (!bTransferOwnership)
+    {
+        result = vkQueueSubmit(pDevice->GetTransferQueue(), 1, &transferSubmitInfo, batch.m_fence);
+        assert(result == VK_SUCCESS);
+    }
+    else
+    {
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        result = vkCreateSemaphore(pDevice->GetDevice(), &semaphoreInfo, nullptr, &batch.m_releaseSemaphore);
+        assert(result == VK_SUCCESS);
+        transferSubmitInfo.signalSemaphoreCount = 1;
+        transferSubmitInfo.pSignalSemaphores = &batch.m_releaseSemaphore;
+        result = vkQueueSubmit(pDevice->GetTransferQueue(), 1, &transferSubmitInfo, VK_NULL_HANDLE);
+        assert(result == VK_SUCCESS);
+
+        // Matching acquire on the graphics queue
+        batch.m_acquireCmdBuf = pDevice->AllocateImmediateCommandBuffer();
+        vkBeginCommandBuffer(batch.m_acquireCmdBuf, &beginInfo);
+        for (VkImageMemoryBarrier& barrier : vBarriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        // Same stages as the semaphore wait so the acquire chains with it
+        vkCmdPipelineBarrier(batch.m_acquireCmdBuf, TEXTURE_CONSUMER_STAGES, TEXTURE_CONSUMER_STAGES,
+                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(vBarriers.size()), vBarriers.data());
+        vkEndCommandBuffer(batch.m_acquireCmdBuf);
+
+        VkSubmitInfo acquireSubmitInfo = {};
+        acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireSubmitInfo.waitSemaphoreCount = 1;
+        acquireSubmitInfo.pWaitSemaphores = &batch.m_releaseSemaphore;
+        acquireSubmitInfo.pWaitDstStageMask = &TEXTURE_CONSUMER_STAGES;
+        acquireSubmitInfo.commandBufferCount = 1;
+        acquireSubmitInfo.pCommandBuffers = &batch.m_acquireCmdBuf;
+        result = vkQueueSubmit(pDevice->GetGraphicsQueue(), 1, &acquireSubmitInfo, batch.m_fence);
+        assert(result == VK_SUCCESS);
+    }
+    (void)result;
+    m_qInFlight.push_back(std::move(batch));
+}
+
+bool TextureStreamer::RetireOldest(bool bWait)
+{
+    if (m_qInFlight.empty())
+    {
+        return false;
+    }
+    VkDevice device = GetRenderDevice()->GetDevice();
+    UploadBatch& batch = m_qInFlight.front();
+    if (bWait)
+    {
+        VkResult result = vkWaitForFences(device, 1, &batch.m_fence, VK_TRUE, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        (void)result;
+    }
+    else if (vkGetFenceStatus(device, batch.m_fence) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    for (PendingUpload& upload : batch.m_vUploads)
+    {
+        upload.m_pTexture->SetResident();
+        if (upload.m_dedicatedAllocation != VK_NULL_HANDLE)
+        {
+            GetMemoryAllocator()->FreeBuffer(upload.m_buffer, upload.m_dedicatedAllocation);
+        }
+    }
+    GetRenderDevice()->FreeTransferCommandBuffer(batch.m_transferCmdBuf);
+    if (batch.m_acquireCmdBuf != VK_NULL_HANDLE)
+    {
+        GetRenderDevice()->FreeImmediateCommandBuffer(batch.m_acquireCmdBuf);
+    }
+    vkDestroySemaphore(device, batch.m_releaseSemaphore, nullptr);
+    vkDestroyFence(device, batch.m_fence, nullptr);
+
+    // A batch ending before the tail was staged after the head wrapped
+    if (batch.m_uRingEnd < m_uTail)
+    {
+        m_bWrapped = false;
+    }
+    m_uTail = batch.m_uRingEnd;
+    m_qInFlight.pop_front();
+    m_bHasNewResidents = true;
+    return true;
+}
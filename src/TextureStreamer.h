@@ -0,0 +1,79 @@
+#pragma once
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "MipChain.h"
+
+class Texture;
+
+// Uploads texture pixels on the transfer queue through a persistently mapped
+// staging ring. Images are released to the graphics queue family once copied,
+// materials sample a placeholder texture until then.
+class TextureStreamer
+{
+public:
+    void Initialize(VkDeviceSize uStagingSize = 64 * 1024 * 1024);
+    void Unintialize();
+
+    // Copy RGBA8 mip levels packed in pData to staging and queue the upload
+    // of the texture's image, the data can be released right after
+    void RequestUpload(Texture* pTexture, const void* pData, size_t nSize, const std::vector<MipLevel>& vLevels);
+
+    // Submit queued uploads and retire finished ones. Returns true if any
+    // texture became resident since the last call.
+    bool Update();
+
+    // Submit queued uploads and wait for all of them
+    void Flush();
+
+    const Texture* GetPlaceholder() const { return m_pPlaceholder.get(); }
+
+private:
+    struct PendingUpload
+    {
+        Texture* m_pTexture = nullptr;
+        VkBuffer m_buffer = VK_NULL_HANDLE;
+        VkDeviceSize m_uOffset = 0;
+        std::vector<MipLevel> m_vLevels;
+        // Uploads larger than the ring get their own staging buffer
+        VmaAllocation m_dedicatedAllocation = VK_NULL_HANDLE;
+    };
+
+    struct UploadBatch
+    {
+        std::vector<PendingUpload> m_vUploads;
+        VkCommandBuffer m_transferCmdBuf = VK_NULL_HANDLE;
+        VkCommandBuffer m_acquireCmdBuf = VK_NULL_HANDLE;
+        VkSemaphore m_releaseSemaphore = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+        // Ring position freed when the batch retires
+        VkDeviceSize m_uRingEnd = 0;
+    };
+
+    bool AllocateStaging(VkDeviceSize uSize, VkDeviceSize& uOffset);
+    void Submit();
+    // Retire the oldest batch if it finished, or wait for it
+    bool RetireOldest(bool bWait);
+    bool IsRingEmpty() const { return m_vPending.empty() && m_qInFlight.empty(); }
+
+    VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_stagingAllocation = VK_NULL_HANDLE;
+    uint8_t* m_pStagingData = nullptr;
+    VkDeviceSize m_uStagingSize = 0;
+    VkDeviceSize m_uHead = 0;
+    VkDeviceSize m_uTail = 0;
+    // Head wrapped around and is behind the tail
+    bool m_bWrapped = false;
+
+    std::vector<PendingUpload> m_vPending;
+    std::deque<UploadBatch> m_qInFlight;
+    bool m_bHasNewResidents = false;
+
+    std::unique_ptr<Texture> m_pPlaceholder = nullptr;
+};
+
+TextureStreamer* GetTextureStreamer();
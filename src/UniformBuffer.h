@@ -30,19 +30,12 @@ class UniformBuffer : public BufferResource
 public:
     UniformBuffer()
         : BufferResource(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                         VMA_MEMORY_USAGE_CPU_TO_GPU)
-
+                         BufferUploadPolicy::HOST_VISIBLE, "Uniform Buffer")
     {
-        const size_t size = sizeof(T);
-        GetMemoryAllocator()->AllocateBuffer(size, BUFFER_USAGE, MEMORY_USAGE,
-                                             m_buffer, m_allocation,
-                                             "Uniform Buffer");
+        SetData(nullptr, sizeof(T));
     }
     void setData(const T& buffer)
     {
-        void* pMappedMemory = nullptr;
-        GetMemoryAllocator()->MapBuffer(m_allocation, &pMappedMemory);
-        memcpy(pMappedMemory, (void*)&buffer, sizeof(T));
-        GetMemoryAllocator()->UnmapBuffer(m_allocation);
+        WriteMappedData(&buffer, 0, sizeof(T));
     }
 };
@@ -0,0 +1,379 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "VkMemoryAllocator.h"
+#include "VkRenderDevice.h"
+
+static UploadManager s_uploadManager;
+
+UploadManager* GetUploadManager()
+{
+    return &s_uploadManager;
+}
+
+void UploadManager::Initialize(VkDeviceSize uStagingSize)
+{
+    assert(m_stagingBuffer == VK_NULL_HANDLE);
+    m_uStagingSize = uStagingSize;
+    GetMemoryAllocator()->AllocateBuffer(
+        m_uStagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_MEMORY_USAGE_CPU_ONLY, m_stagingBuffer, m_stagingAllocation, "Buffer staging ring");
+    m_pStagingData = static_cast<uint8_t*>(GetMemoryAllocator()->GetMappedData(m_stagingAllocation));
+}
+
+void UploadManager::Unintialize()
+{
+    Flush();
+    for (VkFence fence : m_vFreeFences)
+    {
+        vkDestroyFence(GetRenderDevice()->GetDevice(), fence, nullptr);
+    }
+    m_vFreeFences.clear();
+    GetMemoryAllocator()->FreeBuffer(m_stagingBuffer, m_stagingAllocation);
+    m_pStagingData = nullptr;
+    m_stagingBuffer = VK_NULL_HANDLE;
+}
+
+// Stages and accesses reading a buffer of the given usage
+static void GetConsumerScope(VkBufferUsageFlags usage, VkPipelineStageFlags& uStages, VkAccessFlags& uAccess)
+{
+    const VkPipelineStageFlags SHADER_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                               VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+    {
+        uStages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        uAccess |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+    {
+        uStages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        uAccess |= VK_ACCESS_INDEX_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+    {
+        uStages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        uAccess |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+    {
+        uStages |= SHADER_STAGES;
+        uAccess |= VK_ACCESS_UNIFORM_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    {
+        uStages |= SHADER_STAGES;
+        uAccess |= VK_ACCESS_SHADER_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+    {
+        uStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        uAccess |= VK_ACCESS_TRANSFER_READ_BIT;
+    }
+    // Acceleration structure builds read geometry and instances through
+    // device addresses
+    if (GetRenderDevice()->IsRayTracingSupported() &&
+        (usage & (VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                  VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR)))
+    {
+        uStages |= VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+        uAccess |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    }
+}
+
+void UploadManager::UploadBuffer(VkBuffer dstBuffer, VkBufferUsageFlags dstUsage, VkDeviceSize uDstOffset,
+                                 const void* pData, VkDeviceSize uSize)
+{
+    assert(m_pStagingData != nullptr && "Upload manager is not initialized");
+    if (uSize == 0)
+    {
+        return;
+    }
+    PendingCopy copy;
+    copy.m_dstBuffer = dstBuffer;
+    copy.m_region.dstOffset = uDstOffset;
+    copy.m_region.size = uSize;
+    if (uSize > m_uStagingSize)
+    {
+        GetMemoryAllocator()->AllocateBuffer(
+            uSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_ONLY, copy.m_srcBuffer, copy.m_dedicatedAllocation, "Buffer staging");
+        memcpy(GetMemoryAllocator()->GetMappedData(copy.m_dedicatedAllocation), pData, uSize);
+        GetMemoryAllocator()->FlushAllocation(copy.m_dedicatedAllocation, 0, uSize);
+    }
+    else
+    {
+        // Recycle the oldest uploads until the ring has room
+        while (!AllocateStaging(uSize, copy.m_region.srcOffset))
+        {
+            Submit();
+            RetireOldest(true);
+        }
+        memcpy(m_pStagingData + copy.m_region.srcOffset, pData, uSize);
+        GetMemoryAllocator()->FlushAllocation(m_stagingAllocation, copy.m_region.srcOffset, uSize);
+        copy.m_srcBuffer = m_stagingBuffer;
+    }
+    // After any Submit above, which resets the scope of the batch
+    GetConsumerScope(dstUsage, m_uDstStages, m_uDstAccess);
+    m_vPending.push_back(copy);
+}
+
+void UploadManager::Update()
+{
+    Submit();
+    while (RetireOldest(false))
+        ;
+}
+
+void UploadManager::Flush()
+{
+    Submit();
+    while (RetireOldest(true))
+        ;
+}
+
+void UploadManager::ResolveOverlaps()
+{
+    // Queue order is kept per destination
+    std::stable_sort(m_vPending.begin(), m_vPending.end(),
+                     [](const PendingCopy& a, const PendingCopy& b) { return a.m_dstBuffer < b.m_dstBuffer; });
+    std::vector<PendingCopy> vResolved;
+    vResolved.reserve(m_vPending.size());
+    std::vector<const PendingCopy*> vSorted;
+    std::vector<PendingCopy> vParts;
+    // Parts of a copy outside [uStart, uEnd) of its destination
+    auto ClipCopy = [&vParts](const PendingCopy& copy, VkDeviceSize uStart, VkDeviceSize uEnd) {
+        const VkDeviceSize uCopyStart = copy.m_region.dstOffset;
+        const VkDeviceSize uCopyEnd = uCopyStart + copy.m_region.size;
+        if (uEnd <= uCopyStart || uStart >= uCopyEnd)
+        {
+            vParts.push_back(copy);
+            return;
+        }
+        if (uCopyStart < uStart)
+        {
+            PendingCopy head = copy;
+            head.m_region.size = uStart - uCopyStart;
+            vParts.push_back(head);
+        }
+        if (uCopyEnd > uEnd)
+        {
+            PendingCopy tail = copy;
+            tail.m_region.srcOffset += uEnd - uCopyStart;
+            tail.m_region.dstOffset = uEnd;
+            tail.m_region.size = uCopyEnd - uEnd;
+            vParts.push_back(tail);
+        }
+    };
+    for (size_t i = 0; i < m_vPending.size();)
+    {
+        size_t uEnd = i;
+        while (uEnd < m_vPending.size() && m_vPending[uEnd].m_dstBuffer == m_vPending[i].m_dstBuffer)
+        {
+            uEnd++;
+        }
+
+        vSorted.clear();
+        for (size_t j = i; j < uEnd; j++)
+        {
+            vSorted.push_back(&m_vPending[j]);
+        }
+        std::sort(vSorted.begin(), vSorted.end(), [](const PendingCopy* pA, const PendingCopy* pB) {
+            return pA->m_region.dstOffset < pB->m_region.dstOffset;
+        });
+        bool bOverlaps = false;
+        for (size_t j = 1; j < vSorted.size() && !bOverlaps; j++)
+        {
+            bOverlaps = vSorted[j - 1]->m_region.dstOffset + vSorted[j - 1]->m_region.size >
+                        vSorted[j]->m_region.dstOffset;
+        }
+
+        const size_t uFirst = vResolved.size();
+        for (size_t j = i; j < uEnd; j++)
+        {
+            const PendingCopy& copy = m_vPending[j];
+            if (bOverlaps)
+            {
+                // Later uploads win, earlier ones keep what is left
+                vParts.clear();
+                for (size_t k = uFirst; k < vResolved.size(); k++)
+                {
+                    ClipCopy(vResolved[k], copy.m_region.dstOffset, copy.m_region.dstOffset + copy.m_region.size);
+                }
+                vResolved.resize(uFirst);
+                vResolved.insert(vResolved.end(), vParts.begin(), vParts.end());
+            }
+            vResolved.push_back(copy);
+        }
+        i = uEnd;
+    }
+    m_vPending.swap(vResolved);
+}
+
+bool UploadManager::AllocateStaging(VkDeviceSize uSize, VkDeviceSize& uOffset)
+{
+    // Keeps copies of vertex and index data aligned
+    const VkDeviceSize ALIGNMENT = 16;
+    if (IsIdle())
+    {
+        m_uHead = m_uTail = 0;
+        m_bWrapped = false;
+    }
+    const VkDeviceSize uStart = (m_uHead + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (m_bWrapped)
+    {
+        // Free range is [head, tail)
+        if (uStart + uSize > m_uTail)
+        {
+            return false;
+        }
+        uOffset = uStart;
+    }
+    else if (uStart + uSize <= m_uStagingSize)
+    {
+        // Free range is [head, end) then [0, tail)
+        uOffset = uStart;
+    }
+    else if (uSize <= m_uTail)
+    {
+        uOffset = 0;
+        m_bWrapped = true;
+    }
+    else
+    {
+        return false;
+    }
+    m_uHead = uOffset + uSize;
+    return true;
+}
+
+void UploadManager::Submit()
+{
+    if (m_vPending.empty())
+    {
+        return;
+    }
+    VkRenderDevice* pDevice = GetRenderDevice();
+
+    UploadBatch batch;
+    batch.m_uRingEnd = m_uHead;
+    // Dedicated staging is freed with the batch even if its copy was
+    // superseded
+    for (const PendingCopy& copy : m_vPending)
+    {
+        if (copy.m_dedicatedAllocation != VK_NULL_HANDLE)
+        {
+            batch.m_vDedicatedCopies.push_back(copy);
+        }
+    }
+    ResolveOverlaps();
+    // Copies between the same pair of buffers go in a single command
+    std::stable_sort(m_vPending.begin(), m_vPending.end(), [](const PendingCopy& a, const PendingCopy& b) {
+        return a.m_srcBuffer != b.m_srcBuffer ? a.m_srcBuffer < b.m_srcBuffer : a.m_dstBuffer < b.m_dstBuffer;
+    });
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    batch.m_cmdBuf = pDevice->AllocateImmediateCommandBuffer();
+    vkBeginCommandBuffer(batch.m_cmdBuf, &beginInfo);
+    {
+        std::vector<VkBufferCopy> vRegions;
+        for (size_t i = 0; i < m_vPending.size();)
+        {
+            const PendingCopy& first = m_vPending[i];
+            vRegions.clear();
+            for (; i < m_vPending.size() && m_vPending[i].m_srcBuffer == first.m_srcBuffer &&
+                   m_vPending[i].m_dstBuffer == first.m_dstBuffer;
+                 i++)
+            {
+                vRegions.push_back(m_vPending[i].m_region);
+            }
+            vkCmdCopyBuffer(batch.m_cmdBuf, first.m_srcBuffer, first.m_dstBuffer,
+                            static_cast<uint32_t>(vRegions.size()), vRegions.data());
+        }
+
+        // Only the stages consuming the uploaded buffers wait for the
+        // copies, other work of later submissions overlaps them
+        if (m_uDstStages == 0)
+        {
+            m_uDstStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            m_uDstAccess = VK_ACCESS_MEMORY_READ_BIT;
+        }
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = m_uDstAccess;
+        vkCmdPipelineBarrier(batch.m_cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, m_uDstStages,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    vkEndCommandBuffer(batch.m_cmdBuf);
+    m_vPending.clear();
+    m_uDstStages = 0;
+    m_uDstAccess = 0;
+
+    VkResult result = VK_SUCCESS;
+    if (!m_vFreeFences.empty())
+    {
+        batch.m_fence = m_vFreeFences.back();
+        m_vFreeFences.pop_back();
+        result = vkResetFences(pDevice->GetDevice(), 1, &batch.m_fence);
+        assert(result == VK_SUCCESS);
+    }
+    else
+    {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        result = vkCreateFence(pDevice->GetDevice(), &fenceInfo, nullptr, &batch.m_fence);
+        assert(result == VK_SUCCESS);
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.m_cmdBuf;
+    result = vkQueueSubmit(pDevice->GetImmediateQueue(), 1, &submitInfo, batch.m_fence);
+    assert(result == VK_SUCCESS);
+    (void)result;
+    m_qInFlight.push_back(std::move(batch));
+}
+
+bool UploadManager::RetireOldest(bool bWait)
+{
+    if (m_qInFlight.empty())
+    {
+        return false;
+    }
+    VkDevice device = GetRenderDevice()->GetDevice();
+    UploadBatch& batch = m_qInFlight.front();
+    if (bWait)
+    {
+        VkResult result = vkWaitForFences(device, 1, &batch.m_fence, VK_TRUE, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        (void)result;
+    }
+    else if (vkGetFenceStatus(device, batch.m_fence) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    for (PendingCopy& copy : batch.m_vDedicatedCopies)
+    {
+        GetMemoryAllocator()->FreeBuffer(copy.m_srcBuffer, copy.m_dedicatedAllocation);
+    }
+    GetRenderDevice()->FreeImmediateCommandBuffer(batch.m_cmdBuf);
+    m_vFreeFences.push_back(batch.m_fence);
+
+    // A batch ending before the tail was staged after the head wrapped
+    if (batch.m_uRingEnd < m_uTail)
+    {
+        m_bWrapped = false;
+    }
+    m_uTail = batch.m_uRingEnd;
+    m_qInFlight.pop_front();
+    return true;
+}
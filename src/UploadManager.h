@@ -0,0 +1,81 @@
+#pragma once
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+
+// Uploads device local buffer data through a persistently mapped staging
+// ring. Copies queued between submits are recorded into a single command
+// buffer on the graphics queue, a trailing barrier makes them visible to
+// the stages consuming the destination buffers in later submissions. Ring
+// space is recycled once a batch's fence signals, so loading a scene no
+// longer waits on the queue per buffer.
+class UploadManager
+{
+public:
+    void Initialize(VkDeviceSize uStagingSize = 32 * 1024 * 1024);
+    void Unintialize();
+
+    // Copy uSize bytes of pData to staging and queue their copy to the
+    // buffer, the data can be released right after. The usage of the
+    // destination picks the stages the batch's barrier waits in.
+    void UploadBuffer(VkBuffer dstBuffer, VkBufferUsageFlags dstUsage, VkDeviceSize uDstOffset, const void* pData,
+                      VkDeviceSize uSize);
+
+    // Record queued copies and submit them, command buffers submitted to the
+    // graphics queue afterwards see the data
+    void Submit();
+    // Submit queued copies and recycle the staging of finished ones
+    void Update();
+    // Submit queued copies and wait for all of them
+    void Flush();
+
+    // Buffers with copies queued or in flight must not be freed
+    bool IsIdle() const { return m_vPending.empty() && m_qInFlight.empty(); }
+
+private:
+    struct PendingCopy
+    {
+        VkBuffer m_srcBuffer = VK_NULL_HANDLE;
+        VkBuffer m_dstBuffer = VK_NULL_HANDLE;
+        VkBufferCopy m_region = {};
+        // Uploads larger than the ring get their own staging buffer
+        VmaAllocation m_dedicatedAllocation = VK_NULL_HANDLE;
+    };
+
+    struct UploadBatch
+    {
+        std::vector<PendingCopy> m_vDedicatedCopies;
+        VkCommandBuffer m_cmdBuf = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+        // Ring position freed when the batch retires
+        VkDeviceSize m_uRingEnd = 0;
+    };
+
+    bool AllocateStaging(VkDeviceSize uSize, VkDeviceSize& uOffset);
+    // Regions of one copy command must not overlap, and separate commands
+    // would race. Later uploads to a range replace earlier ones.
+    void ResolveOverlaps();
+    // Retire the oldest batch if it finished, or wait for it
+    bool RetireOldest(bool bWait);
+
+    VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_stagingAllocation = VK_NULL_HANDLE;
+    uint8_t* m_pStagingData = nullptr;
+    VkDeviceSize m_uStagingSize = 0;
+    VkDeviceSize m_uHead = 0;
+    VkDeviceSize m_uTail = 0;
+    // Head wrapped around and is behind the tail
+    bool m_bWrapped = false;
+
+    std::vector<PendingCopy> m_vPending;
+    // Consumers of the pending copies
+    VkPipelineStageFlags m_uDstStages = 0;
+    VkAccessFlags m_uDstAccess = 0;
+    std::deque<UploadBatch> m_qInFlight;
+    // Fences of retired batches, reset before reuse
+    std::vector<VkFence> m_vFreeFences;
+};
+
+UploadManager* GetUploadManager();
@@ -1,58 +1,27 @@
 #pragma once
-#include <vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
-#include <array>
-#include <cassert>
-#include <glm/glm.hpp>
-#include <iostream>
-#include <memory>
-#include <vector>
-#include <cstring>
+#include <string>
 
-#include "VkMemoryAllocator.h"
-#include "VkRenderDevice.h"
-class MemoryBuffer
-{
-public:
-    MemoryBuffer(bool stagedUpload = true);
-    void* map();
-    void unmap();
-    void setData(const void* data, size_t size);
-    void flush();
-    const VkBuffer& buffer() const { return m_buffer; }
-    virtual ~MemoryBuffer();
-protected:
-    std::string m_sBufferName = "";
-    VkBufferUsageFlags m_bufferUsageFlags;
-private:
-    VkBuffer m_buffer = VK_NULL_HANDLE;
-    VmaAllocation m_allocation = VK_NULL_HANDLE;
-
-    VmaMemoryUsage m_memoryUsage;
-    size_t m_nSize = 0;
-};
+#include "RenderResource.h"
 
-class VertexBuffer : public MemoryBuffer
+class VertexBuffer : public BufferResource
 {
 public:
-    VertexBuffer(bool stagedUpload = true,
-                 std::string sBufferName = "vertex buffer")
-        : MemoryBuffer(stagedUpload)
+    VertexBuffer(BufferUploadPolicy uploadPolicy = BufferUploadPolicy::STAGED,
+                 const std::string& sBufferName = "vertex buffer")
+        : BufferResource(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                         uploadPolicy, sBufferName)
     {
-        m_bufferUsageFlags |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-        m_sBufferName = sBufferName;
     }
-private:
 };
 
-class IndexBuffer : public MemoryBuffer
+class IndexBuffer : public BufferResource
 {
 public:
-    IndexBuffer(bool stagedUpload = true,
-                 std::string sBufferName = "index buffer")
-        : MemoryBuffer(stagedUpload)
+    IndexBuffer(BufferUploadPolicy uploadPolicy = BufferUploadPolicy::STAGED,
+                const std::string& sBufferName = "index buffer")
+        : BufferResource(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                         uploadPolicy, sBufferName)
     {
-        m_bufferUsageFlags |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-        m_sBufferName = sBufferName;
     }
 };
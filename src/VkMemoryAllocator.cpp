@@ -1,5 +1,6 @@
 #include "VkMemoryAllocator.h"
 #include "VkRenderDevice.h"
+#include <array>
 #include <cassert>
 #include <string>
 VkMemoryAllocator::VkMemoryAllocator() {}
@@ -10,12 +11,55 @@ void VkMemoryAllocator::Initalize(VkRenderDevice* pDevice)
     allocatorInfo.physicalDevice = pDevice->GetPhysicalDevice();
     allocatorInfo.device = pDevice->GetDevice();
     allocatorInfo.instance = pDevice->GetInstance();
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_2;
     allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (pDevice->IsMemoryBudgetSupported())
+    {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
     m_pAllocator = std::make_unique<VmaAllocator>();
     vmaCreateAllocator(&allocatorInfo, m_pAllocator.get());
+
+    // The memory type fits every device local buffer usage of the pool
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = 1024;
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VmaPoolCreateInfo poolInfo = {};
+    VkResult result =
+        vmaFindMemoryTypeIndexForBufferInfo(*m_pAllocator, &bufferInfo, &allocInfo, &poolInfo.memoryTypeIndex);
+    assert(result == VK_SUCCESS);
+    result = vmaCreatePool(*m_pAllocator, &poolInfo, &m_movableBufferPool);
+    assert(result == VK_SUCCESS);
+    (void)result;
 }
 
-void VkMemoryAllocator::Unintialize() { vmaDestroyAllocator(*m_pAllocator); }
+void VkMemoryAllocator::Unintialize()
+{
+    vmaDestroyPool(*m_pAllocator, m_movableBufferPool);
+    m_movableBufferPool = VK_NULL_HANDLE;
+    vmaDestroyAllocator(*m_pAllocator);
+}
+
+// Host visible usages. CPU_TO_GPU prefers device local memory on discrete
+// GPUs, so with resizable BAR uploads land in VRAM directly.
+static VmaAllocationCreateFlags GetMappingFlags(VmaMemoryUsage nMemoryUsageFlags)
+{
+    switch (nMemoryUsageFlags)
+    {
+    case VMA_MEMORY_USAGE_CPU_ONLY:
+    case VMA_MEMORY_USAGE_CPU_TO_GPU:
+    case VMA_MEMORY_USAGE_GPU_TO_CPU:
+    case VMA_MEMORY_USAGE_CPU_COPY:
+        return VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    default:
+        return 0;
+    }
+}
 
 
 void VkMemoryAllocator::AllocateBuffer(size_t nSize,
@@ -31,6 +75,7 @@ void VkMemoryAllocator::AllocateBuffer(size_t nSize,
 
     VmaAllocationCreateInfo allocInfo = {};
     allocInfo.usage = nMemoryUsageFlags;
+    allocInfo.flags = GetMappingFlags(nMemoryUsageFlags);
 
     vmaCreateBuffer(*m_pAllocator, &bufferInfo, &allocInfo, &buffer,
                     &allocation, nullptr);
@@ -50,6 +95,23 @@ void VkMemoryAllocator::AllocateBuffer(size_t nSize,
 
     VmaAllocationCreateInfo allocInfo = {};
     allocInfo.usage = nMemoryUsageFlags;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT | GetMappingFlags(nMemoryUsageFlags);
+    allocInfo.pUserData = bufferName.data();
+
+    vmaCreateBuffer(*m_pAllocator, &bufferInfo, &allocInfo, &buffer,
+                    &allocation, nullptr);
+}
+
+void VkMemoryAllocator::AllocateMovableBuffer(size_t nSize, VkBufferUsageFlags nBufferUsageFlags, VkBuffer& buffer,
+                                              VmaAllocation& allocation, std::string bufferName)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = nSize;
+    bufferInfo.usage = nBufferUsageFlags;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.pool = m_movableBufferPool;
     allocInfo.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
     allocInfo.pUserData = bufferName.data();
 
@@ -62,14 +124,105 @@ void VkMemoryAllocator::FreeBuffer(VkBuffer& buffer, VmaAllocation& allocation)
     vmaDestroyBuffer(*m_pAllocator, buffer, allocation);
 }
 
-void VkMemoryAllocator::MapBuffer(VmaAllocation& allocation, void** ppData)
+void* VkMemoryAllocator::GetMappedData(VmaAllocation& allocation)
+{
+    VmaAllocationInfo allocationInfo = {};
+    vmaGetAllocationInfo(*m_pAllocator, allocation, &allocationInfo);
+    return allocationInfo.pMappedData;
+}
+
+void VkMemoryAllocator::FlushAllocation(VmaAllocation& allocation, VkDeviceSize uOffset, VkDeviceSize uSize)
 {
-    vmaMapMemory(*m_pAllocator, allocation, ppData);
+    vmaFlushAllocation(*m_pAllocator, allocation, uOffset, uSize);
 }
 
-void VkMemoryAllocator::UnmapBuffer(VmaAllocation& allocation)
+void VkMemoryAllocator::InvalidateAllocation(VmaAllocation& allocation, VkDeviceSize uOffset, VkDeviceSize uSize)
 {
-    vmaUnmapMemory(*m_pAllocator, allocation);
+    vmaInvalidateAllocation(*m_pAllocator, allocation, uOffset, uSize);
+}
+
+bool VkMemoryAllocator::IsDeviceLocal(VmaAllocation& allocation)
+{
+    VmaAllocationInfo allocationInfo = {};
+    vmaGetAllocationInfo(*m_pAllocator, allocation, &allocationInfo);
+    VkMemoryPropertyFlags memoryFlags = 0;
+    vmaGetMemoryTypeProperties(*m_pAllocator, allocationInfo.memoryType, &memoryFlags);
+    return (memoryFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+}
+
+void VkMemoryAllocator::GetDeviceLocalBudget(VkDeviceSize& uUsage, VkDeviceSize& uBudget)
+{
+    const VkPhysicalDeviceMemoryProperties* pMemoryProperties = nullptr;
+    vmaGetMemoryProperties(*m_pAllocator, &pMemoryProperties);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> aBudgets = {};
+    vmaGetBudget(*m_pAllocator, aBudgets.data());
+
+    uUsage = 0;
+    uBudget = 0;
+    for (uint32_t i = 0; i < pMemoryProperties->memoryHeapCount; i++)
+    {
+        if (pMemoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            uUsage += aBudgets[i].usage;
+            uBudget += aBudgets[i].budget;
+        }
+    }
+}
+
+void VkMemoryAllocator::GetMovableBufferPoolUsage(VkDeviceSize& uUsed, VkDeviceSize& uUnused)
+{
+    VmaPoolStats stats = {};
+    vmaGetPoolStats(*m_pAllocator, m_movableBufferPool, &stats);
+    uUsed = stats.size - stats.unusedSize;
+    uUnused = stats.unusedSize;
+}
+
+VmaDefragmentationContext VkMemoryAllocator::BeginDefragmentation(const std::vector<VmaAllocation>& vAllocations,
+                                                                  std::vector<VkBool32>& vMoved,
+                                                                  VkDeviceSize uMaxBytes,
+                                                                  VkCommandBuffer cmdBuf)
+{
+    vMoved.assign(vAllocations.size(), VK_FALSE);
+    VmaDefragmentationInfo2 defragInfo = {};
+    defragInfo.allocationCount = static_cast<uint32_t>(vAllocations.size());
+    defragInfo.pAllocations = vAllocations.data();
+    defragInfo.pAllocationsChanged = vMoved.data();
+    defragInfo.maxCpuBytesToMove = uMaxBytes;
+    defragInfo.maxCpuAllocationsToMove = UINT32_MAX;
+    defragInfo.maxGpuBytesToMove = uMaxBytes;
+    defragInfo.maxGpuAllocationsToMove = UINT32_MAX;
+    defragInfo.commandBuffer = cmdBuf;
+
+    VmaDefragmentationContext context = VK_NULL_HANDLE;
+    const VkResult result = vmaDefragmentationBegin(*m_pAllocator, &defragInfo, nullptr, &context);
+    assert(result == VK_SUCCESS || result == VK_NOT_READY);
+    (void)result;
+    return context;
+}
+
+void VkMemoryAllocator::EndDefragmentation(VmaDefragmentationContext context)
+{
+    vmaDefragmentationEnd(*m_pAllocator, context);
+}
+
+void VkMemoryAllocator::RebindBuffer(VkBuffer& buffer, VmaAllocation& allocation,
+                                     VkDeviceSize uSize, VkBufferUsageFlags nBufferUsageFlags)
+{
+    VkDevice device = GetRenderDevice()->GetDevice();
+    vkDestroyBuffer(device, buffer, nullptr);
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = uSize;
+    bufferInfo.usage = nBufferUsageFlags;
+    VkResult result = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
+    assert(result == VK_SUCCESS);
+    // Queried to keep the validation layers quiet, the allocation fits
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(device, buffer, &requirements);
+    result = vmaBindBufferMemory(*m_pAllocator, allocation, buffer);
+    assert(result == VK_SUCCESS);
+    (void)result;
 }
 
 void VkMemoryAllocator::AllocateImage(const VkImageCreateInfo* pImageInfo,
@@ -87,5 +240,35 @@ void VkMemoryAllocator::FreeImage(VkImage& image, VmaAllocation &allocation)
     vmaDestroyImage(*m_pAllocator, image, allocation);
 }
 
+bool VkMemoryAllocator::AllocateMemory(const VkMemoryRequirements& requirements,
+                                       VmaMemoryUsage nMemoryUsageFlags,
+                                       VmaAllocation& allocation)
+{
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = nMemoryUsageFlags;
+    return vmaAllocateMemory(*m_pAllocator, &requirements, &allocInfo,
+                             &allocation, nullptr) == VK_SUCCESS;
+}
+
+void VkMemoryAllocator::FreeMemory(VmaAllocation& allocation)
+{
+    vmaFreeMemory(*m_pAllocator, allocation);
+    allocation = VK_NULL_HANDLE;
+}
+
+void VkMemoryAllocator::BindImageMemory(VmaAllocation& allocation, VkImage image)
+{
+    VkResult result = vmaBindImageMemory(*m_pAllocator, allocation, image);
+    assert(result == VK_SUCCESS);
+    (void)result;
+}
+
+uint32_t VkMemoryAllocator::GetMemoryType(VmaAllocation& allocation)
+{
+    VmaAllocationInfo allocationInfo = {};
+    vmaGetAllocationInfo(*m_pAllocator, allocation, &allocationInfo);
+    return allocationInfo.memoryType;
+}
+
 static VkMemoryAllocator allocator;
 VkMemoryAllocator* GetMemoryAllocator() { return &allocator; }
@@ -2,6 +2,7 @@
 #include <vk_mem_alloc.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 class VkRenderDevice;
 
@@ -19,17 +20,59 @@ public:
                         VmaMemoryUsage nMemoryUsageFlags, VkBuffer &buffer,
                         VmaAllocation &allocation,
                         std::string bufferName);
+    // Device local buffers defragmentation may move. They get a pool of
+    // their own so its fragmentation is measured without unmovable images.
+    void AllocateMovableBuffer(size_t size, VkBufferUsageFlags nBufferUsageFlags, VkBuffer &buffer,
+                               VmaAllocation &allocation, std::string bufferName);
     void FreeBuffer(VkBuffer &buffer, VmaAllocation &allocation);
-    void MapBuffer(VmaAllocation &allocation, void **ppData);
-    void UnmapBuffer(VmaAllocation &allocation);
+    // Buffers in host visible memory are mapped for their whole lifetime,
+    // returns nullptr for device only memory
+    void *GetMappedData(VmaAllocation &allocation);
+    // Make host writes visible to the device and device writes visible to
+    // the host, no-ops on coherent memory
+    void FlushAllocation(VmaAllocation &allocation, VkDeviceSize uOffset, VkDeviceSize uSize);
+    void InvalidateAllocation(VmaAllocation &allocation, VkDeviceSize uOffset, VkDeviceSize uSize);
+    // Memory of the allocation is device local, for host visible
+    // allocations this means it is reached through the BAR
+    bool IsDeviceLocal(VmaAllocation &allocation);
+
+    // Usage and budget summed over device local heaps. Exact with
+    // VK_EXT_memory_budget, estimated from VMA's own allocations otherwise.
+    void GetDeviceLocalBudget(VkDeviceSize &uUsage, VkDeviceSize &uBudget);
+    // Bytes used by allocations and left free in the movable buffer pool
+    void GetMovableBufferPoolUsage(VkDeviceSize &uUsed, VkDeviceSize &uUnused);
+
+    // Move allocations to compact their memory blocks, copying at most
+    // uMaxBytes. Host visible data moves right away, copies of device local
+    // data are recorded to cmdBuf which must have finished before
+    // EndDefragmentation(). vMoved tells which allocations moved from then on.
+    VmaDefragmentationContext BeginDefragmentation(const std::vector<VmaAllocation> &vAllocations,
+                                                   std::vector<VkBool32> &vMoved,
+                                                   VkDeviceSize uMaxBytes,
+                                                   VkCommandBuffer cmdBuf);
+    void EndDefragmentation(VmaDefragmentationContext context);
+    // Replace the buffer of a moved allocation by one bound to its new place
+    void RebindBuffer(VkBuffer &buffer, VmaAllocation &allocation,
+                      VkDeviceSize uSize, VkBufferUsageFlags nBufferUsageFlags);
 
     void AllocateImage(const VkImageCreateInfo *pImageInfo,
                        VmaMemoryUsage nMemoryUsageFlags, VkImage &image,
                        VmaAllocation &allocation);
     void FreeImage(VkImage &image, VmaAllocation &allocation);
 
+    // Memory for resources bound by the caller, several resources may
+    // alias it. Fails when no memory type of the usage fits, e.g. lazily
+    // allocated memory on most desktop GPUs.
+    bool AllocateMemory(const VkMemoryRequirements &requirements,
+                        VmaMemoryUsage nMemoryUsageFlags,
+                        VmaAllocation &allocation);
+    void FreeMemory(VmaAllocation &allocation);
+    void BindImageMemory(VmaAllocation &allocation, VkImage image);
+    uint32_t GetMemoryType(VmaAllocation &allocation);
+
 private:
     std::unique_ptr<VmaAllocator> m_pAllocator = nullptr;
+    VmaPool m_movableBufferPool = VK_NULL_HANDLE;
 };
 
 VkMemoryAllocator *GetMemoryAllocator();
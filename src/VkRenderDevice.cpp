@@ -1,5 +1,6 @@
 #include "VkRenderDevice.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "Debug.h"
@@ -212,14 +213,51 @@ void VkRenderDevice::CreateDevice(
     // Handle queue family indices and add them to the device creation info
 
     int queueFamilyIndex = 0;  //TODO: Enumerate proper queue family for different usages
+
+    // Prefer a transfer only family, which usually maps to the DMA engines,
+    // then any family without graphics. Fall back to the graphics queue.
+    int transferQueueFamilyIndex = -1;
+    for (int j = 0; j < (int)queueFamilies.size() && transferQueueFamilyIndex == -1; j++)
+    {
+        const VkQueueFlags flags = queueFamilies[j].queueFlags;
+        if (queueFamilies[j].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            transferQueueFamilyIndex = j;
+        }
+    }
+    for (int j = 0; j < (int)queueFamilies.size() && transferQueueFamilyIndex == -1; j++)
+    {
+        // Compute queues support transfer implicitly
+        const VkQueueFlags flags = queueFamilies[j].queueFlags;
+        if (queueFamilies[j].queueCount > 0 && (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            !(flags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            transferQueueFamilyIndex = j;
+        }
+    }
+    if (transferQueueFamilyIndex == -1)
+    {
+        transferQueueFamilyIndex = queueFamilyIndex;
+    }
+
     float queuePriority = 1.0f;
     // Create a queue for each of the family
-    VkDeviceQueueCreateInfo queueCreateInfo = {};
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    // Queue are stored in the orders
-    queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    std::vector<VkDeviceQueueCreateInfo> vQueueCreateInfos;
+    for (int family : {queueFamilyIndex, transferQueueFamilyIndex})
+    {
+        if (!vQueueCreateInfos.empty() && vQueueCreateInfos[0].queueFamilyIndex == (uint32_t)family)
+        {
+            continue;
+        }
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        // Queue are stored in the orders
+        queueCreateInfo.queueFamilyIndex = family;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+        vQueueCreateInfos.push_back(queueCreateInfo);
+    }
 
     struct ExtensionHeader  // Helper struct to link extensions together
     {
@@ -259,14 +297,30 @@ void VkRenderDevice::CreateDevice(
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
-    createInfo.pQueueCreateInfos = &queueCreateInfo;
-    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = vQueueCreateInfos.data();
+    createInfo.queueCreateInfoCount = static_cast<uint32_t>(vQueueCreateInfos.size());
 
     createInfo.pEnabledFeatures = nullptr;
     createInfo.pNext = &features2;
 
-    createInfo.enabledExtensionCount = vDeviceExtensions.size();
-    createInfo.ppEnabledExtensionNames = vDeviceExtensions.data();
+    // Memory budget queries are optional, enable them where available
+    std::vector<const char*> vEnabledDeviceExtensions = vDeviceExtensions;
+    {
+        uint32_t uExtensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &uExtensionCount, nullptr);
+        std::vector<VkExtensionProperties> vSupportedExtensions(uExtensionCount);
+        vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &uExtensionCount, vSupportedExtensions.data());
+        for (const VkExtensionProperties& extension : vSupportedExtensions)
+        {
+            if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            {
+                vEnabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                m_bIsMemoryBudgetSupported = true;
+            }
+        }
+    }
+    createInfo.enabledExtensionCount = vEnabledDeviceExtensions.size();
+    createInfo.ppEnabledExtensionNames = vEnabledDeviceExtensions.data();
 
     createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
     createInfo.ppEnabledLayerNames = layers.data();
@@ -287,6 +341,16 @@ void VkRenderDevice::CreateDevice(
 
         setDebugUtilsObjectName(reinterpret_cast<uint64_t>(graphicsQueue), VK_OBJECT_TYPE_QUEUE, "Graphics/Present Queue");
     }
+    {
+        VkQueue transferQueue = VK_NULL_HANDLE;
+        vkGetDeviceQueue(m_device, transferQueueFamilyIndex,
+                         0, &transferQueue);
+        SetTransferQueue(transferQueue, transferQueueFamilyIndex);
+        if (transferQueueFamilyIndex != queueFamilyIndex)
+        {
+            setDebugUtilsObjectName(reinterpret_cast<uint64_t>(transferQueue), VK_OBJECT_TYPE_QUEUE, "Transfer Queue");
+        }
+    }
 }
 
 void VkRenderDevice::DestroyDevice()
@@ -378,6 +442,15 @@ void VkRenderDevice::CreateCommandPools()
                                    &commandPoolInfo, nullptr,
                                    &m_aCommandPools[PER_FRAME_CMD_POOL]) == VK_SUCCESS);
     }
+    // Transfer pool
+    {
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        commandPoolInfo.queueFamilyIndex = m_transferQueueFamilyIndex;
+        VkResult result = vkCreateCommandPool(m_device, &commandPoolInfo, nullptr,
+                                              &m_aCommandPools[TRANSFER_CMD_POOL]);
+        assert(result == VK_SUCCESS);
+        (void)result;
+    }
 }
 
 void VkRenderDevice::DestroyCommandPools()
@@ -423,6 +496,16 @@ void VkRenderDevice::FreeImmediateCommandBuffer(VkCommandBuffer& commandBuffer)
     FreePrimaryCommandbuffer(commandBuffer, IMMEDIATE_CMD_POOL);
 }
 
+VkCommandBuffer VkRenderDevice::AllocateTransferCommandBuffer()
+{
+    return AllocatePrimaryCommandbuffer(TRANSFER_CMD_POOL);
+}
+
+void VkRenderDevice::FreeTransferCommandBuffer(VkCommandBuffer& commandBuffer)
+{
+    FreePrimaryCommandbuffer(commandBuffer, TRANSFER_CMD_POOL);
+}
+
 VkCommandBuffer VkRenderDevice::AllocateSecondaryCommandBuffer()
 {
     // TODO: Implement this
@@ -434,43 +517,6 @@ void VkRenderDevice::FreeSecondaryCommandBuffer(VkCommandBuffer& commandBuffer)
                          &commandBuffer);
 }
 
-// Helper functions
-VkSampler VkRenderDevice::CreateSampler()
-{
-    VkSamplerCreateInfo samplerInfo = {};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-
-    // Wrapping
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-    // Anistropic filter
-    samplerInfo.anisotropyEnable = VK_FALSE;
-    samplerInfo.maxAnisotropy = 1;
-
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    // Choose of [0, width] or [0, 1]
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-
-    // Used for percentage-closer filter for shadow
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-
-    // mipmaps
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-
-    VkSampler sampler = VK_NULL_HANDLE;
-    assert(vkCreateSampler(m_device, &samplerInfo,
-                           nullptr, &sampler) == VK_SUCCESS);
-    return sampler;
-}
-
 VkCommandBuffer VkRenderDevice::AllocatePrimaryCommandbuffer(CommandPools pool)
 {
     VkCommandBuffer commandBuffer;
@@ -497,9 +543,42 @@ void VkRenderDevice::BeginFrame()
     // Wait for previous command renders to current swaphchain image to finish
     vkWaitForFences(m_device, 1, &m_aGPUExecutionFence[m_uImageIdx2Present], VK_TRUE, std::numeric_limits<uint64_t>::max());
     vkResetFences(m_device, 1, &m_aGPUExecutionFence[m_uImageIdx2Present]);
+    m_aIsFrameSubmitted[m_uImageIdx2Present] = false;
+}
+
+void VkRenderDevice::WaitForFrames()
+{
+    std::vector<VkFence> vFences;
+    for (size_t i = 0; i < m_aGPUExecutionFence.size(); i++)
+    {
+        if (m_aIsFrameSubmitted[i])
+        {
+            vFences.push_back(m_aGPUExecutionFence[i]);
+        }
+    }
+    if (!vFences.empty())
+    {
+        VkResult result = vkWaitForFences(m_device, static_cast<uint32_t>(vFences.size()), vFences.data(), VK_TRUE,
+                                          std::numeric_limits<uint64_t>::max());
+        assert(result == VK_SUCCESS);
+        (void)result;
+    }
 }
 
-void VkRenderDevice::SubmitCommandBuffers(std::vector<VkCommandBuffer>& vCmdBuffers)
+uint64_t VkRenderDevice::GetCompletedFrameCount() const
+{
+    uint64_t uCompleted = m_uSubmittedFrameCount;
+    for (size_t i = 0; i < m_aGPUExecutionFence.size(); i++)
+    {
+        if (m_aIsFrameSubmitted[i] && vkGetFenceStatus(m_device, m_aGPUExecutionFence[i]) != VK_SUCCESS)
+        {
+            uCompleted = std::min(uCompleted, m_aFrameNumbers[i] - 1);
+        }
+    }
+    return uCompleted;
+}
+
+void VkRenderDevice::SubmitCommandBuffers(const VkCommandBuffer* pCmdBuffers, uint32_t uCount)
 {
     VkPipelineStageFlags stageFlag =
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;  // only color attachment waits for the semaphore
@@ -509,22 +588,24 @@ void VkRenderDevice::SubmitCommandBuffers(std::vector<VkCommandBuffer>& vCmdBuff
     submitInfo.pWaitSemaphores = &m_imageAvailableSemaphore;
     submitInfo.pWaitDstStageMask = &stageFlag;
 
-    submitInfo.commandBufferCount = static_cast<uint32_t>(vCmdBuffers.size());
-    submitInfo.pCommandBuffers = vCmdBuffers.data();
+    submitInfo.commandBufferCount = uCount;
+    submitInfo.pCommandBuffers = pCmdBuffers;
 
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &m_renderFinishedSemaphore;
 
     assert(vkQueueSubmit(GetGraphicsQueue(), 1, &submitInfo,
                          m_aGPUExecutionFence[m_uImageIdx2Present]) == VK_SUCCESS);
+    m_aIsFrameSubmitted[m_uImageIdx2Present] = true;
+    m_aFrameNumbers[m_uImageIdx2Present] = ++m_uSubmittedFrameCount;
 }
 
-void VkRenderDevice::SubmitCommandBuffersAndWait(std::vector<VkCommandBuffer>& vCmdBuffers)
+void VkRenderDevice::SubmitCommandBuffersAndWait(const VkCommandBuffer* pCmdBuffers, uint32_t uCount)
 {
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = static_cast<uint32_t>(vCmdBuffers.size());
-    submitInfo.pCommandBuffers = vCmdBuffers.data();
+    submitInfo.commandBufferCount = uCount;
+    submitInfo.pCommandBuffers = pCmdBuffers;
 
     assert(vkQueueSubmit(GetGraphicsQueue(), 1, &submitInfo, nullptr) ==
            VK_SUCCESS);
@@ -557,6 +638,13 @@ VkDeviceAddress VkRenderDevice::GetBufferDeviceAddress(VkBuffer buffer) const
     return deviceAddress;
 }
 
+bool VkRenderDevice::IsFormatSampleable(VkFormat format) const
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &formatProperties);
+    return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
 // Debug device 
 //
 void VkDebugRenderDevice::Initialize(
@@ -20,6 +20,8 @@ public:
         return false;
 #endif
     }
+    // VK_EXT_memory_budget got enabled at device creation
+    bool IsMemoryBudgetSupported() const { return m_bIsMemoryBudgetSupported; }
     virtual void Initialize(const std::vector<const char*>& vExtensions, const std::vector<const char*>& vLayers = std::vector<const char*>());
 
     virtual void Unintialize();
@@ -50,9 +52,12 @@ public:
     VkQueue& GetGraphicsQueue() { return m_graphicsQueue; }
     VkQueue& GetImmediateQueue() { return m_graphicsQueue;} // TODO: Handle copy queue
     VkQueue& GetPresentQueue() { return m_presentQueue; }
+    // Dedicated transfer queue if the device has one, the graphics queue otherwise
+    VkQueue& GetTransferQueue() { return m_transferQueue; }
     VkInstance& GetInstance() { return m_instance; }
     int GetGraphicsQueueFamilyIndex() const { return m_graphicsQueueFamilyIndex; }
     int GetPresentQueueFamilyIndex() const { return m_presentQueueFamilyIndex; }
+    int GetTransferQueueFamilyIndex() const { return m_transferQueueFamilyIndex; }
 
     void SetDevice(VkDevice device) { m_device = device; }
     void SetPhysicalDevice(VkPhysicalDevice physicalDevice)
@@ -71,6 +76,12 @@ public:
         m_presentQueueFamilyIndex = queueFamilyIndex;
     }
 
+    void SetTransferQueue(VkQueue transferQueue, int queueFamilyIndex)
+    {
+        m_transferQueue = transferQueue;
+        m_transferQueueFamilyIndex = queueFamilyIndex;
+    }
+
     // TODO: Add compute queue if needed
 
     void SetInstance(VkInstance instance)
@@ -92,6 +103,10 @@ public:
     VkCommandBuffer AllocateImmediateCommandBuffer();
     void FreeImmediateCommandBuffer(VkCommandBuffer& commandBuffer);
 
+    // Command buffers to be submitted on the transfer queue
+    VkCommandBuffer AllocateTransferCommandBuffer();
+    void FreeTransferCommandBuffer(VkCommandBuffer& commandBuffer);
+
     // Comamnd buffer executions
     template <typename Func>
     void ExecuteImmediateCommand(Func fImmediateGPUTask)
@@ -119,9 +134,6 @@ public:
     {
     }
 
-    // Helper functions
-    VkSampler CreateSampler();
-
     VkExtent2D GetViewportSize() const { return m_viewportSize; }
     void SetViewportSize(VkExtent2D vp);
 
@@ -129,18 +141,29 @@ public:
 
     void BeginFrame();
     void Present();
-    void SubmitCommandBuffers(std::vector<VkCommandBuffer>& vCmdBuffers);
-    void SubmitCommandBuffersAndWait(std::vector<VkCommandBuffer>& vCmdBuffers);
+    void SubmitCommandBuffers(const VkCommandBuffer* pCmdBuffers, uint32_t uCount);
+    void SubmitCommandBuffersAndWait(const VkCommandBuffer* pCmdBuffers, uint32_t uCount);
     uint32_t GetFrameIdx() const {return m_uImageIdx2Present;}
+    // Wait for the fences of all submitted frames, their command buffers
+    // can be re-recorded afterwards
+    void WaitForFrames();
+    // Frames are numbered by submission, resources used up to frame N can
+    // be released once GetCompletedFrameCount() >= N
+    uint64_t GetSubmittedFrameCount() const { return m_uSubmittedFrameCount; }
+    uint64_t GetCompletedFrameCount() const;
 
     VkDeviceAddress GetBufferDeviceAddress(VkBuffer buffer) const;
 
+    // Optimal tiling images of this format can be sampled
+    bool IsFormatSampleable(VkFormat format) const;
+
 private: // Private structures
     enum CommandPools
     {
         MAIN_CMD_POOL,
         IMMEDIATE_CMD_POOL,
         PER_FRAME_CMD_POOL,
+        TRANSFER_CMD_POOL,
         NUM_CMD_POOLS
     };
 
@@ -217,6 +240,7 @@ private:  // Members
     VkDevice m_device = VK_NULL_HANDLE;
     VkQueue m_graphicsQueue = VK_NULL_HANDLE;
     VkQueue m_presentQueue = VK_NULL_HANDLE;
+    VkQueue m_transferQueue = VK_NULL_HANDLE;
     VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
 
     std::array<VkCommandPool, NUM_CMD_POOLS> m_aCommandPools = {VK_NULL_HANDLE,
@@ -224,8 +248,10 @@ private:  // Members
 
     int m_graphicsQueueFamilyIndex = -1;
     int m_presentQueueFamilyIndex = -1;
+    int m_transferQueueFamilyIndex = -1;
     int m_computeQueueFamilyIndex = -1;
     bool m_bIsValidationEnabled = false;
+    bool m_bIsMemoryBudgetSupported = false;
     std::vector<const char*> m_vLayers;
 
     VkExtent2D m_viewportSize;
@@ -235,6 +261,10 @@ private:  // Members
     VkSemaphore m_imageAvailableSemaphore = VK_NULL_HANDLE;   // Semaphores to notify the frame when the current image is ready
     VkSemaphore m_renderFinishedSemaphore = VK_NULL_HANDLE;
     std::array<VkFence, NUM_BUFFERS> m_aGPUExecutionFence;
+    // Fences reset by BeginFrame are only waited on once submitted
+    std::array<bool, NUM_BUFFERS> m_aIsFrameSubmitted = {};
+    std::array<uint64_t, NUM_BUFFERS> m_aFrameNumbers = {};
+    uint64_t m_uSubmittedFrameCount = 0;
     uint32_t m_uImageIdx2Present = 0;
 protected:
     VkInstance m_instance = VK_NULL_HANDLE;
@@ -22,10 +22,15 @@
 #include "../thirdparty/tinyobjloader/tiny_obj_loader.h"
 #include "Camera.h"
 #include "Debug.h"
+#include "Defragmentation.h"
 #include "DescriptorManager.h"
+#include "FrameArena.h"
+#include "FrameUniformAllocator.h"
 #include "Geometry.h"
+#include "GeometryHeap.h"
 #include "ImGuiGlfwControl.h"
 #include "Material.h"
+#include "MemoryBudget.h"
 #include "MeshVertex.h"
 #include "PipelineStateBuilder.h"
 #include "RenderPass.h"
@@ -35,6 +40,9 @@
 #include "RenderResourceManager.h"
 #include "SamplerManager.h"
 #include "Texture.h"
+#include "TextureResidency.h"
+#include "TextureStreamer.h"
+#include "UploadManager.h"
 #include "UniformBuffer.h"
 #include "VertexBuffer.h"
 #include "VkMemoryAllocator.h"
@@ -201,6 +209,7 @@ void cleanup()
 {
     GetDescriptorManager()->destroyDescriptorSetLayouts();
     GetDescriptorManager()->destroyDescriptorPool();
+    GetSamplerManager()->destroySamplers();
 
     GetRenderDevice()->DestroySwapchain();
     GetRenderDevice()->DestroyCommandPools();
@@ -212,9 +221,42 @@ void cleanup()
     glfwTerminate();
 }
 
+// --texture-quality=high|medium|low, otherwise picked from the device local
+// memory budget
+static TextureQualityTiers ChooseTextureQualityTier(int argc, char **argv)
+{
+    static const char *QUALITY_OPTION = "--texture-quality=";
+    static const char *TIER_NAMES[TEXTURE_QUALITY_TIER_COUNT] = {"high", "medium", "low"};
+    const size_t nOptionLength = strlen(QUALITY_OPTION);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], QUALITY_OPTION, nOptionLength) != 0)
+        {
+            continue;
+        }
+        for (int nTier = 0; nTier < TEXTURE_QUALITY_TIER_COUNT; nTier++)
+        {
+            if (strcmp(argv[i] + nOptionLength, TIER_NAMES[nTier]) == 0)
+            {
+                return static_cast<TextureQualityTiers>(nTier);
+            }
+        }
+        std::cerr << "Unknown texture quality " << argv[i] + nOptionLength << std::endl;
+    }
+
+    const VkDeviceSize GB = 1024ull * 1024 * 1024;
+    VkDeviceSize uUsage = 0, uBudget = 0;
+    GetMemoryAllocator()->GetDeviceLocalBudget(uUsage, uBudget);
+    if (uBudget < 2 * GB)
+    {
+        return TEXTURE_QUALITY_LOW;
+    }
+    return uBudget < 4 * GB ? TEXTURE_QUALITY_MEDIUM : TEXTURE_QUALITY_HIGH;
+}
+
 static bool bIrradianceMapGenerated = false;
 
-void updateUniformBuffer(UniformBuffer<PerViewData> *ub)
+void updateUniformBuffer()
 {
     static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -238,10 +280,10 @@ void updateUniformBuffer(UniformBuffer<PerViewData> *ub)
     ubo.viewToObject = glm::inverse(ubo.objectToView);
     ubo.normalObjectToView = glm::transpose(ubo.viewToObject);
 
-    ub->setData(ubo);
+    GetFrameUniformAllocator()->SetPerViewData(ubo);
 };
 
-int main()
+int main(int argc, char **argv)
 {
     // Load mesh into memory
     InitGLFW();
@@ -279,12 +321,30 @@ int main()
     GetRenderDevice()->SetViewportSize(VkExtent2D{WIDTH, HEIGHT});
 
     GetRenderDevice()->CreateCommandPools();
+    GetUploadManager()->Initialize();
 
     // Initialize managers
-    GetDescriptorManager()->createDescriptorPool();
+    // Layouts reference immutable samplers
+    GetSamplerManager()->createSamplers();
+    GetDescriptorManager()->createDescriptorPool(
+        static_cast<uint32_t>(GetRenderDevice()->GetSwapchain()->GetImageViews().size()));
     GetDescriptorManager()->createDescriptorSetLayouts();
 
-    GetSamplerManager()->createSamplers();
+    // Caps textures loaded from now on
+    GetTextureManager()->SetQualityTier(ChooseTextureQualityTier(argc, argv));
+    GetTextureStreamer()->Initialize();
+    GetTextureResidencyManager()->Initialize();
+    // Binds the mip feedback buffer
+    GetMaterialManager()->Initialize();
+    GetMemoryBudgetManager()->Initialize();
+    // Owners of buffers compaction may move
+    GetDefragmentationManager()->Initialize();
+    GetDefragmentationManager()->Register(GetGeometryHeap());
+    GetDefragmentationManager()->Register(GetMaterialManager());
+    // A region per swapchain image, frames index them by image
+    GetFrameUniformAllocator()->Initialize(
+        static_cast<uint32_t>(GetRenderDevice()->GetSwapchain()->GetImageViews().size()));
+    GetFrameArena()->Initialize();
 
     VkExtent2D vpExtent = {WIDTH, HEIGHT};
 
@@ -328,13 +388,6 @@ int main()
             rayTracingBuilder.Cleanup();
 
         }
-        // Create perview constant buffer
-        //
-
-        UniformBuffer<PerViewData> *pUniformBuffer =
-            GetRenderResourceManager()->getUniformBuffer<PerViewData>(
-                "perView");
-
         // Load materials
         GetMaterialManager()->CreateDefaultMaterial();
 
@@ -344,12 +397,45 @@ int main()
         while (!glfwWindowShouldClose(s_pWindow))
         {
             glfwPollEvents();
+            // Scratch memory of the previous frame is no longer referenced
+            GetFrameArena()->Reset();
 
-            updateUniformBuffer(pUniformBuffer);
+            updateUniformBuffer();
 
-            GetRenderDevice()->BeginFrame();
+            // Swap HLOD proxies, the draw lists are baked into static command
+            // buffers so they need re-recording
+            glm::vec3 vEye = glm::vec3(glm::inverse(s_arcball.getViewMat())[3]);
+            if (GetSceneManager()->UpdateHLOD(vEye))
+            {
+                GetRenderPassManager()->RecordGeometryCmdBuffers(GetSceneManager()->GatherDrawLists());
+            }
+
+            // Evict least recently used memory when over budget, then queue
+            // the texture levels requested by the mip feedback
+            GetMemoryBudgetManager()->Update();
+            GetTextureResidencyManager()->Update();
+
+            // Streamed textures that finished uploading replace their
+            // placeholders or previous levels in the bindless material set.
+            // It is update after bind, so the static command buffers stay
+            // valid. Replaced slots and images are released once the frames
+            // sampling them are done.
+            GetTextureStreamer()->Update();
+            GetTextureResidencyManager()->ApplyResidencyChanges();
+            GetMaterialManager()->UpdateStreamedTextures();
+            // Compact fragmented memory, the static command buffers bind
+            // the moved buffers
+            if (GetDefragmentationManager()->Update())
+            {
+                GetRenderPassManager()->RecordStaticCmdBuffers(GetSceneManager()->GatherDrawLists());
+            }
 
-            
+            GetRenderDevice()->BeginFrame();
+            // The frame's fence is signaled, its uniform region is free
+            GetFrameUniformAllocator()->BeginFrame(GetRenderDevice()->GetFrameIdx());
+            GetDescriptorManager()->BeginFrame(GetRenderDevice()->GetFrameIdx());
+            // Buffer uploads queued since the last frame go ahead of it
+            GetUploadManager()->Update();
 
             // Handle resizing
             {
@@ -370,8 +456,8 @@ int main()
             VkExtent2D vpExt = {WIDTH, HEIGHT};
             GetRenderPassManager()->RecordDynamicCmdBuffers(uFrameIdx, vpExt);
 
-            std::vector<VkCommandBuffer> vCmdBufs = GetRenderPassManager()->GetCommandBuffers(uFrameIdx);
-            GetRenderDevice()->SubmitCommandBuffers(vCmdBufs);
+            FrameVector<VkCommandBuffer> vCmdBufs = GetRenderPassManager()->GetCommandBuffers(uFrameIdx);
+            GetRenderDevice()->SubmitCommandBuffers(vCmdBufs.data(), static_cast<uint32_t>(vCmdBufs.size()));
 
             GetRenderDevice()->Present();
             ImGui::UpdateMousePosAndButtons();
@@ -386,11 +472,20 @@ int main()
         // Destroy managers
         GetMaterialManager()->destroyMaterials();
         GetGeometryManager()->Destroy();
-        GetSamplerManager()->destroySamplers();
+        GetMemoryBudgetManager()->Unintialize();
+        GetDefragmentationManager()->Unintialize();
         GetTextureManager()->Destroy();
+        GetMaterialManager()->Unintialize();
+        GetFrameUniformAllocator()->Unintialize();
+        GetFrameArena()->Unintialize();
+        GetTextureResidencyManager()->Unintialize();
+        GetTextureStreamer()->Unintialize();
     }
     ImGui::Shutdown();
     GetRenderPassManager()->Unintialize();
+    // After the passes, the IBL layer owns a skybox
+    GetGeometryHeap()->Unintialize();
+    GetUploadManager()->Unintialize();
     cleanup();
     return 0;
 }
@@ -0,0 +1,216 @@
+// Offline texture cooker, compresses the material images of a glTF scene to
+// KTX2 files next to the sources. The importer picks them up in place of the
+// original images.
+//
+//   textureCooker scene.gltf
+//   textureCooker image.png color|normal|scalar
+#include <tiny_gltf.h>
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+
+#include "../KTX2.h"
+#include "../MipChain.h"
+#include "../TextureCompression.h"
+#include "../TexturePacking.h"
+#include "../../thirdparty/stb/stb_image.h"
+
+static bool SkipImageData(tinygltf::Image *, const int, std::string *, std::string *, int, int,
+                          const unsigned char *, int, void *)
+{
+    return true;
+}
+
+struct CookedFormat
+{
+    BlockFormat m_blockFormat;
+    VkFormat m_vkFormat;
+};
+
+static const CookedFormat COLOR_FORMAT = {BlockFormat::BC7, VK_FORMAT_BC7_UNORM_BLOCK};
+static const CookedFormat NORMAL_FORMAT = {BlockFormat::BC5, VK_FORMAT_BC5_UNORM_BLOCK};
+static const CookedFormat SCALAR_FORMAT = {BlockFormat::BC4, VK_FORMAT_BC4_UNORM_BLOCK};
+
+static bool CookPixels(const uint8_t *pPixels, uint32_t uWidth, uint32_t uHeight, const CookedFormat &format,
+                       const std::filesystem::path &cookedPath)
+{
+    std::vector<uint8_t> vChain;
+    std::vector<MipLevel> vLevels;
+    BuildMipChain(pPixels, uWidth, uHeight, vChain, vLevels);
+
+    KTX2Image image;
+    image.m_format = format.m_vkFormat;
+    image.m_uWidth = uWidth;
+    image.m_uHeight = uHeight;
+    CompressMipChain(vChain, vLevels, format.m_blockFormat, image.m_vData, image.m_vLevels);
+
+    if (!WriteKTX2(cookedPath.string(), image))
+    {
+        std::cerr << "Failed to write " << cookedPath << std::endl;
+        return false;
+    }
+    std::cout << cookedPath.string() << ": " << vChain.size() / 1024 << " KB -> " << image.m_vData.size() / 1024
+              << " KB" << std::endl;
+    return true;
+}
+
+static bool CookImage(const std::filesystem::path &imagePath, const CookedFormat &format)
+{
+    int nWidth = 0, nHeight = 0, nChannels = 0;
+    stbi_uc *pPixels = stbi_load(imagePath.string().c_str(), &nWidth, &nHeight, &nChannels, STBI_rgb_alpha);
+    if (pPixels == nullptr)
+    {
+        std::cerr << "Failed to load " << imagePath << std::endl;
+        return false;
+    }
+    std::filesystem::path cookedPath = imagePath;
+    cookedPath.replace_extension(".ktx2");
+    const bool bCooked = CookPixels(pPixels, (uint32_t)nWidth, (uint32_t)nHeight, format, cookedPath);
+    stbi_image_free(pPixels);
+    return bCooked;
+}
+
+// Pack separate occlusion and metallic roughness maps the way the importer
+// does at load, either path may be empty
+static bool CookORM(const std::filesystem::path &occlusionPath, const std::filesystem::path &metallicRoughnessPath)
+{
+    PackingSource aSources[2];
+    stbi_uc *apPixels[2] = {nullptr, nullptr};
+    const std::filesystem::path *apPaths[2] = {&occlusionPath, &metallicRoughnessPath};
+    bool bLoaded = true;
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (apPaths[i]->empty())
+        {
+            continue;
+        }
+        int nWidth = 0, nHeight = 0, nChannels = 0;
+        apPixels[i] = stbi_load(apPaths[i]->string().c_str(), &nWidth, &nHeight, &nChannels, STBI_rgb_alpha);
+        if (apPixels[i] == nullptr)
+        {
+            std::cerr << "Failed to load " << *apPaths[i] << std::endl;
+            bLoaded = false;
+            continue;
+        }
+        aSources[i].m_pPixels = apPixels[i];
+        aSources[i].m_uWidth = (uint32_t)nWidth;
+        aSources[i].m_uHeight = (uint32_t)nHeight;
+    }
+
+    bool bCooked = false;
+    if (bLoaded)
+    {
+        std::vector<uint8_t> vPixels;
+        uint32_t uWidth = 0, uHeight = 0;
+        PackORM(aSources[0], aSources[1], vPixels, uWidth, uHeight);
+        bCooked = CookPixels(vPixels.data(), uWidth, uHeight, COLOR_FORMAT,
+                             GetPackedORMPath(occlusionPath.string(), metallicRoughnessPath.string()));
+    }
+    stbi_image_free(apPixels[0]);
+    stbi_image_free(apPixels[1]);
+    return bCooked;
+}
+
+static int CookScene(const std::filesystem::path &scenePath)
+{
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(SkipImageData, nullptr);
+    tinygltf::Model model;
+    std::string sError, sWarning;
+    if (!loader.LoadASCIIFromFile(&model, &sError, &sWarning, scenePath.string()))
+    {
+        std::cerr << sError << std::endl;
+        return 1;
+    }
+
+    // Albedo to BC7 and normals to BC5. Images used by several slots stay
+    // BC7.
+    std::map<int, const CookedFormat *> mImageFormats;
+    auto AssignFormat = [&](int nTextureIdx, const CookedFormat &format) {
+        if (nTextureIdx < 0 || model.textures[nTextureIdx].source < 0)
+        {
+            return;
+        }
+        const int nImageIdx = model.textures[nTextureIdx].source;
+        auto it = mImageFormats.find(nImageIdx);
+        if (it == mImageFormats.end())
+        {
+            mImageFormats[nImageIdx] = &format;
+        }
+        else if (it->second != &format)
+        {
+            it->second = &COLOR_FORMAT;
+        }
+    };
+    auto GetImagePath = [&](int nTextureIdx) {
+        if (nTextureIdx < 0 || model.textures[nTextureIdx].source < 0)
+        {
+            return std::filesystem::path();
+        }
+        return scenePath.parent_path() / model.images[model.textures[nTextureIdx].source].uri;
+    };
+    // Occlusion, roughness and metalness are packed into one BC7 map, images
+    // holding all three are cooked as they are
+    std::set<std::pair<std::filesystem::path, std::filesystem::path>> sORMMaps;
+    for (const tinygltf::Material &material : model.materials)
+    {
+        AssignFormat(material.pbrMetallicRoughness.baseColorTexture.index, COLOR_FORMAT);
+        AssignFormat(material.normalTexture.index, NORMAL_FORMAT);
+
+        const int nMetallicRoughnessIdx = material.pbrMetallicRoughness.metallicRoughnessTexture.index;
+        const std::filesystem::path metallicRoughnessPath = GetImagePath(nMetallicRoughnessIdx);
+        // Same rule as the importer, occlusion on another UV set than
+        // metallic roughness is not packed
+        const bool bSkipOcclusion = !metallicRoughnessPath.empty() &&
+                                    material.occlusionTexture.texCoord !=
+                                        material.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
+        const std::filesystem::path occlusionPath =
+            bSkipOcclusion ? std::filesystem::path() : GetImagePath(material.occlusionTexture.index);
+        if (occlusionPath == metallicRoughnessPath)
+        {
+            AssignFormat(nMetallicRoughnessIdx, COLOR_FORMAT);
+        }
+        else
+        {
+            sORMMaps.emplace(occlusionPath, metallicRoughnessPath);
+        }
+    }
+
+    int nResult = 0;
+    for (const auto &it : mImageFormats)
+    {
+        const std::filesystem::path imagePath = scenePath.parent_path() / model.images[it.first].uri;
+        nResult |= CookImage(imagePath, *it.second) ? 0 : 1;
+    }
+    for (const auto &maps : sORMMaps)
+    {
+        nResult |= CookORM(maps.first, maps.second) ? 0 : 1;
+    }
+    return nResult;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2)
+    {
+        return CookScene(argv[1]);
+    }
+    if (argc == 3)
+    {
+        const std::string sUsage = argv[2];
+        const CookedFormat *pFormat = sUsage == "color"    ? &COLOR_FORMAT
+                                      : sUsage == "normal" ? &NORMAL_FORMAT
+                                      : sUsage == "scalar" ? &SCALAR_FORMAT
+                                                           : nullptr;
+        if (pFormat != nullptr)
+        {
+            return CookImage(argv[1], *pFormat) ? 0 : 1;
+        }
+    }
+    std::cerr << "Usage: " << argv[0] << " scene.gltf" << std::endl
+              << "       " << argv[0] << " image color|normal|scalar" << std::endl;
+    return 1;
+}